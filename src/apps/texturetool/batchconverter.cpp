@@ -0,0 +1,349 @@
+#include "batchconverter.h"
+#include "exception.h"
+
+#include <TextureLib/TextureIO>
+
+#include <QtGui/QImageReader>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include <functional>
+
+namespace TextureTool {
+
+namespace {
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(std::function<void()> function) : m_function(std::move(function)) {}
+    void run() override { m_function(); }
+
+private:
+    std::function<void()> m_function;
+};
+
+QByteArray mimeTypeToFormat(QStringView mimeType)
+{
+    if (mimeType == u"image/png")
+        return QByteArrayLiteral("png");
+    if (mimeType == u"image/jpeg")
+        return QByteArrayLiteral("jpg");
+    if (mimeType == u"image/bmp")
+        return QByteArrayLiteral("bmp");
+
+    return {};
+}
+
+// Writes are prioritized over reads, so the finished textures leave memory as soon as possible
+constexpr int readPriority = 0;
+constexpr int writePriority = 1;
+
+} // namespace
+
+/*!
+    Reads the texture from the file with the given \a fileName. If TextureIO does not support
+    the file, QImageReader is used. Throws RuntimeError on failure.
+*/
+Texture readTexture(const QString &fileName, const QString &mimeType)
+{
+    TextureIO io(fileName);
+    if (!mimeType.isEmpty())
+        io.setMimeType(mimeType);
+    const auto result = io.read();
+    if (result)
+        return *result;
+
+    if (result.error() == TextureIOError::UnsupportedMimeType) {
+        QImageReader reader(fileName);
+        if (!mimeType.isEmpty())
+            reader.setFormat(mimeTypeToFormat(mimeType));
+        QImage image;
+        if (reader.read(&image))
+            return Texture(image);
+        if (reader.error() != QImageReader::UnsupportedFormatError) {
+            throw RuntimeError(BatchConverter::tr("Can't read \"%1\": %2").
+                               arg(fileName, reader.errorString()));
+        }
+    }
+
+    throw RuntimeError(BatchConverter::tr("Can't read \"%1\": %2").
+                       arg(fileName, toUserString(result.error())));
+}
+
+/*!
+    Converts the \a texture to the given \a format, if set. Throws RuntimeError on failure.
+*/
+Texture convertTexture(const Texture &texture, Optional<TextureFormat> format)
+{
+    if (!format)
+        return texture;
+    const auto result = texture.convert(*format);
+    if (result.isNull())
+        throw RuntimeError(BatchConverter::tr("Convertion failed"));
+    return result;
+}
+
+/*!
+    Writes the \a texture to the file with the given \a fileName. Throws RuntimeError on failure.
+*/
+void writeTexture(const Texture &texture, const QString &fileName, const QString &mimeType)
+{
+    TextureIO io(fileName);
+    if (!mimeType.isEmpty())
+        io.setMimeType(mimeType);
+    const auto ok = io.write(texture);
+    if (!ok) {
+        throw RuntimeError(BatchConverter::tr("Can't write texture %1: %2").
+                           arg(fileName, toUserString(ok.error())));
+    }
+}
+
+class BatchConverter::Private
+{
+public:
+    using Job = BatchConverter::Job;
+
+    explicit Private(Options options) : options(std::move(options)) {}
+
+    void read(const Job &job, qint64 reserved);
+    void convert(const Job &job, Texture texture, qint64 reserved);
+    void write(const Job &job, const Texture &texture, qint64 reserved);
+    void finish(const Job &job, qint64 reserved, const QString &error = QString());
+    void reserve(qint64 &reserved, qint64 bytes);
+    void account(StageStatistics &stage, const QElapsedTimer &timer, qint64 bytes);
+
+    Options options;
+    QThreadPool ioPool;
+    QThreadPool cpuPool;
+
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    qint64 inFlightBytes {0};
+    int pending {0};
+    Statistics statistics;
+    QStringList errors;
+};
+
+void BatchConverter::Private::read(const Job &job, qint64 reserved)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Texture texture;
+    try {
+        texture = readTexture(job.inputFile, options.inputMimeType);
+    } catch (const RuntimeError &ex) {
+        finish(job, reserved, ex.message());
+        return;
+    }
+
+    {
+        QMutexLocker lock(&mutex);
+        account(statistics.read, timer, QFileInfo(job.inputFile).size());
+    }
+    // The reservation was made using the file size, switch to the decoded size
+    reserve(reserved, qint64(texture.bytes()));
+    cpuPool.start(new Task([this, job, texture = std::move(texture), reserved]() mutable {
+        convert(job, std::move(texture), reserved);
+    }));
+}
+
+void BatchConverter::Private::convert(const Job &job, Texture texture, qint64 reserved)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Texture result;
+    try {
+        result = convertTexture(texture, options.format);
+    } catch (const RuntimeError &ex) {
+        finish(job, reserved, BatchConverter::tr("%1: %2").arg(job.inputFile, ex.message()));
+        return;
+    }
+    {
+        QMutexLocker lock(&mutex);
+        account(statistics.convert, timer, options.format ? qint64(result.bytes()) : 0);
+    }
+    // Both the source and the converted texture were alive; without a format they share the data
+    if (options.format)
+        reserve(reserved, qint64(texture.bytes() + result.bytes()));
+    texture = Texture();
+    reserve(reserved, qint64(result.bytes()));
+    ioPool.start(new Task([this, job, result, reserved]() { write(job, result, reserved); }),
+                 writePriority);
+}
+
+void BatchConverter::Private::write(const Job &job, const Texture &texture, qint64 reserved)
+{
+    QElapsedTimer timer;
+    timer.start();
+    try {
+        writeTexture(texture, job.outputFile, options.outputMimeType);
+    } catch (const RuntimeError &ex) {
+        finish(job, reserved, ex.message());
+        return;
+    }
+    {
+        QMutexLocker lock(&mutex);
+        account(statistics.write, timer, QFileInfo(job.outputFile).size());
+    }
+    finish(job, reserved);
+}
+
+void BatchConverter::Private::finish(const Job &job, qint64 reserved, const QString &error)
+{
+    Q_UNUSED(job);
+    QMutexLocker lock(&mutex);
+    inFlightBytes -= reserved;
+    pending--;
+    if (error.isEmpty()) {
+        statistics.succeeded++;
+    } else {
+        statistics.failed++;
+        errors.append(error);
+    }
+    condition.wakeAll();
+}
+
+// Changes the amount of bytes reserved by a job; waiting reads are woken up when it shrinks
+void BatchConverter::Private::reserve(qint64 &reserved, qint64 bytes)
+{
+    QMutexLocker lock(&mutex);
+    inFlightBytes += bytes - reserved;
+    statistics.peakInFlightBytes = std::max(statistics.peakInFlightBytes, inFlightBytes);
+    if (bytes < reserved)
+        condition.wakeAll();
+    reserved = bytes;
+}
+
+void BatchConverter::Private::account(
+        StageStatistics &stage, const QElapsedTimer &timer, qint64 bytes)
+{
+    stage.count++;
+    stage.bytes += bytes;
+    stage.nanoseconds += timer.nsecsElapsed();
+}
+
+/*!
+    \class BatchConverter
+    This class converts many files using a pipeline with separate IO and CPU stages.
+
+    Files are read and written on a small IO thread pool while conversion runs on a CPU thread
+    pool, so reading of the next files overlaps with converting and writing of the previous ones.
+    The amount of memory held by the textures in flight is limited by
+    Options::maxInFlightBytes: new reads are not started until enough textures are written. While
+    a texture is converted, both the source and the result are accounted.
+*/
+
+/*!
+    Constructs a BatchConverter instance with the given \a options.
+*/
+BatchConverter::BatchConverter(Options options)
+    : d(std::make_unique<Private>(std::move(options)))
+{
+    const auto cpuThreads = d->options.cpuThreads > 0
+            ? d->options.cpuThreads
+            : QThread::idealThreadCount();
+    d->cpuPool.setMaxThreadCount(std::max(1, cpuThreads));
+    d->ioPool.setMaxThreadCount(std::max(1, d->options.ioThreads));
+}
+
+/*!
+    Destroys the BatchConverter object.
+*/
+BatchConverter::~BatchConverter() = default;
+
+/*!
+    Converts the given \a jobs. Returns true if all jobs succeeded.
+*/
+bool BatchConverter::run(const std::vector<Job> &jobs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (const auto &job: jobs) {
+        // A single file bigger than the limit is still processed, alone
+        const auto reserved = std::max<qint64>(1, QFileInfo(job.inputFile).size());
+        {
+            QMutexLocker lock(&d->mutex);
+            while (d->inFlightBytes > 0 && d->inFlightBytes + reserved > d->options.maxInFlightBytes)
+                d->condition.wait(&d->mutex);
+            d->inFlightBytes += reserved;
+            d->statistics.peakInFlightBytes =
+                    std::max(d->statistics.peakInFlightBytes, d->inFlightBytes);
+            d->pending++;
+        }
+        d->ioPool.start(new Task([this, job, reserved]() { d->read(job, reserved); }), readPriority);
+    }
+
+    {
+        QMutexLocker lock(&d->mutex);
+        while (d->pending > 0)
+            d->condition.wait(&d->mutex);
+    }
+    d->ioPool.waitForDone();
+    d->cpuPool.waitForDone();
+
+    QMutexLocker lock(&d->mutex);
+    d->statistics.elapsedNanoseconds = timer.nsecsElapsed();
+    return d->statistics.failed == 0;
+}
+
+/*!
+    Returns the statistics of the last run().
+*/
+BatchConverter::Statistics BatchConverter::statistics() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->statistics;
+}
+
+/*!
+    Returns the error messages of the failed jobs.
+*/
+QStringList BatchConverter::errors() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->errors;
+}
+
+/*!
+    Returns a human-readable summary with the per-stage timings.
+*/
+QString BatchConverter::summary() const
+{
+    const auto statistics = this->statistics();
+    const auto megabytes = [](qint64 bytes) { return double(bytes) / (1024 * 1024); };
+    const auto seconds = [](qint64 nanoseconds) { return double(nanoseconds) / 1e9; };
+    const auto stageLine = [&](const QString &name, const StageStatistics &stage)
+    {
+        const auto time = seconds(stage.nanoseconds);
+        const auto throughput = time > 0 ? megabytes(stage.bytes) / time : 0.0;
+        return tr("%1 %2 files %3 s %4 MB %5 MB/s").
+                arg(name, -8).
+                arg(stage.count, 6).
+                arg(time, 9, 'f', 3).
+                arg(megabytes(stage.bytes), 10, 'f', 1).
+                arg(throughput, 9, 'f', 1);
+    };
+
+    QStringList result;
+    result.append(tr("Converted %1 of %2 files in %3 s, %4 failed").
+                  arg(statistics.succeeded).
+                  arg(statistics.succeeded + statistics.failed).
+                  arg(seconds(statistics.elapsedNanoseconds), 0, 'f', 3).
+                  arg(statistics.failed));
+    result.append(stageLine(tr("read"), statistics.read));
+    result.append(stageLine(tr("convert"), statistics.convert));
+    result.append(stageLine(tr("write"), statistics.write));
+    result.append(tr("Stage times are summed over all threads; peak in-flight memory %1 MB").
+                  arg(megabytes(statistics.peakInFlightBytes), 0, 'f', 1));
+    return result.join("\n");
+}
+
+} // namespace TextureTool
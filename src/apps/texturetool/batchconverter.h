@@ -0,0 +1,74 @@
+#pragma once
+
+#include <TextureLib/Texture>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+
+#include <OptionalType>
+
+#include <memory>
+#include <vector>
+
+namespace TextureTool {
+
+Texture readTexture(const QString &fileName, const QString &mimeType = QString());
+Texture convertTexture(const Texture &texture, Optional<TextureFormat> format);
+void writeTexture(const Texture &texture, const QString &fileName, const QString &mimeType = QString());
+
+class BatchConverter
+{
+    Q_DECLARE_TR_FUNCTIONS(BatchConverter)
+    Q_DISABLE_COPY(BatchConverter)
+public:
+    struct Job
+    {
+        QString inputFile;
+        QString outputFile;
+    };
+
+    struct Options
+    {
+        QString inputMimeType;
+        QString outputMimeType;
+        Optional<TextureFormat> format;
+        int cpuThreads {0}; // 0 means QThread::idealThreadCount()
+        int ioThreads {2};
+        qint64 maxInFlightBytes {512 * 1024 * 1024};
+    };
+
+    struct StageStatistics
+    {
+        int count {0};
+        qint64 bytes {0};
+        qint64 nanoseconds {0}; // summed over all threads
+    };
+
+    struct Statistics
+    {
+        StageStatistics read;
+        StageStatistics convert;
+        StageStatistics write;
+        int succeeded {0};
+        int failed {0};
+        qint64 peakInFlightBytes {0};
+        qint64 elapsedNanoseconds {0};
+    };
+
+    explicit BatchConverter(Options options);
+    BatchConverter(BatchConverter &&) = delete;
+    ~BatchConverter();
+    BatchConverter &operator=(BatchConverter &&) = delete;
+
+    bool run(const std::vector<Job> &jobs);
+
+    Statistics statistics() const;
+    QStringList errors() const;
+    QString summary() const;
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+} // namespace TextureTool
@@ -0,0 +1,422 @@
+#include "benchtool.h"
+#include "exception.h"
+#include "toolparser.h"
+
+#include <TextureLib/TextureIO>
+#include <TextureLib/private/TextureIOHandlerDatabase>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSysInfo>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace TextureTool {
+
+namespace {
+
+constexpr gsl::span<const char> toolId = "bench";
+
+struct Options
+{
+    QStringList inputs;
+    QString outputFile;
+    int iterations {5};
+    bool cold {true};
+    bool convert {true};
+    bool write {true};
+    std::vector<TextureFormat> formats; // empty means all supported convertions
+};
+
+Options parseOptions(const QStringList &arguments)
+{
+    ToolParser parser({toolId.data(), int(toolId.size())});
+    QCommandLineOption iterationsOption({QStringLiteral("n"), QStringLiteral("iterations")},
+                                        BenchTool::tr("Number of measured iterations (default 5)"),
+                                        QStringLiteral("count"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    BenchTool::tr("Write the JSON report to a file"),
+                                    QStringLiteral("file"));
+    QCommandLineOption formatsOption(QStringLiteral("formats"),
+                                     BenchTool::tr("Comma-separated list of the convert target "
+                                                   "formats"),
+                                     QStringLiteral("formats"));
+    QCommandLineOption noColdOption(QStringLiteral("no-cold"),
+                                    BenchTool::tr("Skip reads with the dropped page cache"));
+    QCommandLineOption noConvertOption(QStringLiteral("no-convert"),
+                                       BenchTool::tr("Skip the convert benchmarks"));
+    QCommandLineOption noWriteOption(QStringLiteral("no-write"),
+                                     BenchTool::tr("Skip the write benchmarks"));
+    parser.addOption(iterationsOption);
+    parser.addOption(outputOption);
+    parser.addOption(formatsOption);
+    parser.addOption(noColdOption);
+    parser.addOption(noConvertOption);
+    parser.addOption(noWriteOption);
+    parser.addPositionalArgument(QStringLiteral("inputs"),
+                                 BenchTool::tr("Input files or directories"),
+                                 QStringLiteral("inputs..."));
+
+    parser.process(arguments);
+
+    Options options;
+    options.inputs = parser.positionalArguments();
+    if (options.inputs.isEmpty()) {
+        ToolParser::showError(BenchTool::tr("Input argument missing"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.outputFile = parser.value(outputOption);
+    options.cold = !parser.isSet(noColdOption);
+    options.convert = !parser.isSet(noConvertOption);
+    options.write = !parser.isSet(noWriteOption);
+
+    if (parser.isSet(iterationsOption)) {
+        bool ok = false;
+        options.iterations = parser.value(iterationsOption).toInt(&ok);
+        if (!ok || options.iterations <= 0) {
+            ToolParser::showError(BenchTool::tr("Invalid iterations count: %1").
+                                  arg(parser.value(iterationsOption)));
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+
+    if (parser.isSet(formatsOption)) {
+        for (const auto &name: parser.value(formatsOption).split(QLatin1Char(','))) {
+            const auto format = fromQString<TextureFormat>(name.trimmed());
+            if (!format || *format == TextureFormat::Invalid)
+                throw RuntimeError(BenchTool::tr("Invalid format: %1").arg(name));
+            options.formats.push_back(*format);
+        }
+    }
+
+    return options;
+}
+
+QStringList expandInputs(const QStringList &inputs)
+{
+    QStringList result;
+    for (const auto &input: inputs) {
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            for (const auto &entry: QDir(input).entryInfoList(QDir::Files, QDir::Name))
+                result.append(entry.filePath());
+        } else {
+            result.append(input);
+        }
+    }
+    return result;
+}
+
+// Evicts the file from the OS page cache, so the next read goes to the disk
+bool dropPageCache(const QString &filePath)
+{
+#if defined(Q_OS_LINUX)
+    const auto fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    ::fdatasync(fd);
+    const auto result = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    return result == 0;
+#else
+    Q_UNUSED(filePath);
+    return false;
+#endif
+}
+
+qint64 peakRss()
+{
+#if defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_MACOS)
+    return qint64(usage.ru_maxrss); // bytes
+#else
+    return qint64(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return -1;
+#endif
+}
+
+qint64 texelCount(const Texture &texture)
+{
+    qint64 result = 0;
+    for (int level = 0; level < texture.levels(); ++level)
+        result += qint64(texture.width(level)) * texture.height(level) * texture.depth(level);
+    return result * texture.faces() * texture.layers();
+}
+
+// Runs the body the given number of times after one warm-up run; returns the timings in ns or
+// an empty vector if the body fails.
+std::vector<qint64> measure(
+        int iterations,
+        const std::function<bool()> &body,
+        const std::function<void()> &prepare = {})
+{
+    std::vector<qint64> result;
+    result.reserve(size_t(iterations));
+    for (int i = -1; i < iterations; ++i) {
+        if (prepare)
+            prepare();
+        QElapsedTimer timer;
+        timer.start();
+        if (!body())
+            return {};
+        const auto elapsed = timer.nsecsElapsed();
+        if (i >= 0)
+            result.push_back(elapsed);
+    }
+    return result;
+}
+
+double percentile(const std::vector<qint64> &sorted, double p)
+{
+    // nearest-rank method
+    const auto rank = size_t(std::ceil(p / 100.0 * double(sorted.size())));
+    return double(sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)]);
+}
+
+QJsonValue statistics(std::vector<qint64> timings, qint64 bytes, qint64 texels)
+{
+    if (timings.empty())
+        return QJsonValue::Null;
+
+    std::sort(timings.begin(), timings.end());
+    const auto milliseconds = [](double ns) { return ns / 1e6; };
+    const auto mean = double(std::accumulate(timings.begin(), timings.end(), qint64(0)))
+            / double(timings.size());
+    const auto median = percentile(timings, 50);
+    const auto seconds = median / 1e9;
+
+    QJsonObject result;
+    result[QStringLiteral("iterations")] = int(timings.size());
+    result[QStringLiteral("bytes")] = double(bytes);
+    result[QStringLiteral("texels")] = double(texels);
+    result[QStringLiteral("min_ms")] = milliseconds(double(timings.front()));
+    result[QStringLiteral("mean_ms")] = milliseconds(mean);
+    result[QStringLiteral("p50_ms")] = milliseconds(median);
+    result[QStringLiteral("p90_ms")] = milliseconds(percentile(timings, 90));
+    result[QStringLiteral("p99_ms")] = milliseconds(percentile(timings, 99));
+    result[QStringLiteral("max_ms")] = milliseconds(double(timings.back()));
+    // throughput is computed from the median, which is stable against outliers
+    result[QStringLiteral("mb_per_s")] = seconds > 0 ? double(bytes) / (1024 * 1024) / seconds : 0.0;
+    result[QStringLiteral("mtexels_per_s")] = seconds > 0 ? double(texels) / 1e6 / seconds : 0.0;
+    return result;
+}
+
+QJsonObject benchmarkFile(const QString &filePath, const Options &options)
+{
+    QJsonObject result;
+    result[QStringLiteral("file")] = filePath;
+    result[QStringLiteral("size")] = double(QFileInfo(filePath).size());
+
+    TextureIO io(filePath);
+    const auto loaded = io.read();
+    if (!loaded) {
+        result[QStringLiteral("error")] = toUserString(loaded.error());
+        return result;
+    }
+    const auto texture = *loaded;
+    const auto fileSize = QFileInfo(filePath).size();
+    const auto texels = texelCount(texture);
+
+    result[QStringLiteral("mimeType")] = io.mimeType().name();
+    result[QStringLiteral("format")] = toQString(texture.format());
+    result[QStringLiteral("width")] = int(texture.width());
+    result[QStringLiteral("height")] = int(texture.height());
+    result[QStringLiteral("depth")] = int(texture.depth());
+    result[QStringLiteral("faces")] = int(texture.faces());
+    result[QStringLiteral("levels")] = int(texture.levels());
+    result[QStringLiteral("layers")] = int(texture.layers());
+    result[QStringLiteral("bytes")] = double(texture.bytes());
+    result[QStringLiteral("contentHash")] = QString::number(texture.contentHash(), 16);
+
+    const auto read = [&filePath]() {
+        TextureIO io(filePath);
+        return bool(io.read());
+    };
+    QJsonObject readResult;
+    readResult[QStringLiteral("warm")] = statistics(measure(options.iterations, read), fileSize, texels);
+    if (options.cold) {
+        const auto drop = [&filePath]() { dropPageCache(filePath); };
+        readResult[QStringLiteral("cold")] = dropPageCache(filePath)
+                ? statistics(measure(options.iterations, read, drop), fileSize, texels)
+                : QJsonValue(QJsonValue::Null);
+    }
+    result[QStringLiteral("read")] = readResult;
+
+    if (options.convert && !texture.isCompressed()) {
+        QJsonArray convertResult;
+        const auto supported = Texture::supportedConvertions();
+        const auto isSupported = [supported](TextureFormat format) {
+            return std::find(supported.begin(), supported.end(), format) != supported.end();
+        };
+        std::vector<TextureFormat> targets = options.formats;
+        if (targets.empty())
+            targets.assign(supported.begin(), supported.end());
+        if (isSupported(texture.format())) {
+            for (const auto format: targets) {
+                if (format == texture.format() || !isSupported(format))
+                    continue;
+                const auto convert = [&texture, format]() {
+                    return !texture.convert(format).isNull();
+                };
+                QJsonObject item;
+                item[QStringLiteral("to")] = toQString(format);
+                item[QStringLiteral("result")] =
+                        statistics(measure(options.iterations, convert), texture.bytes(), texels);
+                convertResult.append(item);
+            }
+        }
+        result[QStringLiteral("convert")] = convertResult;
+    }
+
+    // toImage() supports only the top level of plain 2d textures
+    if (texture.faces() == 1 && texture.depth() == 1 && !texture.isCompressed()) {
+        const auto toImage = [&texture]() { return !texture.toImage().isNull(); };
+        result[QStringLiteral("toImage")] = statistics(
+                measure(options.iterations, toImage),
+                texture.bytesPerImage(0),
+                qint64(texture.width()) * texture.height());
+    }
+
+    if (options.write) {
+        QJsonArray writeResult;
+        const auto database = TextureIOHandlerDatabase::instance();
+        for (const auto mimeType: database->availableMimeTypes(
+                 TextureIOHandlerPlugin::Capability::CanWrite)) {
+            const auto plugin = database->plugin(mimeType.toString());
+            const auto caps = plugin->formatCapabilites(mimeType);
+            const auto canWrite = std::any_of(caps.begin(), caps.end(), [&texture](const auto &cap) {
+                return cap.format == texture.format()
+                        && (cap.capabilities & TextureIOHandlerPlugin::Capability::CanWrite);
+            });
+            if (!canWrite)
+                continue;
+
+            // Writes go to memory, so the disk does not add noise
+            QBuffer buffer;
+            const auto write = [&texture, &buffer, mimeType]() {
+                buffer.close();
+                buffer.setData(QByteArray());
+                buffer.open(QIODevice::WriteOnly);
+                TextureIO io(TextureIO::QIODevicePointer(&buffer), mimeType);
+                return bool(io.write(texture));
+            };
+            const auto timings = measure(options.iterations, write);
+            QJsonObject item;
+            item[QStringLiteral("mimeType")] = mimeType.toString();
+            item[QStringLiteral("result")] = statistics(timings, buffer.data().size(), texels);
+            writeResult.append(item);
+        }
+        result[QStringLiteral("write")] = writeResult;
+    }
+
+    return result;
+}
+
+QJsonObject environment(const Options &options)
+{
+    QJsonObject result;
+    result[QStringLiteral("tool")] = QStringLiteral("texturetool %1").
+            arg(QCoreApplication::applicationVersion());
+    result[QStringLiteral("qt")] = QString::fromLatin1(qVersion());
+    result[QStringLiteral("os")] = QSysInfo::prettyProductName();
+    result[QStringLiteral("kernel")] = QSysInfo::kernelVersion();
+    result[QStringLiteral("cpu")] = QSysInfo::currentCpuArchitecture();
+    result[QStringLiteral("threads")] = QThread::idealThreadCount();
+    result[QStringLiteral("iterations")] = options.iterations;
+    result[QStringLiteral("timestamp")] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    return result;
+}
+
+void bench(const Options &options)
+{
+    const auto files = expandInputs(options.inputs);
+
+    QJsonArray results;
+    for (const auto &file: files) {
+        ToolParser::showError(BenchTool::tr("Benchmarking %1").arg(file));
+        results.append(benchmarkFile(file, options));
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("environment")] = environment(options);
+    report[QStringLiteral("files")] = results;
+    report[QStringLiteral("peakRss")] = double(peakRss());
+
+    const auto json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (options.outputFile.isEmpty()) {
+        fputs(json.constData(), stdout);
+        return;
+    }
+    QFile file(options.outputFile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        throw RuntimeError(BenchTool::tr("Can't write report %1: %2").
+                           arg(options.outputFile, file.errorString()));
+    }
+}
+
+} // namespace
+
+/*!
+    \class BenchTool
+    This is class implements the benchmarking tool.
+
+    Measures read (with the warm and the dropped page cache), convert to every supported format,
+    toImage() and write with every plugin for the given files, and prints a JSON report with
+    percentiles and throughput, so the numbers can be compared between releases.
+*/
+
+/*!
+    Constructs a BenchTool instance.
+*/
+BenchTool::BenchTool() = default;
+
+/*!
+    \overload
+*/
+QByteArray BenchTool::id() const
+{
+    return {toolId.data(), int(toolId.size())};
+}
+
+/*!
+    \overload
+*/
+QString BenchTool::decription() const
+{
+    return BenchTool::tr("Measures read, convert and write throughput");
+}
+
+/*!
+    \overload
+*/
+int BenchTool::run(const QStringList &arguments)
+{
+    const auto options = parseOptions(arguments);
+    bench(options);
+    return 0;
+}
+
+} // namespace TextureTool
@@ -1,13 +1,15 @@
 #include "converttool.h"
+#include "batchconverter.h"
 #include "exception.h"
 #include "toolparser.h"
 
-#include <TextureLib/TextureIO>
-
-#include <QtGui/QImageReader>
-
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMimeDatabase>
+#include <QtCore/QTextStream>
 
 #include <OptionalType>
 
@@ -19,13 +21,32 @@ constexpr gsl::span<const char> toolId = "convert";
 
 struct Options
 {
-    QString inputFile;
+    QStringList inputs;
     QString inputMimeType;
     QString outputFile;
     QString outputMimeType;
     QString outputFormat;
+    QString outputDirectory;
+    QString manifestFile;
+    int jobs {0};
+    int ioJobs {2};
+    qint64 maxInFlightBytes {512 * 1024 * 1024};
+
+    bool isBatch() const { return !outputDirectory.isEmpty() || !manifestFile.isEmpty(); }
 };
 
+int parseNumber(ToolParser &parser, const QCommandLineOption &option, int minimum)
+{
+    bool ok = false;
+    const auto result = parser.value(option).toInt(&ok);
+    if (!ok || result < minimum) {
+        ToolParser::showError(ConvertTool::tr("Invalid value for --%1: %2").
+                              arg(option.names().last(), parser.value(option)));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return result;
+}
+
 Options parseOptions(const QStringList &arguments)
 {
     ToolParser parser({toolId.data(), int(toolId.size())});
@@ -38,99 +59,204 @@ Options parseOptions(const QStringList &arguments)
     QCommandLineOption outputFormatOption(QStringLiteral("output-format"),
                                         ConvertTool::tr("Output format (i.e. ARGB8_Unorm)"),
                                         QStringLiteral("output format"));
+    QCommandLineOption outputDirOption(QStringLiteral("output-dir"),
+                                       ConvertTool::tr("Convert all inputs into the directory"),
+                                       QStringLiteral("directory"));
+    QCommandLineOption manifestOption(QStringLiteral("manifest"),
+                                      ConvertTool::tr("File with an input and an optional "
+                                                      "tab-separated output per line"),
+                                      QStringLiteral("file"));
+    QCommandLineOption jobsOption({QStringLiteral("j"), QStringLiteral("jobs")},
+                                  ConvertTool::tr("Number of conversion threads"),
+                                  QStringLiteral("count"));
+    QCommandLineOption ioJobsOption(QStringLiteral("io-jobs"),
+                                    ConvertTool::tr("Number of read/write threads (default 2)"),
+                                    QStringLiteral("count"));
+    QCommandLineOption maxInFlightOption(QStringLiteral("max-in-flight"),
+                                         ConvertTool::tr("Maximum size of the textures in "
+                                                         "memory (default 512)"),
+                                         QStringLiteral("megabytes"));
     parser.addOption(inputTypeOption);
     parser.addOption(outputTypeOption);
     parser.addOption(outputFormatOption);
+    parser.addOption(outputDirOption);
+    parser.addOption(manifestOption);
+    parser.addOption(jobsOption);
+    parser.addOption(ioJobsOption);
+    parser.addOption(maxInFlightOption);
     parser.addPositionalArgument(QStringLiteral("input"),
-                                 ConvertTool::tr("Input filename"),
-                                 QStringLiteral("input"));
+                                 ConvertTool::tr("Input filenames, directories or wildcards"),
+                                 QStringLiteral("input..."));
     parser.addPositionalArgument(QStringLiteral("output"),
-                                 ConvertTool::tr("Output filename"),
-                                 QStringLiteral("output"));
+                                 ConvertTool::tr("Output filename, unless --output-dir or "
+                                                 "--manifest is used"),
+                                 QStringLiteral("[output]"));
 
     parser.process(arguments);
 
-    const auto positional = parser.positionalArguments();
-    if (positional.size() != 2) {
-        ToolParser::showError(ConvertTool::tr("Incorrect input/output arguments"));
-        parser.showHelp(EXIT_FAILURE);
-    }
-
     Options options;
-    options.inputFile = positional.at(0);
-    options.outputFile = positional.at(1);
     options.inputMimeType = parser.value(inputTypeOption);
     options.outputMimeType = parser.value(outputTypeOption);
     options.outputFormat = parser.value(outputFormatOption);
+    options.outputDirectory = parser.value(outputDirOption);
+    options.manifestFile = parser.value(manifestOption);
+    if (parser.isSet(jobsOption))
+        options.jobs = parseNumber(parser, jobsOption, 1);
+    if (parser.isSet(ioJobsOption))
+        options.ioJobs = parseNumber(parser, ioJobsOption, 1);
+    if (parser.isSet(maxInFlightOption))
+        options.maxInFlightBytes = qint64(parseNumber(parser, maxInFlightOption, 1)) * 1024 * 1024;
+
+    const auto positional = parser.positionalArguments();
+    if (options.isBatch()) {
+        if (positional.isEmpty() && options.manifestFile.isEmpty()) {
+            ToolParser::showError(ConvertTool::tr("Input argument missing"));
+            parser.showHelp(EXIT_FAILURE);
+        }
+        options.inputs = positional;
+    } else {
+        if (positional.size() != 2) {
+            ToolParser::showError(ConvertTool::tr("Incorrect input/output arguments"));
+            parser.showHelp(EXIT_FAILURE);
+        }
+        options.inputs = QStringList{positional.at(0)};
+        options.outputFile = positional.at(1);
+    }
     return options;
 }
 
-QLatin1String mimeTypeToFormat(QStringView mimeType)
+Optional<TextureFormat> parseFormat(const QString &formatName)
 {
-    if (mimeType == u"image/png")
-        return QLatin1String("png");
-    if (mimeType == u"image/jpeg")
-        return QLatin1String("jpg");
-    if (mimeType == u"image/bmp")
-        return QLatin1String("bmp");
-
-    return {};
+    if (formatName.isEmpty())
+        return {};
+    const auto format = fromQString<TextureFormat>(formatName);
+    if (!format || *format == TextureFormat::Invalid)
+        throw RuntimeError(ConvertTool::tr("Invalid output format: %1").arg(formatName));
+    return format;
 }
 
-void convert(const Options &options)
+bool isWildcard(const QString &input)
 {
-    TextureIO io(options.inputFile);
-    if (!options.inputMimeType.isEmpty())
-        io.setMimeType(options.inputMimeType);
-    const auto result = io.read();
-
-    Optional<Texture> texture;
-    if (result) {
-        texture = *result;
-    } else {
-        if (result.error() == TextureIOError::UnsupportedMimeType) {
-            QImageReader reader(options.inputFile);
-            if (options.inputMimeType.isEmpty())
-                reader.setFormat(mimeTypeToFormat(options.inputMimeType).data());
-            QImage image;
-            if (reader.read(&image)) {
-                texture = Texture(image);
-            } else if (reader.error() != QImageReader::UnsupportedFormatError) {
-                throw RuntimeError(ConvertTool::tr("Can't read \"%1\": %2").
-                                   arg(options.inputFile, reader.errorString()));
-            }
-        }
+    return input.contains(QLatin1Char('*'))
+            || input.contains(QLatin1Char('?'))
+            || input.contains(QLatin1Char('['));
+}
+
+QStringList expandInput(const QString &input)
+{
+    const QFileInfo info(input);
+    if (info.isDir()) {
+        QStringList result;
+        for (const auto &entry: QDir(input).entryInfoList(QDir::Files, QDir::Name))
+            result.append(entry.filePath());
+        return result;
+    }
+    if (isWildcard(info.fileName())) {
+        QStringList result;
+        const auto entries = info.dir().entryInfoList({info.fileName()}, QDir::Files, QDir::Name);
+        for (const auto &entry: entries)
+            result.append(entry.filePath());
+        return result;
     }
+    return {input};
+}
 
-    if (!texture) {
-        throw RuntimeError(ConvertTool::tr("Can't read \"%1\": %2").
-                           arg(options.inputFile, toUserString(result.error())));
+QString outputSuffix(const Options &options, const QString &inputFile)
+{
+    if (!options.outputMimeType.isEmpty()) {
+        const auto mimeType = QMimeDatabase().mimeTypeForName(options.outputMimeType);
+        if (mimeType.isValid() && !mimeType.preferredSuffix().isEmpty())
+            return mimeType.preferredSuffix();
     }
+    return QFileInfo(inputFile).suffix();
+}
 
-    Texture copy;
-    if (!options.outputFormat.isEmpty()) {
-        const auto format = fromQString<TextureFormat>(options.outputFormat);
-        if (!format || *format == TextureFormat::Invalid) {
-            throw RuntimeError(ConvertTool::tr("Invalid output format: %1")
-                               .arg(options.outputFormat));
-        }
-        copy = result->convert(*format);
+QString outputFileFor(const Options &options, const QString &inputFile)
+{
+    if (options.outputDirectory.isEmpty()) {
+        throw RuntimeError(ConvertTool::tr("No output for \"%1\": use --output-dir").
+                           arg(inputFile));
+    }
+    return QStringLiteral("%1/%2.%3").arg(
+            options.outputDirectory,
+            QFileInfo(inputFile).completeBaseName(),
+            outputSuffix(options, inputFile));
+}
+
+std::vector<BatchConverter::Job> readManifest(const Options &options)
+{
+    QFile file(options.manifestFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        throw RuntimeError(ConvertTool::tr("Can't open manifest \"%1\": %2").
+                           arg(options.manifestFile, file.errorString()));
+    }
 
-        if (copy.isNull()) {
-            throw RuntimeError(ConvertTool::tr("Convertion failed"));
+    // Relative paths are relative to the manifest
+    const auto baseDir = QFileInfo(options.manifestFile).dir();
+    std::vector<BatchConverter::Job> result;
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const auto line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+        const auto fields = line.split(QLatin1Char('\t'));
+        for (const auto &input: expandInput(baseDir.filePath(fields.at(0).trimmed()))) {
+            BatchConverter::Job job;
+            job.inputFile = input;
+            job.outputFile = fields.size() > 1
+                    ? baseDir.filePath(fields.at(1).trimmed())
+                    : outputFileFor(options, input);
+            result.push_back(job);
         }
-    } else {
-        copy = *texture;
     }
+    return result;
+}
+
+std::vector<BatchConverter::Job> createJobs(const Options &options)
+{
+    auto result = options.manifestFile.isEmpty()
+            ? std::vector<BatchConverter::Job>()
+            : readManifest(options);
+    for (const auto &input: options.inputs) {
+        const auto files = expandInput(input);
+        if (files.isEmpty())
+            ToolParser::showError(ConvertTool::tr("No files match \"%1\"").arg(input));
+        for (const auto &file: files)
+            result.push_back({file, outputFileFor(options, file)});
+    }
+    return result;
+}
+
+void convert(const Options &options)
+{
+    const auto format = parseFormat(options.outputFormat);
+    const auto texture = readTexture(options.inputs.at(0), options.inputMimeType);
+    const auto copy = convertTexture(texture, format);
+    writeTexture(copy, options.outputFile, options.outputMimeType);
+}
 
-    if (!options.outputMimeType.isEmpty())
-        io.setMimeType(options.outputMimeType);
-    io.setFileName(options.outputFile);
-    const auto ok = io.write(copy);
-    if (!ok) {
-        throw RuntimeError(ConvertTool::tr("Can't write texture %1: %2").
-                           arg(options.outputFile, toUserString(ok.error())));
+void convertBatch(const Options &options)
+{
+    if (!options.outputDirectory.isEmpty() && !QDir().mkpath(options.outputDirectory)) {
+        throw RuntimeError(ConvertTool::tr("Can't create output directory \"%1\"").
+                           arg(options.outputDirectory));
     }
+
+    BatchConverter::Options batchOptions;
+    batchOptions.inputMimeType = options.inputMimeType;
+    batchOptions.outputMimeType = options.outputMimeType;
+    batchOptions.format = parseFormat(options.outputFormat);
+    batchOptions.cpuThreads = options.jobs;
+    batchOptions.ioThreads = options.ioJobs;
+    batchOptions.maxInFlightBytes = options.maxInFlightBytes;
+
+    BatchConverter converter(batchOptions);
+    const auto ok = converter.run(createJobs(options));
+    for (const auto &error: converter.errors())
+        ToolParser::showError(error);
+    ToolParser::showMessage(converter.summary());
+    if (!ok)
+        throw ExitException(EXIT_FAILURE);
 }
 
 } // namespace
@@ -138,6 +264,10 @@ void convert(const Options &options)
 /*!
     \class ConvertTool
     This is class implements image converting tool.
+
+    With a single input and output, the file is converted directly. With --output-dir or
+    --manifest, any number of files, directories and wildcards are converted in one process
+    by the BatchConverter.
 */
 
 /*!
@@ -167,7 +297,10 @@ QString ConvertTool::decription() const
 int ConvertTool::run(const QStringList &arguments)
 {
     const auto options = parseOptions(arguments);
-    convert(options);
+    if (options.isBatch())
+        convertBatch(options);
+    else
+        convert(options);
     return 0;
 }
 
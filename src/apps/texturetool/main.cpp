@@ -1,14 +1,18 @@
 #include "abstracttool.h"
+#include "benchtool.h"
 #include "converttool.h"
 #include "exception.h"
 #include "mainparser.h"
 #include "showtool.h"
+#include "thumbnailtool.h"
 #include "toolparser.h"
 
 #include <QtCore/QDebug>
 #include <QtGui/QGuiApplication>
 
+#include <TextureLib/TextureAllocator>
 #include <TextureLib/TextureIO>
+#include <TextureLib/TextureMemory>
 
 #include <map>
 #include <memory>
@@ -16,8 +20,10 @@
 using ExitException = TextureTool::ExitException;
 using RuntimeError = TextureTool::RuntimeError;
 using AbstractTool = TextureTool::AbstractTool;
+using BenchTool = TextureTool::BenchTool;
 using ConvertTool = TextureTool::ConvertTool;
 using ShowTool = TextureTool::ShowTool;
+using ThumbnailTool = TextureTool::ThumbnailTool;
 using MainParser = TextureTool::MainParser;
 
 using ToolsMap = std::map<QByteArray, std::unique_ptr<AbstractTool>>;
@@ -25,14 +31,58 @@ using DescriptionMap = MainParser::DescriptionMap;
 
 static ToolsMap createTools()
 {
+    auto benchTool = std::make_unique<BenchTool>();
     auto convertTool = std::make_unique<ConvertTool>();
     auto showTool = std::make_unique<ShowTool>();
+    auto thumbnailTool = std::make_unique<ThumbnailTool>();
     ToolsMap result;
+    result[benchTool->id()] = std::move(benchTool);
     result[convertTool->id()] = std::move(convertTool);
     result[showTool->id()] = std::move(showTool);
+    result[thumbnailTool->id()] = std::move(thumbnailTool);
     return result;
 }
 
+static QString formatMemoryStatistics()
+{
+    const auto megabytes = [](qint64 bytes) { return double(bytes) / (1024 * 1024); };
+    const auto line = [&megabytes](const QString &name, const TextureMemory::Counters &counters)
+    {
+        return QStringLiteral("  %1 %2 %3 MB %4 MB %5").
+                arg(name, -16).
+                arg(counters.allocations, 8).
+                arg(megabytes(counters.bytes), 10, 'f', 1).
+                arg(megabytes(counters.peakBytes), 10, 'f', 1).
+                arg(counters.failures, 8);
+    };
+
+    const auto statistics = TextureMemory::statistics();
+    const auto allocator = TextureAllocator::instance()->statistics();
+
+    QStringList result;
+    result.append(QStringLiteral("Texture memory: %1 textures alive, %2 at peak").
+                  arg(statistics.textures).arg(statistics.peakTextures));
+    result.append(QStringLiteral("  %1 %2 %3 %4 %5").
+                  arg(QStringLiteral("Origin/format"), -16).
+                  arg(QStringLiteral("Buffers"), 8).
+                  arg(QStringLiteral("Current"), 13).
+                  arg(QStringLiteral("Peak"), 13).
+                  arg(QStringLiteral("Failures"), 8));
+    result.append(line(QStringLiteral("Total"), statistics.total));
+    for (const auto &item: statistics.origins)
+        result.append(line(QString::fromLatin1(enumToLatin1(item.first)), item.second));
+    for (const auto &item: statistics.formats)
+        result.append(line(toQString(item.first), item.second));
+    result.append(QStringLiteral("Allocator: %1 MB in use, %2 MB at peak, %3 MB pooled, "
+                                 "%4 pool hits, %5 failures").
+                  arg(megabytes(allocator.bytesInUse), 0, 'f', 1).
+                  arg(megabytes(allocator.peakBytesInUse), 0, 'f', 1).
+                  arg(megabytes(allocator.bytesPooled), 0, 'f', 1).
+                  arg(allocator.poolHits).
+                  arg(allocator.failures));
+    return result.join(QLatin1Char('\n'));
+}
+
 static MainParser::DescriptionMap getDescriptions(const ToolsMap &map)
 {
     MainParser::DescriptionMap result;
@@ -44,6 +94,9 @@ static MainParser::DescriptionMap getDescriptions(const ToolsMap &map)
 int main(int argc, char *argv[])
 {
     Q_INIT_RESOURCE(extramimetypes);
+    // The statistics are printed after the tool failed, too
+    bool statisticsRequested = false;
+    int code = 0;
     try {
         QCoreApplication app(argc, argv);
         QCoreApplication::setApplicationName("texturetool");
@@ -54,6 +107,7 @@ int main(int argc, char *argv[])
 
         MainParser parser(getDescriptions(tools));
         parser.process(QCoreApplication::arguments());
+        statisticsRequested = parser.statisticsRequested();
 
         const auto toolName = parser.toolName();
         const auto it = tools.find(toolName.toLatin1());
@@ -62,15 +116,19 @@ int main(int argc, char *argv[])
             parser.showHelp(EXIT_FAILURE);
         }
 
-        return it->second->run(parser.arguments());
+        code = it->second->run(parser.arguments());
     } catch (const ExitException &ex) {
-        return ex.code();
+        code = ex.code();
     } catch (const RuntimeError &ex) {
         MainParser::showError(ex.message());
-        return 1;
+        code = 1;
     } catch (const std::exception &ex) {
         MainParser::showError(QString::fromLatin1(ex.what()));
-        return 1;
+        code = 1;
     }
-}
 
+    // stderr, so the statistics do not mix with the tool's output
+    if (statisticsRequested)
+        MainParser::showError(formatMemoryStatistics());
+    return code;
+}
@@ -18,8 +18,12 @@ namespace TextureTool {
 MainParser::MainParser(DescriptionMap map) :
     _map(std::move(map)),
     helpOption(parser.addHelpOption()),
-    versionOption(parser.addVersionOption())
+    versionOption(parser.addVersionOption()),
+    statsOption(QStringLiteral("stats"),
+                QCoreApplication::translate("TextureTool",
+                                            "Print texture memory statistics on exit"))
 {
+    parser.addOption(statsOption);
     parser.setOptionsAfterPositionalArgumentsMode(QCommandLineParser::ParseAsPositionalArguments);
 }
 
@@ -37,6 +41,8 @@ void MainParser::process(const QStringList &arguments)
     if (parser.isSet(versionOption))
         showVersion();
 
+    _statistics = parser.isSet(statsOption);
+
     const auto positional = parser.positionalArguments();
     if (!positional.isEmpty()) {
         _name = positional.first();
@@ -19,6 +19,7 @@ public:
 
     inline QString toolName() { return _name; }
     inline QStringList arguments() const { return _arguments; }
+    inline bool statisticsRequested() const { return _statistics; }
 
     static void showMessage(const QString &message);
     static void showError(const QString &message);
@@ -31,8 +32,10 @@ private:
     QCommandLineParser parser;
     QCommandLineOption helpOption;
     QCommandLineOption versionOption;
+    QCommandLineOption statsOption;
     QString _name;
     QStringList _arguments;
+    bool _statistics {false};
 };
 
 } // namespace TextureTool
@@ -0,0 +1,214 @@
+#include "thumbnailtool.h"
+#include "exception.h"
+#include "toolparser.h"
+
+#include <TextureLib/ThumbnailCache>
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+
+namespace TextureTool {
+
+namespace {
+
+constexpr gsl::span<const char> toolId = "thumbnail";
+
+struct Options
+{
+    QStringList inputs;
+    QString outputFile;
+    QString cacheDirectory;
+    int size {128};
+    qint64 maxCacheSize {-1};
+    bool freeDesktop {false};
+    bool clear {false};
+};
+
+Options parseOptions(const QStringList &arguments)
+{
+    ToolParser parser({toolId.data(), int(toolId.size())});
+    QCommandLineOption sizeOption(QStringLiteral("size"),
+                                  ThumbnailTool::tr("Maximum thumbnail width and height (default 128)"),
+                                  QStringLiteral("pixels"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    ThumbnailTool::tr("Save the thumbnail of a single input to a file"),
+                                    QStringLiteral("output"));
+    QCommandLineOption cacheDirOption(QStringLiteral("cache-dir"),
+                                      ThumbnailTool::tr("Thumbnail cache directory"),
+                                      QStringLiteral("directory"));
+    QCommandLineOption freeDesktopOption(QStringLiteral("freedesktop"),
+                                         ThumbnailTool::tr("Use the freedesktop.org thumbnail spec layout"));
+    QCommandLineOption maxCacheSizeOption(QStringLiteral("max-cache-size"),
+                                          ThumbnailTool::tr("Trim the cache to the given size"),
+                                          QStringLiteral("megabytes"));
+    QCommandLineOption clearOption(QStringLiteral("clear"),
+                                   ThumbnailTool::tr("Remove all thumbnails from the cache"));
+    parser.addOption(sizeOption);
+    parser.addOption(outputOption);
+    parser.addOption(cacheDirOption);
+    parser.addOption(freeDesktopOption);
+    parser.addOption(maxCacheSizeOption);
+    parser.addOption(clearOption);
+    parser.addPositionalArgument(QStringLiteral("inputs"),
+                                 ThumbnailTool::tr("Input files or directories"),
+                                 QStringLiteral("[inputs...]"));
+
+    parser.process(arguments);
+
+    Options options;
+    options.inputs = parser.positionalArguments();
+    options.outputFile = parser.value(outputOption);
+    options.cacheDirectory = parser.value(cacheDirOption);
+    options.freeDesktop = parser.isSet(freeDesktopOption);
+    options.clear = parser.isSet(clearOption);
+
+    if (parser.isSet(sizeOption)) {
+        bool ok = false;
+        options.size = parser.value(sizeOption).toInt(&ok);
+        if (!ok || options.size <= 0) {
+            ToolParser::showError(ThumbnailTool::tr("Invalid size: %1").arg(parser.value(sizeOption)));
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+    if (parser.isSet(maxCacheSizeOption)) {
+        bool ok = false;
+        options.maxCacheSize = parser.value(maxCacheSizeOption).toLongLong(&ok) * 1024 * 1024;
+        if (!ok || options.maxCacheSize < 0) {
+            ToolParser::showError(ThumbnailTool::tr("Invalid cache size: %1").
+                                  arg(parser.value(maxCacheSizeOption)));
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+
+    if (options.inputs.isEmpty() && !options.clear && options.maxCacheSize < 0) {
+        ToolParser::showError(ThumbnailTool::tr("Input argument missing"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+QStringList expandInputs(const QStringList &inputs)
+{
+    QStringList result;
+    for (const auto &input: inputs) {
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            const QDir dir(input);
+            for (const auto &entry: dir.entryInfoList(QDir::Files, QDir::Name))
+                result.append(entry.filePath());
+        } else {
+            result.append(input);
+        }
+    }
+    return result;
+}
+
+void makeThumbnails(const Options &options)
+{
+    const auto layout = options.freeDesktop
+            ? ThumbnailCache::Layout::FreeDesktop
+            : ThumbnailCache::Layout::Pack;
+    auto directory = options.cacheDirectory;
+    if (directory.isEmpty()) {
+        directory = options.freeDesktop
+                ? ThumbnailCache::freeDesktopDirectory()
+                : ThumbnailCache::defaultDirectory();
+    }
+    ThumbnailCache cache(directory, layout);
+
+    if (options.clear)
+        cache.clear();
+
+    const auto files = expandInputs(options.inputs);
+    if (!options.outputFile.isEmpty() && files.size() != 1)
+        throw RuntimeError(ThumbnailTool::tr("Output file requires exactly one input"));
+
+    const auto size = QSize(options.size, options.size);
+    int cached = 0;
+    int failed = 0;
+    for (const auto &file: files) {
+        const auto key = ThumbnailCache::Key::fromFile(file);
+        if (key.isNull()) {
+            ToolParser::showError(ThumbnailTool::tr("%1: file not found").arg(file));
+            ++failed;
+            continue;
+        }
+        const auto wasCached = !cache.find(key, size).isNull();
+        const auto image = cache.thumbnail(file, size);
+        if (image.isNull()) {
+            ToolParser::showError(ThumbnailTool::tr("%1: can't create thumbnail").arg(file));
+            ++failed;
+            continue;
+        }
+        cached += wasCached ? 1 : 0;
+        ToolParser::showMessage(ThumbnailTool::tr("%1: %2x%3%4").
+                                arg(file).
+                                arg(image.width()).
+                                arg(image.height()).
+                                arg(wasCached ? ThumbnailTool::tr(" (cached)") : QString()));
+
+        if (!options.outputFile.isEmpty() && !image.save(options.outputFile)) {
+            throw RuntimeError(ThumbnailTool::tr("Can't write thumbnail %1").
+                               arg(options.outputFile));
+        }
+    }
+
+    if (options.maxCacheSize >= 0) {
+        cache.setMaxSize(options.maxCacheSize);
+        cache.trim();
+    }
+    cache.sync();
+
+    if (!files.isEmpty()) {
+        ToolParser::showMessage(ThumbnailTool::tr("%1 thumbnails, %2 from cache, %3 failed").
+                                arg(files.size() - failed).
+                                arg(cached).
+                                arg(failed));
+    }
+    if (failed)
+        throw ExitException(EXIT_FAILURE);
+}
+
+} // namespace
+
+/*!
+    \class ThumbnailTool
+    This is class implements thumbnail generation tool.
+
+    Thumbnails are stored in the same persistent ThumbnailCache that is used by the viewer, so
+    the tool can be used to pre-populate the cache for a folder.
+*/
+
+/*!
+    Constructs a ThumbnailTool instance.
+*/
+ThumbnailTool::ThumbnailTool() = default;
+
+/*!
+    \overload
+*/
+QByteArray ThumbnailTool::id() const
+{
+    return {toolId.data(), int(toolId.size())};
+}
+
+/*!
+    \overload
+*/
+QString ThumbnailTool::decription() const
+{
+    return ThumbnailTool::tr("Creates cached thumbnails of image files");
+}
+
+/*!
+    \overload
+*/
+int ThumbnailTool::run(const QStringList &arguments)
+{
+    const auto options = parseOptions(arguments);
+    makeThumbnails(options);
+    return 0;
+}
+
+} // namespace TextureTool
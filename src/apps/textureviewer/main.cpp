@@ -2,10 +2,14 @@
 #include "mainwindow.h"
 #include "startupdialog.h"
 
+#include <TextureViewCoreLib/TextureCache>
+
 #include <TextureLib/TextureIO>
 
 #include <QtWidgets/QApplication>
 
+#include <QtCore/QSettings>
+
 int main(int argc, char *argv[])
 {
     Q_INIT_RESOURCE(extramimetypes);
@@ -17,6 +21,11 @@ int main(int argc, char *argv[])
     QCoreApplication::setApplicationName(QStringLiteral("textureviewer"));
     QCoreApplication::setOrganizationName(QStringLiteral("arch"));
 
+    // The budget is stored in megabytes; the environment variable is used when not set
+    const auto cacheBudget = QSettings().value(QStringLiteral("cacheBudget")).toLongLong();
+    if (cacheBudget > 0)
+        TextureViewer::TextureCache::instance()->setBudget(cacheBudget * 1024 * 1024);
+
     const auto arguments = QCoreApplication::arguments();
     if (arguments.size() == 2) {
         if (!TextureViewer::Application::openPath(arguments.at(1)))
@@ -3,10 +3,12 @@
 
 #include "application.h"
 #include "convertdialog.h"
+#include "memorystatisticsdialog.h"
 #include "textureformatsdialog.h"
 
 #include <TextureLib/TextureIO>
 
+#include <TextureViewCoreLib/TextureCache>
 #include <TextureViewCoreLib/TextureDocument>
 #include <TextureViewCoreLib/TextureItemModel>
 #include <TextureViewCoreLib/ThumbnailsModel>
@@ -14,7 +16,9 @@
 
 #include <QtWidgets/QAbstractItemView>
 #include <QtWidgets/QFileDialog>
+#include <QtWidgets/QLabel>
 #include <QtWidgets/QMessageBox>
+#include <QtWidgets/QProgressDialog>
 
 #include <QtCore/QSettings>
 
@@ -29,7 +33,11 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->leftPaneDockWidget->setTitleBarWidget(new QWidget);
 
+    m_cacheLabel = new QLabel;
+    ui->statusbar->addPermanentWidget(m_cacheLabel);
+
     initConnections();
+    updateCacheStatistics();
 }
 
 ObserverPointer<TextureView> MainWindow::view() const
@@ -44,7 +52,34 @@ void MainWindow::convert()
     ConvertDialog dialog;
     if (dialog.exec() == QDialog::DialogCode::Rejected)
         return;
-    bool ok = m_view->document()->convert(dialog.format(), dialog.alignment());
+
+    // non-modal, the texture can be viewed while it is being converted
+    const auto document = m_view->document().get();
+    const auto progress = new QProgressDialog(tr("Converting texture..."), tr("Cancel"), 0, 100, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setWindowTitle(tr("Convert"));
+    progress->setMinimumDuration(500);
+    connect(document, &TextureDocument::convertProgressChanged,
+            progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, document, &TextureDocument::cancelConvert);
+    const auto closeProgress = [document, progress]()
+    {
+        // closing the dialog emits canceled()
+        disconnect(progress, &QProgressDialog::canceled, document, &TextureDocument::cancelConvert);
+        progress->close();
+    };
+    const auto onFinished = [this, closeProgress](bool ok, const QString &error)
+    {
+        closeProgress();
+        if (!ok)
+            QMessageBox::warning(this, tr("Convert"), error);
+    };
+    connect(document, &TextureDocument::convertFinished, progress, onFinished);
+    connect(document, &TextureDocument::convertCanceled, progress, closeProgress);
+
+    bool ok = document->convert(dialog.format(), dialog.alignment());
+    if (!ok || !document->isConverting())
+        closeProgress();
     if (!ok) {
         QMessageBox::warning(this, tr("Convert"), tr("Can't convert texture"));
     }
@@ -56,6 +91,42 @@ void MainWindow::showTextureFormatsDialog()
     dialog.exec();
 }
 
+void MainWindow::showMemoryStatisticsDialog()
+{
+    // non-modal, so the counters can be watched while working with the texture
+    if (!m_memoryStatisticsDialog)
+        m_memoryStatisticsDialog = new MemoryStatisticsDialog(this);
+    m_memoryStatisticsDialog->show();
+    m_memoryStatisticsDialog->raise();
+    m_memoryStatisticsDialog->activateWindow();
+}
+
+void MainWindow::updateCacheStatistics()
+{
+    const auto cache = TextureCache::instance();
+    if (!cache)
+        return;
+    const auto statistics = cache->statistics();
+    m_cacheLabel->setText(tr("Cache: %1 / %2").arg(
+            locale().formattedDataSize(statistics.bytes),
+            locale().formattedDataSize(statistics.budget)));
+    m_cacheLabel->setToolTip(
+            tr("Textures: %1 resident of %2\n"
+               "Pinned: %3\n"
+               "Peak: %4\n"
+               "Hits: %5, misses: %6, reloads: %7\n"
+               "Evictions: %8 (%9)").
+            arg(statistics.residentEntries).
+            arg(statistics.entries).
+            arg(locale().formattedDataSize(statistics.pinnedBytes)).
+            arg(locale().formattedDataSize(statistics.peakBytes)).
+            arg(statistics.hits).
+            arg(statistics.misses).
+            arg(statistics.reloads).
+            arg(statistics.evictions).
+            arg(locale().formattedDataSize(statistics.evictedBytes)));
+}
+
 void MainWindow::initConnections()
 {
     connect(ui->actionOpen, &QAction::triggered, &Application::open);
@@ -64,10 +135,17 @@ void MainWindow::initConnections()
     // edit menu
     connect(ui->actionConvert, &QAction::triggered, this, &MainWindow::convert);
 
+    if (const auto cache = TextureCache::instance()) {
+        connect(cache, &TextureCache::statisticsChanged,
+                this, &MainWindow::updateCacheStatistics);
+    }
+
     // help menu
     connect(ui->actionAboutQt, &QAction::triggered, &QApplication::aboutQt);
     connect(ui->actionTextureFormats, &QAction::triggered,
             this, &MainWindow::showTextureFormatsDialog);
+    connect(ui->actionMemoryStatistics, &QAction::triggered,
+            this, &MainWindow::showMemoryStatisticsDialog);
 
     auto onTextureChanged = [this]()
     {
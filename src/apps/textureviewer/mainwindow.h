@@ -9,11 +9,14 @@
 
 #include <memory>
 
+class QLabel;
+
 namespace Ui {
 class MainWindow;
 } // namespace Ui
 
 namespace TextureViewer {
+class MemoryStatisticsDialog;
 class TextureView;
 class ThumbnailsModel;
 
@@ -30,14 +33,18 @@ public:
 public slots:
     void convert();
     void showTextureFormatsDialog();
+    void showMemoryStatisticsDialog();
 
 private:
     void initConnections();
+    void updateCacheStatistics();
 
 private:
     std::unique_ptr<Ui::MainWindow> ui;
 
     TextureView *m_view {nullptr};
+    QLabel *m_cacheLabel {nullptr};
+    MemoryStatisticsDialog *m_memoryStatisticsDialog {nullptr};
 };
 
 } // namespace TextureViewer
@@ -0,0 +1,137 @@
+#include "memorystatisticsdialog.h"
+#include "ui_memorystatisticsdialog.h"
+
+#include <TextureLib/TextureAllocator>
+#include <TextureLib/TextureMemory>
+
+#include <TextureViewCoreLib/TextureCache>
+
+#include <UtilsLib/StringHelpers>
+
+#include <QtWidgets/QHeaderView>
+
+#include <QtCore/QTimerEvent>
+
+namespace TextureViewer {
+
+namespace {
+
+constexpr int updateInterval = 500; // ms
+
+void setCounters(
+        QTreeWidgetItem *item,
+        const QString &name,
+        const TextureMemory::Counters &counters,
+        const QLocale &locale)
+{
+    item->setText(0, name);
+    item->setText(1, QString::number(counters.allocations));
+    item->setText(2, locale.formattedDataSize(counters.bytes));
+    item->setText(3, locale.formattedDataSize(counters.peakBytes));
+    item->setText(4, QString::number(counters.failures));
+    for (int column = 1; column < 5; ++column)
+        item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+}
+
+template<typename Key, typename NameFunction>
+void setChildren(
+        QTreeWidgetItem *parent,
+        const std::map<Key, TextureMemory::Counters> &map,
+        NameFunction name,
+        const QLocale &locale)
+{
+    // Counters only appear and never disappear, so the existing items are reused
+    int index = 0;
+    for (const auto &item: map) {
+        auto child = index < parent->childCount()
+                ? parent->child(index)
+                : new QTreeWidgetItem(parent);
+        setCounters(child, name(item.first), item.second, locale);
+        ++index;
+    }
+}
+
+} // namespace
+
+MemoryStatisticsDialog::MemoryStatisticsDialog(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::MemoryStatisticsDialog)
+{
+    ui->setupUi(this);
+    ui->treeWidget->header()->setSectionResizeMode(QHeaderView::ResizeMode::ResizeToContents);
+
+    new QTreeWidgetItem(ui->treeWidget); // total
+    const auto origins = new QTreeWidgetItem(ui->treeWidget);
+    origins->setText(0, tr("By origin"));
+    const auto formats = new QTreeWidgetItem(ui->treeWidget);
+    formats->setText(0, tr("By format"));
+    ui->treeWidget->expandAll();
+
+    connect(ui->resetPeaksButton, &QPushButton::clicked, this, &MemoryStatisticsDialog::resetPeaks);
+
+    updateStatistics();
+}
+
+MemoryStatisticsDialog::~MemoryStatisticsDialog() = default;
+
+void MemoryStatisticsDialog::updateStatistics()
+{
+    const auto statistics = TextureMemory::statistics();
+    const auto &locale = this->locale();
+
+    setCounters(ui->treeWidget->topLevelItem(0), tr("Total"), statistics.total, locale);
+    setChildren(ui->treeWidget->topLevelItem(1), statistics.origins,
+                [](TextureMemory::Origin origin) {
+        return QString::fromLatin1(enumToLatin1(origin));
+    }, locale);
+    setChildren(ui->treeWidget->topLevelItem(2), statistics.formats,
+                [](TextureFormat format) { return toQString(format); }, locale);
+
+    QStringList summary;
+    summary.append(tr("Textures: %1 alive, %2 at peak").
+                   arg(statistics.textures).arg(statistics.peakTextures));
+    if (const auto allocator = TextureAllocator::instance()) {
+        const auto allocatorStatistics = allocator->statistics();
+        summary.append(tr("Allocator: %1 in use, %2 at peak, %3 pooled").
+                       arg(locale.formattedDataSize(allocatorStatistics.bytesInUse),
+                           locale.formattedDataSize(allocatorStatistics.peakBytesInUse),
+                           locale.formattedDataSize(allocatorStatistics.bytesPooled)));
+    }
+    if (const auto cache = TextureCache::instance()) {
+        const auto cacheStatistics = cache->statistics();
+        summary.append(tr("Cache: %1 of %2").
+                       arg(locale.formattedDataSize(cacheStatistics.bytes),
+                           locale.formattedDataSize(cacheStatistics.budget)));
+    }
+    ui->summaryLabel->setText(summary.join(QLatin1Char('\n')));
+}
+
+void MemoryStatisticsDialog::resetPeaks()
+{
+    TextureMemory::resetPeaks();
+    updateStatistics();
+}
+
+void MemoryStatisticsDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    updateStatistics();
+    m_timer.start(updateInterval, this);
+}
+
+void MemoryStatisticsDialog::hideEvent(QHideEvent *event)
+{
+    m_timer.stop();
+    QDialog::hideEvent(event);
+}
+
+void MemoryStatisticsDialog::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_timer.timerId()) {
+        updateStatistics();
+        return;
+    }
+    QDialog::timerEvent(event);
+}
+
+} // namespace TextureViewer
@@ -0,0 +1,40 @@
+#ifndef MEMORYSTATISTICSDIALOG_H
+#define MEMORYSTATISTICSDIALOG_H
+
+#include <QtWidgets/QDialog>
+
+#include <QtCore/QBasicTimer>
+
+#include <memory>
+
+namespace Ui {
+class MemoryStatisticsDialog;
+}
+
+namespace TextureViewer {
+
+class MemoryStatisticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryStatisticsDialog(QWidget *parent = nullptr);
+    ~MemoryStatisticsDialog() override;
+
+public slots:
+    void updateStatistics();
+    void resetPeaks();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    std::unique_ptr<Ui::MemoryStatisticsDialog> ui;
+    QBasicTimer m_timer;
+};
+
+} // namespace TextureViewer
+
+#endif // MEMORYSTATISTICSDIALOG_H
@@ -0,0 +1,297 @@
+#include "devicecursor.h"
+
+#include <QtCore/QFileDevice>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+/*!
+    \class DeviceCursor
+    \brief Buffered, seek-aware reader over a QIODevice for texture handlers.
+
+    Handlers read a lot of small values (headers, image sizes, padding) between large images.
+    DeviceCursor turns this into a few large device reads.
+
+    On random-access devices, small reads are served from a read-ahead buffer filled with a single
+    device read; reads at least as big as the buffer go directly into the destination. Skips are
+    done with QIODevice::seek(). The device is moved back to pos() by sync() or on destruction, so
+    the data read ahead is not lost for the caller.
+
+    Sequential devices cannot give the read-ahead data back, so there is no read-ahead unless the
+    end of the data is known, see setLimit(): reads go directly to the device and skipped data is
+    read into a single scratch buffer that is reused for the lifetime of the cursor.
+
+    deviceReads() returns the number of QIODevice::read() calls issued, which allows to test how
+    many reads a handler needs per file.
+*/
+
+/*!
+    Creates a cursor at the current position of the \a device with the read-ahead (or scratch)
+    buffer of the given \a bufferSize. The buffer is allocated on first use.
+*/
+DeviceCursor::DeviceCursor(QIODevice *device, qint64 bufferSize)
+    : m_device(device)
+    , m_sequential(device->isSequential())
+    , m_bufferSize(std::max<qint64>(1, bufferSize))
+    , m_pos(device->pos())
+{
+}
+
+/*!
+    Destroys the cursor, moving the device to pos().
+*/
+DeviceCursor::~DeviceCursor()
+{
+    sync();
+}
+
+/*!
+    Sets the position the read-ahead never goes past to \a limit; -1 means there is no limit.
+
+    Handlers that know the extent of the payload set the limit to its end. This allows to read ahead
+    on sequential devices and avoids reading data that follows the payload on random-access ones.
+    Reads past the limit are still possible, they go directly to the device.
+*/
+void DeviceCursor::setLimit(qint64 limit)
+{
+    m_limit = limit;
+}
+
+/*!
+    Hints the operating system that the next \a size bytes of the device will be read sequentially,
+    so it can read ahead more aggressively.
+
+    Only files are supported; for other devices and on other platforms this does nothing.
+*/
+void DeviceCursor::adviseSequential(qint64 size)
+{
+#if defined(Q_OS_LINUX)
+    const auto file = qobject_cast<QFileDevice *>(m_device);
+    const auto handle = file ? file->handle() : -1;
+    if (handle < 0 || size <= 0)
+        return;
+    // The hints are best-effort, errors are ignored
+    posix_fadvise(handle, m_pos, size, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(handle, m_pos, size, POSIX_FADV_WILLNEED);
+#else
+    Q_UNUSED(size);
+#endif
+}
+
+/*!
+    Reads \a size bytes into \a data.
+
+    Returns false if less data is available, errorString() contains the reason.
+*/
+bool DeviceCursor::read(char *data, qint64 size)
+{
+    if (size <= 0)
+        return size == 0;
+
+    const auto buffered = std::min(size, available());
+    if (buffered) {
+        memcpy(data, buffer() + m_bufferPos, size_t(buffered));
+        m_bufferPos += buffered;
+        m_pos += buffered;
+        data += buffered;
+        size -= buffered;
+    }
+    if (size == 0)
+        return true;
+
+    if (!canReadAhead() || size >= m_bufferSize || (m_limit >= 0 && m_pos + size > m_limit))
+        return readDevice(data, size);
+
+    if (!fill())
+        return false;
+    if (available() < size) {
+        m_pos += available();
+        m_bufferPos = m_bufferEnd;
+        setError(QStringLiteral("Unexpected end of data"));
+        return false;
+    }
+    memcpy(data, buffer() + m_bufferPos, size_t(size));
+    m_bufferPos += size;
+    m_pos += size;
+    return true;
+}
+
+/*!
+    \overload
+
+    Reads and returns \a size bytes. Returns a shorter array if less data is available.
+*/
+QByteArray DeviceCursor::read(qint64 size)
+{
+    if (size < 0 || size > std::numeric_limits<int>::max()) {
+        setError(QStringLiteral("Invalid size %1").arg(size));
+        return QByteArray();
+    }
+
+    QByteArray result(int(size), Qt::Uninitialized);
+    const auto start = m_pos;
+    if (!read(result.data(), size))
+        result.resize(int(m_pos - start));
+    return result;
+}
+
+/*!
+    Skips \a size bytes.
+
+    Random-access devices are seeked, sequential devices are read into the scratch buffer.
+*/
+bool DeviceCursor::skip(qint64 size)
+{
+    if (size < 0) {
+        setError(QStringLiteral("Can't skip %1 bytes").arg(size));
+        return false;
+    }
+
+    const auto buffered = std::min(size, available());
+    m_bufferPos += buffered;
+    m_pos += buffered;
+    size -= buffered;
+    if (size == 0)
+        return true;
+
+    if (!m_sequential) {
+        m_bufferPos = m_bufferEnd = 0;
+        if (!m_device->seek(m_pos + size)) {
+            setError(m_device->errorString());
+            return false;
+        }
+        m_pos += size;
+        return true;
+    }
+
+    const auto scratch = buffer();
+    while (size > 0) {
+        const auto chunk = std::min(size, m_bufferSize);
+        ++m_deviceReads;
+        const auto read = m_device->read(scratch, chunk);
+        if (read <= 0) {
+            setError(read < 0 ? m_device->errorString() : QStringLiteral("Unexpected end of data"));
+            return false;
+        }
+        m_pos += read;
+        size -= read;
+    }
+    return true;
+}
+
+/*!
+    Moves the cursor to the absolute \a position.
+
+    Sequential devices can only move forward.
+*/
+bool DeviceCursor::seek(qint64 position)
+{
+    if (position >= m_pos)
+        return skip(position - m_pos);
+
+    if (m_sequential) {
+        setError(QStringLiteral("Can't seek backwards on a sequential device"));
+        return false;
+    }
+
+    // Still in the buffer
+    if (m_pos - position <= m_bufferPos) {
+        m_bufferPos -= m_pos - position;
+        m_pos = position;
+        return true;
+    }
+
+    m_bufferPos = m_bufferEnd = 0;
+    if (!m_device->seek(position)) {
+        setError(m_device->errorString());
+        return false;
+    }
+    m_pos = position;
+    return true;
+}
+
+/*!
+    Skips the padding up to the next multiple of \a alignment counting from the \a base position.
+*/
+bool DeviceCursor::align(qint64 alignment, qint64 base)
+{
+    Q_ASSERT(alignment > 0);
+    const auto remainder = (m_pos - base) % alignment;
+    return skip(remainder ? alignment - remainder : 0);
+}
+
+/*!
+    Drops the read-ahead data and moves the device to pos().
+*/
+void DeviceCursor::sync()
+{
+    if (available() > 0 && !m_sequential)
+        m_device->seek(m_pos);
+    m_bufferPos = m_bufferEnd = 0;
+}
+
+/*!
+    Returns the description of the last error.
+*/
+QString DeviceCursor::errorString() const
+{
+    return m_error;
+}
+
+bool DeviceCursor::canReadAhead() const noexcept
+{
+    if (m_limit >= 0)
+        return m_limit > m_pos;
+    return !m_sequential;
+}
+
+char *DeviceCursor::buffer()
+{
+    if (!m_buffer)
+        m_buffer = std::make_unique<char[]>(size_t(m_bufferSize));
+    return m_buffer.get();
+}
+
+bool DeviceCursor::fill()
+{
+    Q_ASSERT(canReadAhead() && available() == 0);
+    m_bufferPos = m_bufferEnd = 0;
+    const auto size = m_limit >= 0 ? std::min(m_bufferSize, m_limit - m_pos) : m_bufferSize;
+    ++m_deviceReads;
+    const auto read = m_device->read(buffer(), size);
+    if (read < 0) {
+        setError(m_device->errorString());
+        return false;
+    }
+    if (read == 0) {
+        setError(QStringLiteral("Unexpected end of data"));
+        return false;
+    }
+    m_bufferEnd = read;
+    return true;
+}
+
+bool DeviceCursor::readDevice(char *data, qint64 size)
+{
+    // The buffer is drained at this point and no longer adjacent to the position
+    m_bufferPos = m_bufferEnd = 0;
+    ++m_deviceReads;
+    const auto read = m_device->read(data, size);
+    if (read > 0)
+        m_pos += read;
+    if (read != size) {
+        setError(read < 0 ? m_device->errorString() : QStringLiteral("Unexpected end of data"));
+        return false;
+    }
+    return true;
+}
+
+void DeviceCursor::setError(const QString &error)
+{
+    m_error = error;
+}
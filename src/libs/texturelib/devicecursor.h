@@ -0,0 +1,65 @@
+#pragma once
+
+#include "texturelib_global.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+#include <gsl/span>
+
+#include <memory>
+
+class QIODevice;
+
+class TEXTURELIB_EXPORT DeviceCursor
+{
+    Q_DISABLE_COPY(DeviceCursor)
+public:
+    static constexpr qint64 defaultBufferSize = 64 * 1024;
+
+    explicit DeviceCursor(QIODevice *device, qint64 bufferSize = defaultBufferSize);
+    DeviceCursor(DeviceCursor &&) = delete;
+    ~DeviceCursor();
+    DeviceCursor &operator=(DeviceCursor &&) = delete;
+
+    inline QIODevice *device() const noexcept { return m_device; }
+    inline qint64 pos() const noexcept { return m_pos; }
+    inline qint64 deviceReads() const noexcept { return m_deviceReads; }
+
+    inline qint64 limit() const noexcept { return m_limit; }
+    void setLimit(qint64 limit);
+
+    void adviseSequential(qint64 size);
+
+    bool read(char *data, qint64 size);
+    inline bool read(gsl::span<uchar> data)
+    { return read(reinterpret_cast<char *>(data.data()), data.size()); }
+    QByteArray read(qint64 size);
+
+    bool skip(qint64 size);
+    bool seek(qint64 position);
+    bool align(qint64 alignment, qint64 base = 0);
+
+    void sync();
+
+    QString errorString() const;
+
+private:
+    inline qint64 available() const noexcept { return m_bufferEnd - m_bufferPos; }
+    bool canReadAhead() const noexcept;
+    char *buffer();
+    bool fill();
+    bool readDevice(char *data, qint64 size);
+    void setError(const QString &error);
+
+    QIODevice *m_device {nullptr};
+    bool m_sequential {false};
+    qint64 m_bufferSize {defaultBufferSize};
+    std::unique_ptr<char[]> m_buffer;
+    qint64 m_bufferPos {0};
+    qint64 m_bufferEnd {0};
+    qint64 m_pos {0};
+    qint64 m_limit {-1};
+    qint64 m_deviceReads {0};
+    QString m_error;
+};
@@ -0,0 +1,229 @@
+#ifndef TEXELVIEW_H
+#define TEXELVIEW_H
+
+#include <TextureLib/Texture>
+
+#include <HalfFloat>
+
+#include <type_traits>
+
+// Texel
+
+template<typename T, int N>
+struct Texel
+{
+    static_assert(N >= 1 && N <= 4, "Invalid components count");
+
+    using ChannelType = T;
+    static constexpr int components = N;
+
+    constexpr T &operator[](int i) noexcept { return channels[i]; }
+    constexpr const T &operator[](int i) const noexcept { return channels[i]; }
+
+    T channels[N];
+};
+
+template<typename T, int N>
+constexpr bool operator==(const Texel<T, N> &lhs, const Texel<T, N> &rhs) noexcept
+{
+    for (int i = 0; i < N; ++i) {
+        if (!(lhs.channels[i] == rhs.channels[i]))
+            return false;
+    }
+    return true;
+}
+
+template<typename T, int N>
+constexpr bool operator!=(const Texel<T, N> &lhs, const Texel<T, N> &rhs) noexcept
+{ return !(lhs == rhs); }
+
+// Traits
+
+// Only uncompressed formats have traits; packed formats are exposed as their storage integer.
+template<TextureFormat format> struct TexelTraits;
+
+#define DECLARE_TEXEL_TRAITS(format, Channel, N) \
+    template<> struct TexelTraits<TextureFormat::format> \
+    { \
+        using ChannelType = Channel; \
+        static constexpr int components = N; \
+        using Type = Texel<Channel, N>; \
+    };
+
+DECLARE_TEXEL_TRAITS(A8_Unorm, quint8, 1)
+DECLARE_TEXEL_TRAITS(L8_Unorm, quint8, 1)
+DECLARE_TEXEL_TRAITS(R8_Snorm, qint8, 1)
+DECLARE_TEXEL_TRAITS(R8_Unorm, quint8, 1)
+DECLARE_TEXEL_TRAITS(R8_Sint, qint8, 1)
+DECLARE_TEXEL_TRAITS(R8_Uint, quint8, 1)
+
+DECLARE_TEXEL_TRAITS(LA8_Unorm, quint8, 2)
+DECLARE_TEXEL_TRAITS(R16_Snorm, qint16, 1)
+DECLARE_TEXEL_TRAITS(R16_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(R16_Sint, qint16, 1)
+DECLARE_TEXEL_TRAITS(R16_Uint, quint16, 1)
+DECLARE_TEXEL_TRAITS(R16_Float, HalfFloat, 1)
+DECLARE_TEXEL_TRAITS(RG8_Snorm, qint8, 2)
+DECLARE_TEXEL_TRAITS(RG8_Unorm, quint8, 2)
+DECLARE_TEXEL_TRAITS(RG8_Sint, qint8, 2)
+DECLARE_TEXEL_TRAITS(RG8_Uint, quint8, 2)
+
+DECLARE_TEXEL_TRAITS(RGB8_Unorm, quint8, 3)
+DECLARE_TEXEL_TRAITS(BGR8_Unorm, quint8, 3)
+
+DECLARE_TEXEL_TRAITS(R32_Sint, qint32, 1)
+DECLARE_TEXEL_TRAITS(R32_Uint, quint32, 1)
+DECLARE_TEXEL_TRAITS(R32_Float, float, 1)
+DECLARE_TEXEL_TRAITS(RG16_Snorm, qint16, 2)
+DECLARE_TEXEL_TRAITS(RG16_Unorm, quint16, 2)
+DECLARE_TEXEL_TRAITS(RG16_Sint, qint16, 2)
+DECLARE_TEXEL_TRAITS(RG16_Uint, quint16, 2)
+DECLARE_TEXEL_TRAITS(RG16_Float, HalfFloat, 2)
+DECLARE_TEXEL_TRAITS(RGBA8_Snorm, qint8, 4)
+DECLARE_TEXEL_TRAITS(RGBA8_Unorm, quint8, 4)
+DECLARE_TEXEL_TRAITS(RGBA8_Sint, qint8, 4)
+DECLARE_TEXEL_TRAITS(RGBA8_Uint, quint8, 4)
+DECLARE_TEXEL_TRAITS(RGBA8_Srgb, quint8, 4)
+DECLARE_TEXEL_TRAITS(BGRA8_Unorm, quint8, 4)
+DECLARE_TEXEL_TRAITS(BGRA8_Srgb, quint8, 4)
+DECLARE_TEXEL_TRAITS(ABGR8_Unorm, quint8, 4)
+DECLARE_TEXEL_TRAITS(RGBX8_Unorm, quint8, 4)
+DECLARE_TEXEL_TRAITS(BGRX8_Unorm, quint8, 4)
+DECLARE_TEXEL_TRAITS(BGRX8_Srgb, quint8, 4)
+
+DECLARE_TEXEL_TRAITS(RGBA16_Snorm, qint16, 4)
+DECLARE_TEXEL_TRAITS(RGBA16_Unorm, quint16, 4)
+DECLARE_TEXEL_TRAITS(RGBA16_Sint, qint16, 4)
+DECLARE_TEXEL_TRAITS(RGBA16_Uint, quint16, 4)
+DECLARE_TEXEL_TRAITS(RGBA16_Float, HalfFloat, 4)
+DECLARE_TEXEL_TRAITS(RG32_Sint, qint32, 2)
+DECLARE_TEXEL_TRAITS(RG32_Uint, quint32, 2)
+DECLARE_TEXEL_TRAITS(RG32_Float, float, 2)
+
+DECLARE_TEXEL_TRAITS(RGB32_Sint, qint32, 3)
+DECLARE_TEXEL_TRAITS(RGB32_Uint, quint32, 3)
+DECLARE_TEXEL_TRAITS(RGB32_Float, float, 3)
+
+DECLARE_TEXEL_TRAITS(RGBA32_Sint, qint32, 4)
+DECLARE_TEXEL_TRAITS(RGBA32_Uint, quint32, 4)
+DECLARE_TEXEL_TRAITS(RGBA32_Float, float, 4)
+
+DECLARE_TEXEL_TRAITS(BGR565_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(RGB565_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(BGRA4_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(BGRX4_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(BGRA5551_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(BGRX5551_Unorm, quint16, 1)
+DECLARE_TEXEL_TRAITS(RGB332_Unorm, quint8, 1)
+
+#undef DECLARE_TEXEL_TRAITS
+
+template<TextureFormat format> using TexelType = typename TexelTraits<format>::Type;
+
+// Views
+
+namespace Details {
+
+template<TextureFormat format, typename T>
+class TexelViewBase
+{
+public:
+    using size_type = Texture::size_type;
+    using value_type = std::remove_const_t<T>;
+    using reference = T &;
+    using pointer = T *;
+    using Row = gsl::span<T>;
+
+    static_assert(sizeof(value_type) == sizeof(typename value_type::ChannelType) * value_type::components,
+                  "Texel should not have padding");
+
+    constexpr bool isNull() const noexcept { return !m_data; }
+
+    constexpr TextureFormat textureFormat() const noexcept { return format; }
+    constexpr size_type width() const noexcept { return m_width; }
+    constexpr size_type height() const noexcept { return m_height; }
+    constexpr size_type depth() const noexcept { return m_depth; }
+    constexpr qsizetype bytesPerLine() const noexcept { return m_bytesPerLine; }
+    constexpr qsizetype bytesPerSlice() const noexcept { return m_bytesPerSlice; }
+
+    Row row(size_type y, size_type z = 0) const noexcept
+    {
+        Q_ASSERT(y >= 0 && y < m_height && z >= 0 && z < m_depth);
+        return {reinterpret_cast<pointer>(m_data + z * m_bytesPerSlice + y * m_bytesPerLine),
+                m_width};
+    }
+
+    reference operator()(size_type x, size_type y, size_type z = 0) const noexcept
+    {
+        Q_ASSERT(x >= 0 && x < m_width);
+        return row(y, z)[x];
+    }
+
+    reference at(Texture::Position p) const noexcept { return (*this)(p.x, p.y, p.z); }
+
+protected:
+    using BytePointer = std::conditional_t<std::is_const_v<T>, const uchar *, uchar *>;
+
+    TexelViewBase() noexcept = default;
+
+    template<typename Data>
+    void init(const Texture &source, Texture::ArrayIndex index, Data data) noexcept
+    {
+        if (source.format() != format) {
+            qCWarning(texture) << "TexelView format mismatch:"
+                               << toQString(source.format()) << "!=" << toQString(format);
+            return;
+        }
+        if (data.empty())
+            return;
+        m_data = data.data();
+        m_width = source.width(index.level());
+        m_height = source.height(index.level());
+        m_depth = source.depth(index.level());
+        m_bytesPerLine = source.bytesPerLine(index.level());
+        m_bytesPerSlice = source.bytesPerSlice(index.level());
+    }
+
+    template<typename U>
+    void assign(const TexelViewBase<format, U> &other) noexcept
+    {
+        m_data = other.m_data;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_depth = other.m_depth;
+        m_bytesPerLine = other.m_bytesPerLine;
+        m_bytesPerSlice = other.m_bytesPerSlice;
+    }
+
+    BytePointer m_data {nullptr};
+    size_type m_width {0};
+    size_type m_height {0};
+    size_type m_depth {0};
+    qsizetype m_bytesPerLine {0};
+    qsizetype m_bytesPerSlice {0};
+
+    template<TextureFormat, typename> friend class TexelViewBase;
+};
+
+} // namespace Details
+
+template<TextureFormat format>
+class TexelView : public Details::TexelViewBase<format, TexelType<format>>
+{
+public:
+    TexelView() noexcept = default;
+    explicit TexelView(Texture &texture, Texture::ArrayIndex index = {})
+    { this->init(texture, index, texture.imageData(index)); }
+};
+
+template<TextureFormat format>
+class ConstTexelView : public Details::TexelViewBase<format, const TexelType<format>>
+{
+public:
+    ConstTexelView() noexcept = default;
+    explicit ConstTexelView(const Texture &texture, Texture::ArrayIndex index = {})
+    { this->init(texture, index, texture.imageData(index)); }
+    ConstTexelView(const TexelView<format> &other) noexcept { this->assign(other); }
+};
+
+#endif // TEXELVIEW_H
@@ -1,9 +1,16 @@
 #include "texture_p.h"
+#include "textureallocator.h"
+#include "texturehash_p.h"
 #include "textureio.h"
+#include "tracing.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QIODevice>
 #include <QtCore/QMetaEnum>
 
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 #include <memory>
 
 #define CHECK_WIDTH(width, rv) \
@@ -52,11 +59,26 @@
 
 namespace {
 
+// The progress of a conversion is reported after this many bytes are written
+constexpr Texture::size_type convertBandSize = 256 * 1024;
+
 void memoryCopy(Texture::Data dst, Texture::ConstData src)
 {
     memcpy(dst.data(), src.data(), std::size_t(std::min(dst.size_bytes(), src.size_bytes())));
 }
 
+// Calls the function for each subresource in the order they are stored in memory
+template<typename Function>
+void forEachSubresource(Texture::ArraySize arraySize, Function function)
+{
+    for (int level = 0; level < arraySize.levels(); ++level) {
+        for (int layer = 0; layer < arraySize.layers(); ++layer) {
+            for (int face = 0; face < arraySize.faces(); ++face)
+                function(Texture::ArrayIndex(Texture::Side(face), level, layer));
+        }
+    }
+}
+
 int memoryCompare(Texture::ConstData lhs, Texture::ConstData rhs)
 {
     if (lhs.size_bytes() != rhs.size_bytes()) {
@@ -174,27 +196,170 @@ TextureData *TextureData::create(
 
     result->levelInfos = std::move(levelInfos);
 
+    result->subresourceHashes = std::make_unique<QAtomicInteger<quint64>[]>(
+            usize_type(result->subresources()));
+
     result->nbytes = totalBytes;
     if (data.empty()) {
-        result->data = DataPointer(
-                new (std::nothrow) uchar[size_t(result->nbytes)], [](const uchar p[]){ delete [] p;});
-        if (!result->data)
+        auto storage = allocateStorage(result->nbytes, format);
+        if (!storage)
             return nullptr;
+        result->setStorage(std::move(storage));
     } else {
         if (data.size_bytes() != result->nbytes) {
             qCWarning(texture) << "Invalid data size:"
                                << data.size_bytes() << "!=" << result->nbytes;
             return nullptr;
         }
-        if (deleter)
-            result->data = DataPointer(data.data(), std::move(deleter));
-        else
-            result->data = DataPointer(data.data());
+        auto pointer = deleter
+                ? DataPointer(data.data(), std::move(deleter))
+                : DataPointer(data.data(), [](uchar p[]) { delete [] p; });
+        result->setStorage(std::make_shared<Storage>(std::move(pointer), result->nbytes, format));
     }
 
     return result.release();
 }
 
+auto TextureData::allocateStorage(qsizetype size, TextureFormat format) -> StoragePointer
+{
+    const auto allocator = TextureAllocator::instance();
+    if (!allocator)
+        return nullptr;
+
+    auto data = DataPointer(allocator->allocate(size), TextureAllocator::deleter(size));
+    if (!data) {
+        TextureMemory::allocationFailed(format, size);
+        return nullptr;
+    }
+    return std::make_shared<Storage>(std::move(data), size, format);
+}
+
+// Lays out all blocks in the given contiguous storage
+void TextureData::setStorage(StoragePointer storage)
+{
+    const auto base = storage->data.get();
+    blocks.resize(usize_type(subresources()));
+    for (size_type level = 0; level < levels; ++level) {
+        for (size_type layer = 0; layer < layers; ++layer) {
+            for (size_type side = 0; side < faces; ++side) {
+                blocks[usize_type(subresourceIndex(side, level, layer))] = std::make_shared<Block>(
+                        Block{storage, base + offset(side, level, layer)});
+            }
+        }
+    }
+    contiguous = true;
+    compacted.reset();
+}
+
+// Returns a new instance sharing the blocks with this one
+TextureData *TextureData::clone() const
+{
+    auto result = std::make_unique<TextureData>();
+
+    result->ref.ref();
+    result->format = format;
+    result->align = align;
+    result->compressed = compressed;
+    result->width = width;
+    result->height = height;
+    result->depth = depth;
+    result->faces = faces;
+    result->levels = levels;
+    result->layers = layers;
+    result->levelInfos = levelInfos;
+    result->nbytes = nbytes;
+    result->blocks = blocks;
+    result->contiguous = contiguous;
+
+    result->subresourceHashes = std::make_unique<QAtomicInteger<quint64>[]>(
+            usize_type(subresources()));
+    for (size_type i = 0; i < subresources(); ++i) {
+        result->subresourceHashes[usize_type(i)].storeRelease(
+                subresourceHashes[usize_type(i)].loadAcquire());
+    }
+    result->hash.storeRelease(hash.loadAcquire());
+
+    return result.release();
+}
+
+// Makes sure the block at the given index is not shared and returns its data
+uchar *TextureData::detachBlock(size_type index)
+{
+    auto &block = blocks[usize_type(index)];
+    compacted.reset();
+    if (block.use_count() == 1)
+        return block->data;
+
+    const auto level = index / faces / layers;
+    const auto size = bytesPerImage(level);
+    TextureMemory::OriginScope scope(TextureMemory::Origin::Copy);
+    auto storage = allocateStorage(size, format);
+    if (!storage)
+        return nullptr;
+
+    const auto data = storage->data.get();
+    memcpy(data, block->data, size_t(size));
+    block = std::make_shared<Block>(Block{std::move(storage), data});
+    contiguous = false;
+    return data;
+}
+
+// Copies the data of all blocks to the given buffer using the contiguous layout
+void TextureData::copyBlocks(uchar *data) const
+{
+    for (size_type level = 0; level < levels; ++level) {
+        for (size_type layer = 0; layer < layers; ++layer) {
+            for (size_type side = 0; side < faces; ++side) {
+                memcpy(data + offset(side, level, layer),
+                       blockData(subresourceIndex(side, level, layer)),
+                       size_t(bytesPerImage(level)));
+            }
+        }
+    }
+}
+
+// Returns the data of all blocks as a single buffer; makes a copy if blocks are scattered
+const uchar *TextureData::contiguousData() const
+{
+    if (contiguous)
+        return blockData(0);
+
+    QMutexLocker lock(&compactedMutex);
+    if (!compacted) {
+        TextureMemory::OriginScope scope(TextureMemory::Origin::Copy);
+        auto storage = allocateStorage(nbytes, format);
+        if (!storage)
+            return nullptr;
+        copyBlocks(storage->data.get());
+        compacted = std::move(storage);
+    }
+    return compacted->data.get();
+}
+
+// Makes sure all blocks are not shared and laid out in a single storage and returns its data
+uchar *TextureData::detachContiguousData()
+{
+    const auto isDetached = std::all_of(blocks.begin(), blocks.end(), [](const BlockPointer &block) {
+        return block.use_count() == 1;
+    });
+    if (contiguous && isDetached) {
+        compacted.reset();
+        return blocks.front()->data;
+    }
+
+    // reuse the copy made for the const access, if any
+    auto storage = std::move(compacted);
+    if (!storage) {
+        TextureMemory::OriginScope scope(TextureMemory::Origin::Copy);
+        storage = allocateStorage(nbytes, format);
+        if (!storage)
+            return nullptr;
+        copyBlocks(storage->data.get());
+    }
+    setStorage(std::move(storage));
+    return blocks.front()->data;
+}
+
 // return unisgned here to avoid unnecessary casts
 std::size_t TextureData::calculateBytesPerLine(
         const TextureFormatInfo &format, usize_type uwidth, Texture::Alignment align)
@@ -256,6 +421,64 @@ qsizetype TextureData::offset(size_type side, size_type level, size_type layer)
     return levelInfos[usize_type(level)].offset + bytesPerImage(level) * (faces * layer + side);
 }
 
+quint64 TextureData::subresourceHash(size_type index) const
+{
+    auto &memo = subresourceHashes[usize_type(index)];
+    auto result = memo.loadAcquire();
+    if (result != TextureHash::notComputed)
+        return result;
+
+    const auto level = index / faces / layers;
+    const auto imageData = Texture::ConstData(blockData(index), bytesPerImage(level));
+    result = TextureHash::nonZero(TextureHash::hash(imageData));
+    memo.storeRelease(result);
+    return result;
+}
+
+quint64 TextureData::contentHash() const
+{
+    auto result = hash.loadAcquire();
+    if (result != TextureHash::notComputed)
+        return result;
+
+    std::vector<size_type> missing;
+    for (size_type i = 0; i < subresources(); ++i) {
+        if (subresourceHashes[usize_type(i)].loadAcquire() == TextureHash::notComputed)
+            missing.push_back(i);
+    }
+
+    // small textures are not worth the thread pool overhead
+    constexpr qsizetype parallelThreshold = 1 << 20;
+    if (missing.size() > 1 && nbytes >= parallelThreshold)
+        QtConcurrent::blockingMap(missing, [this](size_type index) { subresourceHash(index); });
+
+    // Must cover the same fields as operator==
+    const quint32 header[] = {
+        quint32(format), quint32(width), quint32(height), quint32(depth),
+        quint32(faces), quint32(levels), quint32(layers)
+    };
+    result = TextureHash::hash({reinterpret_cast<const uchar *>(header), sizeof(header)});
+    for (size_type i = 0; i < subresources(); ++i)
+        result = TextureHash::combine(result, subresourceHash(i));
+    result = TextureHash::nonZero(result);
+    hash.storeRelease(result);
+    return result;
+}
+
+void TextureData::resetHash(size_type side, size_type level, size_type layer)
+{
+    subresourceHashes[usize_type(subresourceIndex(side, level, layer))].storeRelease(
+            TextureHash::notComputed);
+    hash.storeRelease(TextureHash::notComputed);
+}
+
+void TextureData::resetHashes()
+{
+    for (size_type i = 0; i < subresources(); ++i)
+        subresourceHashes[usize_type(i)].storeRelease(TextureHash::notComputed);
+    hash.storeRelease(TextureHash::notComputed);
+}
+
 /*!
   \enum Texture::Side
 
@@ -983,11 +1206,145 @@ auto Texture::constImageData(ArrayIndex index) const -> ConstData
     return {data, bytesPerImage(index.level())};
 }
 
+/*!
+  \brief Returns the data of the whole texture.
+
+  Invalidates all memoized hashes as the data can be modified through the returned span. If the
+  data is shared with other textures, the whole data is copied.
+*/
+auto Texture::data() -> Data
+{
+    if (!d)
+        return {};
+
+    detach();
+
+    const auto data = d->detachContiguousData();
+    if (!data)
+        return {};
+    d->resetHashes();
+    return {data, bytes()};
+}
+
+/*!
+  \brief Returns the constant data of the whole texture.
+
+  If subresources of this texture were modified while the texture was shared, their data is
+  stored separately; in that case this function assembles a contiguous copy.
+*/
+auto Texture::constData() const -> ConstData
+{
+    if (!d)
+        return {};
+
+    const auto data = d->contiguousData();
+    if (!data)
+        return {};
+    return {data, bytes()};
+}
+
+/*!
+  \brief Returns a 64-bit fingerprint of the whole texture.
+
+  The fingerprint covers the format, the dimensions and the data of every subresource; the
+  alignment only matters through the padding it adds to the lines. Textures that compare equal have the same fingerprint; the opposite is true only
+  with a very high probability, so the fingerprint is suitable for deduplication, cache keys and
+  quick change detection, but not for security purposes.
+
+  The value is computed lazily using a fast non-cryptographic hash, subresources are hashed in
+  parallel. The result is memoized in the shared data and is reset when the data is modified
+  through the non-const accessors. Shallow copies share the memoized value.
+
+  Returns 0 for a null texture.
+
+  \sa subresourceHash()
+*/
+quint64 Texture::contentHash() const
+{
+    if (!d)
+        return 0;
+
+    return d->contentHash();
+}
+
+/*!
+  \brief Returns a 64-bit fingerprint of the data of the image at the given \a index.
+
+  Unlike contentHash(), only the data is hashed, so images of the same size with the same
+  contents have the same fingerprint regardless of their position in the texture.
+
+  Returns 0 for a null texture or an invalid index.
+
+  \sa contentHash()
+*/
+quint64 Texture::subresourceHash(ArrayIndex index) const
+{
+    if (!d)
+        return 0;
+
+    CHECK_SIDE(index.face(), 0);
+    CHECK_LEVEL(index.level(), 0);
+    CHECK_LAYER(index.layer(), 0);
+
+    return d->subresourceHash(d->subresourceIndex(index.face(), index.level(), index.layer()));
+}
+
+/*!
+  \brief Returns the data of the scanline at the position \a p of the image at the given \a index.
+
+  The x coordinate of the position should be 0. The returned span does not include the line
+  padding. For compressed formats, the returned span is the whole row of blocks containing the
+  line.
+*/
+auto Texture::lineData(Position p, ArrayIndex index) -> Data
+{
+    if (!d)
+        return {};
+
+    CHECK_ZERO_X(p.x, Data());
+    CHECK_LEVEL(index.level(), Data());
+    CHECK_POINT(p.x, p.y, p.z, index.level(), Data());
+
+    const auto data = dataImpl(index.face(), index.level(), index.layer());
+    if (!data)
+        return {};
+    return {data + d->lineOffset(p.y, p.z, index.level()), d->lineSize(index.level())};
+}
+
+/*!
+  \brief Returns the constant data of the scanline at the position \a p of the image at the given
+  \a index.
+*/
+auto Texture::lineData(Position p, ArrayIndex index) const -> ConstData
+{
+    return constLineData(p, index);
+}
+
+/*!
+  \brief Returns the constant data of the scanline at the position \a p of the image at the given
+  \a index.
+*/
+auto Texture::constLineData(Position p, ArrayIndex index) const -> ConstData
+{
+    if (!d)
+        return {};
+
+    CHECK_ZERO_X(p.x, ConstData());
+    CHECK_LEVEL(index.level(), ConstData());
+    CHECK_POINT(p.x, p.y, p.z, index.level(), ConstData());
+
+    const auto data = dataImpl(index.face(), index.level(), index.layer());
+    if (!data)
+        return {};
+    return {data + d->lineOffset(p.y, p.z, index.level()), d->lineSize(index.level())};
+}
+
 /*!
     \brief Returns the color of the texel located at position \p and array index \a index.
 
     \note This function returns empty color for compressed formats
-    \note This function is very slow and provided only for convenience purposes.
+    \note This function is very slow and provided only for convenience purposes; use
+    TexelView or ConstTexelView to access the texels of a known format at memory speed.
 */
 ColorVariant Texture::texelColor(Position p, ArrayIndex index) const
 {
@@ -1021,7 +1378,8 @@ ColorVariant Texture::texelColor(Position p, ArrayIndex index) const
     conversion which may lead to loss of precision.
 
     \note This function does nothig for compressed formats
-    \note This function is very slow and provided only for convenience purposes.
+    \note This function is very slow and provided only for convenience purposes; use
+    TexelView to modify the texels of a known format at memory speed.
 */
 void Texture::setTexelColor(Texture::Position p, Texture::ArrayIndex index, const ColorVariant &color)
 {
@@ -1072,6 +1430,22 @@ Texture Texture::convert(TextureFormat format) const
   \brief Converts this texture to a texture with the given \a format and \a align.
 */
 Texture Texture::convert(TextureFormat format, Texture::Alignment align) const
+{
+    return convert(format, align, {});
+}
+
+/*!
+  \brief Converts this texture to a texture with the given \a format and \a align, reporting the
+  \a progress.
+
+  Lines of all images are converted in bands of about 256 KiB; after each band, \a progress is
+  called with the number of lines converted so far and the total number of lines. If it returns
+  false, the conversion is canceled and a null texture is returned. The function is called from
+  the calling thread, so conversions running in a background thread can be canceled between
+  bands.
+*/
+Texture Texture::convert(
+        TextureFormat format, Texture::Alignment align, const ConvertProgress &progress) const
 {
     if (!d)
         return Texture();
@@ -1079,6 +1453,11 @@ Texture Texture::convert(TextureFormat format, Texture::Alignment align) const
     if (format == d->format && align == d->align) // nothing changed
         return *this;
 
+    TraceSpan span("texture", "Texture::convert");
+    TextureMemory::OriginScope scope(TextureMemory::Origin::Convert);
+    if (span.isActive())
+        span.setDetail(QStringLiteral("%1 -> %2").arg(toQString(d->format), toQString(format)));
+
     auto result = Texture(
             TextureData::create(
                     format,
@@ -1127,6 +1506,12 @@ Texture Texture::convert(TextureFormat format, Texture::Alignment align) const
         }
     };
 
+    size_type totalLines = 0;
+    for (size_type level = 0; level < d->levels; ++level)
+        totalLines += d->levelHeight(level) * d->levelDepth(level) * d->layers * d->faces;
+
+    size_type lines = 0;
+    size_type bandBytes = 0;
     for (size_type level = 0; level < d->levels; ++level) {
         const auto srcBytesPerSlice = d->bytesPerSlice(level);
         const auto dstBytesPerSlice = result.d->bytesPerSlice(level);
@@ -1146,12 +1531,22 @@ Texture Texture::convert(TextureFormat format, Texture::Alignment align) const
                         const auto dstLine = dstData.subspan(
                                     dstBytesPerSlice * z + dstBytesPerLine * y, dstBytesPerLine);
                         convertLine(width, srcLine, dstLine);
+                        ++lines;
+                        bandBytes += dstBytesPerLine;
+                        if (progress && bandBytes >= convertBandSize) {
+                            bandBytes = 0;
+                            if (!progress(lines, totalLines))
+                                return Texture();
+                        }
                     }
                 }
             }
         }
     }
 
+    if (progress && !progress(lines, totalLines))
+        return Texture();
+
     return result;
 }
 
@@ -1160,6 +1555,12 @@ Texture Texture::convert(TextureFormat format, Texture::Alignment align) const
 */
 Texture Texture::copy() const
 {
+    if (!d)
+        return {};
+
+    TraceSpan span("texture", "Texture::copy");
+    TextureMemory::OriginScope scope(TextureMemory::Origin::Copy);
+
     Texture result(
             TextureData::create(
                     d->format,
@@ -1170,7 +1571,14 @@ Texture Texture::copy() const
         return result;
 
     Q_ASSERT(result.d->nbytes == d->nbytes);
-    memoryCopy(result.data(), data());
+    d->copyBlocks(result.data().data());
+
+    // the contents are the same, so are the hashes
+    for (size_type i = 0; i < d->subresources(); ++i) {
+        result.d->subresourceHashes[usize_type(i)].storeRelease(
+                d->subresourceHashes[usize_type(i)].loadAcquire());
+    }
+    result.d->hash.storeRelease(d->hash.loadAcquire());
 
     return result;
 }
@@ -1183,6 +1591,8 @@ QImage Texture::toImage() const
     if (!d)
         return {};
 
+    TraceSpan span("texture", "Texture::toImage");
+
     if (d->faces > 1 || d->depth > 1) {
         qCWarning(texture) << "Can't convert to QImage: cubemaps and volumemaps are not supported";
         return {};
@@ -1301,11 +1711,12 @@ Texture::Texture(TextureData *dd)
 {
 }
 
+// Makes a shallow copy of the shared data; subresources are copied on write, see dataImpl()
 void Texture::detach()
 {
     if (d) {
         if (d->ref.load() != 1 /*|| d->ro_data*/)
-            *this = copy();
+            *this = Texture(d->clone());
     }
 }
 
@@ -1325,11 +1736,15 @@ uchar *Texture::dataImpl(size_type side, size_type level, size_type layer)
 
     detach();
 
+    // clone the subresource if it is shared with other textures
+    const auto result = d->detachBlock(d->subresourceIndex(side, level, layer));
     // In case detach ran out of memory...
-    if (!d)
+    if (!result)
         return nullptr;
 
-    return d->data.get() + d->offset(side, level, layer);
+    d->resetHash(side, level, layer);
+
+    return result;
 }
 
 const uchar* Texture::dataImpl(size_type side, size_type level, size_type layer) const
@@ -1341,7 +1756,7 @@ const uchar* Texture::dataImpl(size_type side, size_type level, size_type layer)
     CHECK_LEVEL(level, nullptr);
     CHECK_LAYER(layer, nullptr);
 
-    return d->data.get() + d->offset(side, level, layer);
+    return d->blockData(d->subresourceIndex(side, level, layer));
 }
 
 bool operator==(const Texture &lhs, const Texture &rhs)
@@ -1363,7 +1778,29 @@ bool operator==(const Texture &lhs, const Texture &rhs)
             || lhs.d->levels != rhs.d->levels)
         return false;
 
-    return memoryCompare({lhs.d->data.get(), lhs.d->nbytes}, {rhs.d->data.get(), rhs.d->nbytes}) == 0;
+    // different hashes guarantee different contents, skip comparing if both are known; the hash
+    // covers exactly the fields compared above, so the answer doesn't depend on the memoization.
+    // The alignment is not compared, textures with the same bytes are equal as a whole
+    const auto lhsHash = lhs.d->hash.loadAcquire();
+    const auto rhsHash = rhs.d->hash.loadAcquire();
+    if (lhsHash != TextureHash::notComputed && rhsHash != TextureHash::notComputed
+            && lhsHash != rhsHash)
+        return false;
+
+    for (Texture::size_type i = 0; i < lhs.d->subresources(); ++i) {
+        const auto &lhsBlock = lhs.d->blocks[size_t(i)];
+        const auto &rhsBlock = rhs.d->blocks[size_t(i)];
+        // shared subresource?
+        if (lhsBlock == rhsBlock)
+            continue;
+        // images differ in size if only one of the textures pads its lines
+        const auto level = i / lhs.d->faces / lhs.d->layers;
+        const auto lhsSize = lhs.d->bytesPerImage(level);
+        const auto rhsSize = rhs.d->bytesPerImage(level);
+        if (memoryCompare({lhsBlock->data, lhsSize}, {rhsBlock->data, rhsSize}) != 0)
+            return false;
+    }
+    return true;
 }
 
 bool operator!=(const Texture &lhs, const Texture &rhs)
@@ -1380,15 +1817,34 @@ QDataStream &operator<<(QDataStream &stream, const Texture &texture)
            << quint32(texture.faces())
            << quint32(texture.layers())
            << quint32(texture.levels())
-           << quint8(texture.alignment())
-           << QByteArray::fromRawData(
-                  reinterpret_cast<const char *>(texture.data().data()), int(texture.data().size()));
+           << quint8(texture.alignment());
+
+    // The payload is compatible with QByteArray serialization, but is written directly from the
+    // subresources, so neither a temporary buffer nor a contiguous copy is needed
+    if (texture.isNull()) {
+        stream << quint32(0xffffffff);
+        return stream;
+    }
+    if (texture.bytes() > std::numeric_limits<qint32>::max()) { // QByteArray limit
+        stream.setStatus(QDataStream::WriteFailed);
+        return stream;
+    }
+    stream << quint32(texture.bytes());
+    forEachSubresource(texture.arraySize(), [&stream, &texture](Texture::ArrayIndex index) {
+        const auto data = texture.constImageData(index);
+        if (stream.status() != QDataStream::Ok)
+            return;
+        const auto bytes = int(data.size());
+        if (stream.writeRawData(reinterpret_cast<const char *>(data.data()), bytes) != bytes)
+            stream.setStatus(QDataStream::WriteFailed);
+    });
     return stream;
 }
 
 QDataStream &operator>>(QDataStream &stream, Texture &texture)
 {
     texture = Texture();
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
     quint32 format;
     quint32 width;
     quint32 height;
@@ -1397,7 +1853,7 @@ QDataStream &operator>>(QDataStream &stream, Texture &texture)
     quint32 layers;
     quint32 levels;
     quint8 align;
-    QByteArray data;
+    quint32 size;
     stream >> format
             >> width
             >> height
@@ -1406,22 +1862,58 @@ QDataStream &operator>>(QDataStream &stream, Texture &texture)
             >> layers
             >> levels
             >> align
-            >> data;
-    if (stream.status() == QDataStream::Ok) {
-        auto result = Texture(TextureData::create(
-                                  TextureFormat(format),
-                                  int(width),
-                                  int(height),
-                                  int(depth),
-                                  faces > 1,
-                                  int(levels),
-                                  int(layers),
-                                  Texture::Alignment(align)));
-        if (result.bytes() == data.size()) {
-            memoryCopy(result.data(), {reinterpret_cast<const uchar *>(data.constData()), data.size()});
-            texture = result;
-        }
+            >> size;
+    if (stream.status() != QDataStream::Ok)
+        return stream;
+    if (size == 0xffffffff) { // null texture
+        texture = Texture();
+        return stream;
+    }
+
+    // Reject fields that can't be converted to the enums before they reach TextureFormatInfo
+    if (format == quint32(TextureFormat::Invalid)
+            || format >= quint32(TextureFormat::FormatsCount)
+            || (align != quint8(Texture::Alignment::Byte)
+                && align != quint8(Texture::Alignment::Word))) {
+        stream.skipRawData(int(size));
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+
+    // Don't allocate the storage for a payload the device doesn't have
+    const auto device = stream.device();
+    if (device && !device->isSequential() && qint64(size) > device->size() - device->pos()) {
+        stream.setStatus(QDataStream::ReadPastEnd);
+        return stream;
     }
+
+    auto result = Texture(TextureData::create(
+                              TextureFormat(format),
+                              int(width),
+                              int(height),
+                              int(depth),
+                              faces > 1,
+                              int(levels),
+                              int(layers),
+                              Texture::Alignment(align)));
+    if (result.isNull() || result.bytes() != qsizetype(size)) {
+        // skip the payload, so the stream stays usable
+        stream.skipRawData(int(size));
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+
+    // Read directly into the storage of the new texture
+    forEachSubresource(result.arraySize(), [&stream, &result](Texture::ArrayIndex index) {
+        const auto data = result.imageData(index);
+        if (stream.status() != QDataStream::Ok)
+            return;
+        const auto bytes = int(data.size());
+        if (stream.readRawData(reinterpret_cast<char *>(data.data()), bytes) != bytes)
+            stream.setStatus(QDataStream::ReadPastEnd);
+    });
+    if (stream.status() == QDataStream::Ok)
+        texture = std::move(result);
     return stream;
 }
 
@@ -15,6 +15,8 @@
 
 #include <gsl/span>
 
+#include <functional>
+
 class TextureData;
 
 class TEXTURELIB_EXPORT Texture
@@ -224,27 +226,31 @@ public:
     ConstData imageData(ArrayIndex index) const;
     ConstData constImageData(ArrayIndex index) const;
 
-    Data data() { return {dataImpl(0, 0, 0), bytes()}; }
-    ConstData data() const { return {dataImpl(0, 0, 0), bytes()}; }
-    ConstData constData() const { return {dataImpl(0, 0, 0), bytes()}; }
+    Data data();
+    ConstData data() const { return constData(); }
+    ConstData constData() const;
+
+    quint64 contentHash() const;
+    quint64 subresourceHash(ArrayIndex index) const;
 
     ColorVariant texelColor(Position p, ArrayIndex index) const;
     void setTexelColor(const Position &p, const ColorVariant &color)
     { setTexelColor(p, {}, color); }
     void setTexelColor(Position p, ArrayIndex index, const ColorVariant &color);
 
-    // Ok, KTX really have different alignment (4) rather than other (dds, vtf) formats (1).
-    // So, we can have a usage of a scanline API.
-    // However, the same can be achieved via manual iteration over imageData, hovewer that can
-    // lead to a bunch of a boilerplate code - see convert(TextureFormat, Alignment) function.
+    // KTX uses 4-bytes alignment while other formats (dds, vtf) use 1, so the scanline API
+    // hides the padding. For typed access to the texels, see TexelView.
+    Data lineData(Position p, ArrayIndex index);
+    ConstData lineData(Position p, ArrayIndex index) const;
+    ConstData constLineData(Position p, ArrayIndex index) const;
 
-    // Data lineData(const Position &p, const Index &index);
-    // ConstData lineData(const Position &p, const Index &index) const;
-    // ConstData constLineData(const Position &p, const Index &index) const;
+    // Called between bands of converted lines; returning false cancels the conversion
+    using ConvertProgress = std::function<bool(size_type lines, size_type totalLines)>;
 
     Texture convert(Alignment align) const;
     Texture convert(TextureFormat format) const;
     Texture convert(TextureFormat format, Alignment align) const;
+    Texture convert(TextureFormat format, Alignment align, const ConvertProgress &progress) const;
     static gsl::span<const TextureFormat> supportedConvertions();
 
     Texture copy() const;
@@ -280,7 +286,7 @@ bool TEXTURELIB_EXPORT operator!=(const Texture &lhs, const Texture &rhs);
 QDataStream TEXTURELIB_EXPORT &operator<<(QDataStream &stream, const Texture &texture);
 QDataStream TEXTURELIB_EXPORT &operator>>(QDataStream &stream, Texture &texture);
 
-Q_DECLARE_LOGGING_CATEGORY(texture)
+Q_DECLARE_EXPORTED_LOGGING_CATEGORY(texture, TEXTURELIB_EXPORT)
 
 QDebug operator<<(QDebug &d, const Texture::ArrayIndex &index);
 
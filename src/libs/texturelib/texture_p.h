@@ -3,6 +3,9 @@
 
 #include "texture.h"
 #include "textureformatinfo.h"
+#include "texturememory.h"
+
+#include <QtCore/QMutex>
 
 #include <memory>
 
@@ -12,10 +15,10 @@ public:
     using size_type = Texture::size_type;
     using usize_type = Texture::usize_type;
 
-    TextureData() = default;
+    TextureData() noexcept { TextureMemory::textureCreated(); }
     TextureData(const TextureData &other) = delete;
     TextureData(TextureData &&) = delete;
-    ~TextureData() noexcept = default;
+    ~TextureData() noexcept { TextureMemory::textureDestroyed(); }
 
     TextureData &operator=(const TextureData &) = delete;
     TextureData &operator=(TextureData &&) = delete;
@@ -54,6 +57,69 @@ public:
     }
     qsizetype levelOffset(size_type level) const { return levelInfos[uint(level)].offset; }
     qsizetype offset(size_type side, size_type level, size_type layer) const;
+    // offset of the line inside the image, for compressed formats y is rounded down to the block
+    qsizetype lineOffset(size_type y, size_type z, size_type level) const
+    { return bytesPerSlice(level) * z + bytesPerLine(level) * (compressed ? y / 4 : y); }
+    // line size without padding
+    qsizetype lineSize(size_type level) const
+    {
+        return compressed
+                ? bytesPerLine(level)
+                : TextureFormatInfo::formatInfo(format).bytesPerTexel() * levelWidth(level);
+    }
+
+    size_type subresources() const { return faces * levels * layers; }
+    // subresources are enumerated in the same order as they are stored in memory
+    size_type subresourceIndex(size_type side, size_type level, size_type layer) const
+    { return (level * layers + layer) * faces + side; }
+
+    using DataPointer = std::unique_ptr<uchar[], Texture::DataDeleter>;
+
+    // A buffer holding the data of one or more subresources, accounted in TextureMemory
+    struct Storage
+    {
+        Storage(DataPointer data, qsizetype size, TextureFormat format) noexcept
+            : data(std::move(data))
+            , size(size)
+            , format(format)
+            , origin(TextureMemory::currentOrigin())
+        { TextureMemory::allocated(format, origin, size); }
+        Storage(const Storage &) = delete;
+        Storage(Storage &&) = delete;
+        ~Storage() noexcept { TextureMemory::released(format, origin, size); }
+        Storage &operator=(const Storage &) = delete;
+        Storage &operator=(Storage &&) = delete;
+
+        DataPointer data;
+        qsizetype size {0};
+        TextureFormat format {TextureFormat::Invalid};
+        TextureMemory::Origin origin {TextureMemory::Origin::Other};
+    };
+    using StoragePointer = std::shared_ptr<Storage>;
+
+    // The data of a single subresource. Blocks are shared between TextureData instances and are
+    // cloned on write, so modifying a subresource of a shared texture copies only that subresource
+    struct Block
+    {
+        StoragePointer storage;
+        uchar *data {nullptr};
+    };
+    using BlockPointer = std::shared_ptr<const Block>;
+
+    static StoragePointer allocateStorage(qsizetype size, TextureFormat format);
+    void setStorage(StoragePointer storage);
+    TextureData *clone() const;
+
+    const uchar *blockData(size_type index) const { return blocks[usize_type(index)]->data; }
+    uchar *detachBlock(size_type index);
+    void copyBlocks(uchar *data) const;
+    const uchar *contiguousData() const;
+    uchar *detachContiguousData();
+
+    quint64 subresourceHash(size_type index) const;
+    quint64 contentHash() const;
+    void resetHash(size_type side, size_type level, size_type layer);
+    void resetHashes();
 
     static std::function<ColorVariant(Texture::ConstData)> getFormatReader(TextureFormat format);
     static std::function<void(Texture::Data, const ColorVariant &)> getFormatWriter(TextureFormat format);
@@ -80,8 +146,18 @@ public:
     std::vector<LevelInfo> levelInfos;
 
     qsizetype nbytes {0};
-    using DataPointer = std::unique_ptr<uchar[], Texture::DataDeleter>;
-    DataPointer data;
+
+    std::vector<BlockPointer> blocks;
+    // true if all blocks are laid out in a single storage
+    bool contiguous {true};
+    // contiguous copy of the blocks for the const access, reset on modification
+    mutable QMutex compactedMutex;
+    mutable StoragePointer compacted;
+
+    // Memoized hashes, 0 means "not computed yet"
+    using HashPointer = std::unique_ptr<QAtomicInteger<quint64>[]>;
+    HashPointer subresourceHashes;
+    mutable QAtomicInteger<quint64> hash {0};
 };
 
 #endif // TEXTURE_P_H
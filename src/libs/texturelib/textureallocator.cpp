@@ -0,0 +1,360 @@
+#include "textureallocator.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QMutex>
+
+#include <map>
+
+#if defined(Q_OS_WIN)
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr qsizetype hugePageSize = 2 * 1024 * 1024;
+
+// Classes starting from this size are mapped directly, so freeing them returns the memory to the
+// system right away. It only depends on the size class, so freeBlock() does not need to know the
+// allocator settings.
+constexpr qsizetype mapThreshold = 2 * hugePageSize;
+
+bool isMapped(qsizetype size)
+{
+#if defined(Q_OS_WIN)
+    Q_UNUSED(size);
+    return false;
+#else
+    return size >= mapThreshold;
+#endif
+}
+
+// Frees the block of the given size class allocated by TextureAllocatorPrivate::allocateBlock()
+void freeBlock(uchar *data, qsizetype size)
+{
+#if defined(Q_OS_WIN)
+    Q_UNUSED(size);
+    _aligned_free(data);
+#else
+    if (isMapped(size))
+        munmap(data, size_t(size));
+    else
+        free(data);
+#endif
+}
+
+} // namespace
+
+class TextureAllocatorPrivate
+{
+public:
+    uchar *allocateBlock(qsizetype size);
+
+    mutable QMutex mutex;
+    std::map<qsizetype, std::vector<uchar *>> freeLists;
+    qsizetype poolLimit {128 * 1024 * 1024};
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    bool hugePagesEnabled {true};
+#else
+    bool hugePagesEnabled {false};
+#endif
+    qsizetype hugePageThreshold {2 * hugePageSize};
+    TextureAllocator::Statistics statistics;
+};
+
+uchar *TextureAllocatorPrivate::allocateBlock(qsizetype size)
+{
+    constexpr auto alignment = TextureAllocator::alignment;
+#if defined(Q_OS_WIN)
+    return static_cast<uchar *>(_aligned_malloc(size_t(size), alignment));
+#else
+    if (isMapped(size)) {
+        // mmap returns page-aligned memory, so there is no need to over-allocate for the alignment
+        const auto result = mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (result == MAP_FAILED)
+            return nullptr;
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+        if (hugePagesEnabled && size >= hugePageThreshold) {
+            // this is only a hint, the kernel may ignore it
+            madvise(result, size_t(size), MADV_HUGEPAGE);
+            statistics.hugePageAllocations++;
+        }
+#endif
+        return static_cast<uchar *>(result);
+    }
+
+    void *result = nullptr;
+    if (posix_memalign(&result, alignment, size_t(size)) != 0)
+        return nullptr;
+    return static_cast<uchar *>(result);
+#endif
+}
+
+/*!
+  \class TextureAllocator
+  \brief Pooled allocator for the texture data.
+
+  All buffers are aligned to 64 bytes, so SIMD code can use aligned loads. Requested sizes are
+  rounded up to a size class; freed buffers are kept in per-class free lists up to poolLimit()
+  bytes and reused by subsequent allocations of the same class. That avoids page faults and
+  mmap/munmap calls when textures of the same size are repeatedly created and destroyed, e.g. in
+  batch conversion.
+
+  Buffers of 4 MB and more are mapped directly from the system. On Linux, they are also advised
+  to be backed by transparent huge pages.
+
+  Textures allocate their data using the global instance() unless external data is passed.
+*/
+
+/*!
+  \brief Constructs a new TextureAllocator with an empty pool.
+*/
+TextureAllocator::TextureAllocator()
+    : d_ptr(new TextureAllocatorPrivate)
+{
+}
+
+/*!
+  \brief Destroys the TextureAllocator and releases the pooled buffers.
+
+  All buffers allocated by this allocator should be deallocated before its destruction.
+*/
+TextureAllocator::~TextureAllocator()
+{
+    trim();
+}
+
+/*!
+  \brief Allocates a buffer of at least \a size bytes.
+
+  Returns nullptr if \a size is not positive or if the system is out of memory.
+*/
+uchar *TextureAllocator::allocate(qsizetype size)
+{
+    Q_D(TextureAllocator);
+
+    if (size <= 0)
+        return nullptr;
+
+    const auto cls = sizeClass(size);
+
+    QMutexLocker lock(&d->mutex);
+
+    uchar *result = nullptr;
+    auto it = d->freeLists.find(cls);
+    if (it != d->freeLists.end() && !it->second.empty()) {
+        result = it->second.back();
+        it->second.pop_back();
+        d->statistics.bytesPooled -= cls;
+        d->statistics.poolHits++;
+    } else {
+        result = d->allocateBlock(cls);
+        if (!result) {
+            d->statistics.failures++;
+            return nullptr;
+        }
+    }
+
+    d->statistics.allocations++;
+    d->statistics.bytesInUse += cls;
+    d->statistics.peakBytesInUse = std::max(d->statistics.peakBytesInUse, d->statistics.bytesInUse);
+    return result;
+}
+
+/*!
+  \brief Returns the \a data of the given \a size to the pool.
+
+  The \a size should be the same as passed to allocate(). If the pool is full, the buffer is
+  released to the system.
+*/
+void TextureAllocator::deallocate(uchar *data, qsizetype size)
+{
+    Q_D(TextureAllocator);
+
+    if (!data)
+        return;
+
+    const auto cls = sizeClass(size);
+
+    QMutexLocker lock(&d->mutex);
+
+    d->statistics.deallocations++;
+    d->statistics.bytesInUse -= cls;
+
+    if (d->statistics.bytesPooled + cls > d->poolLimit) {
+        lock.unlock();
+        freeBlock(data, cls);
+        return;
+    }
+
+    d->freeLists[cls].push_back(data);
+    d->statistics.bytesPooled += cls;
+}
+
+/*!
+  \brief Returns a deleter that returns the data of the given \a size to the global instance().
+
+  The deleter can be passed to the Texture constructor that takes external data.
+*/
+Texture::DataDeleter TextureAllocator::deleter(qsizetype size)
+{
+    return [size](uchar data[]) {
+        // The global instance can be destroyed before the last texture
+        if (const auto allocator = TextureAllocator::instance())
+            allocator->deallocate(data, size);
+        else
+            freeBlock(data, sizeClass(size));
+    };
+}
+
+/*!
+  \brief Returns the size class for the given \a size.
+
+  Small sizes are rounded up to the multiple of the alignment, larger sizes are rounded up to
+  one of the 4 classes per power of two, so no more than 25% of memory is wasted.
+*/
+qsizetype TextureAllocator::sizeClass(qsizetype size)
+{
+    constexpr auto align = qsizetype(alignment);
+    if (size <= 4096)
+        return std::max(align, (size + align - 1) / align * align);
+
+    auto power = qsizetype(4096);
+    while (power <= size / 2)
+        power *= 2;
+    const auto step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+/*!
+  \brief Returns the maximum amount of bytes kept in the pool.
+
+  Pooled bytes are not counted by the texture cache, so the limit should be small compared to the
+  cache budget. The default value is 128 MB; the global TextureViewer::TextureCache keeps the limit
+  of the global instance() at a fraction of its budget.
+*/
+qsizetype TextureAllocator::poolLimit() const
+{
+    Q_D(const TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    return d->poolLimit;
+}
+
+/*!
+  \brief Sets the maximum amount of \a bytes kept in the pool and releases the pooled buffers.
+*/
+void TextureAllocator::setPoolLimit(qsizetype bytes)
+{
+    Q_D(TextureAllocator);
+    {
+        QMutexLocker lock(&d->mutex);
+        d->poolLimit = bytes;
+    }
+    trim();
+}
+
+/*!
+  \brief Returns true if large buffers use transparent huge pages.
+
+  The default value is true on Linux and false on other systems, where huge pages are not
+  supported.
+*/
+bool TextureAllocator::hugePagesEnabled() const
+{
+    Q_D(const TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    return d->hugePagesEnabled;
+}
+
+/*!
+  \brief Sets whether large buffers use transparent huge pages to \a enabled.
+*/
+void TextureAllocator::setHugePagesEnabled(bool enabled)
+{
+    Q_D(TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    d->hugePagesEnabled = enabled;
+}
+
+/*!
+  \brief Returns the minimal size of a buffer that uses huge pages.
+
+  The default value is 4 MB. Smaller buffers are not mapped directly and never use huge pages.
+*/
+qsizetype TextureAllocator::hugePageThreshold() const
+{
+    Q_D(const TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    return d->hugePageThreshold;
+}
+
+/*!
+  \brief Sets the minimal size of a buffer that uses huge pages to \a bytes.
+*/
+void TextureAllocator::setHugePageThreshold(qsizetype bytes)
+{
+    Q_D(TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    d->hugePageThreshold = bytes;
+}
+
+/*!
+  \brief Releases all pooled buffers to the system.
+*/
+void TextureAllocator::trim()
+{
+    Q_D(TextureAllocator);
+
+    decltype(d->freeLists) freeLists;
+    {
+        QMutexLocker lock(&d->mutex);
+        freeLists.swap(d->freeLists);
+        d->statistics.bytesPooled = 0;
+    }
+
+    for (const auto &freeList: freeLists) {
+        for (const auto data: freeList.second)
+            freeBlock(data, freeList.first);
+    }
+}
+
+/*!
+  \brief Returns the allocation statistics.
+*/
+TextureAllocator::Statistics TextureAllocator::statistics() const
+{
+    Q_D(const TextureAllocator);
+    QMutexLocker lock(&d->mutex);
+    return d->statistics;
+}
+
+Q_GLOBAL_STATIC(TextureAllocator, globalAllocator)
+
+/*!
+  \brief Returns the global allocator used by textures.
+
+  Returns nullptr during the application shutdown, after the allocator was destroyed.
+*/
+TextureAllocator *TextureAllocator::instance()
+{
+    return globalAllocator();
+}
+
+QDebug operator<<(QDebug debug, const TextureAllocator::Statistics &statistics)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "TextureAllocator::Statistics("
+                    << "allocations = " << statistics.allocations
+                    << ", deallocations = " << statistics.deallocations
+                    << ", poolHits = " << statistics.poolHits
+                    << ", failures = " << statistics.failures
+                    << ", hugePageAllocations = " << statistics.hugePageAllocations
+                    << ", bytesInUse = " << statistics.bytesInUse
+                    << ", peakBytesInUse = " << statistics.peakBytesInUse
+                    << ", bytesPooled = " << statistics.bytesPooled
+                    << ")";
+    return debug;
+}
@@ -0,0 +1,64 @@
+#ifndef TEXTUREALLOCATOR_H
+#define TEXTUREALLOCATOR_H
+
+#include "texturelib_global.h"
+
+#include <TextureLib/Texture>
+
+#include <QtCore/QScopedPointer>
+
+class TextureAllocatorPrivate;
+
+class TEXTURELIB_EXPORT TextureAllocator
+{
+    Q_DISABLE_COPY(TextureAllocator)
+    Q_DECLARE_PRIVATE(TextureAllocator)
+public:
+    static constexpr std::size_t alignment = 64;
+
+    struct Statistics
+    {
+        qint64 allocations {0};
+        qint64 deallocations {0};
+        qint64 poolHits {0};
+        qint64 failures {0};
+        qint64 hugePageAllocations {0};
+        qint64 bytesInUse {0};
+        qint64 peakBytesInUse {0};
+        qint64 bytesPooled {0};
+    };
+
+    TextureAllocator();
+    TextureAllocator(TextureAllocator &&) = delete;
+    ~TextureAllocator();
+    TextureAllocator &operator=(TextureAllocator &&) = delete;
+
+    uchar *allocate(qsizetype size);
+    void deallocate(uchar *data, qsizetype size);
+
+    static Texture::DataDeleter deleter(qsizetype size);
+
+    static qsizetype sizeClass(qsizetype size);
+
+    qsizetype poolLimit() const;
+    void setPoolLimit(qsizetype bytes);
+
+    bool hugePagesEnabled() const;
+    void setHugePagesEnabled(bool enabled);
+
+    qsizetype hugePageThreshold() const;
+    void setHugePageThreshold(qsizetype bytes);
+
+    void trim();
+
+    Statistics statistics() const;
+
+    static TextureAllocator *instance();
+
+private:
+    QScopedPointer<TextureAllocatorPrivate> d_ptr;
+};
+
+QDebug TEXTURELIB_EXPORT operator<<(QDebug debug, const TextureAllocator::Statistics &statistics);
+
+#endif // TEXTUREALLOCATOR_H
@@ -0,0 +1,23 @@
+#ifndef TEXTUREHASH_P_H
+#define TEXTUREHASH_P_H
+
+#include <QtCore/qglobal.h>
+
+#include <gsl/span>
+
+namespace TextureHash {
+
+// 64-bit non-cryptographic hash (xxHash64 algorithm). Processes data in 32-byte stripes using
+// 4 independent accumulators, so the main loop is not serialized on a single multiplication chain.
+quint64 hash(gsl::span<const uchar> data, quint64 seed = 0) noexcept;
+
+// Mixes value into the seed; used to build a fingerprint from several hashes.
+quint64 combine(quint64 seed, quint64 value) noexcept;
+
+// Memoized hashes use 0 as a "not computed" marker, so real hash values never equal 0.
+constexpr quint64 notComputed = 0;
+inline quint64 nonZero(quint64 value) noexcept { return value != notComputed ? value : 1; }
+
+} // namespace TextureHash
+
+#endif // TEXTUREHASH_P_H
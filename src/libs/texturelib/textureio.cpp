@@ -3,6 +3,8 @@
 #include "textureiohandler.h"
 #include "textureiohandlerdatabase.h"
 #include "textureioresult.h"
+#include "texturememory.h"
+#include "tracing.h"
 
 #include <OptionalType>
 
@@ -10,6 +12,8 @@
 #include <QtCore/QFile>
 #include <QtCore/QMimeDatabase>
 
+#include <algorithm>
+
 using Capability = TextureIOHandlerPlugin::Capability;
 using Capabilities = TextureIOHandlerPlugin::Capabilities;
 
@@ -44,6 +48,11 @@ public:
 
     QIODevicePointer device;
     Optional<QMimeType> mimeType {};
+    bool hashOnRead {false};
+    int compression {-1};
+    int previewSize {TextureIOHandler::defaultPreviewSize};
+    TextureIO::HeaderCallback headerCallback;
+    TextureIO::ImageCallback imageCallback;
 };
 
 TextureIOResult TextureIOPrivate::ensureDeviceOpened(Capabilities caps)
@@ -75,6 +84,7 @@ TextureIOResult TextureIOPrivate::ensureHandlerCreated(Capabilities caps)
 
     auto mt = QMimeType();
     if (!mimeType) {
+        TraceSpan span("io", "TextureIO::detectMimeType");
         // mimeType is not set, try to guess from file
         if (file)
             mt = QMimeDatabase().mimeTypeForFile(fileName);
@@ -87,6 +97,8 @@ TextureIOResult TextureIOPrivate::ensureHandlerCreated(Capabilities caps)
     if (!mt.isValid())
         return TextureIOError::InvalidMimeType;
 
+    TraceSpan span("io", "TextureIO::createHandler");
+    span.setDetail(mt.name());
     auto db = TextureIOHandlerDatabase::instance();
     handler = db->create(device, mt.name(), caps);
     if (!handler)
@@ -260,6 +272,116 @@ void TextureIO::setMimeType(QStringView mimeType)
     d->resetHandler();
 }
 
+/*!
+  \property TextureIO::hashOnRead
+  \brief This property holds whether subresource hashes are computed while reading.
+
+  When enabled, handlers hash each image right after it is read, so Texture::contentHash() of the
+  returned texture is cheap. The default value is false.
+*/
+
+bool TextureIO::hashOnRead() const
+{
+    Q_D(const TextureIO);
+    return d->hashOnRead;
+}
+
+void TextureIO::setHashOnRead(bool hashOnRead)
+{
+    Q_D(TextureIO);
+    d->hashOnRead = hashOnRead;
+}
+
+/*!
+  \property TextureIO::compression
+  \brief This property holds the compression level used when writing.
+
+  The value ranges from 0 (no compression) to 9 (best compression); -1 lets the handler choose
+  its default. Handlers of formats without optional compression ignore this property. The default
+  value is -1.
+*/
+
+int TextureIO::compression() const
+{
+    Q_D(const TextureIO);
+    return d->compression;
+}
+
+void TextureIO::setCompression(int compression)
+{
+    Q_D(TextureIO);
+    d->compression = qBound(-1, compression, 9);
+}
+
+/*!
+  \property TextureIO::previewSize
+  \brief This property holds the maximum width and height of the image returned by readPreview().
+
+  The default value is TextureIOHandler::defaultPreviewSize.
+*/
+
+int TextureIO::previewSize() const
+{
+    Q_D(const TextureIO);
+    return d->previewSize;
+}
+
+void TextureIO::setPreviewSize(int previewSize)
+{
+    Q_D(TextureIO);
+    d->previewSize = std::max(1, previewSize);
+}
+
+/*!
+  \brief Returns the function that is called by read() when the header is read.
+
+  \sa setHeaderCallback()
+*/
+TextureIO::HeaderCallback TextureIO::headerCallback() const
+{
+    Q_D(const TextureIO);
+    return d->headerCallback;
+}
+
+/*!
+  \brief Sets the function that is called by read() when the header is read to \a callback.
+
+  The callback gets the texture created from the header before its data is read, so callers can
+  use its format and dimensions while the texture is loading. It is called from the thread that
+  calls read(). Handlers that read the whole file at once don't call it.
+*/
+void TextureIO::setHeaderCallback(HeaderCallback callback)
+{
+    Q_D(TextureIO);
+    d->headerCallback = std::move(callback);
+}
+
+/*!
+  \brief Returns the function that is called by read() for each image that is read.
+
+  \sa setImageCallback()
+*/
+TextureIO::ImageCallback TextureIO::imageCallback() const
+{
+    Q_D(const TextureIO);
+    return d->imageCallback;
+}
+
+/*!
+  \brief Sets the function that is called by read() for each image that is read to \a callback.
+
+  The callback gets the texture that is being read and the index of the image that is complete;
+  the data of the other images must not be accessed. Images are reported in the order they are
+  stored in the file. The callback is called from the thread that calls read().
+
+  \sa TextureIOHandler::imageRead()
+*/
+void TextureIO::setImageCallback(ImageCallback callback)
+{
+    Q_D(TextureIO);
+    d->imageCallback = std::move(callback);
+}
+
 /*!
   \brief Reads the contents of an texture file.
 
@@ -269,10 +391,18 @@ TextureIO::ReadResult TextureIO::read()
 {
     Q_D(TextureIO);
 
+    TraceSpan span("io", "TextureIO::read");
+    span.setDetail(d->fileName);
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
+
     auto ok = d->ensureHandlerCreated(Capability::CanRead);
     if (!ok)
         return makeUnexpected(ok.error());
 
+    d->handler->setHashOnRead(d->hashOnRead);
+    d->handler->setHeaderCallback(d->headerCallback);
+    d->handler->setImageCallback(d->imageCallback);
+
     Texture texture;
     if (!d->handler->read(texture))
         ok = TextureIOError::HandlerError;
@@ -283,6 +413,87 @@ TextureIO::ReadResult TextureIO::read()
     return texture;
 }
 
+/*!
+  \brief Reads a small image of the texture that can be shown while the texture is loading.
+
+  The result has a single level, layer and face and is not bigger than previewSize() unless it is
+  a low resolution image stored in the file. Only the data of that image is read. Handlers that
+  can't read a preview return TextureIOError::HandlerError.
+
+  On random-access devices, the device is moved back to where it was, so read() can be called
+  afterwards to read the whole texture.
+*/
+TextureIO::ReadResult TextureIO::readPreview()
+{
+    Q_D(TextureIO);
+
+    TraceSpan span("io", "TextureIO::readPreview");
+    span.setDetail(d->fileName);
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
+
+    auto ok = d->ensureHandlerCreated(Capability::CanRead);
+    if (!ok)
+        return makeUnexpected(ok.error());
+
+    d->handler->setPreviewSize(d->previewSize);
+    // The preview is not a part of the texture that is reported by read()
+    d->handler->setHeaderCallback({});
+    d->handler->setImageCallback({});
+
+    const auto sequential = d->device->isSequential();
+    const auto pos = d->device->pos();
+    Texture texture;
+    if (!d->handler->readPreview(texture))
+        ok = TextureIOError::HandlerError;
+    if (!sequential && !d->device->seek(pos))
+        ok = TextureIOError::DeviceError;
+
+    if (!ok)
+        return makeUnexpected(ok.error());
+
+    return texture;
+}
+
+/*!
+  \brief Reads a single mip \a level of the texture.
+
+  The result has the size of that level, a single level and all faces and layers of the texture.
+  Only the data of that level is read, so levels can be loaded on demand, for example, the smallest
+  one first. Handlers that can't read single levels return TextureIOError::HandlerError.
+
+  On random-access devices, the device is moved back to where it was, so other levels or the
+  whole texture can be read afterwards.
+*/
+TextureIO::ReadResult TextureIO::readLevel(int level)
+{
+    Q_D(TextureIO);
+
+    TraceSpan span("io", "TextureIO::readLevel");
+    span.setDetail(d->fileName);
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
+
+    auto ok = d->ensureHandlerCreated(Capability::CanRead);
+    if (!ok)
+        return makeUnexpected(ok.error());
+
+    // A single level is not a part of the texture that is reported by read()
+    d->handler->setHeaderCallback({});
+    d->handler->setImageCallback({});
+
+    const auto sequential = d->device->isSequential();
+    const auto pos = d->device->pos();
+    Texture texture;
+    if (!d->handler->readLevel(level, texture))
+        ok = TextureIOError::HandlerError;
+    if (!sequential && !d->device->seek(pos))
+        ok = TextureIOError::DeviceError;
+
+    if (!ok)
+        return makeUnexpected(ok.error());
+
+    return texture;
+}
+
 /*!
   \brief Writes the given \a contents with the given \a options to the device.
 
@@ -291,10 +502,16 @@ TextureIO::ReadResult TextureIO::read()
 TextureIO::WriteResult TextureIO::write(const Texture &contents)
 {
     Q_D(TextureIO);
+
+    TraceSpan span("io", "TextureIO::write");
+    span.setDetail(d->fileName);
+
     auto ok = d->ensureHandlerCreated(Capability::CanWrite);
     if (!ok)
         return ok;
 
+    d->handler->setCompression(d->compression);
+
     if (!d->handler->write(contents))
         return TextureIOError::HandlerError;
 
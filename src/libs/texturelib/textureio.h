@@ -3,6 +3,7 @@
 #include "texturelib_global.h"
 
 #include <TextureLib/Texture>
+#include <TextureLib/TextureIOHandler>
 #include <TextureLib/TextureIOResult>
 
 #include <QtCore/QMimeType>
@@ -26,6 +27,9 @@ class TEXTURELIB_EXPORT TextureIO
     Q_PROPERTY(QString fileName READ fileName WRITE setFileName)
     Q_PROPERTY(QIODevicePointer device READ device WRITE setDevice)
     Q_PROPERTY(QMimeType mimeType READ mimeType WRITE setMimeType)
+    Q_PROPERTY(bool hashOnRead READ hashOnRead WRITE setHashOnRead)
+    Q_PROPERTY(int compression READ compression WRITE setCompression)
+    Q_PROPERTY(int previewSize READ previewSize WRITE setPreviewSize)
 
 public:
     using QIODevicePointer = ObserverPointer<QIODevice>;
@@ -42,6 +46,8 @@ public:
 
     using ReadResult = Expected<Texture, TextureIOError>;
     using WriteResult = TextureIOResult;
+    using HeaderCallback = TextureIOHandler::HeaderCallback;
+    using ImageCallback = TextureIOHandler::ImageCallback;
 
     QString fileName() const;
     void setFileName(const QString &fileName);
@@ -53,7 +59,24 @@ public:
     void setMimeType(const QMimeType &mimeType);
     void setMimeType(QStringView mimeType);
 
+    bool hashOnRead() const;
+    void setHashOnRead(bool hashOnRead);
+
+    int compression() const;
+    void setCompression(int compression);
+
+    int previewSize() const;
+    void setPreviewSize(int previewSize);
+
+    HeaderCallback headerCallback() const;
+    void setHeaderCallback(HeaderCallback callback);
+
+    ImageCallback imageCallback() const;
+    void setImageCallback(ImageCallback callback);
+
     ReadResult read();
+    ReadResult readPreview();
+    ReadResult readLevel(int level);
 
     WriteResult write(const Texture &contents);
 
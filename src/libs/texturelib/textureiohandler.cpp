@@ -1,5 +1,7 @@
 #include "textureiohandler.h"
 
+#include <algorithm>
+
 /*!
     \class TextureIOHandler
 
@@ -25,6 +27,39 @@ TextureIOHandler::~TextureIOHandler() noexcept = default;
     If no device has been assigned, nullptr is returned.
 */
 
+/*!
+    \fn bool TextureIOHandler::hashOnRead() const
+
+    \brief Returns true if the handler should compute subresource hashes while reading.
+
+    \sa hashImageData(), Texture::subresourceHash()
+*/
+
+/*!
+    \fn int TextureIOHandler::compression() const
+
+    \brief Returns the compression level requested for writing, from 0 to 9, or -1 if the handler
+    should use its default.
+
+    \sa TextureIO::compression
+*/
+
+/*!
+    \fn HeaderCallback TextureIOHandler::headerCallback() const
+
+    \brief Returns the function called by read() once the texture is created from the header.
+
+    \sa headerRead(), TextureIO::setHeaderCallback()
+*/
+
+/*!
+    \fn ImageCallback TextureIOHandler::imageCallback() const
+
+    \brief Returns the function called by read() for each image that is completely read.
+
+    \sa imageRead(), TextureIO::setImageCallback()
+*/
+
 /*!
     \fn bool TextureIOHandler::read(Texture &texture)
 
@@ -34,8 +69,55 @@ TextureIOHandler::~TextureIOHandler() noexcept = default;
     read; otherwise should return false.
 
     Specific error can be logged to the stderr.
+
+    Handlers that read the payload in several steps should call headerRead() once the texture is
+    created and imageRead() for each image as soon as it is read, so the callers can show the
+    texture while it is loading.
+*/
+
+/*!
+    \fn int TextureIOHandler::previewSize() const
+
+    \brief Returns the maximum width and height of the image returned by readPreview().
+
+    The default value is defaultPreviewSize.
 */
 
+/*!
+    Reimplement this function to read a small image of the texture that can be shown while the
+    whole texture is loading.
+
+    The image is stored to the given \a texture, which has a single level, layer and face. It is
+    usually the first image of the largest mip level that fits into previewSize(), see
+    previewLevel(), or a low resolution image stored in the file. Handlers should read as little
+    data as possible, seeking directly to the image. Should return true if the preview is read;
+    otherwise should return false.
+
+    The default implementation does nothing, and simply returns false.
+*/
+bool TextureIOHandler::readPreview(Texture &texture)
+{
+    Q_UNUSED(texture);
+    return false;
+}
+
+/*!
+    Reimplement this function to read a single mip \a level of the texture, so levels can be
+    loaded on demand.
+
+    The level is stored to the given \a texture, which has the size of that level, a single level
+    and all faces and layers of the texture. Handlers should seek directly to the data of the
+    level. Should return true if the level is read; otherwise should return false.
+
+    The default implementation does nothing, and simply returns false.
+*/
+bool TextureIOHandler::readLevel(int level, Texture &texture)
+{
+    Q_UNUSED(level);
+    Q_UNUSED(texture);
+    return false;
+}
+
 /*!
     Reimplement this function to write the given \a texture data to the device.
 
@@ -50,3 +132,55 @@ bool TextureIOHandler::write(const Texture &texture)
     Q_UNUSED(texture);
     return false;
 }
+
+/*!
+    Computes the hash of the image at the given \a index of the \a texture if hashOnRead() is
+    enabled, otherwise does nothing.
+
+    Handlers should call this function right after the image was read from the device, while its
+    data is still in the CPU cache, so the hash comes almost for free with the load.
+*/
+void TextureIOHandler::hashImageData(const Texture &texture, Texture::ArrayIndex index) const
+{
+    if (m_hashOnRead)
+        texture.subresourceHash(index);
+}
+
+/*!
+    Returns the largest mip level of a texture with the given base \a size and number of
+    \a levels whose width and height fit into previewSize(), or -1 if there is no such level.
+*/
+int TextureIOHandler::previewLevel(Texture::Size size, int levels) const
+{
+    for (int level = 0; level < levels; ++level) {
+        const auto width = std::max<qsizetype>(1, size.width >> level);
+        const auto height = std::max<qsizetype>(1, size.height >> level);
+        if (width <= m_previewSize && height <= m_previewSize)
+            return level;
+    }
+    return -1;
+}
+
+/*!
+    Calls the headerCallback() with the given \a texture, which is created from the header and
+    whose data is not read yet.
+*/
+void TextureIOHandler::headerRead(const Texture &texture) const
+{
+    if (m_headerCallback)
+        m_headerCallback(texture);
+}
+
+/*!
+    Notifies that the image at the given \a index of the \a texture is read: computes its hash,
+    see hashImageData(), and calls the imageCallback().
+
+    The callback is called from the reading thread while the other images are not read yet; it
+    may only access the data of the image at \a index.
+*/
+void TextureIOHandler::imageRead(const Texture &texture, Texture::ArrayIndex index) const
+{
+    hashImageData(texture, index);
+    if (m_imageCallback)
+        m_imageCallback(texture, index);
+}
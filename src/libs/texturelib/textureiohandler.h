@@ -2,19 +2,25 @@
 
 #include "texturelib_global.h"
 
+#include <TextureLib/Texture>
+
 #include <ObserverPointer>
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE
 class QIODevice;
 QT_END_NAMESPACE
 
-class Texture;
-
 class TEXTURELIB_EXPORT TextureIOHandler
 {
     Q_DISABLE_COPY(TextureIOHandler)
 public:
     using QIODevicePointer = ObserverPointer<QIODevice>;
+    using HeaderCallback = std::function<void(const Texture &texture)>;
+    using ImageCallback = std::function<void(const Texture &texture, Texture::ArrayIndex index)>;
+
+    static constexpr int defaultPreviewSize = 256;
 
     TextureIOHandler() noexcept = default;
     TextureIOHandler(TextureIOHandler &&) noexcept = default;
@@ -25,9 +31,37 @@ public:
     QIODevicePointer device() const noexcept { return m_device; }
     void setDevice(QIODevicePointer device) noexcept { m_device = device; }
 
+    bool hashOnRead() const noexcept { return m_hashOnRead; }
+    void setHashOnRead(bool hashOnRead) noexcept { m_hashOnRead = hashOnRead; }
+
+    int compression() const noexcept { return m_compression; }
+    void setCompression(int compression) noexcept { m_compression = compression; }
+
+    int previewSize() const noexcept { return m_previewSize; }
+    void setPreviewSize(int previewSize) noexcept { m_previewSize = previewSize; }
+
+    HeaderCallback headerCallback() const { return m_headerCallback; }
+    void setHeaderCallback(HeaderCallback callback) { m_headerCallback = std::move(callback); }
+
+    ImageCallback imageCallback() const { return m_imageCallback; }
+    void setImageCallback(ImageCallback callback) { m_imageCallback = std::move(callback); }
+
     virtual bool read(Texture &texture) = 0;
+    virtual bool readPreview(Texture &texture);
+    virtual bool readLevel(int level, Texture &texture);
     virtual bool write(const Texture &texture);
 
+protected:
+    void hashImageData(const Texture &texture, Texture::ArrayIndex index) const;
+    void headerRead(const Texture &texture) const;
+    void imageRead(const Texture &texture, Texture::ArrayIndex index) const;
+    int previewLevel(Texture::Size size, int levels) const;
+
 private:
     QIODevicePointer m_device;
+    bool m_hashOnRead {false};
+    int m_compression {-1};
+    int m_previewSize {defaultPreviewSize};
+    HeaderCallback m_headerCallback;
+    ImageCallback m_imageCallback;
 };
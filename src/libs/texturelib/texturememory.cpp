@@ -0,0 +1,240 @@
+#include "texturememory.h"
+
+#include <UtilsLib/StringHelpers>
+
+#include <QtCore/QDebug>
+
+#include <array>
+#include <atomic>
+
+namespace {
+
+struct AtomicCounters
+{
+    std::atomic<qint64> allocations {0};
+    std::atomic<qint64> bytes {0};
+    std::atomic<qint64> peakBytes {0};
+    std::atomic<qint64> failures {0};
+    std::atomic<bool> used {false};
+};
+
+constexpr auto formatsCount = size_t(TextureFormat::FormatsCount);
+constexpr auto originsCount = size_t(TextureMemory::Origin::OriginsCount);
+
+// Plain global arrays of atomics, so accounting never takes a lock or allocates
+std::atomic<qint64> textures {0};
+std::atomic<qint64> peakTextures {0};
+AtomicCounters total;
+std::array<AtomicCounters, formatsCount> formats;
+std::array<AtomicCounters, originsCount> origins;
+
+thread_local TextureMemory::Origin currentOriginValue = TextureMemory::Origin::Other;
+
+void updatePeak(std::atomic<qint64> &peak, qint64 value) noexcept
+{
+    auto current = peak.load(std::memory_order_relaxed);
+    while (value > current
+           && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void add(AtomicCounters &counters, qint64 bytes) noexcept
+{
+    counters.used.store(true, std::memory_order_relaxed);
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto current = counters.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    updatePeak(counters.peakBytes, current);
+}
+
+void remove(AtomicCounters &counters, qint64 bytes) noexcept
+{
+    counters.allocations.fetch_sub(1, std::memory_order_relaxed);
+    counters.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void fail(AtomicCounters &counters) noexcept
+{
+    counters.used.store(true, std::memory_order_relaxed);
+    counters.failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+TextureMemory::Counters load(const AtomicCounters &counters) noexcept
+{
+    TextureMemory::Counters result;
+    result.allocations = counters.allocations.load(std::memory_order_relaxed);
+    result.bytes = counters.bytes.load(std::memory_order_relaxed);
+    result.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    result.failures = counters.failures.load(std::memory_order_relaxed);
+    return result;
+}
+
+void resetPeak(AtomicCounters &counters) noexcept
+{
+    counters.peakBytes.store(counters.bytes.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+}
+
+AtomicCounters &formatCounters(TextureFormat format) noexcept
+{
+    return formats[std::min(size_t(format), formatsCount - 1)];
+}
+
+AtomicCounters &originCounters(TextureMemory::Origin origin) noexcept
+{
+    return origins[std::min(size_t(origin), originsCount - 1)];
+}
+
+} // namespace
+
+/*!
+    \class TextureMemory
+    \brief Global accounting of the memory held by the textures.
+
+    Counts live TextureData instances and the buffers holding the texel data. The buffers are
+    broken down by format and by origin, i.e. by what created them: reading from a file,
+    conversion, copying (including copy-on-write of a shared texture) or slicing a document.
+    The origin is taken from the innermost OriginScope of the allocating thread.
+
+    Shared textures share the buffers, so the bytes are the actual memory usage, not the sum of
+    Texture::bytes() of all instances. Counters are updated with relaxed atomics, so a snapshot
+    returned by statistics() may be slightly inconsistent while other threads allocate.
+*/
+
+/*!
+    \class TextureMemory::OriginScope
+    \brief Sets the origin of the texture allocations made by the current thread.
+
+    The previous origin is restored on destruction, so scopes can be nested.
+*/
+
+/*!
+    Sets the current origin to \a origin.
+*/
+TextureMemory::OriginScope::OriginScope(Origin origin) noexcept
+    : m_previous(currentOriginValue)
+{
+    currentOriginValue = origin;
+}
+
+/*!
+    Restores the previous origin.
+*/
+TextureMemory::OriginScope::~OriginScope() noexcept
+{
+    currentOriginValue = m_previous;
+}
+
+/*!
+    Returns the origin of the allocations made by the current thread.
+*/
+TextureMemory::Origin TextureMemory::currentOrigin() noexcept
+{
+    return currentOriginValue;
+}
+
+/*!
+    Returns the snapshot of the counters.
+*/
+TextureMemory::Statistics TextureMemory::statistics()
+{
+    Statistics result;
+    result.textures = textures.load(std::memory_order_relaxed);
+    result.peakTextures = peakTextures.load(std::memory_order_relaxed);
+    result.total = load(total);
+    for (size_t i = 0; i < formatsCount; ++i) {
+        if (formats[i].used.load(std::memory_order_relaxed))
+            result.formats[TextureFormat(i)] = load(formats[i]);
+    }
+    for (size_t i = 0; i < originsCount; ++i) {
+        if (origins[i].used.load(std::memory_order_relaxed))
+            result.origins[Origin(i)] = load(origins[i]);
+    }
+    return result;
+}
+
+/*!
+    Resets the peak values to the current values.
+*/
+void TextureMemory::resetPeaks()
+{
+    peakTextures.store(textures.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    resetPeak(total);
+    for (auto &counters: formats)
+        resetPeak(counters);
+    for (auto &counters: origins)
+        resetPeak(counters);
+}
+
+/*!
+    \internal
+*/
+void TextureMemory::textureCreated() noexcept
+{
+    updatePeak(peakTextures, textures.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+
+/*!
+    \internal
+*/
+void TextureMemory::textureDestroyed() noexcept
+{
+    textures.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+*/
+void TextureMemory::allocated(TextureFormat format, Origin origin, qint64 bytes) noexcept
+{
+    add(total, bytes);
+    add(formatCounters(format), bytes);
+    add(originCounters(origin), bytes);
+}
+
+/*!
+    \internal
+*/
+void TextureMemory::released(TextureFormat format, Origin origin, qint64 bytes) noexcept
+{
+    remove(total, bytes);
+    remove(formatCounters(format), bytes);
+    remove(originCounters(origin), bytes);
+}
+
+/*!
+    \internal
+*/
+void TextureMemory::allocationFailed(TextureFormat format, qint64 bytes) noexcept
+{
+    Q_UNUSED(bytes);
+    fail(total);
+    fail(formatCounters(format));
+    fail(originCounters(currentOrigin()));
+}
+
+QDebug operator<<(QDebug debug, const TextureMemory::Counters &counters)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "Counters("
+                    << "allocations = " << counters.allocations
+                    << ", bytes = " << counters.bytes
+                    << ", peakBytes = " << counters.peakBytes
+                    << ", failures = " << counters.failures
+                    << ")";
+    return debug;
+}
+
+QDebug operator<<(QDebug debug, const TextureMemory::Statistics &statistics)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "TextureMemory::Statistics("
+                    << "textures = " << statistics.textures
+                    << ", peakTextures = " << statistics.peakTextures
+                    << ", total = " << statistics.total;
+    for (const auto &item: statistics.origins)
+        debug << ", " << enumToLatin1(item.first) << " = " << item.second;
+    for (const auto &item: statistics.formats)
+        debug << ", " << toQString(item.first) << " = " << item.second;
+    debug << ")";
+    return debug;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "texturelib_global.h"
+
+#include <TextureLib/TextureFormat>
+
+#include <QtCore/QObject>
+
+#include <map>
+
+class QDebug;
+
+class TEXTURELIB_EXPORT TextureMemory
+{
+    Q_GADGET
+public:
+    enum class Origin {
+        Other,
+        IO,
+        Convert,
+        Copy,
+        Slice,
+        OriginsCount // should be the last
+    };
+    Q_ENUM(Origin)
+
+    struct Counters
+    {
+        qint64 allocations {0}; // live buffers
+        qint64 bytes {0};
+        qint64 peakBytes {0};
+        qint64 failures {0};
+    };
+
+    struct Statistics
+    {
+        qint64 textures {0};
+        qint64 peakTextures {0};
+        Counters total;
+        std::map<TextureFormat, Counters> formats; // only formats that were ever allocated
+        std::map<Origin, Counters> origins;
+    };
+
+    class TEXTURELIB_EXPORT OriginScope
+    {
+        Q_DISABLE_COPY(OriginScope)
+    public:
+        explicit OriginScope(Origin origin) noexcept;
+        OriginScope(OriginScope &&) = delete;
+        ~OriginScope() noexcept;
+        OriginScope &operator=(OriginScope &&) = delete;
+
+    private:
+        Origin m_previous {Origin::Other};
+    };
+
+    TextureMemory() = delete;
+
+    static Origin currentOrigin() noexcept;
+
+    static Statistics statistics();
+    static void resetPeaks();
+
+    // called by the TextureData internals
+    static void textureCreated() noexcept;
+    static void textureDestroyed() noexcept;
+    static void allocated(TextureFormat format, Origin origin, qint64 bytes) noexcept;
+    static void released(TextureFormat format, Origin origin, qint64 bytes) noexcept;
+    static void allocationFailed(TextureFormat format, qint64 bytes) noexcept;
+};
+
+QDebug TEXTURELIB_EXPORT operator<<(QDebug debug, const TextureMemory::Counters &counters);
+QDebug TEXTURELIB_EXPORT operator<<(QDebug debug, const TextureMemory::Statistics &statistics);
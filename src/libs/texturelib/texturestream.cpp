@@ -0,0 +1,433 @@
+#include "texturestream.h"
+#include "texturememory.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+#include <QtCore/QIODevice>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+struct Header
+{
+    quint32 magic {0};
+    quint16 version {0};
+    quint32 format {0};
+    quint32 width {0};
+    quint32 height {0};
+    quint32 depth {0};
+    quint32 faces {0};
+    quint32 layers {0};
+    quint32 levels {0};
+    quint8 align {0};
+};
+
+QDataStream &operator<<(QDataStream &stream, const Header &header)
+{
+    return stream << header.magic
+                  << header.version
+                  << header.format
+                  << header.width
+                  << header.height
+                  << header.depth
+                  << header.faces
+                  << header.layers
+                  << header.levels
+                  << header.align;
+}
+
+QDataStream &operator>>(QDataStream &stream, Header &header)
+{
+    return stream >> header.magic
+                  >> header.version
+                  >> header.format
+                  >> header.width
+                  >> header.height
+                  >> header.depth
+                  >> header.faces
+                  >> header.layers
+                  >> header.levels
+                  >> header.align;
+}
+
+// Size of an index entry in the stream: quint64 size and quint8 method
+constexpr quint64 entrySize = sizeof(quint64) + sizeof(quint8);
+// Blobs are read in chunks, so a corrupted size does not allocate more than the stream holds
+constexpr int readChunkSize = 1 << 20;
+
+// An entry of the per-subresource index
+struct Entry
+{
+    quint64 size {0}; // size in the stream
+    TextureStream::Method method {TextureStream::Method::Raw};
+};
+
+struct Blob
+{
+    Texture::ArrayIndex index;
+    Texture::ConstData source;
+    Texture::Data target;
+    QByteArray data;
+    TextureStream::Method method {TextureStream::Method::Raw};
+    bool ok {true};
+};
+
+// Subresources in the order they are stored in memory
+std::vector<Texture::ArrayIndex> subresources(Texture::ArraySize arraySize)
+{
+    std::vector<Texture::ArrayIndex> result;
+    result.reserve(size_t(arraySize.faces() * arraySize.levels() * arraySize.layers()));
+    for (int level = 0; level < arraySize.levels(); ++level) {
+        for (int layer = 0; layer < arraySize.layers(); ++layer) {
+            for (int face = 0; face < arraySize.faces(); ++face)
+                result.emplace_back(Texture::Side(face), level, layer);
+        }
+    }
+    return result;
+}
+
+// Returns the number of bytes left in the stream, or -1 if the device can't tell
+qint64 remainingBytes(QDataStream &stream)
+{
+    const auto device = stream.device();
+    if (!device || device->isSequential())
+        return -1;
+    return std::max<qint64>(0, device->size() - device->pos());
+}
+
+// Skips the given amount of bytes, seeking if the device allows it
+bool skip(QDataStream &stream, quint64 bytes)
+{
+    const auto device = stream.device();
+    if (device && !device->isSequential())
+        return device->seek(device->pos() + qint64(bytes));
+
+    while (bytes > 0) {
+        const auto chunk = int(std::min<quint64>(bytes, std::numeric_limits<int>::max()));
+        if (stream.skipRawData(chunk) != chunk)
+            return false;
+        bytes -= quint64(chunk);
+    }
+    return true;
+}
+
+bool readHeader(QDataStream &stream, Header &header, std::vector<Entry> &entries)
+{
+    stream >> header;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+    if (header.magic != TextureStream::magic || header.version != TextureStream::version) {
+        qCWarning(texture) << "Unsupported compressed texture stream, magic ="
+                           << QString::number(header.magic, 16) << "version =" << header.version;
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    if (header.format == quint32(TextureFormat::Invalid)
+            || header.format >= quint32(TextureFormat::FormatsCount)
+            || (header.align != quint8(Texture::Alignment::Byte)
+                && header.align != quint8(Texture::Alignment::Word))) {
+        qCWarning(texture) << "Invalid compressed texture stream, format =" << header.format
+                           << "alignment =" << int(header.align);
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+
+    // The product is computed in 64 bits, so huge dimensions can't wrap to a small count
+    quint32 count = 0;
+    stream >> count;
+    const auto expected = quint64(header.faces) * header.levels * header.layers;
+    const auto remaining = remainingBytes(stream);
+    if (stream.status() != QDataStream::Ok
+            || count != expected
+            || expected > quint64(std::numeric_limits<int>::max())
+            || (remaining >= 0 && expected * entrySize > quint64(remaining))) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+
+    // Entries are appended as they are read, the count alone is not trusted for allocation
+    entries.clear();
+    if (remaining >= 0)
+        entries.reserve(size_t(count));
+    for (quint32 i = 0; i < count; ++i) {
+        Entry entry;
+        quint8 method = 0;
+        stream >> entry.size >> method;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+        entry.method = TextureStream::Method(method);
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+Texture createTexture(const Header &header)
+{
+    return Texture(
+            TextureFormat(header.format),
+            {int(header.width), int(header.height), int(header.depth)},
+            {Texture::IsCubemap(header.faces > 1), int(header.levels), int(header.layers)},
+            Texture::Alignment(header.align));
+}
+
+// Decompresses the blob into its target, returns false if the data is corrupted
+bool unpack(const QByteArray &data, TextureStream::Method method, Texture::Data target)
+{
+    if (method == TextureStream::Method::Raw) {
+        if (data.size() != target.size())
+            return false;
+        memcpy(target.data(), data.constData(), size_t(target.size()));
+        return true;
+    }
+    if (method == TextureStream::Method::Zlib) {
+        const auto unpacked = qUncompress(data);
+        if (unpacked.size() != target.size())
+            return false;
+        memcpy(target.data(), unpacked.constData(), size_t(target.size()));
+        return true;
+    }
+    return false;
+}
+
+bool readBlob(QDataStream &stream, const Entry &entry, QByteArray &data)
+{
+    const auto remaining = remainingBytes(stream);
+    if (entry.size > quint64(std::numeric_limits<int>::max())
+            || (remaining >= 0 && entry.size > quint64(remaining))) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+
+    // The buffer grows as the data arrives
+    data.clear();
+    const auto total = int(entry.size);
+    if (remaining >= 0)
+        data.reserve(total);
+    while (data.size() < total) {
+        const auto offset = data.size();
+        const auto chunk = std::min(total - offset, readChunkSize);
+        data.resize(offset + chunk);
+        if (stream.readRawData(data.data() + offset, chunk) != chunk) {
+            data.clear();
+            stream.setStatus(QDataStream::ReadPastEnd);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/*!
+    \class TextureStream
+    \brief Versioned compressed serialization of Texture.
+
+    Unlike operator<<(QDataStream &, const Texture &), which writes the texel data as is,
+    writeCompressed() compresses each subresource independently with zlib. Subresources are
+    compressed and decompressed in parallel using the global thread pool. Subresources that do not
+    shrink are stored as is.
+
+    The header is followed by an index with the stored size of each subresource, so
+    readCompressedImage() can decompress a single image and skip the rest, seeking when the device
+    allows it.
+
+    Stream layout (all values use the stream's byte order):
+    \list
+    \li magic (quint32, "TVTC") and version (quint16);
+    \li format, width, height, depth, faces, layers and levels (quint32), alignment (quint8);
+    \li number of subresources (quint32);
+    \li for each subresource: stored size (quint64) and method (quint8, 0 - raw, 1 - zlib);
+    \li the stored subresources in the memory order: levels, then layers, then faces.
+    \endlist
+*/
+
+/*!
+    Writes the \a texture to the \a stream compressing the subresources with the given zlib
+    compression \a level (-1 is the zlib default).
+
+    Returns false and sets the stream status on failure.
+*/
+bool TextureStream::writeCompressed(QDataStream &stream, const Texture &texture, int level)
+{
+    // The parameter shadows the logging category, so failures are reported via the stream status
+    if (texture.isNull()) {
+        stream.setStatus(QDataStream::WriteFailed);
+        return false;
+    }
+
+    const auto indexes = subresources(texture.arraySize());
+    std::vector<Blob> blobs;
+    blobs.reserve(indexes.size());
+    for (const auto &index: indexes) {
+        Blob blob;
+        blob.index = index;
+        blob.source = texture.constImageData(index);
+        if (blob.source.size() > std::numeric_limits<int>::max()) { // qCompress limit
+            stream.setStatus(QDataStream::WriteFailed);
+            return false;
+        }
+        blobs.push_back(std::move(blob));
+    }
+
+    const auto compress = [level](Blob &blob)
+    {
+        blob.data = qCompress(blob.source.data(), int(blob.source.size()), level);
+        blob.method = Method::Zlib;
+        if (blob.data.size() >= blob.source.size()) { // incompressible
+            blob.data.clear();
+            blob.method = Method::Raw;
+        }
+    };
+    QtConcurrent::blockingMap(blobs, compress);
+
+    Header header;
+    header.magic = magic;
+    header.version = version;
+    header.format = quint32(texture.format());
+    header.width = quint32(texture.width());
+    header.height = quint32(texture.height());
+    header.depth = quint32(texture.depth());
+    header.faces = quint32(texture.faces());
+    header.layers = quint32(texture.layers());
+    header.levels = quint32(texture.levels());
+    header.align = quint8(texture.alignment());
+
+    stream << header << quint32(blobs.size());
+    for (const auto &blob: blobs) {
+        const auto size = blob.method == Method::Raw ? blob.source.size() : blob.data.size();
+        stream << quint64(size) << quint8(blob.method);
+    }
+
+    for (const auto &blob: blobs) {
+        const auto data = blob.method == Method::Raw
+                ? reinterpret_cast<const char *>(blob.source.data())
+                : blob.data.constData();
+        const auto size = blob.method == Method::Raw ? int(blob.source.size()) : blob.data.size();
+        if (stream.writeRawData(data, size) != size) {
+            stream.setStatus(QDataStream::WriteFailed);
+            return false;
+        }
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+/*!
+    Reads the texture written by writeCompressed() from the \a stream.
+
+    Returns a null texture and sets the stream status on failure.
+*/
+Texture TextureStream::readCompressed(QDataStream &stream)
+{
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
+
+    Header header;
+    std::vector<Entry> entries;
+    if (!readHeader(stream, header, entries))
+        return Texture();
+
+    auto result = createTexture(header);
+    if (result.isNull() || result.faces() * result.levels() * result.layers() != int(entries.size())) {
+        const auto total = std::accumulate(entries.begin(), entries.end(), quint64(0),
+                [](quint64 sum, const Entry &entry) { return sum + entry.size; });
+        skip(stream, total);
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return Texture();
+    }
+
+    // Targets are taken upfront, so the parallel part does not touch the texture itself
+    const auto indexes = subresources(result.arraySize());
+    std::vector<Blob> blobs(indexes.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        blobs[i].index = indexes[i];
+        blobs[i].method = entries[i].method;
+        blobs[i].target = result.imageData(indexes[i]);
+        if (!readBlob(stream, entries[i], blobs[i].data))
+            return Texture();
+    }
+
+    QtConcurrent::blockingMap(blobs, [](Blob &blob) {
+        blob.ok = unpack(blob.data, blob.method, blob.target);
+        blob.data.clear();
+    });
+
+    const auto ok = std::all_of(blobs.begin(), blobs.end(), [](const Blob &blob) { return blob.ok; });
+    if (!ok) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return Texture();
+    }
+    return result;
+}
+
+/*!
+    Reads a single image with the given \a index of the texture written by writeCompressed() from
+    the \a stream. Other subresources are skipped without decompressing them.
+
+    The image is returned as a texture with a single face, level and layer. The stream is
+    positioned after the whole texture.
+*/
+Texture TextureStream::readCompressedImage(QDataStream &stream, Texture::ArrayIndex index)
+{
+    TextureMemory::OriginScope scope(TextureMemory::Origin::IO);
+
+    Header header;
+    std::vector<Entry> entries;
+    if (!readHeader(stream, header, entries))
+        return Texture();
+
+    // readHeader() checked that the product fits int, so the dimensions do as well
+    const auto faces = qsizetype(header.faces);
+    const auto levels = qsizetype(header.levels);
+    const auto layers = qsizetype(header.layers);
+    const auto position = [&](qsizetype face, qsizetype level, qsizetype layer) {
+        return size_t((level * layers + layer) * faces + face);
+    };
+    const auto sizeBetween = [&entries](size_t first, size_t last) {
+        return std::accumulate(std::next(entries.begin(), qsizetype(first)),
+                std::next(entries.begin(), qsizetype(last)),
+                quint64(0), [](quint64 sum, const Entry &entry) { return sum + entry.size; });
+    };
+
+    if (!index.isValid() || index.face() >= faces || index.level() >= levels
+            || index.layer() >= layers) {
+        qCWarning(texture) << "Invalid index" << index;
+        skip(stream, sizeBetween(0, entries.size()));
+        return Texture();
+    }
+
+    const auto current = position(index.face(), index.level(), index.layer());
+    if (current >= entries.size()) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return Texture();
+    }
+    if (!skip(stream, sizeBetween(0, current))) {
+        stream.setStatus(QDataStream::ReadPastEnd);
+        return Texture();
+    }
+
+    auto result = Texture(
+            TextureFormat(header.format),
+            {std::max(1, int(header.width) >> index.level()),
+             std::max(1, int(header.height) >> index.level()),
+             std::max(1, int(header.depth) >> index.level())},
+            {1, 1},
+            Texture::Alignment(header.align));
+    QByteArray data;
+    if (result.isNull() || !readBlob(stream, entries[current], data)) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return Texture();
+    }
+    if (!unpack(data, entries[current].method, result.imageData({}))) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return Texture();
+    }
+
+    skip(stream, sizeBetween(current + 1, entries.size()));
+    return result;
+}
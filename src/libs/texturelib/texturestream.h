@@ -0,0 +1,25 @@
+#pragma once
+
+#include "texturelib_global.h"
+
+#include <TextureLib/Texture>
+
+class QDataStream;
+
+class TEXTURELIB_EXPORT TextureStream
+{
+public:
+    static constexpr quint32 magic = 0x54565443; // "TVTC"
+    static constexpr quint16 version = 1;
+
+    enum class Method : quint8 {
+        Raw = 0,
+        Zlib = 1
+    };
+
+    TextureStream() = delete;
+
+    static bool writeCompressed(QDataStream &stream, const Texture &texture, int level = -1);
+    static Texture readCompressed(QDataStream &stream);
+    static Texture readCompressedImage(QDataStream &stream, Texture::ArrayIndex index);
+};
@@ -0,0 +1,919 @@
+#include "thumbnailcache.h"
+#include "texturehash_p.h"
+#include "textureio.h"
+#include "utils.h"
+
+#include <QtGui/QImageReader>
+#include <QtGui/QImageWriter>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLockFile>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QUrl>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+Q_LOGGING_CATEGORY(thumbnailcache, "texturelib.thumbnailcache")
+
+namespace {
+
+constexpr quint32 recordMagic = 0x50545654; // "TVTP"
+constexpr quint32 indexMagic = 0x49545654; // "TVTI"
+constexpr quint32 indexVersion = 1;
+constexpr qint64 recordAlignment = 64;
+constexpr int lockTimeout = 5000;
+// Inserted records are appended to the pack in batches of about this size
+constexpr int pendingLimit = 4 * 1024 * 1024;
+
+// Header of a record in the pack file; the RGBA8 pixels follow it, so they are 64-byte aligned
+// in the mapped file and can be used without copying.
+struct RecordHeader
+{
+    quint32 magic;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint64 keyHash;
+    char reserved[40];
+};
+static_assert(sizeof(RecordHeader) == recordAlignment, "Invalid RecordHeader size");
+
+inline qint64 alignUp(qint64 value) noexcept
+{
+    return (value + recordAlignment - 1) / recordAlignment * recordAlignment;
+}
+
+inline qint64 recordSize(quint32 width, quint32 height) noexcept
+{
+    return alignUp(qint64(sizeof(RecordHeader)) + qint64(width) * height * 4);
+}
+
+quint64 keyHash(const ThumbnailCache::Key &key, QSize size)
+{
+    const auto path = key.filePath.toUtf8();
+    auto result = TextureHash::hash({reinterpret_cast<const uchar *>(path.constData()), path.size()});
+    for (const auto value: {quint64(key.modified), quint64(key.fileSize), key.contentHash,
+                            quint64(key.index.face()), quint64(key.index.level()),
+                            quint64(key.index.layer()),
+                            quint64(size.width()), quint64(size.height())}) {
+        result = TextureHash::combine(result, value);
+    }
+    return result;
+}
+
+QByteArray makeRecord(quint64 hash, const QImage &image)
+{
+    const auto rgba = image.convertToFormat(QImage::Format_RGBA8888);
+    const auto width = quint32(rgba.width());
+    const auto height = quint32(rgba.height());
+
+    RecordHeader header {};
+    header.magic = recordMagic;
+    header.width = width;
+    header.height = height;
+    header.bytesPerLine = width * 4;
+    header.keyHash = hash;
+
+    QByteArray result(int(recordSize(width, height)), Qt::Uninitialized);
+    memset(result.data(), 0, size_t(result.size()));
+    memcpy(result.data(), &header, sizeof(header));
+    for (quint32 y = 0; y < height; ++y) {
+        memcpy(result.data() + sizeof(header) + y * header.bytesPerLine,
+               rgba.constScanLine(int(y)),
+               header.bytesPerLine);
+    }
+    return result;
+}
+
+// Sizes of the freedesktop.org thumbnail spec
+QString freeDesktopSubdirectory(QSize size)
+{
+    const auto dimension = std::max(size.width(), size.height());
+    if (dimension <= 128)
+        return QStringLiteral("normal");
+    if (dimension <= 256)
+        return QStringLiteral("large");
+    if (dimension <= 512)
+        return QStringLiteral("x-large");
+    return QStringLiteral("xx-large");
+}
+
+QSize freeDesktopSize(QSize size)
+{
+    const auto subdirectory = freeDesktopSubdirectory(size);
+    if (subdirectory == QLatin1String("normal"))
+        return {128, 128};
+    if (subdirectory == QLatin1String("large"))
+        return {256, 256};
+    if (subdirectory == QLatin1String("x-large"))
+        return {512, 512};
+    return {1024, 1024};
+}
+
+QString fileUri(const QString &filePath)
+{
+    return QString::fromLatin1(QUrl::fromLocalFile(filePath).toEncoded());
+}
+
+} // namespace
+
+class ThumbnailCachePrivate
+{
+public:
+    struct Entry
+    {
+        qint64 offset {0};
+        quint32 width {0};
+        quint32 height {0};
+        qint64 lastUsed {0};
+    };
+    using Entries = std::unordered_map<quint64, Entry>;
+
+    QString packPath() const { return directory + QStringLiteral("/thumbnails.pack"); }
+    QString indexPath() const { return directory + QStringLiteral("/thumbnails.index"); }
+    QString lockPath() const { return directory + QStringLiteral("/thumbnails.lock"); }
+    QString freeDesktopPath(const ThumbnailCache::Key &key, QSize size) const;
+
+    bool openPack();
+    void closePack();
+    bool isPackStale() const;
+    void reloadPack();
+    bool ensureMapped(qint64 size);
+    void recountBytes();
+    bool readIndex(Entries &entries, quint32 &generation, qint64 &useCounter) const;
+    bool writeIndex();
+    bool writePending();
+    bool writeTrimmedPack(qint64 limit);
+    void trimFreeDesktop(qint64 limit);
+
+    QImage findInPack(const ThumbnailCache::Key &key, QSize size);
+    bool insertToPack(const QByteArray &record);
+    QImage findFreeDesktop(const ThumbnailCache::Key &key, QSize size) const;
+    bool insertFreeDesktop(const ThumbnailCache::Key &key, QSize size, const QImage &image) const;
+
+    mutable QMutex mutex;
+    QString directory;
+    ThumbnailCache::Layout layout {ThumbnailCache::Layout::Pack};
+    qint64 maxSize {256 * 1024 * 1024};
+
+    Entries entries;
+    qint64 bytes {0};
+    qint64 useCounter {0};
+    quint32 generation {0};
+    bool dirty {false};
+
+    // Inserted records that are not written to the pack yet; offsets are relative to the buffer
+    Entries pending;
+    QByteArray pendingRecords;
+
+    QFile pack;
+    uchar *mapped {nullptr};
+    qint64 mappedSize {0};
+};
+
+QString ThumbnailCachePrivate::freeDesktopPath(const ThumbnailCache::Key &key, QSize size) const
+{
+    const auto hash = QCryptographicHash::hash(fileUri(key.filePath).toUtf8(), QCryptographicHash::Md5);
+    return QStringLiteral("%1/%2/%3.png").arg(
+            directory, freeDesktopSubdirectory(size), QString::fromLatin1(hash.toHex()));
+}
+
+bool ThumbnailCachePrivate::openPack()
+{
+    closePack();
+    pack.setFileName(packPath());
+    if (!pack.open(QIODevice::ReadWrite)) {
+        qCWarning(thumbnailcache) << "Can't open" << pack.fileName() << ":" << pack.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ThumbnailCachePrivate::closePack()
+{
+    if (mapped)
+        pack.unmap(mapped);
+    mapped = nullptr;
+    mappedSize = 0;
+    pack.close();
+}
+
+// Another process replaces the pack when trimming it; our handle then refers to the orphaned file
+bool ThumbnailCachePrivate::isPackStale() const
+{
+    if (!pack.isOpen())
+        return false;
+#if defined(Q_OS_UNIX)
+    struct stat opened;
+    struct stat current;
+    if (fstat(pack.handle(), &opened) != 0
+            || stat(QFile::encodeName(pack.fileName()).constData(), &current) != 0) {
+        return true;
+    }
+    return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+#else
+    const QFileInfo info(pack.fileName());
+    return !info.exists() || info.size() != pack.size()
+            || info.lastModified() != pack.fileTime(QFileDevice::FileModificationTime);
+#endif
+}
+
+void ThumbnailCachePrivate::reloadPack()
+{
+    qCDebug(thumbnailcache) << "The pack was replaced by another process, reloading the index";
+    Entries newEntries;
+    quint32 newGeneration = 0;
+    qint64 newUseCounter = 0;
+    if (readIndex(newEntries, newGeneration, newUseCounter)) {
+        generation = newGeneration;
+        useCounter = std::max(useCounter, newUseCounter);
+    }
+    entries = std::move(newEntries);
+    for (const auto &item: pending)
+        entries.erase(item.first);
+    recountBytes();
+    openPack();
+}
+
+bool ThumbnailCachePrivate::ensureMapped(qint64 size)
+{
+    if (mapped && size <= mappedSize)
+        return true;
+    if (!pack.isOpen())
+        return false;
+    if (mapped)
+        pack.unmap(mapped);
+    mappedSize = pack.size();
+    mapped = mappedSize > 0 ? pack.map(0, mappedSize) : nullptr;
+    if (!mapped)
+        mappedSize = 0;
+    return mapped && size <= mappedSize;
+}
+
+void ThumbnailCachePrivate::recountBytes()
+{
+    bytes = 0;
+    for (const auto &item: entries)
+        bytes += recordSize(item.second.width, item.second.height);
+    for (const auto &item: pending)
+        bytes += recordSize(item.second.width, item.second.height);
+}
+
+bool ThumbnailCachePrivate::readIndex(Entries &entries, quint32 &generation, qint64 &useCounter) const
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) {
+        qCWarning(thumbnailcache) << "Ignoring index with unsupported version" << file.fileName();
+        return false;
+    }
+    stream >> generation >> useCounter >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint64 hash = 0;
+        Entry entry;
+        stream >> hash >> entry.offset >> entry.width >> entry.height >> entry.lastUsed;
+        entries[hash] = entry;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(thumbnailcache) << "Corrupted index" << file.fileName();
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ThumbnailCachePrivate::writeIndex()
+{
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(thumbnailcache) << "Can't write" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream << indexMagic << indexVersion << generation << useCounter << quint32(entries.size());
+    for (const auto &item: entries) {
+        const auto &entry = item.second;
+        stream << item.first << entry.offset << entry.width << entry.height << entry.lastUsed;
+    }
+    if (!file.commit()) {
+        qCWarning(thumbnailcache) << "Can't write" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+// Appends the pending records to the pack with a single write; the caller must hold the lock file.
+bool ThumbnailCachePrivate::writePending()
+{
+    if (pending.empty()) {
+        pendingRecords.clear();
+        return true;
+    }
+    if (isPackStale())
+        reloadPack();
+
+    const auto opened = pack.isOpen() || openPack();
+    const auto base = alignUp(pack.size());
+    if (!opened || !pack.seek(base) || pack.write(pendingRecords) != pendingRecords.size()) {
+        qCWarning(thumbnailcache) << "Can't write" << pack.fileName() << ":" << pack.errorString();
+        pending.clear();
+        pendingRecords.clear();
+        recountBytes();
+        return false;
+    }
+    pack.flush();
+
+    for (const auto &item: pending) {
+        auto entry = item.second;
+        entry.offset += base;
+        entries[item.first] = entry;
+    }
+    pending.clear();
+    pendingRecords.clear();
+    recountBytes();
+    dirty = true;
+    return true;
+}
+
+// Rewrites the pack with the most recently used entries that fit into the limit.
+bool ThumbnailCachePrivate::writeTrimmedPack(qint64 limit)
+{
+    std::vector<std::pair<quint64, Entry>> sorted(entries.begin(), entries.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.second.lastUsed > rhs.second.lastUsed;
+    });
+
+    ensureMapped(pack.size());
+
+    QSaveFile file(packPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(thumbnailcache) << "Can't write" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+
+    Entries kept;
+    qint64 offset = 0;
+    for (const auto &item: sorted) {
+        auto entry = item.second;
+        const auto size = recordSize(entry.width, entry.height);
+        if (offset + size > limit)
+            break;
+        if (!mapped || entry.offset + size > mappedSize)
+            continue;
+        if (file.write(reinterpret_cast<const char *>(mapped + entry.offset), size) != size) {
+            file.cancelWriting();
+            return false;
+        }
+        entry.offset = offset;
+        offset += size;
+        kept[item.first] = entry;
+    }
+
+    closePack();
+    if (!file.commit()) {
+        qCWarning(thumbnailcache) << "Can't write" << file.fileName() << ":" << file.errorString();
+        openPack();
+        return false;
+    }
+    qCDebug(thumbnailcache) << "Trimmed" << entries.size() - kept.size() << "thumbnails";
+    entries = std::move(kept);
+    bytes = offset;
+    generation++;
+    openPack();
+    return writeIndex();
+}
+
+void ThumbnailCachePrivate::trimFreeDesktop(qint64 limit)
+{
+    std::vector<QFileInfo> files;
+    qint64 total = 0;
+    QDirIterator it(directory, {QStringLiteral("*.png")}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        files.push_back(it.fileInfo());
+        total += it.fileInfo().size();
+    }
+    std::sort(files.begin(), files.end(), [](const QFileInfo &lhs, const QFileInfo &rhs) {
+        return lhs.lastRead() < rhs.lastRead();
+    });
+    for (const auto &file: files) {
+        if (total <= limit)
+            break;
+        if (QFile::remove(file.absoluteFilePath()))
+            total -= file.size();
+    }
+}
+
+QImage ThumbnailCachePrivate::findInPack(const ThumbnailCache::Key &key, QSize size)
+{
+    const auto hash = keyHash(key, size);
+
+    const auto pendingIt = pending.find(hash);
+    if (pendingIt != pending.end()) {
+        auto &entry = pendingIt->second;
+        entry.lastUsed = ++useCounter;
+        const auto record = reinterpret_cast<const uchar *>(pendingRecords.constData()) + entry.offset;
+        return QImage(record + sizeof(RecordHeader),
+                      int(entry.width),
+                      int(entry.height),
+                      int(entry.width * 4),
+                      QImage::Format_RGBA8888).copy();
+    }
+
+    if (isPackStale())
+        reloadPack();
+
+    const auto it = entries.find(hash);
+    if (it == entries.end())
+        return {};
+
+    auto &entry = it->second;
+    const auto recordBytes = recordSize(entry.width, entry.height);
+    if (!ensureMapped(entry.offset + recordBytes))
+        return {};
+
+    // The pack can be trimmed by another process, so check that the record is still ours
+    RecordHeader header;
+    memcpy(&header, mapped + entry.offset, sizeof(header));
+    if (header.magic != recordMagic || header.keyHash != hash
+            || header.width != entry.width || header.height != entry.height) {
+        entries.erase(it);
+        dirty = true;
+        return {};
+    }
+
+    entry.lastUsed = ++useCounter;
+    dirty = true;
+    return QImage(mapped + entry.offset + sizeof(RecordHeader),
+                  int(header.width),
+                  int(header.height),
+                  int(header.bytesPerLine),
+                  QImage::Format_RGBA8888).copy();
+}
+
+bool ThumbnailCachePrivate::insertToPack(const QByteArray &record)
+{
+    RecordHeader header;
+    memcpy(&header, record.constData(), sizeof(header));
+
+    const auto it = entries.find(header.keyHash);
+    if (it != entries.end()) {
+        bytes -= recordSize(it->second.width, it->second.height);
+        entries.erase(it);
+    }
+    auto &entry = pending[header.keyHash];
+    if (entry.width)
+        bytes -= recordSize(entry.width, entry.height);
+    entry.offset = pendingRecords.size();
+    entry.width = header.width;
+    entry.height = header.height;
+    entry.lastUsed = ++useCounter;
+    pendingRecords.append(record);
+    bytes += record.size();
+    dirty = true;
+
+    // Locking and flushing on every insert would serialize the workers, so records are batched
+    if (pendingRecords.size() < pendingLimit && alignUp(pack.size()) + pendingRecords.size() <= maxSize)
+        return true;
+
+    QLockFile lock(lockPath());
+    if (!lock.tryLock(lockTimeout)) {
+        qCWarning(thumbnailcache) << "Can't lock" << lockPath();
+        return false;
+    }
+    if (!writePending())
+        return false;
+
+    if (pack.size() > maxSize)
+        writeTrimmedPack(maxSize * 3 / 4); // leave some room, so we don't trim on every insert
+    return true;
+}
+
+QImage ThumbnailCachePrivate::findFreeDesktop(const ThumbnailCache::Key &key, QSize size) const
+{
+    if (!key.index.isNull())
+        return {};
+
+    QImageReader reader(freeDesktopPath(key, size), "png");
+    if (!reader.canRead())
+        return {};
+    // The text chunks are checked before decoding the image
+    if (reader.text(QStringLiteral("Thumb::URI")) != fileUri(key.filePath)
+            || reader.text(QStringLiteral("Thumb::MTime")) != QString::number(key.modified)) {
+        return {};
+    }
+    if (key.contentHash
+            && reader.text(QStringLiteral("X-TextureViewer::Hash")) != QString::number(key.contentHash, 16)) {
+        return {};
+    }
+    auto image = reader.read();
+    if (image.isNull())
+        return {};
+    if (image.width() > size.width() || image.height() > size.height())
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;
+}
+
+bool ThumbnailCachePrivate::insertFreeDesktop(
+        const ThumbnailCache::Key &key, QSize size, const QImage &image) const
+{
+    if (!key.index.isNull())
+        return false;
+
+    const auto path = freeDesktopPath(key, size);
+    QDir().mkpath(QFileInfo(path).path());
+
+    auto copy = image;
+    copy.setText(QStringLiteral("Thumb::URI"), fileUri(key.filePath));
+    copy.setText(QStringLiteral("Thumb::MTime"), QString::number(key.modified));
+    copy.setText(QStringLiteral("Thumb::Size"), QString::number(key.fileSize));
+    copy.setText(QStringLiteral("Software"), QStringLiteral("textureviewer"));
+    if (key.contentHash)
+        copy.setText(QStringLiteral("X-TextureViewer::Hash"), QString::number(key.contentHash, 16));
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    QImageWriter writer(&file, "png");
+    if (!writer.write(copy)) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+/*!
+  \class ThumbnailCache
+  \brief Persistent cache of small RGBA8 previews of texture files.
+
+  Thumbnails are identified by the file path, its modification time and size, an optional
+  content hash, the image index in the file and the thumbnail size, so a changed file is never
+  matched with an outdated thumbnail.
+
+  In the Pack layout, all thumbnails are stored in a single file, thumbnails.pack, which is
+  memory-mapped for reading; records are 64-byte aligned raw RGBA8 images, so no decoding is
+  needed. An index file maps the keys to the records and keeps the usage order. When the pack
+  exceeds maxSize(), the least recently used thumbnails are dropped. Inserted thumbnails are
+  kept in memory and appended to the pack in batches, at the latest by sync(). Appending to the
+  pack is guarded by a lock file, so several processes (e.g. the viewer and texturetool) can share
+  the directory; when another process replaces the pack while trimming it, the index is reloaded.
+
+  In the FreeDesktop layout, thumbnails are stored as PNG files as described by the
+  freedesktop.org thumbnail spec, so file managers can reuse them. Only the first image of a file
+  is stored in this layout.
+
+  All members are thread-safe.
+*/
+
+/*!
+  \brief Returns the key for the file with the given \a filePath and image \a index.
+
+  Returns a null key if the file does not exist.
+*/
+ThumbnailCache::Key ThumbnailCache::Key::fromFile(const QString &filePath, Texture::ArrayIndex index)
+{
+    const QFileInfo info(filePath);
+    if (!info.exists())
+        return {};
+    Key result;
+    result.filePath = info.absoluteFilePath();
+    result.modified = info.lastModified().toSecsSinceEpoch();
+    result.fileSize = info.size();
+    result.index = index;
+    return result;
+}
+
+/*!
+  \brief Opens the cache in the given \a directory with the given \a layout.
+
+  The directory is created if it does not exist.
+*/
+ThumbnailCache::ThumbnailCache(const QString &directory, Layout layout)
+    : d_ptr(new ThumbnailCachePrivate)
+{
+    Q_D(ThumbnailCache);
+    d->directory = directory;
+    d->layout = layout;
+    if (!QDir().mkpath(directory)) {
+        qCWarning(thumbnailcache) << "Can't create" << directory;
+        return;
+    }
+    if (layout == Layout::Pack) {
+        d->readIndex(d->entries, d->generation, d->useCounter);
+        for (const auto &item: d->entries)
+            d->bytes += recordSize(item.second.width, item.second.height);
+        d->openPack();
+    }
+}
+
+/*!
+  \brief Writes the index and closes the cache.
+*/
+ThumbnailCache::~ThumbnailCache()
+{
+    sync();
+    Q_D(ThumbnailCache);
+    d->closePack();
+}
+
+/*!
+  \brief Returns the cache directory.
+*/
+QString ThumbnailCache::directory() const
+{
+    Q_D(const ThumbnailCache);
+    return d->directory;
+}
+
+/*!
+  \brief Returns the storage layout.
+*/
+ThumbnailCache::Layout ThumbnailCache::layout() const
+{
+    Q_D(const ThumbnailCache);
+    return d->layout;
+}
+
+/*!
+  \brief Returns the maximum size of the stored thumbnails in bytes.
+
+  The default value is 256 MB.
+*/
+qint64 ThumbnailCache::maxSize() const
+{
+    Q_D(const ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    return d->maxSize;
+}
+
+/*!
+  \brief Sets the maximum size of the stored thumbnails to \a bytes.
+
+  Call trim() to apply the new size immediately.
+*/
+void ThumbnailCache::setMaxSize(qint64 bytes)
+{
+    Q_D(ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    d->maxSize = bytes;
+}
+
+/*!
+  \brief Returns the size of the stored thumbnails in bytes.
+
+  For the FreeDesktop layout, only thumbnails stored by this instance are counted.
+*/
+qint64 ThumbnailCache::size() const
+{
+    Q_D(const ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    return d->bytes;
+}
+
+/*!
+  \brief Returns the number of the stored thumbnails.
+
+  Always returns 0 for the FreeDesktop layout.
+*/
+int ThumbnailCache::count() const
+{
+    Q_D(const ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    return int(d->entries.size() + d->pending.size());
+}
+
+/*!
+  \brief Returns the thumbnail of the given \a size for the \a key.
+
+  Returns a null image if there is no such thumbnail.
+*/
+QImage ThumbnailCache::find(const Key &key, QSize size)
+{
+    Q_D(ThumbnailCache);
+    if (key.isNull())
+        return {};
+    QMutexLocker lock(&d->mutex);
+    if (d->layout == Layout::FreeDesktop)
+        return d->findFreeDesktop(key, size);
+    return d->findInPack(key, size);
+}
+
+/*!
+  \brief Stores the thumbnail \a image of the given \a size for the \a key.
+
+  Returns true on success.
+*/
+bool ThumbnailCache::insert(const Key &key, QSize size, const QImage &image)
+{
+    Q_D(ThumbnailCache);
+    if (key.isNull() || image.isNull())
+        return false;
+    if (d->layout == Layout::FreeDesktop) {
+        QMutexLocker lock(&d->mutex);
+        if (!d->insertFreeDesktop(key, size, image))
+            return false;
+        d->bytes += qint64(image.sizeInBytes());
+        return true;
+    }
+    // The record is prepared before locking, the workers only serialize on appending it
+    const auto record = makeRecord(keyHash(key, size), image);
+    QMutexLocker lock(&d->mutex);
+    return d->insertToPack(record);
+}
+
+/*!
+  \brief Removes the thumbnail of the given \a size for the \a key.
+
+  The space in the pack is reclaimed by the next trim().
+*/
+bool ThumbnailCache::remove(const Key &key, QSize size)
+{
+    Q_D(ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    if (d->layout == Layout::FreeDesktop)
+        return QFile::remove(d->freeDesktopPath(key, size));
+    const auto hash = keyHash(key, size);
+    auto &entries = d->pending.count(hash) ? d->pending : d->entries;
+    const auto it = entries.find(hash);
+    if (it == entries.end())
+        return false;
+    d->bytes -= recordSize(it->second.width, it->second.height);
+    entries.erase(it);
+    d->dirty = true;
+    return true;
+}
+
+/*!
+  \brief Returns the thumbnail of the given \a size for the image with the given \a index in
+  the file at \a filePath.
+
+  If the thumbnail is not cached, the file is read with TextureIO and the new thumbnail is stored.
+  Returns a null image if the file can't be read or converted.
+*/
+QImage ThumbnailCache::thumbnail(const QString &filePath, QSize size, Texture::ArrayIndex index)
+{
+    const auto key = Key::fromFile(filePath, index);
+    if (key.isNull())
+        return {};
+    auto result = find(key, size);
+    if (!result.isNull())
+        return result;
+
+    TextureIO io(filePath);
+    const auto texture = io.read();
+    if (!texture) {
+        qCDebug(thumbnailcache) << "Can't read" << filePath << ":" << toUserString(texture.error());
+        return {};
+    }
+
+    // The spec defines fixed sizes, other sizes are scaled from them
+    const auto storedSize = layout() == Layout::FreeDesktop ? freeDesktopSize(size) : size;
+    result = Utils::makeThumbnail(*texture, storedSize, index);
+    if (result.isNull())
+        return {};
+    insert(key, storedSize, result);
+    if (storedSize != size)
+        result = result.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return result;
+}
+
+/*!
+  \brief Appends the pending thumbnails to the pack, merges the index with the changes made by
+  other processes and writes it to disk.
+*/
+bool ThumbnailCache::sync()
+{
+    Q_D(ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    if (d->layout != Layout::Pack || !d->dirty)
+        return true;
+
+    QLockFile fileLock(d->lockPath());
+    if (!fileLock.tryLock(lockTimeout)) {
+        qCWarning(thumbnailcache) << "Can't lock" << d->lockPath();
+        return false;
+    }
+
+    ThumbnailCachePrivate::Entries entries;
+    quint32 generation = 0;
+    qint64 useCounter = 0;
+    if (d->readIndex(entries, generation, useCounter)) {
+        if (generation != d->generation || d->isPackStale()) {
+            // The pack was rewritten by another process, our offsets are not valid anymore
+            d->entries = std::move(entries);
+            d->generation = generation;
+            d->openPack();
+        } else {
+            for (const auto &item: entries) {
+                auto &entry = d->entries[item.first];
+                if (!entry.width || entry.lastUsed < item.second.lastUsed)
+                    entry = item.second;
+            }
+        }
+        d->useCounter = std::max(d->useCounter, useCounter);
+    }
+    d->writePending();
+    d->recountBytes();
+    return d->writeIndex();
+}
+
+/*!
+  \brief Drops the least recently used thumbnails until the cache fits into maxSize().
+*/
+void ThumbnailCache::trim()
+{
+    sync();
+
+    Q_D(ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    QLockFile fileLock(d->lockPath());
+    if (!fileLock.tryLock(lockTimeout)) {
+        qCWarning(thumbnailcache) << "Can't lock" << d->lockPath();
+        return;
+    }
+    if (d->layout == Layout::FreeDesktop)
+        d->trimFreeDesktop(d->maxSize);
+    else
+        d->writeTrimmedPack(d->maxSize);
+}
+
+/*!
+  \brief Removes all thumbnails.
+*/
+void ThumbnailCache::clear()
+{
+    Q_D(ThumbnailCache);
+    QMutexLocker lock(&d->mutex);
+    QLockFile fileLock(d->lockPath());
+    if (!fileLock.tryLock(lockTimeout)) {
+        qCWarning(thumbnailcache) << "Can't lock" << d->lockPath();
+        return;
+    }
+    if (d->layout == Layout::FreeDesktop) {
+        d->trimFreeDesktop(0);
+    } else {
+        d->entries.clear();
+        d->pending.clear();
+        d->pendingRecords.clear();
+        d->writeTrimmedPack(0);
+    }
+    d->bytes = 0;
+}
+
+/*!
+  \brief Returns the directory used by the instance().
+
+  The directory is shared by all applications of the project.
+*/
+QString ThumbnailCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/textureviewer/thumbnails");
+}
+
+/*!
+  \brief Returns the thumbnails directory defined by the freedesktop.org thumbnail spec.
+*/
+QString ThumbnailCache::freeDesktopDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/thumbnails");
+}
+
+Q_GLOBAL_STATIC(ThumbnailCache, globalCache)
+
+/*!
+  \brief Returns the cache in the defaultDirectory().
+
+  Returns nullptr during the application shutdown, after the cache was destroyed.
+*/
+ThumbnailCache *ThumbnailCache::instance()
+{
+    return globalCache();
+}
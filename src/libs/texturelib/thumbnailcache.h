@@ -0,0 +1,68 @@
+#pragma once
+
+#include "texturelib_global.h"
+
+#include <TextureLib/Texture>
+
+#include <QtGui/QImage>
+
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+class ThumbnailCachePrivate;
+class TEXTURELIB_EXPORT ThumbnailCache
+{
+    Q_DISABLE_COPY(ThumbnailCache)
+    Q_DECLARE_PRIVATE(ThumbnailCache)
+public:
+    enum class Layout {
+        Pack,       // single pack file with an index, see ThumbnailCache
+        FreeDesktop // one PNG per file, as described by the freedesktop.org thumbnail spec
+    };
+
+    struct Key
+    {
+        QString filePath;
+        qint64 modified {0}; // seconds since epoch
+        qint64 fileSize {0};
+        quint64 contentHash {0}; // optional
+        Texture::ArrayIndex index;
+
+        bool isNull() const noexcept { return filePath.isEmpty(); }
+
+        static Key fromFile(const QString &filePath, Texture::ArrayIndex index = {});
+    };
+
+    explicit ThumbnailCache(const QString &directory = defaultDirectory(), Layout layout = Layout::Pack);
+    ThumbnailCache(ThumbnailCache &&) = delete;
+    ~ThumbnailCache();
+    ThumbnailCache &operator=(ThumbnailCache &&) = delete;
+
+    QString directory() const;
+    Layout layout() const;
+
+    qint64 maxSize() const;
+    void setMaxSize(qint64 bytes);
+
+    qint64 size() const;
+    int count() const;
+
+    QImage find(const Key &key, QSize size);
+    bool insert(const Key &key, QSize size, const QImage &image);
+    bool remove(const Key &key, QSize size);
+
+    QImage thumbnail(const QString &filePath, QSize size, Texture::ArrayIndex index = {});
+
+    bool sync();
+    void trim();
+    void clear();
+
+    static QString defaultDirectory();
+    static QString freeDesktopDirectory();
+
+    static ThumbnailCache *instance();
+
+private:
+    QScopedPointer<ThumbnailCachePrivate> d_ptr;
+};
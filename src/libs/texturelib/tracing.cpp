@@ -0,0 +1,270 @@
+#include "tracing.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Debug messages are disabled by default, use "texturelib.trace.debug=true" to enable tracing
+Q_LOGGING_CATEGORY(tracing, "texturelib.trace", QtWarningMsg)
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Limits the memory used by a forgotten trace, ~100 MB
+constexpr size_t maxEvents = 1024 * 1024;
+
+struct Event
+{
+    const char *category {nullptr};
+    const char *name {nullptr};
+    qint64 start {0};
+    qint64 duration {0};
+    quint32 thread {0};
+    QString detail;
+};
+
+struct TraceData
+{
+    QMutex mutex;
+    std::vector<Event> events;
+    std::vector<std::pair<quint32, QString>> threadNames;
+    QString outputFile {qEnvironmentVariable("TEXTUREVIEWER_TRACE")};
+    qint64 dropped {0};
+    std::once_flag saveAtExit;
+};
+
+Q_GLOBAL_STATIC(TraceData, traceData)
+
+const Clock::time_point startTime = Clock::now();
+std::atomic<bool> forceEnabled {qEnvironmentVariableIsSet("TEXTUREVIEWER_TRACE")};
+std::atomic<quint32> threadCounter {0};
+
+quint32 currentThreadId()
+{
+    thread_local quint32 id = 0;
+    if (!id) {
+        id = ++threadCounter;
+        const auto thread = QThread::currentThread();
+        auto name = thread ? thread->objectName() : QString();
+        if (name.isEmpty()) {
+            name = QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()
+                    ? QStringLiteral("main")
+                    : QStringLiteral("thread %1").arg(id);
+        }
+        const auto data = traceData();
+        QMutexLocker lock(&data->mutex);
+        data->threadNames.emplace_back(id, name);
+    }
+    return id;
+}
+
+void saveTrace()
+{
+    const auto fileName = Tracer::outputFile();
+    if (Tracer::eventCount() == 0)
+        return;
+    if (Tracer::save(fileName))
+        qCInfo(tracing) << "Trace is saved to" << fileName;
+}
+
+} // namespace
+
+/*!
+    \class Tracer
+    \brief Collects timed spans of the hot paths and exports them as a Chrome trace.
+
+    Tracing is disabled by default; it is enabled if the TEXTUREVIEWER_TRACE environment variable
+    is set to the output file name, if debug output of the "texturelib.trace" logging category is
+    enabled (e.g. QT_LOGGING_RULES="texturelib.trace.debug=true"), or by calling setEnabled().
+
+    The collected events are saved when the application exits. The file can be opened with
+    chrome://tracing or https://ui.perfetto.dev.
+
+    \sa TraceSpan
+*/
+
+/*!
+    Returns true if the trace events are collected.
+*/
+bool Tracer::isEnabled() noexcept
+{
+    return forceEnabled.load(std::memory_order_relaxed) || tracing().isDebugEnabled();
+}
+
+/*!
+    Enables or disables the tracing, regardless of the logging category.
+*/
+void Tracer::setEnabled(bool enabled)
+{
+    forceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+/*!
+    Returns the file name the trace is saved to on exit.
+
+    Defaults to the value of the TEXTUREVIEWER_TRACE environment variable or to the
+    textureviewer-<pid>.trace.json file in the temporary directory.
+*/
+QString Tracer::outputFile()
+{
+    const auto data = traceData();
+    QMutexLocker lock(&data->mutex);
+    if (!data->outputFile.isEmpty())
+        return data->outputFile;
+    return QDir::temp().filePath(QStringLiteral("textureviewer-%1.trace.json").
+                                 arg(QCoreApplication::applicationPid()));
+}
+
+/*!
+    Sets the file name the trace is saved to on exit to \a fileName.
+*/
+void Tracer::setOutputFile(const QString &fileName)
+{
+    const auto data = traceData();
+    QMutexLocker lock(&data->mutex);
+    data->outputFile = fileName;
+}
+
+/*!
+    Returns the monotonic time in nanoseconds since the start of the process.
+*/
+qint64 Tracer::timestamp() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+}
+
+/*!
+    Adds the complete event with the given \a category, \a name, \a start, \a duration (both in
+    nanoseconds) and an optional \a detail, e.g. a file name.
+*/
+void Tracer::addEvent(
+        const char *category, const char *name, qint64 start, qint64 duration, const QString &detail)
+{
+    const auto thread = currentThreadId();
+    const auto data = traceData();
+
+    std::call_once(data->saveAtExit, []() {
+        if (QCoreApplication::instance())
+            qAddPostRoutine(saveTrace);
+    });
+
+    QMutexLocker lock(&data->mutex);
+    if (data->events.size() >= maxEvents) {
+        if (!data->dropped++)
+            qCWarning(tracing) << "Too many trace events, the new ones are dropped";
+        return;
+    }
+    data->events.push_back({category, name, start, duration, thread, detail});
+}
+
+/*!
+    Returns the number of the collected events.
+*/
+int Tracer::eventCount()
+{
+    const auto data = traceData();
+    QMutexLocker lock(&data->mutex);
+    return int(data->events.size());
+}
+
+/*!
+    Returns the collected events in the Chrome trace event JSON format.
+*/
+QByteArray Tracer::toJson()
+{
+    const auto data = traceData();
+    QMutexLocker lock(&data->mutex);
+
+    const auto pid = QCoreApplication::applicationPid();
+    const auto microseconds = [](qint64 ns) { return double(ns) / 1000.0; };
+
+    QJsonArray events;
+    for (const auto &thread: data->threadNames) {
+        events.append(QJsonObject{
+                {QStringLiteral("ph"), QStringLiteral("M")},
+                {QStringLiteral("name"), QStringLiteral("thread_name")},
+                {QStringLiteral("pid"), pid},
+                {QStringLiteral("tid"), int(thread.first)},
+                {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), thread.second}}}
+        });
+    }
+
+    for (const auto &event: data->events) {
+        QJsonObject object{
+            {QStringLiteral("ph"), QStringLiteral("X")},
+            {QStringLiteral("cat"), QString::fromLatin1(event.category)},
+            {QStringLiteral("name"), QString::fromLatin1(event.name)},
+            {QStringLiteral("ts"), microseconds(event.start)},
+            {QStringLiteral("dur"), microseconds(event.duration)},
+            {QStringLiteral("pid"), pid},
+            {QStringLiteral("tid"), int(event.thread)}
+        };
+        if (!event.detail.isEmpty())
+            object[QStringLiteral("args")] = QJsonObject{{QStringLiteral("detail"), event.detail}};
+        events.append(object);
+    }
+
+    QJsonObject result;
+    result[QStringLiteral("traceEvents")] = events;
+    result[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+    if (data->dropped)
+        result[QStringLiteral("droppedEvents")] = double(data->dropped);
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+/*!
+    Saves the collected events to the file with the given \a fileName.
+*/
+bool Tracer::save(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(tracing) << "Can't open" << fileName << ":" << file.errorString();
+        return false;
+    }
+    const auto json = toJson();
+    if (file.write(json) != json.size()) {
+        qCWarning(tracing) << "Can't write" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Removes the collected events.
+*/
+void Tracer::clear()
+{
+    const auto data = traceData();
+    QMutexLocker lock(&data->mutex);
+    data->events.clear();
+    data->dropped = 0;
+}
+
+/*!
+    \class TraceSpan
+    \brief Records the time between the construction and the destruction as a trace event.
+
+    When tracing is disabled, the span only checks Tracer::isEnabled() and does nothing else.
+
+    \code
+    TraceSpan span("io", "TextureIO::read");
+    span.setDetail(fileName);
+    \endcode
+*/
+
+void TraceSpan::finish()
+{
+    Tracer::addEvent(m_category, m_name, m_start, Tracer::timestamp() - m_start, m_detail);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "texturelib_global.h"
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QString>
+
+class TEXTURELIB_EXPORT Tracer
+{
+public:
+    Tracer() = delete;
+
+    static bool isEnabled() noexcept;
+    static void setEnabled(bool enabled);
+
+    static QString outputFile();
+    static void setOutputFile(const QString &fileName);
+
+    static qint64 timestamp() noexcept;
+
+    static void addEvent(
+            const char *category,
+            const char *name,
+            qint64 start,
+            qint64 duration,
+            const QString &detail = QString());
+
+    static int eventCount();
+    static QByteArray toJson();
+    static bool save(const QString &fileName);
+    static void clear();
+};
+
+class TEXTURELIB_EXPORT TraceSpan
+{
+    Q_DISABLE_COPY(TraceSpan)
+public:
+    // category and name should be string literals, only pointers are stored
+    inline TraceSpan(const char *category, const char *name) noexcept
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::isEnabled() ? Tracer::timestamp() : -1)
+    {}
+    TraceSpan(TraceSpan &&) = delete;
+    inline ~TraceSpan() { if (isActive()) finish(); }
+    TraceSpan &operator=(TraceSpan &&) = delete;
+
+    inline bool isActive() const noexcept { return m_start >= 0; }
+    inline void setDetail(const QString &detail) { if (isActive()) m_detail = detail; }
+
+private:
+    void finish();
+
+    const char *m_category {nullptr};
+    const char *m_name {nullptr};
+    qint64 m_start {-1};
+    QString m_detail;
+};
+
+Q_DECLARE_LOGGING_CATEGORY(tracing)
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "textureformatinfo.h"
+#include "tracing.h"
 
 #include <TextureLib/Texture>
 
@@ -56,6 +57,8 @@ std::unique_ptr<QOpenGLTexture> Utils::makeOpenGLTexture(const Texture &texture)
         return nullptr;
     }
 
+    TraceSpan span("gl", "Utils::makeOpenGLTexture");
+
     const auto target = getTarget(texture);
     const auto &texelFormat = TextureFormatInfo::formatInfo(texture.format());
     const auto textureFormat = texelFormat.oglTextureFormat();
@@ -138,3 +141,72 @@ std::unique_ptr<QOpenGLTexture> Utils::makeOpenGLTexture(const Texture &texture)
 
     return result;
 }
+
+/*!
+  \brief Returns the smallest mip level of the \a texture that is at least as large as the
+  image scaled to fit into the given \a size.
+
+  The image keeps its aspect ratio, so for non-square textures only the longer side has to fill
+  the \a size. The search starts from the given \a level; if it is already smaller than the
+  fitted size, it is returned as is.
+*/
+Texture::size_type Utils::thumbnailLevel(
+        const Texture &texture, QSize size, Texture::size_type level)
+{
+    const auto fitted = QSize(texture.width(level), texture.height(level))
+            .scaled(size, Qt::KeepAspectRatio);
+    while (level + 1 < texture.levels()
+           && texture.width(level + 1) >= fitted.width()
+           && texture.height(level + 1) >= fitted.height()) {
+        ++level;
+    }
+    return level;
+}
+
+/*!
+  \brief Creates a thumbnail that fits into the given \a size from the image with the given
+  \a index.
+
+  To reduce the amount of work, the image is taken from the smallest mip level that is not smaller
+  than the thumbnail (see thumbnailLevel()); the first slice is used for volume textures. Returns a
+  null image if the texture can't be converted to QImage, e.g. if it is compressed.
+*/
+QImage Utils::makeThumbnail(const Texture &texture, QSize size, Texture::ArrayIndex index)
+{
+    if (texture.isNull() || size.isEmpty())
+        return {};
+    if (texture.isCompressed())
+        return {}; // toImage() does not support compressed formats yet
+
+    TraceSpan span("texture", "Utils::makeThumbnail");
+
+    const auto level = thumbnailLevel(texture, size, index.level());
+    const auto source = texture.imageData({Texture::Side(index.face()), level, index.layer()});
+    if (source.empty())
+        return {};
+
+    auto slice = Texture(
+            texture.format(),
+            {texture.width(level), texture.height(level)},
+            {1, 1},
+            texture.alignment());
+    if (slice.isNull())
+        return {};
+    const auto bytesPerSlice = texture.bytesPerSlice(level);
+    Q_ASSERT(slice.imageData({}).size() == bytesPerSlice);
+    memcpy(slice.imageData({}).data(), source.data(), size_t(bytesPerSlice));
+
+    auto image = slice.toImage();
+    if (image.isNull())
+        return {};
+
+    const auto target = image.size().scaled(size, Qt::KeepAspectRatio);
+    if (target == image.size())
+        return image;
+
+    // Nearest-neighbour pass to 2x the target size, then a box filter; this is much cheaper than
+    // smoothing the whole image and looks the same at the thumbnail size.
+    if (image.width() > 2 * target.width() && image.height() > 2 * target.height())
+        image = image.scaled(target * 2, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    return image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
@@ -3,6 +3,10 @@
 
 #include "texturelib_global.h"
 
+#include <TextureLib/Texture>
+
+#include <QtGui/QImage>
+
 #include <qglobal.h>
 
 #include <memory>
@@ -11,12 +15,15 @@ QT_BEGIN_NAMESPACE
 class QOpenGLTexture;
 QT_END_NAMESPACE
 
-class Texture;
-
 namespace Utils {
 
 std::unique_ptr<QOpenGLTexture> TEXTURELIB_EXPORT makeOpenGLTexture(const Texture &texture);
 
+Texture::size_type TEXTURELIB_EXPORT thumbnailLevel(
+        const Texture &texture, QSize size, Texture::size_type level = 0);
+QImage TEXTURELIB_EXPORT makeThumbnail(
+        const Texture &texture, QSize size, Texture::ArrayIndex index = {});
+
 } // namespace Utils
 
 #endif // UTILS_H
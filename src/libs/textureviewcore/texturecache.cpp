@@ -0,0 +1,472 @@
+#include "texturecache.h"
+
+#include <TextureLib/TextureAllocator>
+
+#include <QtCore/QDebug>
+#include <QtCore/QMutex>
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+
+namespace TextureViewer {
+
+class TextureCachePrivate
+{
+public:
+    using Key = TextureCache::Key;
+    using Loader = TextureCache::Loader;
+    using LruList = std::list<Key>;
+
+    struct Entry
+    {
+        Texture texture;
+        Loader loader;
+        qint64 bytes {0};
+        int pins {0};
+        LruList::iterator lruPosition;
+    };
+
+    bool isEvictable(const Entry &entry) const { return entry.loader && !entry.pins; }
+    void touch(Key key, Entry &entry);
+    void attach(Key key, Entry &entry, const Texture &texture);
+    void detach(Entry &entry);
+    qint64 evict(Key keep);
+
+    mutable QMutex mutex;
+    std::unordered_map<Key, Entry> entries;
+    LruList lru; // most recently used first; only resident entries with a loader
+    Key nextKey {1};
+    TextureCache::Statistics statistics;
+};
+
+void TextureCachePrivate::touch(Key key, Entry &entry)
+{
+    if (!isEvictable(entry) || entry.texture.isNull())
+        return;
+    if (entry.lruPosition != lru.end())
+        lru.erase(entry.lruPosition);
+    lru.push_front(key);
+    entry.lruPosition = lru.begin();
+}
+
+void TextureCachePrivate::attach(Key key, Entry &entry, const Texture &texture)
+{
+    entry.texture = texture;
+    entry.bytes = texture.isNull() ? 0 : texture.bytes();
+    if (entry.texture.isNull())
+        return;
+    statistics.bytes += entry.bytes;
+    statistics.residentEntries++;
+    if (!isEvictable(entry))
+        statistics.pinnedBytes += entry.bytes;
+    statistics.peakBytes = std::max(statistics.peakBytes, statistics.bytes);
+    touch(key, entry);
+}
+
+void TextureCachePrivate::detach(Entry &entry)
+{
+    if (entry.texture.isNull())
+        return;
+    statistics.bytes -= entry.bytes;
+    statistics.residentEntries--;
+    if (!isEvictable(entry))
+        statistics.pinnedBytes -= entry.bytes;
+    if (entry.lruPosition != lru.end()) {
+        lru.erase(entry.lruPosition);
+        entry.lruPosition = lru.end();
+    }
+    entry.texture = Texture();
+    entry.bytes = 0;
+}
+
+// Drops the least recently used entries until the budget is met; returns the amount of evicted
+// bytes. The entry with the key \a keep is never evicted, so the caller can still use it.
+qint64 TextureCachePrivate::evict(Key keep)
+{
+    qint64 result = 0;
+    auto it = lru.end();
+    while (statistics.bytes > statistics.budget && it != lru.begin()) {
+        --it;
+        const auto key = *it;
+        if (key == keep)
+            continue;
+        auto &entry = entries.at(key);
+        const auto bytes = entry.bytes;
+        it = lru.erase(it);
+        entry.lruPosition = lru.end();
+        detach(entry);
+        statistics.evictions++;
+        statistics.evictedBytes += bytes;
+        result += bytes;
+    }
+    return result;
+}
+
+/*!
+  \class TextureViewer::TextureCache
+  \brief Process-wide cache that limits the amount of memory used by textures.
+
+  Each entry holds a Texture and, optionally, a Loader function that can recreate it. When the
+  total size of the resident textures exceeds the budget(), the least recently used entries with
+  a loader are evicted; they are transparently reloaded by the next call to texture(). Entries
+  without a loader are pinned: they count towards the budget but are never evicted. Entries with
+  a loader can be pinned temporarily with pin(), e.g. while they are being used.
+
+  All members are thread-safe. Loaders are called without holding the internal lock, so a loader
+  may access the cache itself.
+*/
+
+/*!
+  \brief Constructs a new TextureCache with the defaultBudget() and the given \a parent.
+*/
+TextureCache::TextureCache(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new TextureCachePrivate)
+{
+    Q_D(TextureCache);
+    d->statistics.budget = defaultBudget();
+}
+
+/*!
+  \brief Destroys the TextureCache.
+*/
+TextureCache::~TextureCache()
+{
+    Q_D(TextureCache);
+    if (d->statistics.entries)
+        qCDebug(texturecache) << "Destroying cache with" << d->statistics.entries << "entries";
+}
+
+/*!
+  \brief Adds a new entry that is reloaded using the \a loader when evicted.
+
+  If \a texture is not null, it becomes resident immediately; otherwise, the \a loader is
+  called lazily by the first texture() call. Returns the key of the new entry.
+*/
+auto TextureCache::insert(Loader loader, const Texture &texture) -> Key
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto key = d->nextKey++;
+    auto &entry = d->entries[key];
+    entry.loader = std::move(loader);
+    entry.lruPosition = d->lru.end();
+    d->statistics.entries++;
+    d->attach(key, entry, texture);
+    const auto evicted = d->evict(key);
+    lock.unlock();
+
+    if (evicted)
+        qCDebug(texturecache) << "Evicted" << evicted << "bytes;" << statistics();
+    emit statisticsChanged();
+    return key;
+}
+
+/*!
+  \brief Adds a new pinned entry holding the \a texture.
+
+  The \a texture is never evicted; returns the key of the new entry.
+*/
+auto TextureCache::insert(const Texture &texture) -> Key
+{
+    return insert(Loader(), texture);
+}
+
+/*!
+  \brief Removes the entry with the given \a key from the cache.
+*/
+void TextureCache::remove(Key key)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto it = d->entries.find(key);
+    if (it == d->entries.end())
+        return;
+    d->detach(it->second);
+    d->entries.erase(it);
+    d->statistics.entries--;
+    lock.unlock();
+
+    emit statisticsChanged();
+}
+
+/*!
+  \brief Pins the entry with the given \a key, so it is not evicted until unpinned.
+
+  Pins are counted, each call must be paired with unpin(). Pinned bytes count towards the budget.
+  Pinning an entry that is not resident doesn't load it.
+*/
+void TextureCache::pin(Key key)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto it = d->entries.find(key);
+    if (it == d->entries.end())
+        return;
+    auto &entry = it->second;
+    const auto wasEvictable = d->isEvictable(entry);
+    entry.pins++;
+    if (!wasEvictable || entry.texture.isNull())
+        return;
+    d->statistics.pinnedBytes += entry.bytes;
+    if (entry.lruPosition != d->lru.end()) {
+        d->lru.erase(entry.lruPosition);
+        entry.lruPosition = d->lru.end();
+    }
+    lock.unlock();
+
+    emit statisticsChanged();
+}
+
+/*!
+  \brief Removes a pin added by pin() from the entry with the given \a key.
+
+  The entry becomes evictable again when its last pin is removed, unless it has no loader.
+*/
+void TextureCache::unpin(Key key)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto it = d->entries.find(key);
+    if (it == d->entries.end() || it->second.pins == 0)
+        return;
+    auto &entry = it->second;
+    entry.pins--;
+    if (!d->isEvictable(entry) || entry.texture.isNull())
+        return;
+    d->statistics.pinnedBytes -= entry.bytes;
+    d->touch(key, entry);
+    const auto evicted = d->evict(0);
+    lock.unlock();
+
+    if (evicted)
+        qCDebug(texturecache) << "Evicted" << evicted << "bytes;" << statistics();
+    emit statisticsChanged();
+}
+
+/*!
+  \brief Removes all entries from the cache.
+*/
+void TextureCache::clear()
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    for (auto &entry: d->entries)
+        d->detach(entry.second);
+    d->entries.clear();
+    d->statistics.entries = 0;
+    lock.unlock();
+
+    emit statisticsChanged();
+}
+
+/*!
+  \brief Returns the texture for the given \a key.
+
+  If the entry was evicted, it is reloaded using its loader, which may evict other entries.
+  Returns a null texture if there is no such entry or if the loader fails.
+*/
+Texture TextureCache::texture(Key key)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    auto it = d->entries.find(key);
+    if (it == d->entries.end())
+        return Texture();
+
+    if (!it->second.texture.isNull()) {
+        d->statistics.hits++;
+        d->touch(key, it->second);
+        return it->second.texture;
+    }
+
+    d->statistics.misses++;
+    auto loader = it->second.loader;
+    if (!loader)
+        return Texture();
+    lock.unlock();
+
+    const auto loaded = loader();
+
+    lock.relock();
+    it = d->entries.find(key);
+    if (it == d->entries.end()) // removed while loading
+        return loaded;
+    if (!it->second.texture.isNull()) { // loaded concurrently by another thread
+        d->touch(key, it->second);
+        return it->second.texture;
+    }
+    if (loaded.isNull()) {
+        qCWarning(texturecache) << "Can't reload texture for key" << key;
+        return loaded;
+    }
+    d->statistics.reloads++;
+    d->attach(key, it->second, loaded);
+    const auto evicted = d->evict(key);
+    lock.unlock();
+
+    if (evicted)
+        qCDebug(texturecache) << "Evicted" << evicted << "bytes;" << statistics();
+    emit statisticsChanged();
+    return loaded;
+}
+
+/*!
+  \brief Returns the texture for the given \a key if it is resident.
+
+  Unlike texture(), an evicted entry is not reloaded; a null texture is returned instead. Callers
+  that must not block on the loader use this function and reload the texture elsewhere.
+*/
+Texture TextureCache::find(Key key)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto it = d->entries.find(key);
+    if (it == d->entries.end() || it->second.texture.isNull())
+        return Texture();
+    d->statistics.hits++;
+    d->touch(key, it->second);
+    return it->second.texture;
+}
+
+/*!
+  \brief Returns true if the entry with the given \a key holds a loaded texture.
+*/
+bool TextureCache::isResident(Key key) const
+{
+    Q_D(const TextureCache);
+    QMutexLocker lock(&d->mutex);
+    const auto it = d->entries.find(key);
+    return it != d->entries.end() && !it->second.texture.isNull();
+}
+
+/*!
+  \brief Returns true if the cache has an entry with the given \a key.
+*/
+bool TextureCache::contains(Key key) const
+{
+    Q_D(const TextureCache);
+    QMutexLocker lock(&d->mutex);
+    return d->entries.find(key) != d->entries.end();
+}
+
+/*!
+  \property qint64 TextureCache::budget
+  \brief This property holds the maximum amount of bytes of the resident textures.
+
+  The budget is a soft limit: pinned entries and the most recently requested texture are kept
+  even if they do not fit.
+
+  Default value is defaultBudget().
+*/
+
+qint64 TextureCache::budget() const
+{
+    Q_D(const TextureCache);
+    QMutexLocker lock(&d->mutex);
+    return d->statistics.budget;
+}
+
+void TextureCache::setBudget(qint64 bytes)
+{
+    Q_D(TextureCache);
+    QMutexLocker lock(&d->mutex);
+    bytes = std::max<qint64>(0, bytes);
+    if (d->statistics.budget == bytes)
+        return;
+    d->statistics.budget = bytes;
+    const auto evicted = d->evict(0);
+    lock.unlock();
+
+    qCInfo(texturecache) << "Budget set to" << bytes << "bytes";
+    if (evicted)
+        qCDebug(texturecache) << "Evicted" << evicted << "bytes;" << statistics();
+    emit budgetChanged(bytes);
+    emit statisticsChanged();
+}
+
+/*!
+  \brief Returns the usage statistics.
+*/
+TextureCache::Statistics TextureCache::statistics() const
+{
+    Q_D(const TextureCache);
+    QMutexLocker lock(&d->mutex);
+    return d->statistics;
+}
+
+/*!
+  \brief Returns the default budget in bytes.
+
+  The default budget can be set in megabytes using the TEXTUREVIEWER_CACHE_BUDGET environment
+  variable; otherwise, it is 1 GB.
+*/
+qint64 TextureCache::defaultBudget()
+{
+    bool ok = false;
+    const auto megabytes = qEnvironmentVariableIntValue("TEXTUREVIEWER_CACHE_BUDGET", &ok);
+    if (ok && megabytes > 0)
+        return qint64(megabytes) * 1024 * 1024;
+    return qint64(1024) * 1024 * 1024;
+}
+
+namespace {
+
+// The memory pooled by the allocator is not counted by the cache, so the pool of the global
+// allocator is kept at a fraction of the budget of the global cache
+constexpr qint64 allocatorPoolFraction = 8;
+
+class GlobalTextureCache : public TextureCache
+{
+public:
+    GlobalTextureCache()
+    {
+        limitAllocatorPool(budget());
+        connect(this, &TextureCache::budgetChanged, this, &GlobalTextureCache::limitAllocatorPool);
+    }
+
+private:
+    static void limitAllocatorPool(qint64 budget)
+    {
+        if (const auto allocator = TextureAllocator::instance())
+            allocator->setPoolLimit(qsizetype(budget / allocatorPoolFraction));
+    }
+};
+
+} // namespace
+
+Q_GLOBAL_STATIC(GlobalTextureCache, globalCache)
+
+/*!
+  \brief Returns the cache shared by all documents.
+
+  Returns nullptr during the application shutdown, after the cache was destroyed.
+*/
+TextureCache *TextureCache::instance()
+{
+    return globalCache();
+}
+
+QDebug operator<<(QDebug debug, const TextureCache::Statistics &statistics)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "TextureCache::Statistics("
+                    << "budget = " << statistics.budget
+                    << ", bytes = " << statistics.bytes
+                    << ", pinnedBytes = " << statistics.pinnedBytes
+                    << ", peakBytes = " << statistics.peakBytes
+                    << ", entries = " << statistics.entries
+                    << ", residentEntries = " << statistics.residentEntries
+                    << ", hits = " << statistics.hits
+                    << ", misses = " << statistics.misses
+                    << ", reloads = " << statistics.reloads
+                    << ", evictions = " << statistics.evictions
+                    << ", evictedBytes = " << statistics.evictedBytes
+                    << ")";
+    return debug;
+}
+
+} // namespace TextureViewer
+
+Q_LOGGING_CATEGORY(texturecache, "textureviewcore.texturecache");
@@ -0,0 +1,80 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "textureviewcore_global.h"
+
+#include <TextureLib/Texture>
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QObject>
+
+#include <functional>
+
+namespace TextureViewer {
+
+class TextureCachePrivate;
+class TEXTUREVIEWCORE_EXPORT TextureCache : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TextureCache)
+    Q_DECLARE_PRIVATE(TextureCache)
+    Q_PROPERTY(qint64 budget READ budget WRITE setBudget NOTIFY budgetChanged)
+public:
+    using Key = quint64;
+    using Loader = std::function<Texture()>;
+
+    struct Statistics
+    {
+        qint64 budget {0};
+        qint64 bytes {0};
+        qint64 pinnedBytes {0};
+        qint64 peakBytes {0};
+        qint64 entries {0};
+        qint64 residentEntries {0};
+        qint64 hits {0};
+        qint64 misses {0};
+        qint64 reloads {0};
+        qint64 evictions {0};
+        qint64 evictedBytes {0};
+    };
+
+    explicit TextureCache(QObject *parent = nullptr);
+    TextureCache(TextureCache &&) = delete;
+    ~TextureCache() override;
+    TextureCache &operator=(TextureCache &&) = delete;
+
+    Key insert(Loader loader, const Texture &texture = Texture());
+    Key insert(const Texture &texture);
+    void remove(Key key);
+    void clear();
+
+    void pin(Key key);
+    void unpin(Key key);
+
+    Texture texture(Key key);
+    Texture find(Key key);
+    bool isResident(Key key) const;
+    bool contains(Key key) const;
+
+    qint64 budget() const;
+    void setBudget(qint64 bytes);
+    Q_SIGNAL void budgetChanged(qint64 budget);
+
+    Statistics statistics() const;
+    Q_SIGNAL void statisticsChanged();
+
+    static qint64 defaultBudget();
+
+    static TextureCache *instance();
+
+private:
+    QScopedPointer<TextureCachePrivate> d_ptr;
+};
+
+QDebug TEXTUREVIEWCORE_EXPORT operator<<(QDebug debug, const TextureCache::Statistics &statistics);
+
+} // namespace TextureViewer
+
+Q_DECLARE_LOGGING_CATEGORY(texturecache)
+
+#endif // TEXTURECACHE_H
@@ -11,6 +11,8 @@
 #include <QtGui/QOpenGLVertexArrayObject>
 #include <QtGui/QResizeEvent>
 
+#include <utility>
+
 namespace TextureViewer {
 
 class TextureControlPrivate
@@ -24,6 +26,7 @@ public:
     explicit TextureControlPrivate(ObserverPointer<TextureControl> qq) noexcept : q_ptr(qq) {}
 
     ItemPointer currentItem() const;
+    Texture currentImage() const;
     void onTextureChanged(const Texture &texture);
     void updateModel(const Texture &image);
 
@@ -51,6 +54,9 @@ public:
     int layer {0};
     int level {0};
     bool textureDirty {false};
+    // Set when the requested image of the current item was reloaded; if it was evicted again
+    // before painting, it is reloaded in the GUI thread rather than requested once more
+    mutable bool imageReloaded {false};
     OpenGLData glData;
 
 protected:
@@ -117,7 +123,36 @@ bool TextureControlPrivate::OpenGLData::initializeShaders()
 
 TextureControlPrivate::ItemPointer TextureControlPrivate::currentItem() const
 {
-    return document ? document->item(face, layer, level) : nullptr;
+    return document ? document->item(face, level, layer) : nullptr;
+}
+
+// Returns the current image. While the document is opening or while an evicted image is reloaded
+// in the background, that is the closest level of the current face and layer that is resident,
+// preferring the bigger one, or the preview.
+Texture TextureControlPrivate::currentImage() const
+{
+    if (!document)
+        return Texture();
+
+    const auto reloaded = std::exchange(imageReloaded, false);
+    const auto current = currentItem();
+    if (current && current->isReady()) {
+        if (current->isResident() || reloaded)
+            return current->texture();
+        document->requestImage(face, level, layer);
+    }
+
+    const auto levels = document->levels();
+    for (int distance = 0; distance < levels; ++distance) {
+        for (const auto candidate: {level - distance, level + distance}) {
+            if (candidate < 0 || candidate >= levels)
+                continue;
+            const auto item = document->item(face, candidate, layer);
+            if (item && item->isResident())
+                return item->texture();
+        }
+    }
+    return document->preview();
 }
 
 void TextureControlPrivate::onTextureChanged(const Texture &texture)
@@ -129,6 +164,7 @@ void TextureControlPrivate::onTextureChanged(const Texture &texture)
     level = 0;
     face = 0;
     textureDirty = true;
+    imageReloaded = false;
     q->update();
 }
 
@@ -197,6 +233,28 @@ void TextureControl::setDocument(TextureControl::TextureDocumentPointer document
 
     connect(d->document.get(), &TextureDocument::textureChanged,
             this, [d](const Texture &texture) { d->onTextureChanged(texture); } );
+    connect(d->document.get(), &TextureDocument::previewChanged, this, [this, d]()
+    {
+        const auto item = d->currentItem();
+        if (item && item->isReady())
+            return;
+        d->textureDirty = true;
+        update();
+    });
+    // A better level of the current image may become available
+    connect(d->document.get(), &TextureDocument::itemReady,
+            this, [this, d](int face, int level, int layer)
+    {
+        if (face != d->face || layer != d->layer)
+            return;
+        const auto item = d->currentItem();
+        if (level == d->level)
+            d->imageReloaded = item && item->isReady();
+        else if (item && item->isResident())
+            return;
+        d->textureDirty = true;
+        update();
+    });
 
     emit documentChanged(document);
     update();
@@ -233,6 +291,7 @@ void TextureControl::setLevel(int level)
         return;
     d->level = level;
     d->textureDirty = true;
+    d->imageReloaded = false;
     emit levelChanged(d->level);
     update();
 }
@@ -250,6 +309,7 @@ void TextureControl::setLayer(int layer)
         return;
     d->layer = layer;
     d->textureDirty = true;
+    d->imageReloaded = false;
     emit layerChanged(d->layer);
     update();
 }
@@ -267,6 +327,7 @@ void TextureControl::setFace(int face)
         return;
     d->face = face;
     d->textureDirty = true;
+    d->imageReloaded = false;
     emit faceChanged(d->face);
     update();
 }
@@ -344,8 +405,7 @@ void TextureControl::resizeGL(int w, int h)
     d->glData.view = QMatrix4x4();
     d->glData.view.translate({0, 0, -3.0f});
 
-    auto item = d->currentItem();
-    const auto &image = item ? item->texture : Texture();
+    const auto image = d->currentImage();
     if (!image.isNull()) {
         d->updateModel(image);
     }
@@ -359,8 +419,7 @@ void TextureControl::paintGL()
 
     if (d->textureDirty) {
         d->glData.texture.reset(); // delete tex here as we have a context
-        auto item = d->currentItem();
-        const auto &image = item ? item->texture : Texture();
+        const auto image = d->currentImage();
         if (!image.isNull()) {
             d->glData.texture = Utils::makeOpenGLTexture(image);
             d->updateModel(image);
@@ -1,25 +1,480 @@
 #include "texturedocument.h"
 
 #include <TextureLib/TextureIO>
+#include <TextureLib/TextureMemory>
+#include <TextureLib/ThumbnailCache>
+#include <TextureLib/Tracing>
+#include <TextureLib/Utils>
 
 #include <QtConcurrent/QtConcurrentRun>
 
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
 namespace TextureViewer {
 
+namespace {
+
+class ThumbnailJob : public QRunnable
+{
+public:
+    explicit ThumbnailJob(std::function<void()> function) : m_function(std::move(function)) {}
+    void run() override { m_function(); }
+
+private:
+    std::function<void()> m_function;
+};
+
+} // namespace
+
 class TextureDocumentPrivate
 {
+    Q_DECLARE_PUBLIC(TextureDocument)
 public:
     using Item = TextureDocument::Item;
     using ReadWatcher = QFutureWatcher<TextureIO::ReadResult>;
     using WriteWatcher = QFutureWatcher<TextureIO::WriteResult>;
+    using ConvertWatcher = QFutureWatcher<Texture>;
+
+    explicit TextureDocumentPrivate(TextureDocument *qq) : q_ptr(qq) {}
+    ~TextureDocumentPrivate();
+
+    void setTexture(
+            const Texture &texture,
+            TextureCache::Loader loader,
+            const QString &filePath = QString());
+    void setLayout(
+            TextureFormat format,
+            Texture::Alignment alignment,
+            Texture::Size size,
+            Texture::ArraySize arraySize,
+            const QString &filePath);
+    void setHeader(
+            TextureFormat format,
+            Texture::Alignment alignment,
+            Texture::Size size,
+            Texture::ArraySize arraySize,
+            const QString &filePath);
+    void setImage(Texture::ArrayIndex index, const Texture &image);
+    void emitTextureChanged(const Texture &texture);
+    void release();
+    void setPreview(const Texture &texture);
+    void setConverting(bool converting);
+    int itemIndex(int face, int level, int layer) const
+    { return arraySize.faces() * (arraySize.layers() * level + layer) + face; }
+    void cancelThumbnails();
+    static TextureCache::Loader fileLoader(const QString &path, const Texture &texture);
+    static TextureCache::Loader sliceLoader(
+            TextureCache::Key sourceKey,
+            const QString &path,
+            const Texture &source,
+            Texture::ArrayIndex index);
+    static Texture makeSlice(const Texture &source, Texture::ArrayIndex index);
+
+    TextureDocument *q_ptr {nullptr};
+
+    // The texture itself lives in the cache; the document only keeps its description. A texture
+    // read from a file can be evicted, the other ones are pinned.
+    TextureCache::Key textureKey {0};
+    TextureFormat format {TextureFormat::Invalid};
+    Texture::Alignment alignment {Texture::Alignment::Byte};
+    Texture::Size size;
+    Texture::ArraySize arraySize;
 
-    Texture texture;
     std::vector<std::unique_ptr<Item>> items;
 
+    // While a texture is opening, its layout is read from the header before the data and the
+    // items are filled with pinned copies of the images as they are read, as long as the copies
+    // fit the free part of the cache budget. The items are kept when the whole texture is read.
+    bool partial {false};
+
+    // Thumbnails and the evicted images requested by views are loaded on a separate pool, so
+    // they don't compete with opening and saving and don't block the GUI thread. Each request
+    // gets a higher priority than the previous ones: views request the data of the visible items
+    // when painting, so those are loaded first. Results of the jobs from the previous generation
+    // are dropped.
+    QSize thumbnailSize {128, 128};
+    QThreadPool thumbnailPool;
+    QAtomicInt thumbnailGeneration {0};
+    QSet<int> thumbnailRequests;
+    QSet<int> imageRequests;
+    QSet<int> deferredThumbnails;
+    int thumbnailPriority {0};
+    ThumbnailCache::Key thumbnailKey;
+
+    // A small image read before the whole texture, painted while it is loading. Open jobs run
+    // on their own pool, so the document can wait for the canceled ones that still deliver
+    // previews; previews of the canceled opens are dropped.
+    Texture preview;
+    QThreadPool openPool;
+    QAtomicInt openGeneration {0};
+
+    // Conversions run on their own pool as well and check the generation between bands of
+    // lines, so the canceled ones stop early; the texture is replaced when the conversion is done
+    QThreadPool convertPool;
+    QAtomicInt convertGeneration {0};
+    bool converting {false};
+
     std::unique_ptr<QFutureWatcher<TextureIO::ReadResult>> readWatcher;
     std::unique_ptr<QFutureWatcher<TextureIO::WriteResult>> writeWatcher;
+    std::unique_ptr<QFutureWatcher<Texture>> convertWatcher;
 };
 
+TextureDocumentPrivate::~TextureDocumentPrivate()
+{
+    release();
+    convertGeneration.fetchAndAddOrdered(1);
+    thumbnailPool.waitForDone();
+    openPool.waitForDone();
+    convertPool.waitForDone();
+}
+
+void TextureDocumentPrivate::setTexture(
+        const Texture &texture, TextureCache::Loader loader, const QString &filePath)
+{
+    Q_Q(TextureDocument);
+
+    const auto cache = TextureCache::instance();
+    if (!textureKey && !partial && texture.isNull())
+        return;
+    if (textureKey && cache && cache->isResident(textureKey) && cache->texture(textureKey) == texture)
+        return;
+
+    TraceSpan span("document", "TextureDocument::setTexture");
+    span.setDetail(filePath);
+
+    // The texture that was being opened keeps its items, so views don't lose them
+    const auto keepItems = partial
+            && !texture.isNull()
+            && texture.format() == format
+            && texture.alignment() == alignment
+            && texture.width() == size.width
+            && texture.height() == size.height
+            && texture.depth() == size.depth
+            && texture.faces() == arraySize.faces()
+            && texture.levels() == arraySize.levels()
+            && texture.layers() == arraySize.layers();
+
+    if (keepItems) {
+        cancelThumbnails();
+        partial = false;
+    } else {
+        release();
+        setLayout(texture.format(), texture.alignment(),
+                  !texture.isNull() ? texture.size() : Texture::Size(),
+                  !texture.isNull() ? texture.arraySize() : Texture::ArraySize(),
+                  filePath);
+    }
+
+    if (!texture.isNull() && cache) {
+        // Without a loader (e.g. the converted texture) the texture is pinned. A texture read from
+        // a file is evictable like its slices; the evicted slices only read their level from the
+        // file, see sliceLoader(), so the whole texture does not have to fit the budget.
+        textureKey = loader ? cache->insert(std::move(loader), texture) : cache->insert(texture);
+
+        // Slices are created lazily by the first Item::texture() call; the pinned copies made
+        // while opening become evictable
+        for (const auto &item: items) {
+            const auto index = Texture::ArrayIndex(
+                    Texture::Side(item->face), item->level, item->layer);
+            const auto ready = item->isReady();
+            const auto slice = ready && cache->isResident(item->cacheKey)
+                    ? cache->texture(item->cacheKey)
+                    : Texture();
+            const auto key = cache->insert(sliceLoader(textureKey, filePath, texture, index), slice);
+            cache->remove(std::exchange(item->cacheKey, key));
+            if (keepItems && !ready)
+                emit q->itemReady(item->face, item->level, item->layer);
+        }
+    }
+
+    emitTextureChanged(texture);
+}
+
+// Sets the layout of the texture and creates the items without images
+void TextureDocumentPrivate::setLayout(
+        TextureFormat format,
+        Texture::Alignment alignment,
+        Texture::Size size,
+        Texture::ArraySize arraySize,
+        const QString &filePath)
+{
+    // Thumbnails of the textures read from files are stored in the persistent ThumbnailCache
+    thumbnailKey = !filePath.isEmpty()
+            ? ThumbnailCache::Key::fromFile(filePath)
+            : ThumbnailCache::Key();
+    this->format = format;
+    this->alignment = alignment;
+    this->size = size;
+    this->arraySize = arraySize;
+
+    if (format == TextureFormat::Invalid || !TextureCache::instance())
+        return;
+
+    items.reserve(size_t(arraySize.faces() * arraySize.layers() * arraySize.levels()));
+    for (int level = 0; level < arraySize.levels(); ++level) {
+        for (int layer = 0; layer < arraySize.layers(); ++layer) {
+            for (int face = 0; face < arraySize.faces(); ++face) {
+                auto item = std::make_unique<Item>();
+                item->level = level;
+                item->layer = layer;
+                item->face = face;
+                items.push_back(std::move(item));
+            }
+        }
+    }
+}
+
+// Lays out the texture that is being opened before its data is read
+void TextureDocumentPrivate::setHeader(
+        TextureFormat format,
+        Texture::Alignment alignment,
+        Texture::Size size,
+        Texture::ArraySize arraySize,
+        const QString &filePath)
+{
+    TraceSpan span("document", "TextureDocument::setHeader");
+    span.setDetail(filePath);
+
+    release();
+    setLayout(format, alignment, size, arraySize, filePath);
+    partial = true;
+    emitTextureChanged(Texture());
+}
+
+// Stores the copy of the image that was just read while the texture is opening
+void TextureDocumentPrivate::setImage(Texture::ArrayIndex index, const Texture &image)
+{
+    Q_Q(TextureDocument);
+    const auto cache = TextureCache::instance();
+    if (!partial || items.empty() || !cache)
+        return;
+
+    const auto face = int(index.side());
+    const auto level = int(index.level());
+    const auto layer = int(index.layer());
+    const auto itemIndex = this->itemIndex(face, level, layer);
+    const auto &item = items.at(size_t(itemIndex));
+    if (item->isReady())
+        return;
+
+    item->cacheKey = cache->insert(image);
+    emit q->itemReady(face, level, layer);
+
+    if (deferredThumbnails.remove(itemIndex))
+        q->requestThumbnail(face, level, layer);
+}
+
+void TextureDocumentPrivate::emitTextureChanged(const Texture &texture)
+{
+    Q_Q(TextureDocument);
+    emit q->textureChanged(texture);
+    emit q->widthChanged(q->width());
+    emit q->heigthChanged(q->heigth());
+    emit q->depthChanged(q->depth());
+    emit q->levelsChanged(q->levels());
+    emit q->layersChanged(q->layers());
+    emit q->facesChanged(q->faces());
+}
+
+void TextureDocumentPrivate::release()
+{
+    cancelThumbnails();
+    items.clear();
+    partial = false;
+    if (textureKey) {
+        if (const auto cache = TextureCache::instance())
+            cache->remove(textureKey);
+        textureKey = 0;
+    }
+}
+
+void TextureDocumentPrivate::setPreview(const Texture &texture)
+{
+    Q_Q(TextureDocument);
+    if (preview.isNull() && texture.isNull())
+        return;
+    preview = texture;
+    emit q->previewChanged(preview);
+}
+
+void TextureDocumentPrivate::setConverting(bool converting)
+{
+    Q_Q(TextureDocument);
+    if (this->converting == converting)
+        return;
+    this->converting = converting;
+    emit q->convertingChanged(converting);
+}
+
+void TextureDocumentPrivate::cancelThumbnails()
+{
+    thumbnailGeneration.fetchAndAddOrdered(1);
+    thumbnailPool.clear();
+    thumbnailRequests.clear();
+    imageRequests.clear();
+    deferredThumbnails.clear();
+    thumbnailPriority = 0;
+}
+
+// Reloads the evicted texture from the file it was read from.
+TextureCache::Loader TextureDocumentPrivate::fileLoader(const QString &path, const Texture &texture)
+{
+    const auto format = texture.format();
+    const auto size = texture.size();
+    const auto arraySize = texture.arraySize();
+    return [path, format, size, arraySize]() -> Texture
+    {
+        qCDebug(texturedocument) << "Reloading" << path;
+        TraceSpan span("document", "TextureDocument::reload");
+        span.setDetail(path);
+        TextureIO io(path);
+        const auto result = io.read();
+        if (!result) {
+            qCWarning(texturedocument) << "Can't reload" << path << ":" << toUserString(result.error());
+            return Texture();
+        }
+        const auto &texture = *result;
+        if (texture.format() != format
+                || texture.width() != size.width
+                || texture.height() != size.height
+                || texture.depth() != size.depth
+                || texture.faces() != arraySize.faces()
+                || texture.levels() != arraySize.levels()
+                || texture.layers() != arraySize.layers()) {
+            qCWarning(texturedocument) << "Can't reload" << path << ": file was changed";
+            return Texture();
+        }
+        return texture;
+    };
+}
+
+// Copies a single image of the source texture. If the source was evicted and was read from the
+// file at the given path, only the level of the image is read when the handler supports that;
+// otherwise, the source is reloaded.
+TextureCache::Loader TextureDocumentPrivate::sliceLoader(
+        TextureCache::Key sourceKey,
+        const QString &path,
+        const Texture &source,
+        Texture::ArrayIndex index)
+{
+    const auto format = source.format();
+    const auto size = source.size(index.level());
+    const auto faces = source.faces();
+    const auto layers = source.layers();
+    return [sourceKey, path, format, size, faces, layers, index]() -> Texture
+    {
+        const auto cache = TextureCache::instance();
+        if (!cache)
+            return Texture();
+        auto source = cache->find(sourceKey);
+        if (!source.isNull())
+            return makeSlice(source, index);
+
+        if (!path.isEmpty()) {
+            TraceSpan span("document", "TextureDocument::reloadLevel");
+            span.setDetail(path);
+            TextureIO io(path);
+            const auto level = io.readLevel(int(index.level()));
+            if (level) {
+                if (level->format() != format
+                        || level->width() != size.width
+                        || level->height() != size.height
+                        || level->depth() != size.depth
+                        || level->faces() != faces
+                        || level->layers() != layers) {
+                    qCWarning(texturedocument) << "Can't reload" << path << ": file was changed";
+                    return Texture();
+                }
+                return makeSlice(*level, {index.side(), 0, index.layer()});
+            }
+        }
+
+        source = cache->texture(sourceKey);
+        if (source.isNull())
+            return Texture();
+        return makeSlice(source, index);
+    };
+}
+
+// Copies the image at the given index into a texture with a single level, layer and face. Only
+// the data of that image is accessed, so the source can be still being read.
+Texture TextureDocumentPrivate::makeSlice(const Texture &source, Texture::ArrayIndex index)
+{
+    TraceSpan span("document", "TextureDocument::slice");
+    TextureMemory::OriginScope scope(TextureMemory::Origin::Slice);
+    auto slice = Texture(
+            source.format(),
+            source.size(index.level()),
+            {1, 1},
+            source.alignment());
+    if (slice.isNull()) {
+        qCWarning(texturedocument) << "Can't create slice";
+        return Texture();
+    }
+    const auto image = source.constImageData(index);
+    Q_ASSERT(image.size() == slice.imageData({}).size());
+    memcpy(slice.imageData({}).data(), image.data(), size_t(image.size()));
+    return slice;
+}
+
+/*!
+  \class TextureViewer::TextureDocument::Item
+  \brief A single image of the document's texture.
+*/
+
+/*!
+  \brief Destroys the Item and removes its image from the TextureCache.
+*/
+TextureDocument::Item::~Item()
+{
+    if (const auto cache = TextureCache::instance())
+        cache->remove(cacheKey);
+}
+
+/*!
+  \brief Returns the image as a texture with a single level, layer and face.
+
+  The image is stored in the TextureCache and can be evicted; in that case, it is recreated from
+  the document's texture or read from the file in the calling thread, see
+  TextureDocument::requestImage().
+*/
+Texture TextureDocument::Item::texture() const
+{
+    const auto cache = TextureCache::instance();
+    return cache ? cache->texture(cacheKey) : Texture();
+}
+
+/*!
+  \brief Returns true if the image is loaded in the TextureCache.
+
+  An image that is ready but not resident was evicted; texture() reloads it in the calling
+  thread, TextureDocument::requestImage() reloads it in the background.
+*/
+bool TextureDocument::Item::isResident() const
+{
+    const auto cache = TextureCache::instance();
+    return cacheKey && cache && cache->isResident(cacheKey);
+}
+
+/*!
+  \brief Returns true if the image is available.
+
+  While the document is opening, the items are created from the header of the file and their
+  images become available as they are read, see TextureDocument::itemReady(). texture() returns
+  a null texture for the items that are not ready.
+*/
+bool TextureDocument::Item::isReady() const
+{
+    return cacheKey != 0;
+}
+
 /*!
   \class TextureViewer::TextureDocument
   \brief A document containing a Texture.
@@ -30,9 +485,10 @@ public:
 */
 TextureDocument::TextureDocument(QObject *parent)
     : AbstractDocument(parent)
-    , d_ptr(new TextureDocumentPrivate())
+    , d_ptr(new TextureDocumentPrivate(this))
 {
     Q_D(TextureDocument);
+    d->thumbnailPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
     d->readWatcher = std::make_unique<TextureDocumentPrivate::ReadWatcher>();
 
     const auto onOpenFinished = [this]()
@@ -43,9 +499,14 @@ TextureDocument::TextureDocument(QObject *parent)
             return;
         const auto result = future.result();
         if (result) {
-            setTexture(*result);
+            const auto path = url().toLocalFile();
+            d->setTexture(*result, d->fileLoader(path, *result), path);
+            d->setPreview(Texture());
             endOpen(true);
         } else {
+            d->setPreview(Texture());
+            if (d->partial)
+                d->setTexture(Texture(), {});
             endOpen(false, toUserString(result.error()));
         }
     };
@@ -66,6 +527,25 @@ TextureDocument::TextureDocument(QObject *parent)
             endSave(false, toUserString(result.error()));
     };
     connect(d->writeWatcher.get(), &QFutureWatcherBase::finished, this, onSaveFinished);
+
+    d->convertWatcher = std::make_unique<TextureDocumentPrivate::ConvertWatcher>();
+
+    const auto onConvertFinished = [this]()
+    {
+        Q_D(TextureDocument);
+        const auto future = d->convertWatcher->future();
+        if (future.isCanceled())
+            return;
+        const auto converted = future.result();
+        d->setConverting(false);
+        if (converted.isNull()) {
+            emit convertFinished(false, tr("Can't convert texture"));
+            return;
+        }
+        d->setTexture(converted, {});
+        emit convertFinished(true, QString());
+    };
+    connect(d->convertWatcher.get(), &QFutureWatcherBase::finished, this, onConvertFinished);
 }
 
 /*!
@@ -83,148 +563,430 @@ TextureDocument::~TextureDocument() = default;
 Texture TextureDocument::texture() const
 {
     Q_D(const TextureDocument);
-    return d->texture;
+    const auto cache = TextureCache::instance();
+    return d->textureKey && cache ? cache->texture(d->textureKey) : Texture();
 }
 
 void TextureDocument::setTexture(const Texture &texture)
 {
     Q_D(TextureDocument);
-    if (d->texture == texture)
-        return;
-    d->items.clear();
-    d->texture = texture;
-    const auto size = d->texture.faces() * d->texture.layers() * d->texture.levels();
-    d->items.reserve(size);
-    for (int level = 0; level < d->texture.levels(); ++level) {
-        for (int layer = 0; layer < d->texture.layers(); ++layer) {
-            for (int face = 0; face < d->texture.faces(); ++face) {
-                auto item = std::make_unique<Item>();
-                item->level = level;
-                item->layer = layer;
-                item->face = face;
-                auto slice = Texture(
-                        d->texture.format(),
-                        {d->texture.width(level), d->texture.height(level)},
-                        {1, 1},
-                        d->texture.alignment());
-                if (slice.isNull()) {
-                    qWarning() << "Can't create slice";
-                    d->items.clear();
-                    break;
-                }
-                const auto image = d->texture.imageData({Texture::Side(face), level, layer});
-                Q_ASSERT(image.size() == slice.imageData({}).size());
-                memcpy(slice.imageData({}).data(), image.data(), image.size());
-                item->texture = slice;
-//                item->thumbnail = slice.toImage();
-                d->items.push_back(std::move(item));
-            }
-        }
-    }
-
-    emit textureChanged(texture);
-    emit widthChanged(width());
-    emit heigthChanged(heigth());
-    emit depthChanged(depth());
-    emit levelsChanged(levels());
-    emit layersChanged(layers());
-    emit facesChanged(faces());
+    cancelConvert();
+    d->setTexture(texture, {});
 }
 
 TextureFormat TextureDocument::format() const
 {
     Q_D(const TextureDocument);
-    return d->texture.format();
+    return d->format;
 }
 
 Texture::Alignment TextureDocument::alignment() const
 {
     Q_D(const TextureDocument);
-    return d->texture.alignment();
+    return d->alignment;
 }
 
 int TextureDocument::width() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.width() : 0;
+    return d->size.width;
 }
 
 int TextureDocument::heigth() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.height() : 0;
+    return d->size.height;
 }
 
 int TextureDocument::depth() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.depth() : 0;
+    return d->size.depth;
 }
 
 int TextureDocument::levels() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.levels() : 0;
+    return d->arraySize.levels();
 }
 
 int TextureDocument::layers() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.layers() : 0;
+    return d->arraySize.layers();
 }
 
 int TextureDocument::faces() const
 {
     Q_D(const TextureDocument);
-    return !d->texture.isNull() ? d->texture.faces() : 0;
+    return d->arraySize.faces();
 }
 
 auto TextureDocument::item(int face, int level, int layer) const -> ItemPointer
 {
     Q_D(const TextureDocument);
 
-    if (d->texture.isNull())
+    if (d->items.empty())
         return {};
 
-    const auto index = d->texture.faces() * (d->texture.layers() * level + layer) + face;
-    return ItemPointer(d->items.at(index).get());
+    return ItemPointer(d->items.at(size_t(d->itemIndex(face, level, layer))).get());
+}
+
+/*!
+  \fn void TextureDocument::itemReady(int face, int level, int layer)
+  \brief This signal is emitted when the image of the item with the given \a face, \a level and
+  \a layer becomes available while the document is opening.
+
+  Textures are opened progressively. Once the header of the file is read, the format and the
+  dimensions are set and textureChanged() is emitted with a null texture, so views can lay out
+  the items. Their images become ready in the order they are stored in the file, see
+  Item::isReady(); the images that don't fit the free part of the TextureCache budget wait for
+  the whole texture. When the whole texture is read, textureChanged() is emitted again and the
+  remaining items become ready; the items themselves are kept.
+
+  The signal is also emitted when an image requested by requestImage() is reloaded.
+*/
+
+/*!
+  \brief Returns the preview of the texture that is being opened.
+
+  The preview is a small image of the texture, usually its smallest mip levels or a low
+  resolution image stored in the file, see TextureIO::readPreview(). It is read before the whole
+  texture, so views can paint it while the texture is loading. The preview is reset when opening
+  is finished or canceled; the previewChanged() signal is emitted when it changes.
+*/
+Texture TextureDocument::preview() const
+{
+    Q_D(const TextureDocument);
+    return d->preview;
+}
+
+/*!
+  \property QSize TextureDocument::thumbnailSize
+  \brief This property holds the maximum size of the item thumbnails.
+
+  Changing the size drops the existing thumbnails.
+
+  Default value is 128x128.
+*/
+
+QSize TextureDocument::thumbnailSize() const
+{
+    Q_D(const TextureDocument);
+    return d->thumbnailSize;
+}
+
+void TextureDocument::setThumbnailSize(QSize size)
+{
+    Q_D(TextureDocument);
+    if (d->thumbnailSize == size)
+        return;
+    d->cancelThumbnails();
+    d->thumbnailSize = size;
+    for (const auto &item: d->items)
+        item->thumbnail = QImage();
+    emit thumbnailSizeChanged(size);
+}
+
+/*!
+  \brief Schedules the thumbnail generation for the item with the given \a face, \a level and
+  \a layer.
+
+  The thumbnail is generated in a background thread; the thumbnailChanged() signal is emitted
+  when the Item::thumbnail is set. The most recent requests are processed first. Pending requests
+  are canceled when the texture changes.
+*/
+void TextureDocument::requestThumbnail(int face, int level, int layer)
+{
+    Q_D(TextureDocument);
+
+    if (d->items.empty() || d->thumbnailSize.isEmpty())
+        return;
+
+    const auto index = d->itemIndex(face, level, layer);
+    const auto &item = d->items.at(size_t(index));
+    if (!item->thumbnail.isNull() || d->thumbnailRequests.contains(index))
+        return;
+
+    // While the texture is opening, the thumbnail is made once the image is read
+    if (!item->isReady()) {
+        d->deferredThumbnails.insert(index);
+        return;
+    }
+    d->thumbnailRequests.insert(index);
+
+    const auto generation = d->thumbnailGeneration.load();
+    // The slice is used rather than the whole texture, so an evicted texture only reloads a level
+    const auto sliceKey = item->cacheKey;
+    const auto size = d->thumbnailSize;
+    auto key = d->thumbnailKey;
+    key.index = {Texture::Side(face), level, layer};
+    const auto job = [this, d, generation, sliceKey, key, size, face, level, layer, index]()
+    {
+        if (d->thumbnailGeneration.load() != generation)
+            return;
+        const auto thumbnailCache = !key.isNull() ? ThumbnailCache::instance() : nullptr;
+        auto image = thumbnailCache ? thumbnailCache->find(key, size) : QImage();
+        if (image.isNull()) {
+            const auto cache = TextureCache::instance();
+            const auto texture = cache ? cache->texture(sliceKey) : Texture();
+            image = Utils::makeThumbnail(texture, size);
+            if (thumbnailCache && !image.isNull())
+                thumbnailCache->insert(key, size, image);
+        }
+        const auto deliver = [this, d, generation, image, face, level, layer, index]()
+        {
+            if (d->thumbnailGeneration.load() != generation)
+                return;
+            if (image.isNull())
+                return; // keep the request, so unsupported formats are not retried
+            d->thumbnailRequests.remove(index);
+            d->items.at(size_t(index))->thumbnail = image;
+            emit thumbnailChanged(face, level, layer);
+        };
+        QMetaObject::invokeMethod(this, deliver, Qt::QueuedConnection);
+    };
+    d->thumbnailPool.start(new ThumbnailJob(job), d->thumbnailPriority++);
 }
 
+/*!
+  \brief Reloads the evicted image of the item with the given \a face, \a level and \a layer in
+  a background thread.
+
+  The itemReady() signal is emitted when the image is loaded. Views paint the resident images
+  and request the evicted ones, so the GUI thread does not wait for the file to be read, see
+  Item::isResident(). Does nothing if the image is resident or not ready yet.
+*/
+void TextureDocument::requestImage(int face, int level, int layer)
+{
+    Q_D(TextureDocument);
+
+    if (d->items.empty())
+        return;
+
+    const auto index = d->itemIndex(face, level, layer);
+    const auto &item = d->items.at(size_t(index));
+    if (!item->isReady() || item->isResident() || d->imageRequests.contains(index))
+        return;
+    d->imageRequests.insert(index);
+
+    const auto generation = d->thumbnailGeneration.load();
+    const auto sliceKey = item->cacheKey;
+    const auto job = [this, d, generation, sliceKey, face, level, layer, index]()
+    {
+        if (d->thumbnailGeneration.load() != generation)
+            return;
+        if (const auto cache = TextureCache::instance())
+            cache->texture(sliceKey);
+        const auto deliver = [this, d, generation, face, level, layer, index]()
+        {
+            if (d->thumbnailGeneration.load() != generation)
+                return;
+            d->imageRequests.remove(index);
+            emit itemReady(face, level, layer);
+        };
+        QMetaObject::invokeMethod(this, deliver, Qt::QueuedConnection);
+    };
+    d->thumbnailPool.start(new ThumbnailJob(job), d->thumbnailPriority++);
+}
+
+/*!
+  \property bool TextureDocument::converting
+  \brief This property holds whether the texture is being converted.
+
+  \sa convert()
+*/
+
+bool TextureDocument::isConverting() const
+{
+    Q_D(const TextureDocument);
+    return d->converting;
+}
+
+/*!
+  \brief Starts converting the texture to the given \a format and \a alignment.
+
+  The texture is converted in a background thread; the current texture stays in the document
+  until the converted one replaces it. convertStarted() is emitted when the conversion starts,
+  convertProgressChanged() reports its progress in percent and convertFinished() is emitted when
+  it is done; convertCanceled() is emitted instead if it is canceled. A running conversion is
+  canceled when a new one is started or the texture is changed.
+
+  Returns false if the conversion can't be started, for example, if the document has no texture.
+  If the texture already has the given format and alignment, returns true without starting
+  the conversion.
+*/
 bool TextureDocument::convert(TextureFormat format, Texture::Alignment alignment)
 {
     Q_D(TextureDocument);
-    if (d->texture.isNull()) {
+    if (!d->textureKey) {
         qCWarning(texturedocument) << "Can't convert null texture";
         return false;
     }
-    if (format == d->texture.format() && alignment == d->texture.alignment())
+    if (format == d->format && alignment == d->alignment)
         return true; // nothing to do
-    const auto converted = d->texture.convert(format, alignment);
+
+    cancelConvert();
+
+    const auto generation = d->convertGeneration.fetchAndAddOrdered(1) + 1;
+    const auto textureKey = d->textureKey;
+    const auto convertFunc = [this, d, textureKey, format, alignment, generation]() -> Texture
+    {
+        TraceSpan span("document", "TextureDocument::convert");
+        // An evicted texture is reloaded here rather than in the GUI thread
+        const auto cache = TextureCache::instance();
+        const auto texture = cache ? cache->texture(textureKey) : Texture();
+        if (texture.isNull())
+            return Texture();
+        // Progress is delivered in percent, so the document's thread is not flooded
+        int percent = -1;
+        const auto progress = [this, d, generation, &percent](qsizetype lines, qsizetype total)
+        {
+            if (d->convertGeneration.load() != generation)
+                return false;
+            const auto value = total ? int(lines * 100 / total) : 100;
+            if (value != percent) {
+                percent = value;
+                const auto deliver = [this, d, generation, value]()
+                {
+                    if (d->convertGeneration.load() == generation)
+                        emit convertProgressChanged(value);
+                };
+                QMetaObject::invokeMethod(this, deliver, Qt::QueuedConnection);
+            }
+            return true;
+        };
+        const auto converted = texture.convert(format, alignment, progress);
+        if (converted.isNull() && d->convertGeneration.load() == generation)
+            qCWarning(texturedocument) << "Can't convert texture";
+        return converted;
+    };
+
+    d->setConverting(true);
+    emit convertStarted();
+    emit convertProgressChanged(0);
+    d->convertWatcher->setFuture(QtConcurrent::run(&d->convertPool, convertFunc));
+    return true;
+}
+
+/*!
+  \brief Cancels the running conversion.
+
+  The conversion stops after the current band of lines and the texture is not changed.
+  convertCanceled() is emitted, convertFinished() is not.
+*/
+void TextureDocument::cancelConvert()
+{
+    Q_D(TextureDocument);
+    if (!d->converting)
+        return;
+    d->convertGeneration.fetchAndAddOrdered(1);
+    d->convertWatcher->future().cancel();
+    d->convertWatcher->setFuture(QFuture<Texture>());
+    d->setConverting(false);
+    emit convertCanceled();
+}
+
+/*!
+  \brief Waits until the running conversion is finished and applies its result.
+
+  Returns true if the texture was converted.
+*/
+bool TextureDocument::waitForConverted()
+{
+    Q_D(TextureDocument);
+    if (!d->converting)
+        return false;
+    d->convertWatcher->waitForFinished();
+    // The finished signal is queued, so the result is applied here
+    const auto converted = d->convertWatcher->future().result();
+    d->convertWatcher->setFuture(QFuture<Texture>());
+    d->setConverting(false);
     if (converted.isNull()) {
-        qCWarning(texturedocument) << "Can't convert texture";
+        emit convertFinished(false, tr("Can't convert texture"));
         return false;
     }
-    setTexture(converted);
+    d->setTexture(converted, {});
+    emit convertFinished(true, QString());
     return true;
 }
 
 void TextureDocument::doOpen(const QUrl &url)
 {
     Q_D(TextureDocument);
+    cancelConvert();
     beginOpen();
     if (!url.isLocalFile()) {
         endOpen(false, tr("Can't open non-local files"));
         return;
     }
 
-    const auto openFunc = [](QUrl url) -> TextureIO::ReadResult
+    // Runs the function in the document's thread unless the opening was canceled or restarted
+    const auto generation = d->openGeneration.fetchAndAddOrdered(1) + 1;
+    const auto deliver = [this, d, generation](std::function<void()> function)
+    {
+        const auto guarded = [this, d, generation, function = std::move(function)]()
+        {
+            if (d->openGeneration.load() == generation && state() == State::Opening)
+                function();
+        };
+        QMetaObject::invokeMethod(this, guarded, Qt::QueuedConnection);
+    };
+
+    // The copies of the images are pinned until the whole texture is read, so they only take
+    // the part of the budget that is free now; the rest of the images become ready at the end
+    const auto cache = TextureCache::instance();
+    const auto copyBudget = cache ? std::max<qint64>(0, cache->budget() - cache->statistics().bytes)
+                                  : qint64(0);
+
+    const auto openFunc = [d, deliver, copyBudget](QUrl url) -> TextureIO::ReadResult
     {
         const auto path = url.toLocalFile();
+        TraceSpan span("document", "TextureDocument::open");
+        span.setDetail(path);
         TextureIO io(path);
+        if (const auto preview = io.readPreview())
+            deliver([d, preview = *preview]() { d->setPreview(preview); });
+
+        // Only the description is passed to the document; the texture is not copied, so the
+        // handler keeps filling its data without detaching
+        io.setHeaderCallback([d, deliver, path](const Texture &texture)
+        {
+            const auto format = texture.format();
+            const auto alignment = texture.alignment();
+            const auto size = texture.size();
+            const auto arraySize = texture.arraySize();
+            deliver([d, format, alignment, size, arraySize, path]()
+            {
+                d->setHeader(format, alignment, size, arraySize, path);
+            });
+        });
+
+        // The last image comes with the whole texture, so it is not copied
+        io.setImageCallback([d, deliver, copyBudget, path, count = 0, copiedBytes = qint64(0)](
+                const Texture &texture, Texture::ArrayIndex index) mutable
+        {
+            if (++count == texture.faces() * texture.levels() * texture.layers())
+                return;
+            if (copiedBytes < 0)
+                return; // out of budget
+            const auto bytes = qint64(texture.bytesPerImage(index.level()));
+            if (copiedBytes + bytes > copyBudget) {
+                qCDebug(texturedocument) << "Not enough cache budget to show" << path
+                                         << "while it is opening, copied" << copiedBytes << "bytes";
+                copiedBytes = -1;
+                return;
+            }
+            copiedBytes += bytes;
+            auto image = TextureDocumentPrivate::makeSlice(texture, index);
+            if (!image.isNull())
+                deliver([d, index, image = std::move(image)]() { d->setImage(index, image); });
+        });
+
         return io.read();
     };
 
-    d->readWatcher->setFuture(QtConcurrent::run(openFunc, url));
+    d->readWatcher->setFuture(QtConcurrent::run(&d->openPool, openFunc, url));
 }
 
 void TextureDocument::doSave(const QUrl &url)
@@ -236,9 +998,12 @@ void TextureDocument::doSave(const QUrl &url)
         return;
     }
 
-    const auto texture = d->texture;
-    const auto saveFunc = [texture](QUrl url) -> TextureIO::WriteResult
+    // An evicted texture is reloaded in the saving thread
+    const auto textureKey = d->textureKey;
+    const auto saveFunc = [textureKey](QUrl url) -> TextureIO::WriteResult
     {
+        const auto cache = TextureCache::instance();
+        const auto texture = textureKey && cache ? cache->texture(textureKey) : Texture();
         const auto path = url.toLocalFile();
         TextureIO io(path);
         return io.write(texture);
@@ -256,6 +1021,10 @@ void TextureDocument::doCancel()
 {
     Q_D(TextureDocument);
     if (state() == State::Opening) {
+        d->openGeneration.fetchAndAddOrdered(1);
+        d->setPreview(Texture());
+        if (d->partial)
+            d->setTexture(Texture(), {});
         d->readWatcher->future().cancel();
         d->readWatcher->setFuture(QFuture<TextureIO::ReadResult>());
         openFinished(false, tr("Canceled"));
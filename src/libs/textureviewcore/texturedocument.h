@@ -3,6 +3,8 @@
 
 #include "textureviewcore_global.h"
 
+#include <TextureViewCoreLib/TextureCache>
+
 #include <TextureLib/Texture>
 
 #include <UtilsLib/AbstractDocument>
@@ -32,6 +34,10 @@ class TEXTUREVIEWCORE_EXPORT TextureDocument : public AbstractDocument
     Q_PROPERTY(TextureFormat format READ format NOTIFY formatChanged)
     Q_PROPERTY(Texture::Alignment alignment READ alignment NOTIFY alignmentChanged)
 
+    Q_PROPERTY(QSize thumbnailSize READ thumbnailSize WRITE setThumbnailSize NOTIFY thumbnailSizeChanged)
+
+    Q_PROPERTY(bool converting READ isConverting NOTIFY convertingChanged)
+
 public:
     class Item;
     using ItemPointer = ObserverPointer<Item>;
@@ -64,8 +70,29 @@ public:
     int faces() const;
 
     ItemPointer item(int face, int level, int layer) const;
+    void requestImage(int face, int level, int layer);
+    Q_SIGNAL void itemReady(int face, int level, int layer);
+
+    Texture preview() const;
+    Q_SIGNAL void previewChanged(const Texture &preview);
+
+    QSize thumbnailSize() const;
+    void setThumbnailSize(QSize size);
+    Q_SIGNAL void thumbnailSizeChanged(QSize size);
+
+    void requestThumbnail(int face, int level, int layer);
+    Q_SIGNAL void thumbnailChanged(int face, int level, int layer);
+
+    bool isConverting() const;
+    Q_SIGNAL void convertingChanged(bool converting);
 
     bool convert(TextureFormat format, Texture::Alignment alignment);
+    void cancelConvert();
+    bool waitForConverted();
+    Q_SIGNAL void convertStarted();
+    Q_SIGNAL void convertProgressChanged(int progress);
+    Q_SIGNAL void convertFinished(bool ok, const QString &error);
+    Q_SIGNAL void convertCanceled();
 
 signals:
     void textureChanged(const Texture &texture);
@@ -87,14 +114,29 @@ private:
     QScopedPointer<TextureDocumentPrivate> d_ptr;
 };
 
-class TextureDocument::Item
+class TEXTUREVIEWCORE_EXPORT TextureDocument::Item
 {
+    Q_DISABLE_COPY(Item)
 public:
+    Item() = default;
+    Item(Item &&) = delete;
+    ~Item();
+    Item &operator=(Item &&) = delete;
+
+    Texture texture() const;
+    bool isResident() const;
+    bool isReady() const;
+
     int level {0};
     int layer {0};
     int face {0};
-    Texture texture;
     QImage thumbnail;
+
+private:
+    TextureCache::Key cacheKey {0};
+
+    friend class TextureDocument;
+    friend class TextureDocumentPrivate;
 };
 
 } // namespace TextureViewer
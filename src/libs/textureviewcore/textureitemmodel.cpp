@@ -47,6 +47,8 @@ void TextureItemModel::setDocument(TextureItemModel::TextureDocumentPointer docu
     if (m_document) {
         connect(m_document.get(), &TextureDocument::textureChanged,
                 this, &TextureItemModel::updateItems);
+        connect(m_document.get(), &TextureDocument::thumbnailChanged,
+                this, &TextureItemModel::onThumbnailChanged);
     }
 
     updateItems();
@@ -107,7 +109,11 @@ QVariant TextureItemModel::data(const QModelIndex &index, int role) const
     if (role == Qt::DisplayRole) {
         return getDisplayRole(m_dimension, pos);
     } else if (role == Qt::DecorationRole) {
-        return m_items[size_t(pos)]->thumbnail;
+        const auto &item = m_items[size_t(pos)];
+        // Views only ask for the visible items, so those are generated first
+        if (item->thumbnail.isNull())
+            m_document->requestThumbnail(item->face, item->level, item->layer);
+        return item->thumbnail;
     }
 
     return QVariant();
@@ -131,6 +137,26 @@ int TextureItemModel::columnCount(const QModelIndex &parent) const
     return 1;
 }
 
+void TextureItemModel::onThumbnailChanged(int face, int level, int layer)
+{
+    int row = -1;
+    switch (m_dimension) {
+    case Dimension::Face:
+        row = level == m_level && layer == m_layer ? face : -1;
+        break;
+    case Dimension::Level:
+        row = face == m_face && layer == m_layer ? level : -1;
+        break;
+    case Dimension::Layer:
+        row = face == m_face && level == m_level ? layer : -1;
+        break;
+    }
+    if (row < 0 || row >= rowCount())
+        return;
+    const auto index = this->index(row);
+    emit dataChanged(index, index, {Qt::DecorationRole});
+}
+
 void TextureItemModel::updateItems()
 {
     beginResetModel();
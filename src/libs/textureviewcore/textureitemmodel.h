@@ -54,6 +54,7 @@ public: // QAbstractItemModel interface
 
 private:
     void updateItems();
+    void onThumbnailChanged(int face, int level, int layer);
 
 private:
     TextureDocumentPointer m_document;
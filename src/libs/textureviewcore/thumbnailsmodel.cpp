@@ -1,15 +1,30 @@
 #include "thumbnailsmodel.h"
 #include "thumbnailsmodel_p.h"
 
+#include <algorithm>
+
 namespace TextureViewer {
 
+namespace {
+
+// Children are created in batches as the view scrolls to them
+constexpr int fetchBatchSize = 256;
+
+} // namespace
+
 /*!
     \class ThumbnailsModel
+
+    The model is populated lazily: the children of an item are created by fetchMore() when a
+    view asks for them and labels are made in data(), so big texture arrays don't create the
+    whole layer/level/face tree up front. A texture change that keeps the number of layers,
+    levels and faces only refreshes the thumbnails instead of resetting the model.
 */
 
 ThumbnailsModel::ThumbnailsModel(QObject *parent) :
     QAbstractItemModel(parent),
-    m_rootItem(std::make_unique<Item>())
+    m_arena(std::make_unique<ItemArena>()),
+    m_rootItem(createRootItem())
 {
 }
 
@@ -23,7 +38,7 @@ int ThumbnailsModel::columnCount(const QModelIndex &parent) const
 
 int ThumbnailsModel::rowCount(const QModelIndex &parent) const
 {
-    return item(parent)->childCount();
+    return int(item(parent)->childCount());
 }
 
 QModelIndex ThumbnailsModel::index(int row, int column, const QModelIndex &parent) const
@@ -45,7 +60,48 @@ QModelIndex ThumbnailsModel::parent(const QModelIndex &index) const
     if (parentItem.get() == m_rootItem.get())
         return {};
 
-    return createIndex(parentItem->row(), 0, parentItem.get());
+    return createIndex(int(parentItem->row()), 0, parentItem.get());
+}
+
+bool ThumbnailsModel::hasChildren(const QModelIndex &parent) const
+{
+    return expectedChildCount(item(parent)) > 0;
+}
+
+bool ThumbnailsModel::canFetchMore(const QModelIndex &parent) const
+{
+    const auto item = this->item(parent);
+    return item->childCount() < expectedChildCount(item);
+}
+
+void ThumbnailsModel::fetchMore(const QModelIndex &parent)
+{
+    const auto item = this->item(parent);
+    const auto first = int(item->childCount());
+    const auto count = std::min(expectedChildCount(item) - first, fetchBatchSize);
+    if (count <= 0)
+        return;
+
+    if (first == 0)
+        item->reserve(expectedChildCount(item));
+    beginInsertRows(parent, first, first + count - 1);
+    for (int row = first; row < first + count; ++row) {
+        auto child = item->createChild();
+        child->depth = item->depth + 1;
+        child->position = item->position;
+        if (!m_dimensions.empty()) {
+            switch (m_dimensions[size_t(child->depth)]) {
+            case Dimension::Layer: child->position.layer = row; break;
+            case Dimension::Level: child->position.level = row; break;
+            case Dimension::Face: child->position.face = row; break;
+            }
+        }
+        if (isLeaf(child)) {
+            const auto &position = child->position;
+            m_leaves[std::make_tuple(position.face, position.level, position.layer)] = child;
+        }
+    }
+    endInsertRows();
 }
 
 QVariant ThumbnailsModel::data(const QModelIndex &index, int role) const
@@ -55,7 +111,17 @@ QVariant ThumbnailsModel::data(const QModelIndex &index, int role) const
 
     auto item = this->item(index);
     if (role == Qt::DisplayRole || role == Qt::EditRole) {
-        return item->text;
+        return text(item);
+    } else if (role == Qt::DecorationRole) {
+        const auto &position = item->position;
+        if (!m_document || !isLeaf(item))
+            return QVariant();
+        const auto documentItem = m_document->item(position.face, position.level, position.layer);
+        if (!documentItem)
+            return QVariant();
+        if (documentItem->thumbnail.isNull())
+            m_document->requestThumbnail(position.face, position.level, position.layer);
+        return documentItem->thumbnail;
     } else if (role == IndexRole) {
         return QVariant::fromValue(item->index);
     }
@@ -65,7 +131,8 @@ QVariant ThumbnailsModel::data(const QModelIndex &index, int role) const
 
 ThumbnailsModel::Position ThumbnailsModel::position(QModelIndex index) const
 {
-    return item(index)->position;
+    const auto item = this->item(index);
+    return isLeaf(item) ? item->position : Position{-1, -1, -1, -1};
 }
 
 void ThumbnailsModel::setDocument(const TextureDocumentPointer &document)
@@ -81,14 +148,16 @@ void ThumbnailsModel::setDocument(const TextureDocumentPointer &document)
 
     if (m_document) {
         connect(m_document.get(), &TextureDocument::textureChanged,
-                this, static_cast<void (ThumbnailsModel::*)()>(&ThumbnailsModel::rebuildModel));
+                this, &ThumbnailsModel::onTextureChanged);
+        connect(m_document.get(), &TextureDocument::thumbnailChanged,
+                this, &ThumbnailsModel::onThumbnailChanged);
     }
     rebuildModel();
 }
 
 QModelIndex ThumbnailsModel::index(ThumbnailsModel::Item *item) const
 {
-    return createIndex(item->row(), 0, item);
+    return createIndex(int(item->row()), 0, item);
 }
 
 auto ThumbnailsModel::item(QModelIndex index) const -> ItemPointer
@@ -99,61 +168,94 @@ auto ThumbnailsModel::item(QModelIndex index) const -> ItemPointer
     return ObserverPointer<Item>(m_rootItem.get());
 }
 
-void ThumbnailsModel::rebuildModel()
+// A texture without layers, levels and faces is shown as a single "Image" leaf
+bool ThumbnailsModel::isLeaf(ItemPointer item) const
 {
-    beginResetModel();
-    m_rootItem = std::make_unique<Item>();
-    rebuildModel(ItemPointer(m_rootItem.get()));
-    endResetModel();
+    if (item.get() == m_rootItem.get())
+        return false;
+    return item->depth + 1 >= std::max(1, int(m_dimensions.size()));
 }
 
-void ThumbnailsModel::rebuildModel(ItemPointer parent)
+int ThumbnailsModel::expectedChildCount(ItemPointer item) const
 {
-    if (m_document->layers() <= 1) {
-        rebuildModel(parent, 0);
-    } else {
-        for (int i = 0; i < m_document->layers(); i++) {
-            auto item = parent->createChild();
-            item->text = tr("Image %1").arg(i);
-            rebuildModel(item, i);
-        }
-    }
+    const auto isEmpty = [](int size) { return size <= 0; };
+    if (std::any_of(m_shape.begin(), m_shape.end(), isEmpty) || isLeaf(item))
+        return 0;
+    if (m_dimensions.empty())
+        return 1;
+    return m_shape[size_t(m_dimensions[size_t(item->depth + 1)])];
 }
 
-void ThumbnailsModel::rebuildModel(ItemPointer parent, int layer)
+QString ThumbnailsModel::text(ItemPointer item) const
 {
-    if (m_document->levels() == 1) {
-        rebuildModel(parent, layer, 0);
-    } else {
-        for (int i = 0; i < m_document->levels(); ++i) {
-            auto item = parent->createChild();
-            item->text = tr("Mipmap %1").arg(i);
-            rebuildModel(item, layer, i);
-        }
+    if (m_dimensions.empty())
+        return tr("Image");
+    const auto &position = item->position;
+    switch (m_dimensions[size_t(item->depth)]) {
+    case Dimension::Layer: return tr("Image %1").arg(position.layer);
+    case Dimension::Level: return tr("Mipmap %1").arg(position.level);
+    case Dimension::Face: return tr("Face %1").arg(position.face);
     }
+    return {};
 }
 
-void ThumbnailsModel::rebuildModel(ItemPointer parent, int layer, int level)
+auto ThumbnailsModel::documentShape() const -> Shape
 {
-    if (m_document->faces() == 1) {
-        rebuildModel(parent, layer, level, 0);
-    } else {
-        for (int i = 0; i < m_document->faces(); ++i) {
-            auto item = parent->createChild();
-            item->text = tr("Face %1").arg(i);
-            rebuildModel(item, layer, level, i);
-        }
+    if (!m_document)
+        return {};
+    return {m_document->layers(), m_document->levels(), m_document->faces()};
+}
+
+// The root is not allocated from the arena, so the tree can be replaced while the arena stays
+auto ThumbnailsModel::createRootItem() const -> std::unique_ptr<Item>
+{
+    auto result = std::make_unique<Item>();
+    result->setArena(m_arena.get());
+    return result;
+}
+
+void ThumbnailsModel::rebuildModel()
+{
+    beginResetModel();
+    m_leaves.clear();
+    m_rootItem = createRootItem();
+    m_shape = documentShape();
+    m_dimensions.clear();
+    for (const auto dimension: {Dimension::Layer, Dimension::Level, Dimension::Face}) {
+        if (m_shape[size_t(dimension)] > 1)
+            m_dimensions.push_back(dimension);
     }
+    endResetModel();
 }
 
-void ThumbnailsModel::rebuildModel(ItemPointer parent, int layer, int level, int face)
+void ThumbnailsModel::onTextureChanged()
 {
-    auto item = parent;
-    if (item.get() == m_rootItem.get()) {
-        auto item = parent->createChild();
-        item->text = tr("Image");
+    if (documentShape() != m_shape) {
+        rebuildModel();
+        return;
     }
-    item->position = {layer, level, face, 0};
+    // Same tree, only the thumbnails of the fetched items are outdated
+    updateThumbnails(ItemPointer(m_rootItem.get()));
+}
+
+void ThumbnailsModel::onThumbnailChanged(int face, int level, int layer)
+{
+    const auto it = m_leaves.find(std::make_tuple(face, level, layer));
+    if (it == m_leaves.end())
+        return;
+    const auto index = this->index(it->second.get());
+    emit dataChanged(index, index, {Qt::DecorationRole});
+}
+
+void ThumbnailsModel::updateThumbnails(ItemPointer parent)
+{
+    if (parent->childCount() == 0)
+        return;
+    emit dataChanged(index(parent->children().front().get()),
+                     index(parent->children().back().get()),
+                     {Qt::DecorationRole});
+    for (const auto &child: parent->children())
+        updateThumbnails(ItemPointer(child.get()));
 }
 
 } // namespace TextureViewer
@@ -7,7 +7,13 @@
 
 #include <QtCore/QAbstractItemModel>
 
+#include <array>
+#include <map>
 #include <memory>
+#include <tuple>
+#include <vector>
+
+template <typename T> class TreeModelItemArena;
 
 namespace TextureViewer {
 
@@ -40,6 +46,10 @@ public:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
     QModelIndex parent(const QModelIndex &index = QModelIndex()) const override;
 
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
     Position position(QModelIndex index) const;
@@ -50,17 +60,29 @@ public:
 private:
     class Item;
     using ItemPointer = ObserverPointer<Item>;
+    using ItemArena = TreeModelItemArena<Item>;
+
+    enum class Dimension { Layer, Level, Face };
+    using Shape = std::array<int, 3>; // indexed by Dimension
 
     QModelIndex index(Item *item) const;
     ItemPointer item(QModelIndex index) const;
+    bool isLeaf(ItemPointer item) const;
+    int expectedChildCount(ItemPointer item) const;
+    QString text(ItemPointer item) const;
+    Shape documentShape() const;
+    std::unique_ptr<Item> createRootItem() const;
     void rebuildModel();
-    void rebuildModel(ItemPointer parent);
-    void rebuildModel(ItemPointer parent, int level);
-    void rebuildModel(ItemPointer parent, int layer, int level);
-    void rebuildModel(ItemPointer parent, int layer, int level, int face);
+    void onTextureChanged();
+    void onThumbnailChanged(int face, int level, int layer);
+    void updateThumbnails(ItemPointer parent);
 
 private:
+    std::unique_ptr<ItemArena> m_arena; // outlives the items
     std::unique_ptr<Item> m_rootItem;
+    std::map<std::tuple<int, int, int>, ItemPointer> m_leaves; // (face, level, layer) -> item
+    Shape m_shape {};
+    std::vector<Dimension> m_dimensions; // tree levels, from the top, only the ones with size > 1
     TextureDocumentPointer m_document { nullptr };
 };
 
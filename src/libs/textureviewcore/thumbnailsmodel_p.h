@@ -12,9 +12,10 @@ class ThumbnailsModel::Item : public TreeModelItem<ThumbnailsModel::Item>
 public:
     using Position = ThumbnailsModel::Position;
 
-    QString text;
     QPair<int, int> index;
-    Position position {-1, -1, -1, -1};
+    // Coordinates of the item; the ones below the item's dimension are 0
+    Position position;
+    int depth {-1}; // index of the item's dimension in the model, -1 for the root
 };
 
 } // namespace TextureViewer
@@ -3,9 +3,90 @@
 
 #include <ObserverPointer>
 
+#include <algorithm>
 #include <memory>
+#include <new>
+#include <utility>
 #include <vector>
 
+// Allocates tree items in blocks and reuses the freed ones; must outlive the items it created
+template <typename T>
+class TreeModelItemArena
+{
+public:
+    explicit TreeModelItemArena(qsizetype blockSize = 256) noexcept
+        : m_blockSize(std::max<qsizetype>(1, blockSize))
+    {}
+
+    TreeModelItemArena(const TreeModelItemArena &) = delete;
+    TreeModelItemArena(TreeModelItemArena &&) = delete;
+    ~TreeModelItemArena() = default;
+
+    TreeModelItemArena &operator=(const TreeModelItemArena &) = delete;
+    TreeModelItemArena &operator=(TreeModelItemArena &&) = delete;
+
+    template <typename... Args>
+    T *create(Args &&...args)
+    {
+        Slot *slot = nullptr;
+        if (!m_free.empty()) {
+            slot = m_free.back();
+            m_free.pop_back();
+        } else {
+            if (m_blocks.empty() || m_used == m_blockSize) {
+                m_blocks.push_back(std::make_unique<Slot[]>(size_t(m_blockSize)));
+                m_used = 0;
+            }
+            slot = &m_blocks.back()[size_t(m_used++)];
+        }
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T *item) noexcept
+    {
+        if (!item)
+            return;
+        item->~T();
+        m_free.push_back(reinterpret_cast<Slot *>(item));
+    }
+
+private:
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    qsizetype m_blockSize {0};
+    qsizetype m_used {0};
+    std::vector<std::unique_ptr<Slot[]>> m_blocks;
+    std::vector<Slot *> m_free;
+};
+
+// Deletes items that come from an arena or from new; std::unique_ptr<T> converts to it
+template <typename T>
+class TreeModelItemDeleter
+{
+public:
+    constexpr TreeModelItemDeleter() noexcept = default;
+    constexpr TreeModelItemDeleter(std::default_delete<T>) noexcept {}
+    constexpr explicit TreeModelItemDeleter(TreeModelItemArena<T> *arena) noexcept
+        : m_arena(arena)
+    {}
+
+    void operator()(T *item) const noexcept
+    {
+        if (m_arena)
+            m_arena->destroy(item);
+        else
+            delete item;
+    }
+
+private:
+    TreeModelItemArena<T> *m_arena {nullptr};
+};
+
+// Each item keeps its row in the parent, so row() and thus QAbstractItemModel::parent() are O(1);
+// inserting and removing renumber the following siblings
 template <typename T>
 class TreeModelItem
 {
@@ -13,8 +94,9 @@ public:
     using Derived = T;
     using Base = TreeModelItem<T>;
 
+    using Arena = TreeModelItemArena<Derived>;
     using ItemObserverPointer = ObserverPointer<Derived>;
-    using ItemUniquePointer = std::unique_ptr<Derived>;
+    using ItemUniquePointer = std::unique_ptr<Derived, TreeModelItemDeleter<Derived>>;
 
     TreeModelItem() noexcept = default;
 
@@ -25,22 +107,25 @@ public:
     TreeModelItem &operator=(const TreeModelItem &) = delete;
     TreeModelItem &operator=(TreeModelItem &&) noexcept = default;
 
+    // Children created by createChild() are allocated from the arena and inherit it
+    Arena *arena() const noexcept { return m_arena; }
+    void setArena(Arena *arena) noexcept { m_arena = arena; }
+
     ItemObserverPointer createChild(qsizetype row = -1)
     {
-        insert(row == - 1 ? childCount() : row, std::make_unique<Derived>());
-        return ItemObserverPointer(m_children.back().get());
+        if (row == -1)
+            row = childCount();
+        auto item = m_arena
+                ? ItemUniquePointer(m_arena->create(), TreeModelItemDeleter<Derived>(m_arena))
+                : ItemUniquePointer(new Derived);
+        item->m_arena = m_arena;
+        insert(row, std::move(item));
+        return child(row);
     }
 
     ItemObserverPointer parent() const noexcept { return m_parent; }
 
-    qsizetype row() const noexcept
-    {
-        if (!m_parent)
-            return 0;
-        const auto pred = [this](const ItemUniquePointer &p) { return this == p.get(); };
-        const auto it = std::find_if(m_parent->m_children.begin(), m_parent->m_children.end(), pred);
-        return {it - m_parent->m_children.begin()};
-    }
+    qsizetype row() const noexcept { return m_row; }
 
     std::vector<ItemUniquePointer> &children() noexcept { return m_children; }
     const std::vector<ItemUniquePointer> &children() const noexcept { return m_children; }
@@ -52,6 +137,8 @@ public:
 
     qsizetype childCount() const noexcept { return qsizetype(m_children.size()); }
 
+    void reserve(qsizetype count) { m_children.reserve(size_t(count)); }
+
     void append(ItemUniquePointer item) { insert(childCount(), std::move(item)); }
 
     void insert(qsizetype row, ItemUniquePointer item)
@@ -59,24 +146,34 @@ public:
         Q_ASSERT(row >= 0 && row <= childCount());
         item->m_parent = ItemObserverPointer(static_cast<Derived *>(this));
         m_children.insert(m_children.begin() + row, std::move(item));
+        renumber(row);
     }
 
     void remove(ItemObserverPointer item)
     {
-        const auto pred = [item](const ItemUniquePointer &p) { return item.get() == p.get(); };
-        const auto it = std::find_if(m_children.begin(), m_children.end(), pred);
-        if (it != m_children.end())
-            m_children.erase(it);
+        if (!item || item->m_parent.get() != this)
+            return;
+        remove(item->m_row);
     }
 
     void remove(qsizetype row)
     {
-        Q_ASSERT(row >= 0 && row <= childCount());
+        Q_ASSERT(row >= 0 && row < childCount());
         m_children.erase(m_children.begin() + row);
+        renumber(row);
+    }
+
+private:
+    void renumber(qsizetype first) noexcept
+    {
+        for (auto row = first; row < childCount(); ++row)
+            m_children[size_t(row)]->m_row = row;
     }
 
 private:
     ItemObserverPointer m_parent;
+    qsizetype m_row {0};
+    Arena *m_arena {nullptr};
     std::vector<ItemUniquePointer> m_children;
 };
 
@@ -44,18 +44,32 @@
 
 #include "ddsheader.h"
 
+#include <TextureLib/DeviceCursor>
 #include <TextureLib/Texture>
 #include <TextureLib/TextureIOHandlerPlugin>
+#include <TextureLib/Tracing>
 
 #include <QtCore/QDebug>
 #include <QtCore/QtMath>
 
 #include <gsl/span>
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
 namespace {
 
 constexpr auto maxInt = std::numeric_limits<int>::max();
 
+constexpr qint64 headerSize = 4 + DDSHeader::ddsSize; // with magic
+constexpr qint64 headerDX10Size = 20;
+
+// Subresources smaller than this are batched into reads and writes of this size
+constexpr qint64 ioBlockSize = 4 * 1024 * 1024;
+
 constexpr DDSCaps2Flag faceFlags[6] = {
     DDSCaps2Flag::CubeMapPositiveX,
     DDSCaps2Flag::CubeMapNegativeX,
@@ -465,25 +479,107 @@ bool verifyHeaderDX10(const DDSHeaderDX10 &header)
     return true;
 }
 
-} // namespace
+// Contiguous data that is read at once and the number of images in it
+struct Run
+{
+    Texture::Data data;
+    int images {0};
+};
 
-bool DDSHandler::read(Texture &texture)
+// Appends the image to the list merging it with the previous run if they are adjacent in memory
+// and the run is still smaller than ioBlockSize
+void appendRun(std::vector<Run> &runs, Texture::Data image)
 {
-    if (device()->peek(4) != QByteArrayLiteral("DDS "))
+    if (!runs.empty()
+            && runs.back().data.size() < ioBlockSize
+            && runs.back().data.data() + runs.back().data.size() == image.data()) {
+        auto &run = runs.back();
+        run.data = Texture::Data(run.data.data(), run.data.size() + image.size());
+        ++run.images;
+    } else {
+        runs.push_back({image, 1});
+    }
+}
+
+// Streams data to the device with few large writes: data adjacent in memory is merged, small
+// pieces are gathered in a staging buffer and large ones are written directly
+class BlockWriter
+{
+public:
+    explicit BlockWriter(DDSHandler::QIODevicePointer device) : m_device(device) {}
+
+    bool write(const uchar *data, qint64 size)
+    {
+        if (m_pendingSize && m_pending + m_pendingSize == data) {
+            m_pendingSize += size;
+            return true;
+        }
+        if (!commit())
+            return false;
+        m_pending = data;
+        m_pendingSize = size;
+        return true;
+    }
+
+    bool write(Texture::ConstData data) { return write(data.data(), data.size()); }
+
+    bool finish() { return commit() && flush(); }
+
+private:
+    bool commit()
+    {
+        const auto size = std::exchange(m_pendingSize, 0);
+        if (size == 0)
+            return true;
+        if (m_staged + size > ioBlockSize && !flush())
+            return false;
+        if (size >= ioBlockSize)
+            return writeDevice(reinterpret_cast<const char *>(m_pending), size);
+        if (!m_staging)
+            m_staging = std::make_unique<char[]>(size_t(ioBlockSize));
+        memcpy(m_staging.get() + m_staged, m_pending, size_t(size));
+        m_staged += size;
+        return true;
+    }
+
+    bool flush()
+    {
+        return writeDevice(m_staging.get(), std::exchange(m_staged, 0));
+    }
+
+    bool writeDevice(const char *data, qint64 size)
+    {
+        if (size == 0 || m_device->write(data, size) == size)
+            return true;
+        qCWarning(ddshandler) << "Can't write to device:" << m_device->errorString();
         return false;
+    }
 
-    DDSHeader header;
-    DDSHeaderDX10 header10;
+    DDSHandler::QIODevicePointer m_device;
+    const uchar *m_pending {nullptr};
+    qint64 m_pendingSize {0};
+    std::unique_ptr<char[]> m_staging;
+    qint64 m_staged {0};
+};
 
+// Reads and verifies the header and the DX10 header if there is one
+bool readHeader(DeviceCursor &cursor, DDSHeader &header, DDSHeaderDX10 &header10)
+{
     {
-        QDataStream s(device().get());
+        auto headerData = cursor.read(headerSize);
+        QDataStream s(headerData);
         s.setByteOrder(QDataStream::LittleEndian);
         s >> header;
-        if (isDX10(header))
-            s >> header10;
+        if (s.status() == QDataStream::Ok && isDX10(header)) {
+            const auto headerData10 = cursor.read(headerDX10Size);
+            QDataStream s10(headerData10);
+            s10.setByteOrder(QDataStream::LittleEndian);
+            s10 >> header10;
+            s.setStatus(s10.status());
+        }
 
         if (s.status() != QDataStream::Ok) {
-            qCWarning(ddshandler) << "Can't read header: data stream status =" << s.status();
+            qCWarning(ddshandler) << "Can't read header:" << cursor.errorString();
             return false;
         }
     }
@@ -494,6 +590,25 @@ bool DDSHandler::read(Texture &texture)
     if (isDX10(header) && !verifyHeaderDX10(header10))
         return false;
 
+    return true;
+}
+
+} // namespace
+
+bool DDSHandler::read(Texture &texture)
+{
+    TraceSpan span("handler", "DDSHandler::read");
+
+    if (device()->peek(4) != QByteArrayLiteral("DDS "))
+        return false;
+
+    DDSHeader header;
+    DDSHeaderDX10 header10;
+
+    DeviceCursor cursor(device().get(), ioBlockSize);
+    if (!readHeader(cursor, header, header10))
+        return false;
+
     const auto udepth = isVolumeMap(header) ? std::max(1u, header.depth) : 1u;
     const auto ulayers = std::max(1u, header10.arraySize);
     const auto ulevels = std::max(1u, header.mipMapCount);
@@ -514,6 +629,8 @@ bool DDSHandler::read(Texture &texture)
         return false;
     }
 
+    headerRead(result);
+
     const auto pitch = Texture::calculateBytesPerLine(textureFormat, int(header.width));
 
     if (header.pitchOrLinearSize && pitch != header.pitchOrLinearSize) {
@@ -521,6 +638,14 @@ bool DDSHandler::read(Texture &texture)
                             << pitch << "!=" << header.pitchOrLinearSize;
     }
 
+    TraceSpan payloadSpan("handler", "DDSHandler::readPayload");
+
+    // The file stores layers, then faces, then levels; images that are adjacent in the texture
+    // memory as well are merged into reads of at least ioBlockSize. Images are reported after
+    // each read, so a big image is still read at once while the small levels are batched
+    std::vector<Texture::ArrayIndex> indexes;
+    std::vector<Run> runs;
+    qint64 payloadSize = 0;
     for (int layer = 0; layer < int(ulayers); ++layer) {
         for (int face = 0; face < faces; ++face) {
             if (cubeMap && !(header.caps2 & gsl::at(faceFlags, face))) {
@@ -528,59 +653,143 @@ bool DDSHandler::read(Texture &texture)
             }
 
             for (int level = 0; level < int(ulevels); ++level) {
-                const auto data = result.imageData({Texture::Side(face), level, layer});
-                const auto read = device()->read(reinterpret_cast<char *>(data.data()), data.size());
-                if (read != data.size()) {
-                    qCWarning(ddshandler) << "Can't read from file:" << device()->errorString();
-                    return false;
-                }
+                const auto index = Texture::ArrayIndex(Texture::Side(face), level, layer);
+                const auto data = result.imageData(index);
+                indexes.push_back(index);
+                appendRun(runs, data);
+                payloadSize += data.size();
             }
         }
     }
 
+    // Smaller images are scattered from large reads that never go past the payload
+    cursor.setLimit(cursor.pos() + payloadSize);
+    cursor.adviseSequential(payloadSize);
+    auto index = indexes.cbegin();
+    for (const auto &run: runs) {
+        if (!cursor.read(run.data)) {
+            qCWarning(ddshandler) << "Can't read from file:" << cursor.errorString();
+            return false;
+        }
+        for (const auto end = index + run.images; index != end; ++index)
+            imageRead(result, *index);
+    }
+
     texture = std::move(result);
 
     return true;
 }
 
-bool DDSHandler::write(const Texture &texture)
+/*!
+    Reads the first image of the largest level that fits into previewSize(). The file stores the
+    levels of the first image first, so only the bigger levels of that image are skipped.
+*/
+bool DDSHandler::readPreview(Texture &texture)
 {
-    if (texture.layers() > 1) {
-        qCWarning(ddshandler) << "Writing layers are not supported";
+    TraceSpan span("handler", "DDSHandler::readPreview");
+
+    if (device()->peek(4) != QByteArrayLiteral("DDS "))
+        return false;
+
+    DDSHeader header;
+    DDSHeaderDX10 header10;
+
+    DeviceCursor cursor(device().get());
+    if (!readHeader(cursor, header, header10))
         return false;
+
+    const auto textureFormat = getFormat(header, header10);
+    if (textureFormat == TextureFormat::Invalid)
+        return false;
+
+    // Cubemaps may omit faces, the first stored one is used
+    if (isCubeMap(header)) {
+        const auto flags = gsl::span<const DDSCaps2Flag>(faceFlags);
+        if (std::none_of(flags.begin(), flags.end(),
+                         [&header](DDSCaps2Flag flag) { return bool(header.caps2 & flag); })) {
+            qCWarning(ddshandler) << "Cubemap has no faces";
+            return false;
+        }
     }
 
-    if (texture.depth() > 1) {
-        qCWarning(ddshandler) << "Writing volume maps are not supported";
+    const auto size = Texture::Size(
+            int(header.width),
+            int(header.height),
+            isVolumeMap(header) ? int(std::max(1u, header.depth)) : 1);
+    const auto level = previewLevel(size, int(std::max(1u, header.mipMapCount)));
+    if (level < 0) {
+        qCDebug(ddshandler) << "No level fits into the preview size";
         return false;
     }
 
-    if (texture.faces() > 1) {
-        qCWarning(ddshandler) << "Writing cube maps are not supported";
+    qint64 offset = 0;
+    for (int bigger = 0; bigger < level; ++bigger) {
+        offset += Texture::calculateBytesPerSlice(
+                        textureFormat,
+                        std::max<qsizetype>(1, size.width >> bigger),
+                        std::max<qsizetype>(1, size.height >> bigger))
+                * std::max<qsizetype>(1, size.depth >> bigger);
+    }
+
+    auto result = Texture(
+            textureFormat,
+            {std::max<qsizetype>(1, size.width >> level),
+             std::max<qsizetype>(1, size.height >> level),
+             std::max<qsizetype>(1, size.depth >> level)});
+    if (result.isNull()) {
+        qCWarning(ddshandler) << "Can't create texture";
         return false;
     }
 
-    const auto copy = texture.convert(Texture::Alignment::Byte);
+    if (!cursor.skip(offset) || !cursor.read(result.imageData({}))) {
+        qCWarning(ddshandler) << "Can't read from file:" << cursor.errorString();
+        return false;
+    }
 
-    QDataStream s(device().get());
-    s.setByteOrder(QDataStream::LittleEndian);
+    texture = std::move(result);
+    return true;
+}
+
+bool DDSHandler::write(const Texture &texture)
+{
+    TraceSpan span("handler", "DDSHandler::write");
+
+    if (texture.layers() > 1 && texture.depth() > 1) {
+        qCWarning(ddshandler) << "Writing arrays of volume maps is not supported";
+        return false;
+    }
 
     DDSHeader dds;
     DDSHeaderDX10 dds10;
     // Filling header
     dds.flags = DDSFlag::Caps | DDSFlag::Height |
                 DDSFlag::Width | DDSFlag::PixelFormat;
-    dds.height = quint32(copy.height());
-    dds.width = quint32(copy.width());
+    dds.height = quint32(texture.height());
+    dds.width = quint32(texture.width());
     dds.depth = 0;
-    dds.mipMapCount = quint32(copy.levels() > 1 ? copy.levels() : 0);
+    dds.mipMapCount = quint32(texture.levels() > 1 ? texture.levels() : 0);
     dds.caps = DDSCapsFlag::Texture;
-    if (copy.levels() > 1)
-        dds.caps |= DDSCapsFlag::Mipmap;
+    if (texture.levels() > 1) {
+        dds.flags |= DDSFlag::MipmapCount;
+        dds.caps |= DDSCapsFlag::Mipmap | DDSCapsFlag::Complex;
+    }
+    if (texture.faces() > 1) {
+        dds.caps |= DDSCapsFlag::Complex;
+        dds.caps2 |= DDSCaps2Flag::CubeMap;
+        for (const auto flag: faceFlags)
+            dds.caps2 |= flag;
+    }
+    if (texture.depth() > 1) {
+        dds.flags |= DDSFlag::Depth;
+        dds.depth = quint32(texture.depth());
+        dds.caps |= DDSCapsFlag::Complex;
+        dds.caps2 |= DDSCaps2Flag::Volume;
+    }
 
     // TODO (abbapoh): Invert priority to almost always write DX10 files
+    // Arrays can only be described by the DX10 header
     const auto &info = getFormatInfo(texture.format());
-    if (info.format == TextureFormat::Invalid) {
+    if (info.format == TextureFormat::Invalid || texture.layers() > 1) {
         const auto format = convertFormat(texture.format());
         if (format == DXGIFormat::UNKNOWN) {
             qCWarning(ddshandler()) << "Unsupported format" << texture.format();
@@ -591,6 +800,11 @@ bool DDSHandler::write(const Texture &texture)
         dds.pixelFormat.flags = DDSPixelFormatFlag::FourCC;
 
         dds10.dxgiFormat = quint32(format);
+        dds10.resourceDimension = quint32(texture.depth() > 1
+                ? DDSResourceDimension::Texture3D
+                : DDSResourceDimension::Texture2D);
+        dds10.miscFlag = texture.faces() > 1 ? quint32(DDSResourceMiscFlag::TextureCube) : 0;
+        // number of cubes for cube maps
         dds10.arraySize = quint32(texture.layers());
     } else {
         dds.pixelFormat.fourCC = 0;
@@ -604,27 +818,50 @@ bool DDSHandler::write(const Texture &texture)
     }
 
     dds.pitchOrLinearSize =
-            quint32(Texture::calculateBytesPerLine(copy.format(), copy.width()));
+            quint32(Texture::calculateBytesPerLine(texture.format(), texture.width()));
 
-    s << dds;
+    // The header is written with the first block of the payload
+    QByteArray headerData;
+    {
+        QDataStream s(&headerData, QIODevice::WriteOnly);
+        s.setByteOrder(QDataStream::LittleEndian);
+        s << dds;
 
-    if (isDX10(dds))
-        s << dds10;
+        if (isDX10(dds))
+            s << dds10;
+    }
 
-    for (int layer = 0; layer < copy.layers(); ++layer) {
-        for (int face = 0; face < copy.faces(); ++face) {
-            for (int level = 0; level < copy.levels(); ++level) {
-                const auto data = copy.imageData({Texture::Side(face), level, layer});
-                const auto writen = device()->write(reinterpret_cast<const char *>(data.data()), data.size());
-                if (writen != data.size()) {
-                    qCWarning(ddshandler) << "Can't write to device:" << device()->errorString();
-                    return false;
+    TraceSpan payloadSpan("handler", "DDSHandler::writePayload");
+
+    BlockWriter writer(device());
+    if (!writer.write(reinterpret_cast<const uchar *>(headerData.constData()), headerData.size()))
+        return false;
+
+    // Subresources are streamed in the file order: layers, then faces, then levels. DDS rows are
+    // tightly packed, rows of textures with a bigger alignment are realigned one by one
+    for (int layer = 0; layer < texture.layers(); ++layer) {
+        for (int face = 0; face < texture.faces(); ++face) {
+            for (int level = 0; level < texture.levels(); ++level) {
+                const auto data = texture.constImageData({Texture::Side(face), level, layer});
+                const auto lineSize = texture.bytesPerLine(level);
+                const auto packedLineSize =
+                        Texture::calculateBytesPerLine(texture.format(), texture.width(level));
+                if (lineSize == packedLineSize) {
+                    if (!writer.write(data))
+                        return false;
+                    continue;
+                }
+
+                const auto lines = data.size() / lineSize;
+                for (qsizetype line = 0; line < lines; ++line) {
+                    if (!writer.write(data.data() + line * lineSize, packedLineSize))
+                        return false;
                 }
             }
         }
     }
 
-    return true;
+    return writer.finish();
 }
 
 gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> DDSHandler::formatCapabilites()
@@ -63,6 +63,7 @@ public:
 
 public: // ImageIOHandler interface
     bool read(Texture &texture) override;
+    bool readPreview(Texture &texture) override;
     bool write(const Texture &texture) override;
 
 public:
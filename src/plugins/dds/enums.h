@@ -86,6 +86,19 @@ enum class DDSCaps2Flag : quint32 {
 Q_DECLARE_FLAGS(DDSCaps2Flags, DDSCaps2Flag)
 Q_DECLARE_OPERATORS_FOR_FLAGS(DDSCaps2Flags)
 
+// DX10 header values
+enum class DDSResourceDimension : quint32 {
+    Unknown   = 0,
+    Buffer    = 1,
+    Texture1D = 2,
+    Texture2D = 3,
+    Texture3D = 4
+};
+
+enum class DDSResourceMiscFlag : quint32 {
+    TextureCube = 0x4
+};
+
 enum class DXGIFormat : quint32 {
     UNKNOWN                     ,
     R32G32B32A32_TYPELESS       ,
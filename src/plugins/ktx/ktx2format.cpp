@@ -0,0 +1,206 @@
+#include "ktx2format.h"
+
+#include <QtCore/QDataStream>
+
+namespace {
+
+using Kind = Ktx2Format::Kind;
+
+// KHR_DF_MODEL_*
+constexpr quint8 rgbsda = 1;
+constexpr quint8 bc1a = 128;
+constexpr quint8 bc2 = 129;
+constexpr quint8 bc3 = 130;
+constexpr quint8 bc4 = 131;
+constexpr quint8 bc5 = 132;
+constexpr quint8 bc6h = 133;
+constexpr quint8 bc7 = 134;
+constexpr quint8 etc2 = 161;
+
+// KHR_DF_CHANNEL_*; the same values are reused by the block-compressed models
+constexpr quint8 red = 0;
+constexpr quint8 green = 1;
+constexpr quint8 blue = 2;
+constexpr quint8 alpha = 15;
+constexpr quint8 color = 0;
+constexpr quint8 alphaPresent = 1; // BC1A
+constexpr quint8 etc2Color = 2;
+
+// KHR_DF_SAMPLE_DATATYPE_*
+constexpr quint8 linearQualifier = 0x10;
+constexpr quint8 signedQualifier = 0x40;
+constexpr quint8 floatQualifier = 0x80;
+
+// KHR_DF_PRIMARIES_BT709, KHR_DF_TRANSFER_LINEAR and KHR_DF_TRANSFER_SRGB
+constexpr quint8 primariesBT709 = 1;
+constexpr quint8 transferLinear = 1;
+constexpr quint8 transferSrgb = 2;
+
+constexpr Ktx2Format formats[] = {
+    // format, vkFormat, model, kind, srgb, blockBytes, blockDimension, typeSize, samples
+    { TextureFormat::R8_Unorm, 9, rgbsda, Kind::Unorm, false, 1, 1, 1, 1, {{red, 0, 8}} },
+    { TextureFormat::R8_Snorm, 10, rgbsda, Kind::Snorm, false, 1, 1, 1, 1, {{red, 0, 8}} },
+    { TextureFormat::RG8_Unorm, 16, rgbsda, Kind::Unorm, false, 2, 1, 1, 2,
+      {{red, 0, 8}, {green, 8, 8}} },
+    { TextureFormat::RG8_Snorm, 17, rgbsda, Kind::Snorm, false, 2, 1, 1, 2,
+      {{red, 0, 8}, {green, 8, 8}} },
+    { TextureFormat::RGB8_Unorm, 23, rgbsda, Kind::Unorm, false, 3, 1, 1, 3,
+      {{red, 0, 8}, {green, 8, 8}, {blue, 16, 8}} },
+    { TextureFormat::BGR8_Unorm, 30, rgbsda, Kind::Unorm, false, 3, 1, 1, 3,
+      {{blue, 0, 8}, {green, 8, 8}, {red, 16, 8}} },
+    { TextureFormat::RGBA8_Unorm, 37, rgbsda, Kind::Unorm, false, 4, 1, 1, 4,
+      {{red, 0, 8}, {green, 8, 8}, {blue, 16, 8}, {alpha, 24, 8}} },
+    { TextureFormat::RGBA8_Snorm, 38, rgbsda, Kind::Snorm, false, 4, 1, 1, 4,
+      {{red, 0, 8}, {green, 8, 8}, {blue, 16, 8}, {alpha, 24, 8}} },
+    { TextureFormat::RGBA8_Srgb, 43, rgbsda, Kind::Unorm, true, 4, 1, 1, 4,
+      {{red, 0, 8}, {green, 8, 8}, {blue, 16, 8}, {alpha, 24, 8}} },
+    { TextureFormat::BGRA8_Unorm, 44, rgbsda, Kind::Unorm, false, 4, 1, 1, 4,
+      {{blue, 0, 8}, {green, 8, 8}, {red, 16, 8}, {alpha, 24, 8}} },
+    { TextureFormat::BGRA8_Srgb, 50, rgbsda, Kind::Unorm, true, 4, 1, 1, 4,
+      {{blue, 0, 8}, {green, 8, 8}, {red, 16, 8}, {alpha, 24, 8}} },
+    { TextureFormat::R16_Unorm, 70, rgbsda, Kind::Unorm, false, 2, 1, 2, 1, {{red, 0, 16}} },
+    { TextureFormat::R16_Float, 76, rgbsda, Kind::Float, false, 2, 1, 2, 1, {{red, 0, 16}} },
+    { TextureFormat::RG16_Unorm, 77, rgbsda, Kind::Unorm, false, 4, 1, 2, 2,
+      {{red, 0, 16}, {green, 16, 16}} },
+    { TextureFormat::RG16_Float, 83, rgbsda, Kind::Float, false, 4, 1, 2, 2,
+      {{red, 0, 16}, {green, 16, 16}} },
+    { TextureFormat::RGBA16_Unorm, 91, rgbsda, Kind::Unorm, false, 8, 1, 2, 4,
+      {{red, 0, 16}, {green, 16, 16}, {blue, 32, 16}, {alpha, 48, 16}} },
+    { TextureFormat::RGBA16_Float, 97, rgbsda, Kind::Float, false, 8, 1, 2, 4,
+      {{red, 0, 16}, {green, 16, 16}, {blue, 32, 16}, {alpha, 48, 16}} },
+    { TextureFormat::R32_Float, 100, rgbsda, Kind::Float, false, 4, 1, 4, 1, {{red, 0, 32}} },
+    { TextureFormat::RG32_Float, 103, rgbsda, Kind::Float, false, 8, 1, 4, 2,
+      {{red, 0, 32}, {green, 32, 32}} },
+    { TextureFormat::RGB32_Float, 106, rgbsda, Kind::Float, false, 12, 1, 4, 3,
+      {{red, 0, 32}, {green, 32, 32}, {blue, 64, 32}} },
+    { TextureFormat::RGBA32_Float, 109, rgbsda, Kind::Float, false, 16, 1, 4, 4,
+      {{red, 0, 32}, {green, 32, 32}, {blue, 64, 32}, {alpha, 96, 32}} },
+
+    { TextureFormat::Bc1Rgb_Unorm, 131, bc1a, Kind::Unorm, false, 8, 4, 1, 1, {{color, 0, 64}} },
+    { TextureFormat::Bc1Rgb_Srgb, 132, bc1a, Kind::Unorm, true, 8, 4, 1, 1, {{color, 0, 64}} },
+    { TextureFormat::Bc1Rgba_Unorm, 133, bc1a, Kind::Unorm, false, 8, 4, 1, 1,
+      {{alphaPresent, 0, 64}} },
+    { TextureFormat::Bc1Rgba_Srgb, 134, bc1a, Kind::Unorm, true, 8, 4, 1, 1,
+      {{alphaPresent, 0, 64}} },
+    { TextureFormat::Bc2_Unorm, 135, bc2, Kind::Unorm, false, 16, 4, 1, 2,
+      {{alpha, 0, 64}, {color, 64, 64}} },
+    { TextureFormat::Bc2_Srgb, 136, bc2, Kind::Unorm, true, 16, 4, 1, 2,
+      {{alpha, 0, 64}, {color, 64, 64}} },
+    { TextureFormat::Bc3_Unorm, 137, bc3, Kind::Unorm, false, 16, 4, 1, 2,
+      {{alpha, 0, 64}, {color, 64, 64}} },
+    { TextureFormat::Bc3_Srgb, 138, bc3, Kind::Unorm, true, 16, 4, 1, 2,
+      {{alpha, 0, 64}, {color, 64, 64}} },
+    { TextureFormat::Bc4_Unorm, 139, bc4, Kind::Unorm, false, 8, 4, 1, 1, {{red, 0, 64}} },
+    { TextureFormat::Bc4_Snorm, 140, bc4, Kind::Snorm, false, 8, 4, 1, 1, {{red, 0, 64}} },
+    { TextureFormat::Bc5_Unorm, 141, bc5, Kind::Unorm, false, 16, 4, 1, 2,
+      {{red, 0, 64}, {green, 64, 64}} },
+    { TextureFormat::Bc5_Snorm, 142, bc5, Kind::Snorm, false, 16, 4, 1, 2,
+      {{red, 0, 64}, {green, 64, 64}} },
+    { TextureFormat::Bc6HUF16, 143, bc6h, Kind::UFloat, false, 16, 4, 1, 1, {{color, 0, 128}} },
+    { TextureFormat::Bc6HSF16, 144, bc6h, Kind::Float, false, 16, 4, 1, 1, {{color, 0, 128}} },
+    { TextureFormat::Bc7_Unorm, 145, bc7, Kind::Unorm, false, 16, 4, 1, 1, {{color, 0, 128}} },
+    { TextureFormat::Bc7_Srgb, 146, bc7, Kind::Unorm, true, 16, 4, 1, 1, {{color, 0, 128}} },
+
+    { TextureFormat::RGB8_ETC2, 147, etc2, Kind::Unorm, false, 8, 4, 1, 1, {{etc2Color, 0, 64}} },
+    { TextureFormat::RGB8_PunchThrough_Alpha1_ETC2, 149, etc2, Kind::Unorm, false, 8, 4, 1, 2,
+      {{etc2Color, 0, 64}, {alpha, 0, 64}} },
+    { TextureFormat::RGBA8_ETC2_EAC, 151, etc2, Kind::Unorm, false, 16, 4, 1, 2,
+      {{alpha, 0, 64}, {etc2Color, 64, 64}} },
+    { TextureFormat::R11_EAC_UNorm, 153, etc2, Kind::Unorm, false, 8, 4, 1, 1, {{red, 0, 64}} },
+    { TextureFormat::R11_EAC_SNorm, 154, etc2, Kind::Snorm, false, 8, 4, 1, 1, {{red, 0, 64}} },
+    { TextureFormat::RG11_EAC_UNorm, 155, etc2, Kind::Unorm, false, 16, 4, 1, 2,
+      {{red, 0, 64}, {green, 64, 64}} },
+    { TextureFormat::RG11_EAC_SNorm, 156, etc2, Kind::Snorm, false, 16, 4, 1, 2,
+      {{red, 0, 64}, {green, 64, 64}} },
+};
+
+using Formats = gsl::span<const Ktx2Format>;
+
+// Values of the sampleLower and sampleUpper fields of a sample
+std::pair<quint32, quint32> sampleRange(const Ktx2Format &format, const Ktx2Format::Sample &sample)
+{
+    const auto bits = format.isCompressed() ? 32 : int(sample.bitLength);
+    switch (format.kind) {
+    case Kind::Unorm:
+        return {0, bits >= 32 ? 0xffffffffu : (1u << bits) - 1};
+    case Kind::Snorm: {
+        const auto upper = bits >= 32 ? 0x7fffffffu : (1u << (bits - 1)) - 1;
+        return {quint32(-qint32(upper)), upper};
+    }
+    case Kind::Float:
+        return {0xbf800000u, 0x3f800000u}; // -1.0f, 1.0f
+    case Kind::UFloat:
+        return {0, 0x3f800000u};
+    }
+    return {0, 0};
+}
+
+} // namespace
+
+const Ktx2Format *Ktx2Format::find(TextureFormat format) noexcept
+{
+    for (const auto &info: Formats(formats)) {
+        if (info.format == format)
+            return &info;
+    }
+    return nullptr;
+}
+
+const Ktx2Format *Ktx2Format::find(quint32 vkFormat) noexcept
+{
+    for (const auto &info: Formats(formats)) {
+        if (info.vkFormat == vkFormat)
+            return &info;
+    }
+    return nullptr;
+}
+
+gsl::span<const Ktx2Format> Ktx2Format::allFormats() noexcept
+{
+    return formats;
+}
+
+/*!
+    Returns the data format descriptor with a single basic descriptor block for the given
+    \a format, including the leading dfdTotalSize field.
+*/
+QByteArray dataFormatDescriptor(const Ktx2Format &format, bool supercompressed)
+{
+    const auto blockSize = quint32(24 + 16 * format.sampleCount);
+
+    QByteArray result;
+    QDataStream s(&result, QIODevice::WriteOnly);
+    s.setByteOrder(QDataStream::LittleEndian);
+
+    s << quint32(4 + blockSize); // dfdTotalSize
+    s << quint32(0); // vendorId = KHR, descriptorType = basic
+    s << quint32(2 | blockSize << 16); // versionNumber = 1.3
+    s << quint8(format.colorModel)
+      << quint8(primariesBT709)
+      << quint8(format.srgb ? transferSrgb : transferLinear)
+      << quint8(0); // flags: straight alpha
+    const auto dimension = quint8(format.blockDimension - 1);
+    s << dimension << dimension << quint8(0) << quint8(0);
+    // Sizes of the planes are unknown for supercompressed data
+    s << quint8(supercompressed ? 0 : format.blockBytes) << quint8(0) << quint8(0) << quint8(0);
+    s << quint32(0);
+
+    for (int i = 0; i < format.sampleCount; ++i) {
+        const auto &sample = format.samples[i];
+        auto channelType = sample.channel;
+        if (format.kind == Kind::Snorm || format.kind == Kind::Float)
+            channelType |= signedQualifier;
+        if (format.kind == Kind::Float || format.kind == Kind::UFloat)
+            channelType |= floatQualifier;
+        if (format.srgb && sample.channel == alpha)
+            channelType |= linearQualifier;
+
+        const auto range = sampleRange(format, sample);
+        s << quint32(sample.bitOffset | quint32(sample.bitLength - 1) << 16 | quint32(channelType) << 24);
+        s << quint32(0); // samplePosition
+        s << range.first;
+        s << range.second;
+    }
+
+    return result;
+}
@@ -0,0 +1,43 @@
+#ifndef KTX2FORMAT_H
+#define KTX2FORMAT_H
+
+#include <TextureLib/TextureFormat>
+
+#include <QtCore/QByteArray>
+
+#include <gsl/span>
+
+// Mapping between TextureFormat, VkFormat and the Khronos Data Format Descriptor
+struct Ktx2Format
+{
+    enum class Kind : quint8 { Unorm, Snorm, Float, UFloat };
+
+    // Channel of the descriptor sample, bitOffset and bitLength are in bits
+    struct Sample
+    {
+        quint8 channel {0};
+        quint16 bitOffset {0};
+        quint8 bitLength {0};
+    };
+
+    TextureFormat format {TextureFormat::Invalid};
+    quint32 vkFormat {0};
+    quint8 colorModel {0};
+    Kind kind {Kind::Unorm};
+    bool srgb {false};
+    quint8 blockBytes {0}; // bytes per texel or per compressed block
+    quint8 blockDimension {1}; // 4 for block-compressed formats
+    quint8 typeSize {1};
+    quint8 sampleCount {0};
+    Sample samples[4] {};
+
+    constexpr bool isCompressed() const noexcept { return blockDimension > 1; }
+
+    static const Ktx2Format *find(TextureFormat format) noexcept;
+    static const Ktx2Format *find(quint32 vkFormat) noexcept;
+    static gsl::span<const Ktx2Format> allFormats() noexcept;
+};
+
+QByteArray dataFormatDescriptor(const Ktx2Format &format, bool supercompressed);
+
+#endif // KTX2FORMAT_H
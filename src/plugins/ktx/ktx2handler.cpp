@@ -0,0 +1,582 @@
+#include "ktx2handler.h"
+#include "ktx2format.h"
+
+#include <TextureLib/DeviceCursor>
+#include <TextureLib/Texture>
+#include <TextureLib/Tracing>
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <QtCore/QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+constexpr auto maxInt = quint32(std::numeric_limits<int>::max());
+constexpr quint32 maxLevels = 32;
+
+constexpr qint64 alignUp(qint64 value, qint64 alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool writeData(Ktx2Handler::QIODevicePointer device, const char *data, qint64 size)
+{
+    if (size == 0)
+        return true;
+
+    const auto written = device->write(data, size);
+    if (written != size)
+        qCWarning(ktx2handler) << "Can't write to device:" << device->errorString();
+    return written == size;
+}
+
+bool writePaddingTo(Ktx2Handler::QIODevicePointer device, qint64 base, qint64 offset)
+{
+    const auto padding = offset - (device->pos() - base);
+    Q_ASSERT(padding >= 0);
+    return writeData(device, QByteArray(int(padding), '\0').constData(), padding);
+}
+
+bool verifyHeader(const Ktx2Header &header)
+{
+    if (!std::equal(std::begin(header.identifier), std::end(header.identifier),
+                    std::begin(Ktx2::identifier))) {
+        qCWarning(ktx2handler) << "Invalid identifier";
+        return false;
+    }
+
+    const auto scheme = Ktx2::Supercompression(header.supercompressionScheme);
+    if (scheme != Ktx2::Supercompression::None && scheme != Ktx2::Supercompression::Zlib) {
+        qCWarning(ktx2handler) << "Unsupported supercompression scheme:"
+                               << header.supercompressionScheme;
+        return false;
+    }
+
+    if (!header.pixelWidth || header.pixelWidth > maxInt
+            || header.pixelHeight > maxInt || header.pixelDepth > maxInt) {
+        qCWarning(ktx2handler) << "Invalid size:" << header.pixelWidth
+                               << "x" << header.pixelHeight << "x" << header.pixelDepth;
+        return false;
+    }
+
+    if (header.faceCount != 1 && header.faceCount != 6) {
+        qCWarning(ktx2handler) << "Number of faces is invalid:" << header.faceCount;
+        return false;
+    }
+
+    if (header.layerCount > maxInt) {
+        qCWarning(ktx2handler) << "Number of layers is too big:" << header.layerCount;
+        return false;
+    }
+
+    if (header.levelCount > maxLevels) {
+        qCWarning(ktx2handler) << "Number of levels is too big:" << header.levelCount;
+        return false;
+    }
+
+    return true;
+}
+
+// Size of an image without the row padding, as stored in KTX2
+qsizetype packedImageSize(const Texture &texture, int level)
+{
+    return Texture::calculateBytesPerSlice(
+            texture.format(), texture.width(level), texture.height(level))
+            * texture.depth(level);
+}
+
+// Copies the image to dst removing the row padding
+void packImage(const Texture &texture, int level, Texture::ConstData image, char *dst)
+{
+    const auto lineSize = texture.bytesPerLine(level);
+    const auto packedLineSize = Texture::calculateBytesPerLine(texture.format(), texture.width(level));
+    if (lineSize == packedLineSize) {
+        memcpy(dst, image.data(), size_t(image.size()));
+        return;
+    }
+    const auto lines = image.size() / lineSize;
+    for (qsizetype line = 0; line < lines; ++line)
+        memcpy(dst + line * packedLineSize, image.data() + line * lineSize, size_t(packedLineSize));
+}
+
+QByteArray keyValueData(const Texture &texture)
+{
+    // Keys are sorted by their byte values
+    const QByteArray pairs[] = {
+        QByteArrayLiteral("KTXorientation") + '\0'
+                + (texture.depth() > 1 ? QByteArrayLiteral("rdi") : QByteArrayLiteral("rd")) + '\0',
+        QByteArrayLiteral("KTXwriter") + '\0' + QByteArrayLiteral("textureviewer") + '\0',
+    };
+
+    QByteArray result;
+    QDataStream s(&result, QIODevice::WriteOnly);
+    s.setByteOrder(QDataStream::LittleEndian);
+    for (const auto &pair: pairs) {
+        s << quint32(pair.size());
+        s.writeRawData(pair.constData(), pair.size());
+        const auto padding = QByteArray(3 - (pair.size() + 3) % 4, '\0');
+        s.writeRawData(padding.constData(), padding.size());
+    }
+    return result;
+}
+
+// A level to be decompressed; images are taken upfront, so the parallel part does not touch the
+// texture itself
+struct LevelJob
+{
+    QByteArray data; // qCompress format: 4-byte big-endian size followed by the zlib stream
+    std::vector<Texture::Data> images;
+    bool ok {true};
+};
+
+void decompress(LevelJob &job)
+{
+    const auto uncompressed = qUncompress(job.data);
+    job.data.clear();
+
+    const auto expected = std::accumulate(job.images.begin(), job.images.end(), qsizetype(0),
+            [](qsizetype sum, Texture::Data image) { return sum + image.size(); });
+    if (uncompressed.size() != expected) {
+        job.ok = false;
+        return;
+    }
+
+    auto source = uncompressed.constData();
+    for (const auto image: job.images) {
+        memcpy(image.data(), source, size_t(image.size()));
+        source += image.size();
+    }
+}
+
+} // namespace
+
+bool Ktx2Handler::read(Texture &texture)
+{
+    TraceSpan span("handler", "Ktx2Handler::read");
+
+    if (!readIndex())
+        return false;
+
+    auto result = createTexture(0, int(m_levelIndex.size()));
+    if (result.isNull())
+        return false;
+
+    headerRead(result);
+
+    if (!readLevels(result, 0))
+        return false;
+
+    texture = std::move(result);
+
+    return true;
+}
+
+/*!
+    Reads the given mip \a level into the \a texture, seeking directly to its data using the level
+    index. The result has the size of that level and a single level.
+
+    The header is parsed on the first call, so levels can be loaded on demand, for example, the
+    smallest one first. Requires a random-access device unless levels are read in the file order
+    (smallest first).
+*/
+bool Ktx2Handler::readLevel(int level, Texture &texture)
+{
+    TraceSpan span("handler", "Ktx2Handler::readLevel");
+
+    if (!readIndex())
+        return false;
+
+    if (level < 0 || level >= int(m_levelIndex.size())) {
+        qCWarning(ktx2handler) << "Invalid level:" << level;
+        return false;
+    }
+
+    auto result = createTexture(level, 1);
+    if (result.isNull())
+        return false;
+
+    if (!readLevels(result, level))
+        return false;
+
+    texture = std::move(result);
+
+    return true;
+}
+
+/*!
+    Reads the first image of the largest level that fits into previewSize() using readLevel().
+*/
+bool Ktx2Handler::readPreview(Texture &texture)
+{
+    TraceSpan span("handler", "Ktx2Handler::readPreview");
+
+    if (!readIndex())
+        return false;
+
+    const auto size = Texture::Size(
+            int(m_header.pixelWidth),
+            std::max(1, int(m_header.pixelHeight)),
+            std::max(1, int(m_header.pixelDepth)));
+    const auto level = previewLevel(size, int(m_levelIndex.size()));
+    if (level < 0) {
+        qCDebug(ktx2handler) << "No level fits into the preview size";
+        return false;
+    }
+
+    Texture levelTexture;
+    if (!readLevel(level, levelTexture))
+        return false;
+
+    if (levelTexture.faces() == 1 && levelTexture.layers() == 1) {
+        texture = std::move(levelTexture);
+        return true;
+    }
+
+    auto result = Texture(levelTexture.format(), levelTexture.size(), {1, 1});
+    if (result.isNull()) {
+        qCWarning(ktx2handler) << "Can't create texture";
+        return false;
+    }
+    const auto image = levelTexture.constImageData({});
+    memcpy(result.imageData({}).data(), image.data(), size_t(image.size()));
+
+    texture = std::move(result);
+    return true;
+}
+
+bool Ktx2Handler::readIndex()
+{
+    if (m_indexRead)
+        return true;
+
+    DeviceCursor cursor(device().get());
+    m_base = cursor.pos();
+
+    const auto headerData = cursor.read(Ktx2::headerSize);
+    if (headerData.size() != Ktx2::headerSize) {
+        qCWarning(ktx2handler) << "Can't read header:" << cursor.errorString();
+        return false;
+    }
+
+    QDataStream s(headerData);
+    s.setByteOrder(QDataStream::LittleEndian);
+    s >> m_header;
+
+    qCDebug(ktx2handler) << "header:" << m_header;
+
+    if (!verifyHeader(m_header))
+        return false;
+
+    m_format = Ktx2Format::find(m_header.vkFormat);
+    if (!m_format) {
+        qCWarning(ktx2handler) << "Unsupported format:" << m_header.vkFormat;
+        return false;
+    }
+
+    // levelCount == 0 asks to generate the mipmaps, only the base level is stored
+    m_levelIndex.resize(std::max<size_t>(1, m_header.levelCount));
+    const auto indexData = cursor.read(qint64(m_levelIndex.size()) * Ktx2::levelIndexEntrySize);
+    QDataStream indexStream(indexData);
+    indexStream.setByteOrder(QDataStream::LittleEndian);
+    for (auto &entry: m_levelIndex)
+        indexStream >> entry;
+
+    if (indexStream.status() != QDataStream::Ok) {
+        qCWarning(ktx2handler) << "Can't read level index:" << cursor.errorString();
+        return false;
+    }
+
+    // Levels are allocated by their byteLength, so it can't exceed the device
+    if (!device()->isSequential()) {
+        const auto available = quint64(std::max<qint64>(0, device()->size() - m_base));
+        for (size_t level = 0; level < m_levelIndex.size(); ++level) {
+            const auto &entry = m_levelIndex[level];
+            if (entry.byteOffset > available || entry.byteLength > available - entry.byteOffset) {
+                qCWarning(ktx2handler) << "Level" << level << "is out of bounds:"
+                                       << entry.byteOffset << "+" << entry.byteLength
+                                       << ">" << available;
+                return false;
+            }
+        }
+    }
+
+    m_indexRead = true;
+    return true;
+}
+
+Texture Ktx2Handler::createTexture(int baseLevel, int levels) const
+{
+    const auto size = Texture::Size(
+            std::max(1, int(m_header.pixelWidth) >> baseLevel),
+            std::max(1, int(m_header.pixelHeight) >> baseLevel),
+            std::max(1, int(m_header.pixelDepth) >> baseLevel));
+    const auto arraySize = Texture::ArraySize(
+            Texture::IsCubemap(m_header.faceCount == 6),
+            levels,
+            std::max(1, int(m_header.layerCount)));
+
+    // KTX2 rows are tightly packed
+    auto result = Texture(m_format->format, size, arraySize, Texture::Alignment::Byte);
+    if (result.isNull()) {
+        qCWarning(ktx2handler) << "Can't create texture";
+        return Texture();
+    }
+    if (result.levels() != levels) {
+        qCWarning(ktx2handler) << "Number of levels is too big:" << m_header.levelCount;
+        return Texture();
+    }
+    return result;
+}
+
+bool Ktx2Handler::readLevels(Texture &texture, int baseLevel)
+{
+    TraceSpan span("handler", "Ktx2Handler::readPayload");
+
+    const auto zlib = Ktx2::Supercompression(m_header.supercompressionScheme)
+            == Ktx2::Supercompression::Zlib;
+
+    // Levels are usually stored smallest first; reading them in the file order lets sequential
+    // devices skip forward only
+    std::vector<int> levels(size_t(texture.levels()));
+    std::iota(levels.begin(), levels.end(), 0);
+    std::sort(levels.begin(), levels.end(), [this, baseLevel](int lhs, int rhs) {
+        return m_levelIndex[size_t(baseLevel + lhs)].byteOffset
+                < m_levelIndex[size_t(baseLevel + rhs)].byteOffset;
+    });
+
+    // Only the images of the whole texture are reported, the indexes of a single level are relative
+    const auto notify = [this, &texture, baseLevel](Texture::ArrayIndex index)
+    {
+        if (baseLevel == 0 && texture.levels() == int(m_levelIndex.size()))
+            imageRead(texture, index);
+        else
+            hashImageData(texture, index);
+    };
+
+    DeviceCursor cursor(device().get());
+    std::vector<LevelJob> jobs;
+    jobs.reserve(levels.size());
+    for (const auto level: levels) {
+        const auto &entry = m_levelIndex[size_t(baseLevel + level)];
+
+        LevelJob job;
+        qsizetype expected = 0;
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            for (int face = 0; face < texture.faces(); ++face) {
+                job.images.push_back(texture.imageData({Texture::Side(face), level, layer}));
+                expected += job.images.back().size();
+            }
+        }
+
+        const auto length = zlib ? entry.uncompressedByteLength : entry.byteLength;
+        if (length != quint64(expected)) {
+            qCWarning(ktx2handler) << "Invalid size of level" << baseLevel + level << ":"
+                                   << length << "!=" << expected;
+            return false;
+        }
+
+        if (!cursor.seek(m_base + qint64(entry.byteOffset))) {
+            qCWarning(ktx2handler) << "Can't seek to level" << baseLevel + level << ":"
+                                   << cursor.errorString();
+            return false;
+        }
+
+        if (!zlib) {
+            for (int layer = 0; layer < texture.layers(); ++layer) {
+                for (int face = 0; face < texture.faces(); ++face) {
+                    const auto index = Texture::ArrayIndex(Texture::Side(face), level, layer);
+                    if (!cursor.read(texture.imageData(index))) {
+                        qCWarning(ktx2handler) << "Can't read from device:" << cursor.errorString();
+                        return false;
+                    }
+                    notify(index);
+                }
+            }
+            continue;
+        }
+
+        if (entry.byteLength > maxInt - 4 || quint64(expected) > maxInt) {
+            qCWarning(ktx2handler) << "Level" << baseLevel + level << "is too big";
+            return false;
+        }
+        job.data.resize(int(entry.byteLength) + 4);
+        qToBigEndian(quint32(expected), job.data.data());
+        if (!cursor.read(job.data.data() + 4, qint64(entry.byteLength))) {
+            qCWarning(ktx2handler) << "Can't read from device:" << cursor.errorString();
+            return false;
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    // Levels are compressed independently, so they are decompressed in parallel
+    QtConcurrent::blockingMap(jobs, decompress);
+    if (!std::all_of(jobs.begin(), jobs.end(), [](const LevelJob &job) { return job.ok; })) {
+        qCWarning(ktx2handler) << "Can't decompress level data";
+        return false;
+    }
+
+    // Supercompressed images are reported once they are decompressed
+    if (zlib) {
+        for (const auto level: levels) {
+            for (int layer = 0; layer < texture.layers(); ++layer) {
+                for (int face = 0; face < texture.faces(); ++face)
+                    notify({Texture::Side(face), level, layer});
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Ktx2Handler::write(const Texture &texture)
+{
+    TraceSpan span("handler", "Ktx2Handler::write");
+
+    const auto format = Ktx2Format::find(texture.format());
+    if (!format) {
+        qCWarning(ktx2handler) << "Unsupported format" << texture.format();
+        return false;
+    }
+
+    const auto zlib = compression() > 0;
+    const auto levels = texture.levels();
+    const auto base = device()->pos();
+
+    Ktx2Header header;
+    std::copy(std::begin(Ktx2::identifier), std::end(Ktx2::identifier), header.identifier);
+    header.vkFormat = format->vkFormat;
+    header.typeSize = format->typeSize;
+    header.pixelWidth = quint32(texture.width());
+    header.pixelHeight = quint32(texture.height());
+    header.pixelDepth = texture.depth() > 1 ? quint32(texture.depth()) : 0;
+    header.layerCount = texture.layers() > 1 ? quint32(texture.layers()) : 0;
+    header.faceCount = quint32(texture.faces());
+    header.levelCount = quint32(levels);
+    header.supercompressionScheme = quint32(zlib
+            ? Ktx2::Supercompression::Zlib
+            : Ktx2::Supercompression::None);
+
+    const auto dfd = dataFormatDescriptor(*format, zlib);
+    const auto kvd = keyValueData(texture);
+    header.dfdByteOffset = quint32(Ktx2::headerSize + levels * Ktx2::levelIndexEntrySize);
+    header.dfdByteLength = quint32(dfd.size());
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = quint32(kvd.size());
+
+    // Level data is computed before the index; compressing only keeps compressed levels in memory
+    std::vector<QByteArray> compressed(size_t(levels));
+    if (zlib) {
+        TraceSpan compressSpan("handler", "Ktx2Handler::compress");
+        std::vector<int> indexes(size_t(levels));
+        std::iota(indexes.begin(), indexes.end(), 0);
+        const auto compress = [&texture, &compressed, level = compression()](int index)
+        {
+            const auto imageSize = packedImageSize(texture, index);
+            auto packed = QByteArray(int(imageSize * texture.faces() * texture.layers()), '\0');
+            auto dst = packed.data();
+            for (int layer = 0; layer < texture.layers(); ++layer) {
+                for (int face = 0; face < texture.faces(); ++face) {
+                    const auto image = texture.constImageData({Texture::Side(face), index, layer});
+                    packImage(texture, index, image, dst);
+                    dst += imageSize;
+                }
+            }
+            compressed[size_t(index)] = qCompress(packed, level);
+        };
+        const auto tooBig = packedImageSize(texture, 0) * texture.faces() * texture.layers()
+                > qsizetype(maxInt);
+        if (tooBig) {
+            qCWarning(ktx2handler) << "Texture is too big for zlib supercompression";
+            return false;
+        }
+        QtConcurrent::blockingMap(indexes, compress);
+    }
+
+    // Mip levels are stored from the smallest to the largest
+    const auto alignment = zlib ? qint64(1) : std::lcm(qint64(format->blockBytes), qint64(4));
+    std::vector<Ktx2LevelIndex> levelIndex(size_t(levels));
+    auto offset = qint64(header.kvdByteOffset + header.kvdByteLength);
+    for (int level = levels - 1; level >= 0; --level) {
+        auto &entry = levelIndex[size_t(level)];
+        const auto uncompressed =
+                packedImageSize(texture, level) * texture.faces() * texture.layers();
+        offset = alignUp(offset, alignment);
+        entry.byteOffset = quint64(offset);
+        entry.byteLength = quint64(zlib ? compressed[size_t(level)].size() - 4 : uncompressed);
+        entry.uncompressedByteLength = quint64(uncompressed);
+        offset += qint64(entry.byteLength);
+    }
+
+    {
+        QDataStream s(device().get());
+        s.setByteOrder(QDataStream::LittleEndian);
+        s << header;
+        for (const auto &entry: levelIndex)
+            s << entry;
+
+        if (s.status() != QDataStream::Ok) {
+            qCWarning(ktx2handler) << "Can't write header: data stream status =" << s.status();
+            return false;
+        }
+    }
+
+    if (!writeData(device(), dfd.constData(), dfd.size())
+            || !writeData(device(), kvd.constData(), kvd.size())) {
+        return false;
+    }
+
+    TraceSpan payloadSpan("handler", "Ktx2Handler::writePayload");
+    QByteArray staging;
+    for (int level = levels - 1; level >= 0; --level) {
+        if (!writePaddingTo(device(), base, qint64(levelIndex[size_t(level)].byteOffset)))
+            return false;
+
+        if (zlib) {
+            const auto &data = compressed[size_t(level)];
+            if (!writeData(device(), data.constData() + 4, data.size() - 4))
+                return false;
+            continue;
+        }
+
+        // Images are written straight from the storage unless rows are padded
+        const auto padded = texture.bytesPerLine(level)
+                != Texture::calculateBytesPerLine(texture.format(), texture.width(level));
+        if (padded)
+            staging.resize(int(packedImageSize(texture, level)));
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            for (int face = 0; face < texture.faces(); ++face) {
+                const auto image = texture.constImageData({Texture::Side(face), level, layer});
+                if (padded) {
+                    packImage(texture, level, image, staging.data());
+                    if (!writeData(device(), staging.constData(), staging.size()))
+                        return false;
+                } else {
+                    const auto data = reinterpret_cast<const char *>(image.data());
+                    if (!writeData(device(), data, image.size()))
+                        return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> Ktx2Handler::formatCapabilites()
+{
+    static const auto result = []
+    {
+        std::vector<TextureIOHandlerPlugin::FormatCapabilites> result;
+        for (const auto &format: Ktx2Format::allFormats())
+            result.push_back({format.format, TextureIOHandlerPlugin::Capability::ReadWrite});
+        return result;
+    }();
+    return result;
+}
+
+Q_LOGGING_CATEGORY(ktx2handler, "plugins.textureformats.ktx2handler")
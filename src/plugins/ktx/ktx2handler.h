@@ -0,0 +1,41 @@
+#ifndef KTX2HANDLER_H
+#define KTX2HANDLER_H
+
+#include "ktx2header.h"
+
+#include <TextureLib/TextureIOHandler>
+#include <TextureLib/TextureIOHandlerPlugin>
+
+#include <QtCore/QLoggingCategory>
+
+#include <vector>
+
+struct Ktx2Format;
+
+class Ktx2Handler : public TextureIOHandler
+{
+public:
+    Ktx2Handler() = default;
+
+    bool read(Texture &texture) override;
+    bool readPreview(Texture &texture) override;
+    bool readLevel(int level, Texture &texture) override;
+    bool write(const Texture &texture) override;
+
+    static gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> formatCapabilites();
+
+private:
+    bool readIndex();
+    Texture createTexture(int baseLevel, int levels) const;
+    bool readLevels(Texture &texture, int baseLevel);
+
+    Ktx2Header m_header;
+    std::vector<Ktx2LevelIndex> m_levelIndex;
+    const Ktx2Format *m_format {nullptr};
+    qint64 m_base {0};
+    bool m_indexRead {false};
+};
+
+Q_DECLARE_LOGGING_CATEGORY(ktx2handler)
+
+#endif // KTX2HANDLER_H
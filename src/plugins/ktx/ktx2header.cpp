@@ -0,0 +1,91 @@
+#include "ktx2header.h"
+
+#include <gsl/span>
+
+QDataStream &operator>>(QDataStream &s, Ktx2Header &header)
+{
+    for (auto &byte: gsl::span<quint8>(header.identifier))
+        s >> byte;
+
+    s >> header.vkFormat;
+    s >> header.typeSize;
+    s >> header.pixelWidth;
+    s >> header.pixelHeight;
+    s >> header.pixelDepth;
+    s >> header.layerCount;
+    s >> header.faceCount;
+    s >> header.levelCount;
+    s >> header.supercompressionScheme;
+
+    s >> header.dfdByteOffset;
+    s >> header.dfdByteLength;
+    s >> header.kvdByteOffset;
+    s >> header.kvdByteLength;
+    s >> header.sgdByteOffset;
+    s >> header.sgdByteLength;
+
+    return s;
+}
+
+QDataStream &operator<<(QDataStream &s, const Ktx2Header &header)
+{
+    for (const auto byte: gsl::span<const quint8>(header.identifier))
+        s << byte;
+
+    s << header.vkFormat;
+    s << header.typeSize;
+    s << header.pixelWidth;
+    s << header.pixelHeight;
+    s << header.pixelDepth;
+    s << header.layerCount;
+    s << header.faceCount;
+    s << header.levelCount;
+    s << header.supercompressionScheme;
+
+    s << header.dfdByteOffset;
+    s << header.dfdByteLength;
+    s << header.kvdByteOffset;
+    s << header.kvdByteLength;
+    s << header.sgdByteOffset;
+    s << header.sgdByteLength;
+
+    return s;
+}
+
+QDataStream &operator>>(QDataStream &s, Ktx2LevelIndex &index)
+{
+    s >> index.byteOffset;
+    s >> index.byteLength;
+    s >> index.uncompressedByteLength;
+    return s;
+}
+
+QDataStream &operator<<(QDataStream &s, const Ktx2LevelIndex &index)
+{
+    s << index.byteOffset;
+    s << index.byteLength;
+    s << index.uncompressedByteLength;
+    return s;
+}
+
+QDebug &operator<<(QDebug &d, const Ktx2Header &header)
+{
+    d << "Ktx2Header {"
+      << "vkFormat:" << header.vkFormat << ","
+      << "typeSize:" << header.typeSize << ","
+      << "pixelWidth:" << header.pixelWidth << ","
+      << "pixelHeight:" << header.pixelHeight << ","
+      << "pixelDepth:" << header.pixelDepth << ","
+      << "layerCount:" << header.layerCount << ","
+      << "faceCount:" << header.faceCount << ","
+      << "levelCount:" << header.levelCount << ","
+      << "supercompressionScheme:" << header.supercompressionScheme << ","
+      << "dfdByteOffset:" << header.dfdByteOffset << ","
+      << "dfdByteLength:" << header.dfdByteLength << ","
+      << "kvdByteOffset:" << header.kvdByteOffset << ","
+      << "kvdByteLength:" << header.kvdByteLength << ","
+      << "sgdByteOffset:" << header.sgdByteOffset << ","
+      << "sgdByteLength:" << header.sgdByteLength
+      << "}";
+    return d;
+}
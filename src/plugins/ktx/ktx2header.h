@@ -0,0 +1,62 @@
+#ifndef KTX2HEADER_H
+#define KTX2HEADER_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+
+namespace Ktx2 {
+
+constexpr quint8 identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+constexpr qint64 headerSize = 80; // identifier, header and index
+constexpr qint64 levelIndexEntrySize = 24;
+
+enum class Supercompression : quint32 {
+    None = 0,
+    BasisLZ = 1,
+    Zstandard = 2,
+    Zlib = 3,
+};
+
+} // namespace Ktx2
+
+struct Ktx2Header
+{
+    quint8 identifier[12] {};
+    quint32 vkFormat {0};
+    quint32 typeSize {0};
+    quint32 pixelWidth {0};
+    quint32 pixelHeight {0};
+    quint32 pixelDepth {0};
+    quint32 layerCount {0};
+    quint32 faceCount {0};
+    quint32 levelCount {0};
+    quint32 supercompressionScheme {0};
+
+    // index
+    quint32 dfdByteOffset {0};
+    quint32 dfdByteLength {0};
+    quint32 kvdByteOffset {0};
+    quint32 kvdByteLength {0};
+    quint64 sgdByteOffset {0};
+    quint64 sgdByteLength {0};
+};
+
+struct Ktx2LevelIndex
+{
+    quint64 byteOffset {0};
+    quint64 byteLength {0};
+    quint64 uncompressedByteLength {0};
+};
+
+QDataStream &operator>>(QDataStream &s, Ktx2Header &header);
+QDataStream &operator<<(QDataStream &s, const Ktx2Header &header);
+
+QDataStream &operator>>(QDataStream &s, Ktx2LevelIndex &index);
+QDataStream &operator<<(QDataStream &s, const Ktx2LevelIndex &index);
+
+QDebug &operator<<(QDebug &d, const Ktx2Header &header);
+
+#endif // KTX2HEADER_H
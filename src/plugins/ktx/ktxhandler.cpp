@@ -1,12 +1,20 @@
 #include "ktxhandler.h"
 #include "ktxheader.h"
 
+#include <TextureLib/DeviceCursor>
 #include <TextureLib/Texture>
 #include <TextureLib/TextureFormatInfo>
+#include <TextureLib/Tracing>
+
+#include <QtCore/QtEndian>
+
+#include <cstring>
+#include <vector>
 
 namespace {
 
 constexpr auto maxInt = std::numeric_limits<int>::max();
+constexpr qint64 headerSize = 64; // identifier and 13 fields
 
 struct FormatInfo
 {
@@ -34,18 +42,122 @@ constexpr TextureFormat findFormat(quint32 textureFormat, quint32 pixelFormat, q
     return TextureFormat::Invalid;
 }
 
-bool readPadding(KtxHandler::QIODevicePointer device, qint64 size)
+constexpr quint8 ktxIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// Base internal formats, the values are the same as in QOpenGLTexture::PixelFormat
+constexpr quint32 glRed = 0x1903;
+constexpr quint32 glRG = 0x8227;
+constexpr quint32 glRGB = 0x1907;
+constexpr quint32 glRGBA = 0x1908;
+
+constexpr quint32 baseInternalFormat(const TextureFormatInfo &info)
+{
+    if (!info.isCompressed()) {
+        switch (info.oglPixelFormat()) {
+        case QOpenGLTexture::Red_Integer: return glRed;
+        case QOpenGLTexture::RG_Integer: return glRG;
+        case QOpenGLTexture::BGR:
+        case QOpenGLTexture::RGB_Integer:
+        case QOpenGLTexture::BGR_Integer: return glRGB;
+        case QOpenGLTexture::BGRA:
+        case QOpenGLTexture::RGBA_Integer:
+        case QOpenGLTexture::BGRA_Integer: return glRGBA;
+        default: return quint32(info.oglPixelFormat());
+        }
+    }
+
+    switch (info.oglTextureFormat()) {
+    case QOpenGLTexture::R_ATI1N_UNorm:
+    case QOpenGLTexture::R_ATI1N_SNorm:
+    case QOpenGLTexture::R11_EAC_UNorm:
+    case QOpenGLTexture::R11_EAC_SNorm: return glRed;
+    case QOpenGLTexture::RG_ATI2N_UNorm:
+    case QOpenGLTexture::RG_ATI2N_SNorm:
+    case QOpenGLTexture::RG11_EAC_UNorm:
+    case QOpenGLTexture::RG11_EAC_SNorm: return glRG;
+    case QOpenGLTexture::RGB_DXT1:
+    case QOpenGLTexture::SRGB_DXT1:
+    case QOpenGLTexture::RGB_BP_UNSIGNED_FLOAT:
+    case QOpenGLTexture::RGB_BP_SIGNED_FLOAT:
+    case QOpenGLTexture::RGB8_ETC1:
+    case QOpenGLTexture::RGB8_ETC2:
+    case QOpenGLTexture::SRGB8_ETC2: return glRGB;
+    default: return glRGBA;
+    }
+}
+
+// Size of the type used for the endianness conversion; 1 for compressed formats
+constexpr quint32 typeSize(QOpenGLTexture::PixelType type)
+{
+    switch (type) {
+    case QOpenGLTexture::Int16:
+    case QOpenGLTexture::UInt16:
+    case QOpenGLTexture::Float16:
+    case QOpenGLTexture::Float16OES:
+    case QOpenGLTexture::UInt16_RGB5A1:
+    case QOpenGLTexture::UInt16_RGB5A1_Rev:
+    case QOpenGLTexture::UInt16_R5G6B5:
+    case QOpenGLTexture::UInt16_R5G6B5_Rev:
+    case QOpenGLTexture::UInt16_RGBA4:
+    case QOpenGLTexture::UInt16_RGBA4_Rev: return 2;
+    case QOpenGLTexture::Int32:
+    case QOpenGLTexture::UInt32:
+    case QOpenGLTexture::Float32:
+    case QOpenGLTexture::UInt32_RGBA8:
+    case QOpenGLTexture::UInt32_RGBA8_Rev:
+    case QOpenGLTexture::UInt32_RGB10A2:
+    case QOpenGLTexture::UInt32_RGB10A2_Rev:
+    case QOpenGLTexture::UInt32_RG11B10F:
+    case QOpenGLTexture::UInt32_RGB9_E5:
+    case QOpenGLTexture::UInt32_D24S8: return 4;
+    default: return 1;
+    }
+}
+
+// Key/value pairs; every pair is prefixed with its size and padded to 4 bytes
+QByteArray keyValueData(const Texture &texture)
+{
+    const auto orientation = texture.depth() > 1
+            ? QByteArrayLiteral("S=r,T=d,R=i")
+            : QByteArrayLiteral("S=r,T=d");
+    const auto pair = QByteArrayLiteral("KTXorientation") + '\0' + orientation + '\0';
+
+    QByteArray result;
+    QDataStream s(&result, QIODevice::WriteOnly);
+    s.setByteOrder(QDataStream::LittleEndian);
+    s << quint32(pair.size());
+    s.writeRawData(pair.constData(), pair.size());
+    result.append(QByteArray(3 - (pair.size() + 3) % 4, '\0'));
+    return result;
+}
+
+bool writeData(KtxHandler::QIODevicePointer device, const char *data, qint64 size)
 {
     if (size == 0)
         return true;
 
-    const auto buffer = std::make_unique<char[]>(size_t(size));
-    const auto read = device->read(buffer.get(), size);
-    if (read != size) {
-        qCWarning(ktxhandler) << "Can't read padding of size" << size
-                              << ":" << device->errorString();
-    }
-    return read == size;
+    const auto written = device->write(data, size);
+    if (written != size)
+        qCWarning(ktxhandler) << "Can't write to device:" << device->errorString();
+    return written == size;
+}
+
+bool writePadding(KtxHandler::QIODevicePointer device, qint64 size)
+{
+    constexpr char zeros[4] = {};
+    return writeData(device, zeros, size);
+}
+
+bool readImageSize(DeviceCursor &cursor, QDataStream::ByteOrder byteOrder, quint32 &imageSize)
+{
+    if (!cursor.read(reinterpret_cast<char *>(&imageSize), sizeof(imageSize)))
+        return false;
+    imageSize = byteOrder == QDataStream::LittleEndian
+            ? qFromLittleEndian(imageSize)
+            : qFromBigEndian(imageSize);
+    return true;
 }
 
 bool verifyHeader(const KtxHeader &header)
@@ -91,13 +203,21 @@ bool verifyHeader(const KtxHeader &header)
     return true;
 }
 
-} // namespace
-
-bool KtxHandler::read(Texture& texture)
+// Reads the header, skips the key/value data and finds the texture format
+bool readHeader(
+        DeviceCursor &cursor,
+        qint64 base,
+        KtxHeader &header,
+        QDataStream::ByteOrder &byteOrder,
+        TextureFormat &textureFormat)
 {
-    KtxHeader header = {};
+    const auto headerData = cursor.read(headerSize);
+    if (headerData.size() != headerSize) {
+        qCWarning(ktxhandler) << "Can't read header:" << cursor.errorString();
+        return false;
+    }
 
-    QDataStream s(device().get());
+    QDataStream s(headerData);
     s >> header;
 
     qCDebug(ktxhandler) << "header:" << header;
@@ -110,12 +230,14 @@ bool KtxHandler::read(Texture& texture)
     if (!verifyHeader(header))
         return false;
 
-    if (!readPadding(device(), header.bytesOfKeyValueData))
+    if (!cursor.skip(header.bytesOfKeyValueData) || !cursor.align(4, base)) {
+        qCWarning(ktxhandler) << "Can't skip key/value data:" << cursor.errorString();
         return false;
+    }
 
-    readPadding(device(), 3 - ((device()->pos() + 3) % 4));
+    byteOrder = s.byteOrder();
 
-    TextureFormat textureFormat = TextureFormat::Invalid;
+    textureFormat = TextureFormat::Invalid;
     if (header.glFormat == 0 && header.glType == 0) {
         textureFormat = TextureFormatInfo::findOGLFormat(
                     QOpenGLTexture::TextureFormat(header.glInternalFormat)).format();
@@ -136,6 +258,25 @@ bool KtxHandler::read(Texture& texture)
         return false;
     }
 
+    return true;
+}
+
+} // namespace
+
+bool KtxHandler::read(Texture& texture)
+{
+    TraceSpan span("handler", "KtxHandler::read");
+
+    // Header, key/value data, image sizes and padding are served from a single buffer
+    DeviceCursor cursor(device().get());
+    const auto base = cursor.pos();
+
+    KtxHeader header = {};
+    auto byteOrder = QDataStream::LittleEndian;
+    auto textureFormat = TextureFormat::Invalid;
+    if (!readHeader(cursor, base, header, byteOrder, textureFormat))
+        return false;
+
     const auto size = Texture::Size(
                 header.pixelWidth,
                 std::max<int>(1, header.pixelHeight),
@@ -147,34 +288,33 @@ bool KtxHandler::read(Texture& texture)
     auto result = Texture(
                 textureFormat,
                 size,
-                {levels, layers},
+                {Texture::IsCubemap(faces == 6), levels, layers},
                 Texture::Alignment::Word);
     if (result.isNull()) {
         qCWarning(ktxhandler) << "Can't create texture";
         return false;
     }
 
+    headerRead(result);
+
+    TraceSpan payloadSpan("handler", "KtxHandler::readPayload");
     for (int level = 0; level < levels; ++level) {
         quint32 imageSize = 0;
-        s >> imageSize;
-        if (s.status() != QDataStream::Ok) {
-            qCWarning(ktxhandler) << "Can't read image size: data stream status =" << s.status();
+        if (!readImageSize(cursor, byteOrder, imageSize)) {
+            qCWarning(ktxhandler) << "Can't read image size:" << cursor.errorString();
             return false;
         }
 
         for (int layer = 0; layer < layers; ++layer) {
             for (int face = 0; face < faces; ++face) {
                 const auto data = result.imageData({Texture::Side(face), level, layer});
-                const auto read = device()->read(reinterpret_cast<char *>(data.data()), data.size());
-                if (read != data.size()) {
-                    qCWarning(ktxhandler) << "Can't read from device:"
-                                          << device()->errorString();
+                if (!cursor.read(data) || !cursor.align(4, base)) {
+                    qCWarning(ktxhandler) << "Can't read from device:" << cursor.errorString();
                     return false;
                 }
-                readPadding(device(), 3 - ((device()->pos() + 3) % 4));
+                imageRead(result, {Texture::Side(face), level, layer});
             }
         }
-        readPadding(device(), 3 - ((device()->pos() + 3) % 4));
     }
 
     texture = std::move(result);
@@ -182,4 +322,191 @@ bool KtxHandler::read(Texture& texture)
     return true;
 }
 
+/*!
+    Reads the first image of the largest level that fits into previewSize(). The bigger levels
+    are skipped without reading their data.
+*/
+bool KtxHandler::readPreview(Texture &texture)
+{
+    TraceSpan span("handler", "KtxHandler::readPreview");
+
+    DeviceCursor cursor(device().get());
+    const auto base = cursor.pos();
+
+    KtxHeader header = {};
+    auto byteOrder = QDataStream::LittleEndian;
+    auto textureFormat = TextureFormat::Invalid;
+    if (!readHeader(cursor, base, header, byteOrder, textureFormat))
+        return false;
+
+    const auto size = Texture::Size(
+                header.pixelWidth,
+                std::max<int>(1, header.pixelHeight),
+                std::max<int>(1, header.pixelDepth));
+    const auto images = std::max<qint64>(1, header.numberOfFaces)
+            * std::max<qint64>(1, header.numberOfArrayElements);
+    const auto level = previewLevel(size, std::max<int>(1, header.numberOfMipmapLevels));
+    if (level < 0) {
+        qCDebug(ktxhandler) << "No level fits into the preview size";
+        return false;
+    }
+
+    const auto levelSize = [&size](int level)
+    {
+        return Texture::Size(
+                std::max<qsizetype>(1, size.width >> level),
+                std::max<qsizetype>(1, size.height >> level),
+                std::max<qsizetype>(1, size.depth >> level));
+    };
+
+    // Each level is its image size followed by the images padded to 4 bytes
+    qint64 offset = 0;
+    for (int bigger = 0; bigger < level; ++bigger) {
+        const auto biggerSize = levelSize(bigger);
+        const auto imageSize = Texture::calculateBytesPerSlice(
+                textureFormat, biggerSize.width, biggerSize.height, Texture::Alignment::Word)
+                * biggerSize.depth;
+        offset += 4 + images * ((imageSize + 3) & ~qint64(3));
+    }
+
+    auto result = Texture(textureFormat, levelSize(level), {1, 1}, Texture::Alignment::Word);
+    if (result.isNull()) {
+        qCWarning(ktxhandler) << "Can't create texture";
+        return false;
+    }
+
+    if (!cursor.skip(offset + 4) || !cursor.read(result.imageData({}))) {
+        qCWarning(ktxhandler) << "Can't read from device:" << cursor.errorString();
+        return false;
+    }
+
+    texture = std::move(result);
+    return true;
+}
+
+bool KtxHandler::write(const Texture &texture)
+{
+    TraceSpan span("handler", "KtxHandler::write");
+
+    const auto &info = texture.formatInfo();
+    const auto &found = TextureFormatInfo::findOGLFormat(
+            info.oglTextureFormat(), info.oglPixelFormat(), info.oglPixelType());
+    if (info.oglTextureFormat() == QOpenGLTexture::NoFormat || found.format() != texture.format()) {
+        qCWarning(ktxhandler) << "Unsupported format" << texture.format();
+        return false;
+    }
+
+    KtxHeader header = {};
+    std::copy(std::begin(ktxIdentifier), std::end(ktxIdentifier), header.identifier);
+    header.endianness = 0x04030201;
+    header.glType = quint32(info.oglPixelType());
+    header.glTypeSize = typeSize(info.oglPixelType());
+    header.glFormat = quint32(info.oglPixelFormat());
+    header.glInternalFormat = quint32(info.oglTextureFormat());
+    header.glBaseInternalFormat = baseInternalFormat(info);
+    header.pixelWidth = quint32(texture.width());
+    header.pixelHeight = quint32(texture.height());
+    header.pixelDepth = texture.depth() > 1 ? quint32(texture.depth()) : 0;
+    header.numberOfArrayElements = texture.layers() > 1 ? quint32(texture.layers()) : 0;
+    header.numberOfFaces = quint32(texture.faces());
+    header.numberOfMipmapLevels = quint32(texture.levels());
+
+    const auto keyValues = keyValueData(texture);
+    header.bytesOfKeyValueData = quint32(keyValues.size());
+
+    {
+        QDataStream s(device().get());
+        s.setByteOrder(QDataStream::LittleEndian);
+        s << header;
+
+        if (s.status() != QDataStream::Ok) {
+            qCWarning(ktxhandler) << "Can't write header: data stream status =" << s.status();
+            return false;
+        }
+    }
+
+    if (!writeData(device(), keyValues.constData(), keyValues.size()))
+        return false;
+
+    // For non-array cubemaps, imageSize is the size of a single face
+    const auto singleFace = texture.faces() == 6 && texture.layers() == 1;
+
+    TraceSpan payloadSpan("handler", "KtxHandler::writePayload");
+    QByteArray staging;
+    for (int level = 0; level < texture.levels(); ++level) {
+        // KTX rows are 4-bytes aligned; when the texture rows already are (always true for Word
+        // alignment and compressed formats), images are written straight from the storage
+        const auto lineSize = texture.bytesPerLine(level);
+        const auto alignedLineSize = Texture::calculateBytesPerLine(
+                texture.format(), texture.width(level), Texture::Alignment::Word);
+        const auto imageSize = texture.bytesPerImage(level) / lineSize * alignedLineSize;
+
+        const auto levelSize = singleFace
+                ? imageSize
+                : imageSize * texture.faces() * texture.layers();
+        if (levelSize > qsizetype(std::numeric_limits<quint32>::max())) {
+            qCWarning(ktxhandler) << "Level" << level << "is too big:" << levelSize;
+            return false;
+        }
+
+        {
+            QDataStream s(device().get());
+            s.setByteOrder(QDataStream::LittleEndian);
+            s << quint32(levelSize);
+        }
+
+        if (lineSize != alignedLineSize)
+            staging.resize(int(imageSize));
+
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            for (int face = 0; face < texture.faces(); ++face) {
+                const auto data = texture.constImageData({Texture::Side(face), level, layer});
+                if (lineSize == alignedLineSize) {
+                    if (!writeData(device(), reinterpret_cast<const char *>(data.data()), data.size()))
+                        return false;
+                } else {
+                    // Re-align only this image rather than converting the whole texture
+                    staging.fill('\0');
+                    const auto lines = data.size() / lineSize;
+                    for (qsizetype line = 0; line < lines; ++line) {
+                        memcpy(staging.data() + line * alignedLineSize,
+                               data.data() + line * lineSize,
+                               size_t(lineSize));
+                    }
+                    if (!writeData(device(), staging.constData(), staging.size()))
+                        return false;
+                }
+                if (singleFace && !writePadding(device(), 3 - (imageSize + 3) % 4))
+                    return false;
+            }
+        }
+
+        if (!writePadding(device(), 3 - (levelSize + 3) % 4))
+            return false;
+    }
+
+    return true;
+}
+
+gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> KtxHandler::formatCapabilites()
+{
+    // Only formats that are found by the reader by their OpenGL triple
+    static const auto result = []
+    {
+        std::vector<TextureIOHandlerPlugin::FormatCapabilites> result;
+        for (const auto &info: TextureFormatInfo::allFormatInfos()) {
+            if (info.format() == TextureFormat::Invalid
+                    || info.oglTextureFormat() == QOpenGLTexture::NoFormat) {
+                continue;
+            }
+            const auto &found = TextureFormatInfo::findOGLFormat(
+                    info.oglTextureFormat(), info.oglPixelFormat(), info.oglPixelType());
+            if (found.format() == info.format())
+                result.push_back({info.format(), TextureIOHandlerPlugin::Capability::ReadWrite});
+        }
+        return result;
+    }();
+    return result;
+}
+
 Q_LOGGING_CATEGORY(ktxhandler, "plugins.textureformats.ktxhandler")
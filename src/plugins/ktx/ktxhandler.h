@@ -2,6 +2,7 @@
 #define KTXHANDLER_H
 
 #include <TextureLib/TextureIOHandler>
+#include <TextureLib/TextureIOHandlerPlugin>
 
 #include <QtCore/QLoggingCategory>
 
@@ -11,6 +12,10 @@ public:
     KtxHandler() = default;
 
     bool read(Texture &texture) override;
+    bool readPreview(Texture &texture) override;
+    bool write(const Texture &texture) override;
+
+    static gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> formatCapabilites();
 };
 
 Q_DECLARE_LOGGING_CATEGORY(ktxhandler)
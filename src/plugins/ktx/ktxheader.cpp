@@ -33,6 +33,29 @@ QDataStream&operator>>(QDataStream& s, KtxHeader& header)
     return s;
 }
 
+QDataStream &operator<<(QDataStream &s, const KtxHeader &header)
+{
+    for (const auto byte: gsl::span<const quint8>(header.identifier)) {
+        s << byte;
+    }
+
+    s << header.endianness;
+    s << header.glType;
+    s << header.glTypeSize;
+    s << header.glFormat;
+    s << header.glInternalFormat;
+    s << header.glBaseInternalFormat;
+    s << header.pixelWidth;
+    s << header.pixelHeight;
+    s << header.pixelDepth;
+    s << header.numberOfArrayElements;
+    s << header.numberOfFaces;
+    s << header.numberOfMipmapLevels;
+    s << header.bytesOfKeyValueData;
+
+    return s;
+}
+
 QDebug&operator<<(QDebug& d, const KtxHeader& header)
 {
     d << "KtxHeader {"
@@ -23,6 +23,7 @@ struct KtxHeader
 };
 
 QDataStream &operator>>(QDataStream &s, KtxHeader &header);
+QDataStream &operator<<(QDataStream &s, const KtxHeader &header);
 
 QDebug &operator<<(QDebug &d, const KtxHeader &header);
 
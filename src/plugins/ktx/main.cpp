@@ -1,4 +1,5 @@
 #include "ktxhandler.h"
+#include "ktx2handler.h"
 
 #include <TextureLib/TextureIOHandlerPlugin>
 
@@ -19,13 +20,24 @@ public:
     {
         if (mimeType == u"image/x-ktx")
             return std::make_unique<KtxHandler>();
+        if (mimeType == u"image/ktx2")
+            return std::make_unique<Ktx2Handler>();
         return nullptr;
     }
 
     Capabilities capabilities(QStringView mimeType) const override
+    {
+        if (mimeType == u"image/x-ktx" || mimeType == u"image/ktx2")
+            return Capability::CanRead | Capability::CanWrite;
+        return {};
+    }
+
+    gsl::span<const FormatCapabilites> formatCapabilites(QStringView mimeType) const override
     {
         if (mimeType == u"image/x-ktx")
-            return Capability::CanRead;
+            return KtxHandler::formatCapabilites();
+        if (mimeType == u"image/ktx2")
+            return Ktx2Handler::formatCapabilites();
         return {};
     }
 };
@@ -1,6 +1,7 @@
 #include "pkmhandler.h"
 
 #include <TextureLib/Texture>
+#include <TextureLib/Tracing>
 
 #include <OptionalType>
 
@@ -179,6 +180,8 @@ bool verifyTexture(const Texture &texture)
 
 bool PkmHandler::read(Texture& texture)
 {
+    TraceSpan span("handler", "PkmHandler::read");
+
     PkmHeader header;
 
     {
@@ -216,6 +219,7 @@ bool PkmHandler::read(Texture& texture)
         qCWarning(pkmhandler) << "Can't read from device:" << device()->errorString();
         return false;
     }
+    imageRead(result, {});
 
     texture = std::move(result);
 
@@ -224,6 +228,8 @@ bool PkmHandler::read(Texture& texture)
 
 bool PkmHandler::write(const Texture& texture)
 {
+    TraceSpan span("handler", "PkmHandler::write");
+
     if (!verifyTexture(texture))
         return false;
 
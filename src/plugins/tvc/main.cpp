@@ -0,0 +1,42 @@
+#include "tvchandler.h"
+
+#include <TextureLib/TextureIOHandlerPlugin>
+
+class TvcHandlerPlugin : public TextureIOHandlerPlugin
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TvcHandlerPlugin)
+    Q_PLUGIN_METADATA(IID "org.arch.ImageDocument.TvcHandlerPlugin" FILE "tvc.json")
+
+public:
+    TvcHandlerPlugin() = default;
+    TvcHandlerPlugin(TvcHandlerPlugin &&) = delete;
+    ~TvcHandlerPlugin() override = default;
+
+    TvcHandlerPlugin &operator =(TvcHandlerPlugin &&) = delete;
+
+    std::unique_ptr<TextureIOHandler> create(QStringView mimeType) override
+    {
+        if (mimeType == u"image/x-tvc")
+            return std::make_unique<TvcHandler>();
+        return nullptr;
+    }
+
+    Capabilities capabilities(QStringView mimeType) const override
+    {
+        if (mimeType == u"image/x-tvc")
+            return Capability::CanRead | Capability::CanWrite;
+        return {};
+    }
+
+    // TextureIOHandlerPlugin interface
+public:
+    gsl::span<const FormatCapabilites> formatCapabilites(QStringView mimeType) const override
+    {
+        if (mimeType == u"image/x-tvc")
+            return TvcHandler::formatCapabilites();
+        return {};
+    }
+};
+
+#include "main.moc"
@@ -0,0 +1,424 @@
+#include "tvchandler.h"
+#include "tvcheader.h"
+
+#include <TextureLib/DeviceCursor>
+#include <TextureLib/Texture>
+#include <TextureLib/Tracing>
+
+#include <QtCore/QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr auto maxInt = quint32(std::numeric_limits<int>::max());
+constexpr quint32 maxLevels = 32;
+
+constexpr qint64 alignUp(qint64 value, qint64 alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Subresources in the order they are stored in memory
+std::vector<Texture::ArrayIndex> subresources(Texture::ArraySize arraySize)
+{
+    std::vector<Texture::ArrayIndex> result;
+    result.reserve(size_t(arraySize.faces()) * size_t(arraySize.levels())
+                   * size_t(arraySize.layers()));
+    for (int level = 0; level < arraySize.levels(); ++level) {
+        for (int layer = 0; layer < arraySize.layers(); ++layer) {
+            for (int face = 0; face < arraySize.faces(); ++face)
+                result.emplace_back(Texture::Side(face), level, layer);
+        }
+    }
+    return result;
+}
+
+bool verifyHeader(const TvcHeader &header)
+{
+    if (!std::equal(std::begin(header.identifier), std::end(header.identifier),
+                    std::begin(Tvc::identifier))) {
+        qCWarning(tvchandler) << "Invalid identifier";
+        return false;
+    }
+
+    if (header.version != Tvc::version) {
+        qCWarning(tvchandler) << "Unsupported version:" << header.version;
+        return false;
+    }
+
+    if (header.format == quint32(TextureFormat::Invalid)
+            || header.format >= quint32(TextureFormat::FormatsCount)) {
+        qCWarning(tvchandler) << "Invalid format:" << header.format;
+        return false;
+    }
+
+    if (header.alignment != quint32(Texture::Alignment::Byte)
+            && header.alignment != quint32(Texture::Alignment::Word)) {
+        qCWarning(tvchandler) << "Invalid alignment:" << header.alignment;
+        return false;
+    }
+
+    if (!header.width || !header.height || !header.depth
+            || header.width > maxInt || header.height > maxInt || header.depth > maxInt) {
+        qCWarning(tvchandler) << "Invalid size:"
+                              << header.width << "x" << header.height << "x" << header.depth;
+        return false;
+    }
+
+    if (header.faces != 1 && header.faces != 6) {
+        qCWarning(tvchandler) << "Number of faces is invalid:" << header.faces;
+        return false;
+    }
+
+    if (!header.levels || header.levels > maxLevels || !header.layers || header.layers > maxInt) {
+        qCWarning(tvchandler) << "Invalid number of levels or layers:"
+                              << header.levels << header.layers;
+        return false;
+    }
+
+    const auto subresources = quint64(header.faces) * header.levels * header.layers;
+    if (subresources > maxInt) {
+        qCWarning(tvchandler) << "Too many subresources:" << subresources;
+        return false;
+    }
+    if (header.dataOffset % Tvc::dataAlignment
+            || header.dataOffset < quint64(Tvc::headerSize) + subresources * Tvc::entrySize) {
+        qCWarning(tvchandler) << "Invalid data offset:" << header.dataOffset;
+        return false;
+    }
+
+    return true;
+}
+
+// Maps the payload of a file without compressed subresources directly into the texture
+Texture mapTexture(
+        const QString &fileName,
+        qint64 offset,
+        qint64 size,
+        TextureFormat format,
+        Texture::Size textureSize,
+        Texture::ArraySize arraySize,
+        Texture::Alignment alignment)
+{
+    TraceSpan span("handler", "TvcHandler::map");
+
+    // The mapping must outlive the device of the handler, so it is owned by the deleter
+    const auto file = std::make_shared<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+        return Texture();
+
+    // A private mapping is copy-on-write, so modifying the texture never touches the file
+    const auto data = file->map(offset, size, QFileDevice::MapPrivateOption);
+    if (!data) {
+        qCDebug(tvchandler) << "Can't map" << fileName << ":" << file->errorString();
+        return Texture();
+    }
+
+    return Texture(
+            Texture::Data(data, size),
+            [file](uchar p[]) { file->unmap(p); },
+            format,
+            textureSize,
+            arraySize,
+            alignment);
+}
+
+bool readImage(DeviceCursor &cursor, const TvcEntry &entry, Texture::Data data)
+{
+    if (entry.compression == Tvc::Compression::None) {
+        if (!cursor.read(data)) {
+            qCWarning(tvchandler) << "Can't read from device:" << cursor.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    if (entry.compression == Tvc::Compression::Zlib) {
+        if (entry.storedSize > maxInt) {
+            qCWarning(tvchandler) << "Compressed image is too big:" << entry.storedSize;
+            return false;
+        }
+        const auto compressed = cursor.read(qint64(entry.storedSize));
+        if (compressed.size() != int(entry.storedSize)) {
+            qCWarning(tvchandler) << "Can't read from device:" << cursor.errorString();
+            return false;
+        }
+        const auto uncompressed = qUncompress(compressed);
+        if (uncompressed.size() != data.size()) {
+            qCWarning(tvchandler) << "Can't decompress image";
+            return false;
+        }
+        memcpy(data.data(), uncompressed.constData(), size_t(data.size()));
+        return true;
+    }
+
+    qCWarning(tvchandler) << "Unsupported compression:" << quint32(entry.compression);
+    return false;
+}
+
+bool writeData(TvcHandler::QIODevicePointer device, const char *data, qint64 size)
+{
+    const auto written = device->write(data, size);
+    if (written != size) {
+        qCWarning(tvchandler) << "Can't write to device:" << device->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool writeTable(
+        TvcHandler::QIODevicePointer device,
+        const TvcHeader &header,
+        const std::vector<TvcEntry> &entries)
+{
+    QDataStream s(device.get());
+    s.setByteOrder(QDataStream::LittleEndian);
+    s << header;
+    for (const auto &entry: entries)
+        s << entry;
+
+    if (s.status() != QDataStream::Ok) {
+        qCWarning(tvchandler) << "Can't write header: data stream status =" << s.status();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool TvcHandler::read(Texture &texture)
+{
+    TraceSpan span("handler", "TvcHandler::read");
+
+    // All offsets are relative to the beginning of the header
+    const auto base = device()->pos();
+
+    TvcHeader header;
+    QDataStream s(device().get());
+    s.setByteOrder(QDataStream::LittleEndian);
+    s >> header;
+
+    qCDebug(tvchandler) << "header:" << header;
+
+    if (s.status() != QDataStream::Ok) {
+        qCWarning(tvchandler) << "Can't read header: data stream status =" << s.status();
+        return false;
+    }
+
+    if (!verifyHeader(header))
+        return false;
+
+    // The table is allocated from the header, so it is checked against the file size first
+    const auto count = quint64(header.faces) * header.levels * header.layers;
+    if (!device()->isSequential()
+            && count * quint64(Tvc::entrySize)
+                    > quint64(std::max<qint64>(0, device()->size() - base - Tvc::headerSize))) {
+        qCWarning(tvchandler) << "Subresource table is truncated";
+        return false;
+    }
+
+    const auto format = TextureFormat(header.format);
+    const auto size = Texture::Size(int(header.width), int(header.height), int(header.depth));
+    const auto arraySize = Texture::ArraySize(
+            Texture::IsCubemap(header.faces == 6), int(header.levels), int(header.layers));
+    const auto alignment = Texture::Alignment(header.alignment);
+    const auto indexes = subresources(arraySize);
+
+    std::vector<TvcEntry> entries(indexes.size());
+    for (auto &entry: entries)
+        s >> entry;
+
+    if (s.status() != QDataStream::Ok) {
+        qCWarning(tvchandler) << "Can't read subresource table: data stream status =" << s.status();
+        return false;
+    }
+
+    const auto dataEnd = header.dataOffset + header.dataSize;
+    if (!device()->isSequential() && qint64(dataEnd) > device()->size() - base) {
+        qCWarning(tvchandler) << "File is truncated";
+        return false;
+    }
+
+    // Data is stored as is and in the memory order: the payload can be used without copying
+    bool contiguous = true;
+    auto expectedOffset = header.dataOffset;
+    for (const auto &entry: entries) {
+        if (entry.offset < header.dataOffset || entry.offset + entry.storedSize > dataEnd) {
+            qCWarning(tvchandler) << "Invalid subresource offset:" << entry.offset;
+            return false;
+        }
+        contiguous = contiguous
+                && entry.compression == Tvc::Compression::None
+                && entry.offset == expectedOffset;
+        expectedOffset += entry.storedSize;
+    }
+
+    Texture result;
+    const auto file = qobject_cast<QFileDevice *>(device().get());
+    if (contiguous && file && !file->fileName().isEmpty()) {
+        result = mapTexture(
+                file->fileName(),
+                base + qint64(header.dataOffset),
+                qint64(header.dataSize),
+                format, size, arraySize, alignment);
+    }
+
+    if (result.isNull()) {
+        result = Texture(format, size, arraySize, alignment);
+        if (result.isNull()) {
+            qCWarning(tvchandler) << "Can't create texture";
+            return false;
+        }
+
+        TraceSpan payloadSpan("handler", "TvcHandler::readPayload");
+        DeviceCursor cursor(device().get());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const auto data = result.imageData(indexes[i]);
+            if (entries[i].compression == Tvc::Compression::None
+                    && entries[i].storedSize != quint64(data.size())) {
+                qCWarning(tvchandler) << "Invalid image size:" << entries[i].storedSize;
+                return false;
+            }
+            if (!cursor.seek(base + qint64(entries[i].offset))) {
+                qCWarning(tvchandler) << "Can't seek to" << entries[i].offset << ":"
+                                      << cursor.errorString();
+                return false;
+            }
+            if (!readImage(cursor, entries[i], data))
+                return false;
+        }
+    }
+
+    if (result.levels() != arraySize.levels()) {
+        qCWarning(tvchandler) << "Invalid number of levels:" << arraySize.levels();
+        return false;
+    }
+
+    // Hashes all images in parallel; they are memoized, so the checks below are cheap and the
+    // content hash of the result is free for the callers
+    result.contentHash();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (result.subresourceHash(indexes[i]) != entries[i].checksum) {
+            qCWarning(tvchandler) << "Checksum mismatch for" << indexes[i];
+            return false;
+        }
+    }
+
+    texture = std::move(result);
+
+    return true;
+}
+
+bool TvcHandler::write(const Texture &texture)
+{
+    TraceSpan span("handler", "TvcHandler::write");
+
+    if (texture.isNull()) {
+        qCWarning(tvchandler) << "Can't write null texture";
+        return false;
+    }
+
+    // Uncompressed files are the default, since only they can be mapped
+    const auto level = compression();
+    auto compress = level > 0;
+    if (compress && device()->isSequential()) {
+        qCWarning(tvchandler) << "Compression requires a random-access device, writing uncompressed";
+        compress = false;
+    }
+
+    const auto base = device()->pos();
+    const auto indexes = subresources(texture.arraySize());
+
+    TvcHeader header;
+    std::copy(std::begin(Tvc::identifier), std::end(Tvc::identifier), header.identifier);
+    header.version = Tvc::version;
+    header.format = quint32(texture.format());
+    header.alignment = quint32(texture.alignment());
+    header.width = quint32(texture.width());
+    header.height = quint32(texture.height());
+    header.depth = quint32(texture.depth());
+    header.faces = quint32(texture.faces());
+    header.levels = quint32(texture.levels());
+    header.layers = quint32(texture.layers());
+    header.dataOffset = quint64(alignUp(
+            Tvc::headerSize + qint64(indexes.size()) * Tvc::entrySize, Tvc::dataAlignment));
+
+    // Hashes all images in parallel, the results are memoized by the texture
+    texture.contentHash();
+
+    // Without compression the table is known upfront, so the file is written in a single pass
+    std::vector<TvcEntry> entries(indexes.size());
+    auto offset = header.dataOffset;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].offset = offset;
+        entries[i].storedSize = quint64(texture.constImageData(indexes[i]).size());
+        entries[i].checksum = texture.subresourceHash(indexes[i]);
+        offset += entries[i].storedSize;
+    }
+    header.dataSize = offset - header.dataOffset;
+
+    if (!writeTable(device(), header, entries))
+        return false;
+
+    const auto padding = qint64(header.dataOffset) - (device()->pos() - base);
+    if (!writeData(device(), QByteArray(int(padding), '\0').constData(), padding))
+        return false;
+
+    TraceSpan payloadSpan("handler", "TvcHandler::writePayload");
+    offset = header.dataOffset;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const auto data = texture.constImageData(indexes[i]);
+        entries[i].offset = offset;
+
+        // Images are compressed one by one, so only one compressed image is kept in memory
+        QByteArray compressed;
+        if (compress && data.size() <= qsizetype(maxInt))
+            compressed = qCompress(data.data(), int(data.size()), level);
+
+        if (!compressed.isEmpty() && compressed.size() < data.size()) {
+            entries[i].compression = Tvc::Compression::Zlib;
+            entries[i].storedSize = quint64(compressed.size());
+            if (!writeData(device(), compressed.constData(), compressed.size()))
+                return false;
+        } else {
+            const auto bytes = reinterpret_cast<const char *>(data.data());
+            if (!writeData(device(), bytes, data.size()))
+                return false;
+        }
+        offset += entries[i].storedSize;
+    }
+
+    if (compress) {
+        header.dataSize = offset - header.dataOffset;
+        const auto end = device()->pos();
+        if (!device()->seek(base) || !writeTable(device(), header, entries) || !device()->seek(end)) {
+            qCWarning(tvchandler) << "Can't update subresource table:" << device()->errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The payload is stored as is, so every format can be cached
+gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> TvcHandler::formatCapabilites()
+{
+    static const auto result = []
+    {
+        std::vector<TextureIOHandlerPlugin::FormatCapabilites> result;
+        for (int i = 0; i < int(TextureFormat::FormatsCount); ++i) {
+            const auto format = TextureFormat(i);
+            if (format != TextureFormat::Invalid)
+                result.push_back({format, TextureIOHandlerPlugin::Capability::ReadWrite});
+        }
+        return result;
+    }();
+    return result;
+}
+
+Q_LOGGING_CATEGORY(tvchandler, "plugins.textureformats.tvchandler")
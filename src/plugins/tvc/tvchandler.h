@@ -0,0 +1,27 @@
+#ifndef TVCHANDLER_H
+#define TVCHANDLER_H
+
+#include <TextureLib/TextureIOHandler>
+#include <TextureLib/TextureIOHandlerPlugin>
+
+#include <QtCore/QLoggingCategory>
+
+class TvcHandler : public TextureIOHandler
+{
+    Q_DISABLE_COPY(TvcHandler)
+public:
+    TvcHandler() noexcept = default;
+    TvcHandler(TvcHandler &&) noexcept = default;
+    ~TvcHandler() noexcept override = default;
+    TvcHandler &operator=(TvcHandler &&) noexcept = default;
+
+public: // TextureIOHandler interface
+    bool read(Texture &texture) override;
+    bool write(const Texture &texture) override;
+
+    static gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> formatCapabilites();
+};
+
+Q_DECLARE_LOGGING_CATEGORY(tvchandler)
+
+#endif // TVCHANDLER_H
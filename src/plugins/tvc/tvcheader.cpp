@@ -0,0 +1,83 @@
+#include "tvcheader.h"
+
+#include <gsl/span>
+
+QDataStream &operator>>(QDataStream &s, TvcHeader &header)
+{
+    for (auto &byte: gsl::span<quint8>(header.identifier))
+        s >> byte;
+    s >> header.version;
+    s >> header.flags;
+    s >> header.format;
+    s >> header.alignment;
+    s >> header.width;
+    s >> header.height;
+    s >> header.depth;
+    s >> header.faces;
+    s >> header.levels;
+    s >> header.layers;
+    s >> header.dataOffset;
+    s >> header.dataSize;
+    return s;
+}
+
+QDataStream &operator<<(QDataStream &s, const TvcHeader &header)
+{
+    for (const auto byte: gsl::span<const quint8>(header.identifier))
+        s << byte;
+    s << header.version;
+    s << header.flags;
+    s << header.format;
+    s << header.alignment;
+    s << header.width;
+    s << header.height;
+    s << header.depth;
+    s << header.faces;
+    s << header.levels;
+    s << header.layers;
+    s << header.dataOffset;
+    s << header.dataSize;
+    return s;
+}
+
+QDataStream &operator>>(QDataStream &s, TvcEntry &entry)
+{
+    quint32 compression = 0;
+    s >> entry.offset;
+    s >> entry.storedSize;
+    s >> entry.checksum;
+    s >> compression;
+    s >> entry.reserved;
+    entry.compression = Tvc::Compression(compression);
+    return s;
+}
+
+QDataStream &operator<<(QDataStream &s, const TvcEntry &entry)
+{
+    s << entry.offset;
+    s << entry.storedSize;
+    s << entry.checksum;
+    s << quint32(entry.compression);
+    s << entry.reserved;
+    return s;
+}
+
+QDebug &operator<<(QDebug &d, const TvcHeader &header)
+{
+    d << "TvcHeader {"
+      << "identifier:" << QLatin1String(reinterpret_cast<const char *>(header.identifier), 7) << ","
+      << "version:" << header.version << ","
+      << "flags:" << header.flags << ","
+      << "format:" << header.format << ","
+      << "alignment:" << header.alignment << ","
+      << "width:" << header.width << ","
+      << "height:" << header.height << ","
+      << "depth:" << header.depth << ","
+      << "faces:" << header.faces << ","
+      << "levels:" << header.levels << ","
+      << "layers:" << header.layers << ","
+      << "dataOffset:" << header.dataOffset << ","
+      << "dataSize:" << header.dataSize
+      << "}";
+    return d;
+}
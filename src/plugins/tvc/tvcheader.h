@@ -0,0 +1,57 @@
+#ifndef TVCHEADER_H
+#define TVCHEADER_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+
+namespace Tvc {
+
+constexpr quint8 identifier[8] = {'T', 'V', 'C', 'A', 'C', 'H', 'E', '\0'};
+constexpr quint32 version = 1;
+constexpr qint64 headerSize = 64;
+constexpr qint64 entrySize = 32;
+constexpr qint64 dataAlignment = 4096;
+
+enum class Compression : quint32 {
+    None = 0,
+    Zlib = 1,
+};
+
+} // namespace Tvc
+
+struct TvcHeader
+{
+    quint8 identifier[8] {};
+    quint32 version {0};
+    quint32 flags {0};
+    quint32 format {0};
+    quint32 alignment {0};
+    quint32 width {0};
+    quint32 height {0};
+    quint32 depth {0};
+    quint32 faces {0};
+    quint32 levels {0};
+    quint32 layers {0};
+    quint64 dataOffset {0};
+    quint64 dataSize {0};
+};
+
+// An entry of the subresource table, stored in the memory order: levels, then layers, then faces
+struct TvcEntry
+{
+    quint64 offset {0}; // from the beginning of the file
+    quint64 storedSize {0};
+    quint64 checksum {0}; // Texture::subresourceHash() of the uncompressed data
+    Tvc::Compression compression {Tvc::Compression::None};
+    quint32 reserved {0};
+};
+
+QDataStream &operator>>(QDataStream &s, TvcHeader &header);
+QDataStream &operator<<(QDataStream &s, const TvcHeader &header);
+
+QDataStream &operator>>(QDataStream &s, TvcEntry &entry);
+QDataStream &operator<<(QDataStream &s, const TvcEntry &entry);
+
+QDebug &operator<<(QDebug &d, const TvcHeader &header);
+
+#endif // TVCHEADER_H
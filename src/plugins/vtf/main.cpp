@@ -24,7 +24,14 @@ public:
     Capabilities capabilities(QStringView mimeType) const override
     {
         if (mimeType == u"image/x-vtf")
-            return Capability::CanRead;
+            return Capability::CanRead | Capability::CanWrite;
+        return {};
+    }
+
+    gsl::span<const FormatCapabilites> formatCapabilites(QStringView mimeType) const override
+    {
+        if (mimeType == u"image/x-vtf")
+            return VTFHandler::formatCapabilites();
         return {};
     }
 };
@@ -1,16 +1,44 @@
 #include "vtfhandler.h"
 #include "vtfenums.h"
+#include "vtflowres.h"
 
+#include <TextureLib/DeviceCursor>
 #include <TextureLib/Texture>
+#include <TextureLib/Tracing>
 
 #include <QtCore/QDataStream>
+#include <QtCore/QtEndian>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+// signature, version and header size
+static constexpr qint64 headerPrefixSize = 16;
+// 7.3+ header followed by the resource entries
+static constexpr quint32 maxHeaderSize = 80 + maxResourcesCount * 8;
+
+// the writer always produces 7.5 where cubemaps have no spheremap face
+static constexpr quint32 writeVersion[2] = {7, 5};
+// the low resolution image and the image resources
+static constexpr quint32 writeResourcesCount = 2;
 
 template<typename T>
 inline constexpr bool isPower2(T value) noexcept
 {
-    return (value - 1) ^ value;
+    return value && !(value & (value - 1));
 }
 
+// VTF stores cubemap faces in this order
+static constexpr Texture::Side vtfSides[] = {
+    Texture::Side::PositiveZ,
+    Texture::Side::NegativeZ,
+    Texture::Side::PositiveX,
+    Texture::Side::NegativeX,
+    Texture::Side::PositiveY,
+    Texture::Side::NegativeY
+};
+
 static bool validateHeader(const VTFHeader &header)
 {
     if (header.signature != 0x00465456) {
@@ -70,20 +98,6 @@ static bool validateHeader(const VTFHeader &header)
     return true;
 }
 
-static bool readPadding(VTFHandler::QIODevicePointer device, qint64 size)
-{
-    if (size == 0)
-        return true;
-
-    const auto buffer = std::make_unique<char[]>(size_t(size));
-    const auto read = device->read(buffer.get(), size);
-    if (read != size) {
-        qCWarning(vtfhandler) << "Can't read padding of size" << size
-                              << ":" << device->errorString();
-    }
-    return read == size;
-}
-
 static TextureFormat convertFormat(VTFImageFormat format)
 {
     switch (format) {
@@ -114,11 +128,50 @@ static TextureFormat convertFormat(VTFImageFormat format)
     }
 }
 
-static bool readTexture(
-        VTFHandler::QIODevicePointer device,
-        const VTFHeader &header,
-        Texture &texture)
+static VTFImageFormat convertFormat(TextureFormat format)
 {
+    // BlueScreen formats follow their plain counterparts, so they are never written
+    for (quint32 i = 0; i < quint32(VTFImageFormat::FormatCount); ++i) {
+        if (convertFormat(VTFImageFormat(i)) == format)
+            return VTFImageFormat(i);
+    }
+    return VTFImageFormat::None;
+}
+
+static VTFFlags alphaFlags(VTFImageFormat format)
+{
+    switch (format) {
+    case VTFImageFormat::DXT1_ONEBITALPHA:
+    case VTFImageFormat::BGRA_5551:
+        return VTFFlag::OneBitAlpha;
+    case VTFImageFormat::RGBA_8888:
+    case VTFImageFormat::ABGR_8888:
+    case VTFImageFormat::BGRA_8888:
+    case VTFImageFormat::BGRA_4444:
+    case VTFImageFormat::IA88:
+    case VTFImageFormat::A8:
+    case VTFImageFormat::DXT3:
+    case VTFImageFormat::DXT5:
+    case VTFImageFormat::RGBA_16161616F:
+    case VTFImageFormat::RGBA_16161616:
+        return VTFFlag::EightBitAlpha;
+    default:
+        return {};
+    }
+}
+
+static qint64 imageSize(TextureFormat format, Texture::Size size, int level)
+{
+    const auto width = std::max<qsizetype>(1, size.width >> level);
+    const auto height = std::max<qsizetype>(1, size.height >> level);
+    const auto depth = std::max<qsizetype>(1, size.depth >> level);
+    return Texture::calculateBytesPerSlice(format, width, height) * depth;
+}
+
+bool VTFHandler::readTexture(DeviceCursor &cursor, const VTFHeader &header, Texture &texture)
+{
+    TraceSpan span("handler", "VTFHandler::readPayload");
+
     const auto highFormat = vtfFormat(header.highResImageFormat);
     const auto format = convertFormat(highFormat);
     if (format == TextureFormat::Invalid) {
@@ -137,26 +190,18 @@ static bool readTexture(
         return false;
     }
 
-    const Texture::Side sides[] = {
-        Texture::Side::PositiveZ,
-        Texture::Side::NegativeZ,
-        Texture::Side::PositiveX,
-        Texture::Side::NegativeX,
-        Texture::Side::PositiveY,
-        Texture::Side::NegativeY
-    };
+    headerRead(result);
 
     for (int level = header.mipmapCount - 1; level >= 0; --level) {
         for (int layer = 0; layer < header.frames; ++layer) {
             for (int face = 0; face < (isCubemap ? 6 : 1); ++face) {
-                const auto side = isCubemap ? gsl::at(sides, face) : Texture::Side::PositiveX;
+                const auto side = isCubemap ? gsl::at(vtfSides, face) : Texture::Side::PositiveX;
                 const auto data = result.imageData({side, level, layer});
-                const auto read = device->read(reinterpret_cast<char *>(data.data()), data.size());
-                if (read != data.size()) {
-                    qCWarning(vtfhandler) << "Can't read from device:"
-                                          << device->errorString();
+                if (!cursor.read(data)) {
+                    qCWarning(vtfhandler) << "Can't read from device:" << cursor.errorString();
                     return false;
                 }
+                imageRead(result, {side, level, layer});
             }
         }
     }
@@ -167,9 +212,114 @@ static bool readTexture(
 
 bool VTFHandler::read(Texture &texture)
 {
+    TraceSpan span("handler", "VTFHandler::read");
+
+    DeviceCursor cursor(device().get());
+    const auto base = cursor.pos();
+
     VTFHeader header;
+    Offsets offsets;
+    if (!readHeader(cursor, header, offsets))
+        return false;
+
+    if (offsets.image < 0) {
+        qCWarning(vtfhandler) << "Can't find any image resource";
+        return false;
+    }
+
+    if (!cursor.seek(base + offsets.image)) {
+        qCWarning(vtfhandler) << "Can't seek to image data:" << cursor.errorString();
+        return false;
+    }
+
+    return readTexture(cursor, header, texture);
+}
+
+/*!
+    Reads the first image of the largest level that fits into previewSize(). Levels are stored
+    smallest first, so only the data of the smaller levels is skipped.
+
+    If all levels are bigger, the DXT1 low resolution image is returned.
+*/
+bool VTFHandler::readPreview(Texture &texture)
+{
+    TraceSpan span("handler", "VTFHandler::readPreview");
+
+    DeviceCursor cursor(device().get());
+    const auto base = cursor.pos();
+
+    VTFHeader header;
+    Offsets offsets;
+    if (!readHeader(cursor, header, offsets))
+        return false;
+
+    const auto format = convertFormat(vtfFormat(header.highResImageFormat));
+    const auto size = Texture::Size(header.width, header.height, std::max<quint16>(1, header.depth));
+    const auto level = format != TextureFormat::Invalid && offsets.image >= 0
+            ? previewLevel(size, header.mipmapCount)
+            : -1;
+
+    Texture result;
+    qint64 offset = 0;
+    if (level >= 0) {
+        const auto faces = bool(header.flags & VTFFlag::EnvironmentMap) ? 6 : 1;
+        offset = offsets.image;
+        for (int smaller = header.mipmapCount - 1; smaller > level; --smaller)
+            offset += qint64(header.frames) * faces * imageSize(format, size, smaller);
+        result = Texture(format, {
+                std::max<qsizetype>(1, size.width >> level),
+                std::max<qsizetype>(1, size.height >> level),
+                std::max<qsizetype>(1, size.depth >> level)});
+    } else if (offsets.lowRes >= 0 && header.lowResImageWidth && header.lowResImageHeight) {
+        offset = offsets.lowRes;
+        result = Texture(TextureFormat::Bc1Rgb_Unorm,
+                         {header.lowResImageWidth, header.lowResImageHeight});
+    } else {
+        qCDebug(vtfhandler) << "No image fits into the preview size";
+        return false;
+    }
+
+    if (result.isNull()) {
+        qCWarning(vtfhandler) << "Can't create preview texture";
+        return false;
+    }
+
+    if (!cursor.seek(base + offset) || !cursor.read(result.imageData({}))) {
+        qCWarning(vtfhandler) << "Can't read preview:" << cursor.errorString();
+        return false;
+    }
+
+    texture = std::move(result);
+    return true;
+}
+
+/*!
+    Reads the header and the resource entries and finds the offsets of the low resolution image
+    and the image data relative to the beginning of the file.
+
+    The whole header including the resource entries is read at once.
+*/
+bool VTFHandler::readHeader(DeviceCursor &cursor, VTFHeader &header, Offsets &offsets)
+{
+    auto headerData = cursor.read(headerPrefixSize);
+    if (headerData.size() != headerPrefixSize) {
+        qCWarning(vtfhandler) << "Can't read header:" << cursor.errorString();
+        return false;
+    }
+
+    const auto headerSize = qFromLittleEndian<quint32>(headerData.constData() + 12);
+    if (headerSize < headerPrefixSize || headerSize > maxHeaderSize) {
+        qCWarning(vtfhandler) << "Invalid header.headerSize:" << headerSize;
+        return false;
+    }
 
-    QDataStream s(device().get());
+    headerData += cursor.read(headerSize - headerPrefixSize);
+    if (headerData.size() != int(headerSize)) {
+        qCWarning(vtfhandler) << "Can't read header:" << cursor.errorString();
+        return false;
+    }
+
+    QDataStream s(headerData);
     s >> header;
 
     qCDebug(vtfhandler) << "header:" << header;
@@ -182,50 +332,37 @@ bool VTFHandler::read(Texture &texture)
     if (!validateHeader(header))
         return false;
 
-    // read padding after header before resources entries
-    if (!readPadding(device(), 15 - (device()->pos() + 15) % 16))
-        return false;
+    // skip padding after header before resources entries
+    s.skipRawData(int(15 - (s.device()->pos() + 15) % 16));
 
     if (header.version[0] == 7) {
         if (header.version[1] == 0
                 || header.version[1] == 1
                 || header.version[1] == 2) {
-            const auto lowSize = header.lowResImageHeight * header.lowResImageHeight / 2;
-            if (!readPadding(device(), lowSize))
-                return false;
-            return readTexture(device(), header, texture);
+            const auto lowSize = lowResImageBytes(
+                    {header.lowResImageWidth, header.lowResImageHeight});
+            offsets.lowRes = headerSize;
+            offsets.image = headerSize + lowSize;
+            return true;
         }
 
         if (header.version[1] == 3
                 || header.version[1] == 4
                 || header.version[1] == 5) {
-
-            std::vector<VTFResourceEntry> resources;
-            resources.reserve(header.numResources);
             for (quint32 i = 0; i < header.numResources; ++i) {
-                resources.emplace_back();
-                s >> resources.back();
+                VTFResourceEntry entry;
+                s >> entry;
+                if (entry.type == quint32(VTFResourceType::LegacyLowResolutionImage))
+                    offsets.lowRes = entry.data;
+                else if (entry.type == quint32(VTFResourceType::LegacyImage))
+                    offsets.image = entry.data;
             }
 
-            // Sort entries by offset in a file so we can simply skip padding instead of seeking
-            // (in case we need any other resources except Image)
-            const auto lessThan = [](const VTFResourceEntry &lhs, const VTFResourceEntry &rhs)
-            {
-                return lhs.data < rhs.data;
-            };
-            std::sort(resources.begin(), resources.end(), lessThan);
-
-            for (const auto &entry: resources) {
-                if (entry.type == quint32(VTFResourceType::LegacyImage)) {
-                    if (!readPadding(device(), entry.data - device()->pos()))
-                        return false;
-                    return readTexture(device(), header, texture);
-                }
+            if (s.status() != QDataStream::Ok) {
+                qCWarning(vtfhandler) << "Can't read resource entries";
+                return false;
             }
-
-            qCWarning(vtfhandler) << "Can't find any image resource";
-            return false;
-
+            return true;
         }
     }
 
@@ -234,4 +371,152 @@ bool VTFHandler::read(Texture &texture)
     return false;
 }
 
+bool VTFHandler::write(const Texture &texture)
+{
+    TraceSpan span("handler", "VTFHandler::write");
+
+    const auto format = convertFormat(texture.format());
+    if (format == VTFImageFormat::None) {
+        qCWarning(vtfhandler) << "format" << texture.format() << "is not supported";
+        return false;
+    }
+
+    const auto size = texture.size();
+    if (!isPower2(size.width) || !isPower2(size.height) || !isPower2(size.depth)
+            || size.width > std::numeric_limits<quint16>::max()
+            || size.height > std::numeric_limits<quint16>::max()
+            || size.depth > std::numeric_limits<quint16>::max()) {
+        qCWarning(vtfhandler) << "Texture size should be a power of 2 less than 65536:"
+                              << size.width << size.height << size.depth;
+        return false;
+    }
+
+    if (texture.levels() > std::numeric_limits<uchar>::max()
+            || texture.layers() > std::numeric_limits<quint16>::max()) {
+        qCWarning(vtfhandler) << "Too many levels or layers:"
+                              << texture.levels() << texture.layers();
+        return false;
+    }
+
+    const auto isCubemap = texture.faces() == 6;
+    const auto lowResSize = lowResImageSize(size);
+    const auto lowResImage = makeLowResImage(
+            texture, {isCubemap ? vtfSides[0] : Texture::Side::PositiveX, 0, 0}, lowResSize);
+
+    VTFFlags flags = alphaFlags(format);
+    if (isCubemap)
+        flags |= VTFFlag::EnvironmentMap;
+    if (texture.levels() == 1)
+        flags |= VTFFlag::NoMipmaps;
+
+    const auto headerSize = paddedHeaderSize + writeResourcesCount * 8;
+
+    VTFHeader header;
+    header.signature = 0x00465456;
+    header.version[0] = writeVersion[0];
+    header.version[1] = writeVersion[1];
+    header.headerSize = headerSize;
+    header.width = quint16(size.width);
+    header.height = quint16(size.height);
+    header.flags = flags;
+    header.frames = quint16(texture.layers());
+    header.firstFrame = 0;
+    header.reflectivity[0] = header.reflectivity[1] = header.reflectivity[2] = 0;
+    header.bumpmapScale = 1;
+    header.highResImageFormat = quint32(format);
+    header.mipmapCount = uchar(texture.levels());
+    header.lowResImageFormat = quint32(VTFImageFormat::DXT1);
+    header.lowResImageWidth = uchar(lowResSize.width());
+    header.lowResImageHeight = uchar(lowResSize.height());
+    header.depth = quint16(size.depth);
+    header.numResources = writeResourcesCount;
+
+    // The header, the resource directory and the low resolution image are written at once
+    QByteArray headerData;
+    {
+        QDataStream s(&headerData, QIODevice::WriteOnly);
+        s.setByteOrder(QDataStream::LittleEndian);
+        s << header;
+        while (headerData.size() < int(paddedHeaderSize))
+            s << quint8(0);
+        s << VTFResourceEntry{quint32(VTFResourceType::LegacyLowResolutionImage), headerSize};
+        s << VTFResourceEntry{
+                quint32(VTFResourceType::LegacyImage), headerSize + quint32(lowResImage.size())};
+    }
+    headerData += lowResImage;
+
+    if (device()->write(headerData) != headerData.size()) {
+        qCWarning(vtfhandler) << "Can't write header:" << device()->errorString();
+        return false;
+    }
+
+    TraceSpan payloadSpan("handler", "VTFHandler::writePayload");
+
+    const auto writeData = [this](const uchar *data, qsizetype size)
+    {
+        if (device()->write(reinterpret_cast<const char *>(data), size) == size)
+            return true;
+        qCWarning(vtfhandler) << "Can't write to device:" << device()->errorString();
+        return false;
+    };
+
+    // Images that are adjacent in the storage (e.g. all frames of a level) are written at once
+    Texture::ConstData pending;
+    const auto commit = [&pending, &writeData]
+    {
+        const auto data = std::exchange(pending, {});
+        return data.empty() || writeData(data.data(), data.size());
+    };
+
+    // Images are streamed in the file order: levels from the smallest one, then frames, then
+    // faces. VTF rows are tightly packed, rows of textures with a bigger alignment are realigned
+    // one by one
+    for (int level = texture.levels() - 1; level >= 0; --level) {
+        const auto lineSize = texture.bytesPerLine(level);
+        const auto packedLineSize =
+                Texture::calculateBytesPerLine(texture.format(), texture.width(level));
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            for (int face = 0; face < texture.faces(); ++face) {
+                const auto side = isCubemap ? gsl::at(vtfSides, face) : Texture::Side::PositiveX;
+                const auto data = texture.constImageData({side, level, layer});
+                if (lineSize != packedLineSize) {
+                    if (!commit())
+                        return false;
+                    const auto lines = data.size() / lineSize;
+                    for (qsizetype line = 0; line < lines; ++line) {
+                        if (!writeData(data.data() + line * lineSize, packedLineSize))
+                            return false;
+                    }
+                    continue;
+                }
+                if (!pending.empty() && pending.data() + pending.size() == data.data()) {
+                    pending = {pending.data(), pending.size() + data.size()};
+                    continue;
+                }
+                if (!commit())
+                    return false;
+                pending = data;
+            }
+        }
+    }
+
+    return commit();
+}
+
+gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> VTFHandler::formatCapabilites()
+{
+    // Only formats the writer maps back to the same VTF format
+    static const auto result = []
+    {
+        std::vector<TextureIOHandlerPlugin::FormatCapabilites> result;
+        for (quint32 i = 0; i < quint32(VTFImageFormat::FormatCount); ++i) {
+            const auto format = convertFormat(VTFImageFormat(i));
+            if (format != TextureFormat::Invalid && convertFormat(format) == VTFImageFormat(i))
+                result.push_back({format, TextureIOHandlerPlugin::Capability::ReadWrite});
+        }
+        return result;
+    }();
+    return result;
+}
+
 Q_LOGGING_CATEGORY(vtfhandler, "plugins.textureformats.vtfhandler")
@@ -3,8 +3,11 @@
 
 #include <QtCore/QLoggingCategory>
 #include <TextureLib/TextureIOHandler>
+#include <TextureLib/TextureIOHandlerPlugin>
 #include "vtfheader.h"
 
+class DeviceCursor;
+
 class VTFHandler : public TextureIOHandler
 {
 public:
@@ -12,6 +15,22 @@ public:
 
 public: // ImageIOHandler interface
     bool read(Texture &texture) override;
+    bool readPreview(Texture &texture) override;
+    bool write(const Texture &texture) override;
+
+public:
+    static gsl::span<const TextureIOHandlerPlugin::FormatCapabilites> formatCapabilites();
+
+private:
+    // Offsets of the resources from the beginning of the file, -1 if there is no resource
+    struct Offsets
+    {
+        qint64 lowRes {-1};
+        qint64 image {-1};
+    };
+
+    bool readHeader(DeviceCursor &cursor, VTFHeader &header, Offsets &offsets);
+    bool readTexture(DeviceCursor &cursor, const VTFHeader &header, Texture &texture);
 };
 
 Q_DECLARE_LOGGING_CATEGORY(vtfhandler)
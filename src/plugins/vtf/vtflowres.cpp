@@ -0,0 +1,285 @@
+#include "vtflowres.h"
+#include "vtfhandler.h"
+
+#include <TextureLib/Tracing>
+
+#include <QtCore/QtEndian>
+#include <QtGui/QRgb>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr qsizetype dxt1BlockSize = 8;
+// The box filter reads at most maxTaps x maxTaps texels per low resolution texel
+constexpr qsizetype maxTaps = 4;
+
+using Block = std::array<QRgb, 16>;
+
+constexpr quint16 toRgb565(int red, int green, int blue) noexcept
+{
+    return quint16((((red * 31 + 127) / 255) << 11)
+                   | (((green * 63 + 127) / 255) << 5)
+                   | ((blue * 31 + 127) / 255));
+}
+
+constexpr QRgb fromRgb565(quint16 color) noexcept
+{
+    const int red = (color >> 11) & 0x1f;
+    const int green = (color >> 5) & 0x3f;
+    const int blue = color & 0x1f;
+    return qRgb((red << 3) | (red >> 2), (green << 2) | (green >> 4), (blue << 3) | (blue >> 2));
+}
+
+constexpr QRgb mixColors(QRgb color0, QRgb color1) noexcept
+{
+    return qRgb((2 * qRed(color0) + qRed(color1)) / 3,
+                (2 * qGreen(color0) + qGreen(color1)) / 3,
+                (2 * qBlue(color0) + qBlue(color1)) / 3);
+}
+
+constexpr int distance(QRgb lhs, QRgb rhs) noexcept
+{
+    const auto red = qRed(lhs) - qRed(rhs);
+    const auto green = qGreen(lhs) - qGreen(rhs);
+    const auto blue = qBlue(lhs) - qBlue(rhs);
+    return red * red + green * green + blue * blue;
+}
+
+void storeBlock(uchar *dst, quint16 color0, quint16 color1, quint32 indices)
+{
+    qToLittleEndian(color0, dst);
+    qToLittleEndian(color1, dst + 2);
+    qToLittleEndian(indices, dst + 4);
+}
+
+// Encodes an opaque block in the 4-color mode. The endpoints are the corners of the color
+// bounding box inset by 1/16 of its size, which reduces the error of the interpolated colors
+void encodeBlock(const Block &block, uchar *dst)
+{
+    int min[3] = {255, 255, 255};
+    int max[3] = {0, 0, 0};
+    for (const auto texel: block) {
+        const int channels[3] = {qRed(texel), qGreen(texel), qBlue(texel)};
+        for (int i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], channels[i]);
+            max[i] = std::max(max[i], channels[i]);
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        const auto inset = (max[i] - min[i]) / 16;
+        min[i] += inset;
+        max[i] -= inset;
+    }
+
+    // Quantization is monotonic, so color0 >= color1
+    const auto color0 = toRgb565(max[0], max[1], max[2]);
+    const auto color1 = toRgb565(min[0], min[1], min[2]);
+    if (color0 == color1) {
+        storeBlock(dst, color0, color1, 0);
+        return;
+    }
+
+    const QRgb palette[4] = {
+        fromRgb565(color0),
+        fromRgb565(color1),
+        mixColors(fromRgb565(color0), fromRgb565(color1)),
+        mixColors(fromRgb565(color1), fromRgb565(color0))
+    };
+
+    quint32 indices = 0;
+    for (size_t i = 0; i < block.size(); ++i) {
+        quint32 best = 0;
+        for (quint32 j = 1; j < 4; ++j) {
+            if (distance(block[i], palette[j]) < distance(block[i], palette[best]))
+                best = j;
+        }
+        indices |= best << (2 * i);
+    }
+    storeBlock(dst, color0, color1, indices);
+}
+
+// The color part of DXT3 and DXT5 blocks is always decoded in the 4-color mode while DXT1 selects
+// it by color0 > color1, so the endpoints (and the indices) are swapped when needed
+void copyColorBlock(const uchar *src, uchar *dst)
+{
+    const auto color0 = qFromLittleEndian<quint16>(src);
+    const auto color1 = qFromLittleEndian<quint16>(src + 2);
+    const auto indices = qFromLittleEndian<quint32>(src + 4);
+    if (color0 > color1)
+        memcpy(dst, src, dxt1BlockSize);
+    else if (color0 == color1)
+        storeBlock(dst, color0, color1, 0);
+    else
+        storeBlock(dst, color1, color0, indices ^ 0x55555555u);
+}
+
+constexpr int expand(int value, int bits) noexcept
+{
+    return value * 255 / ((1 << bits) - 1);
+}
+
+// Texture has no texel readers for the 16-bit packed formats VTF supports, so they are decoded
+// here; the layouts match the DDS masks of these formats
+bool isPacked(TextureFormat format) noexcept
+{
+    return format == TextureFormat::BGR565_Unorm
+            || format == TextureFormat::RGB565_Unorm
+            || format == TextureFormat::BGRA4_Unorm
+            || format == TextureFormat::BGRA5551_Unorm
+            || format == TextureFormat::BGRX5551_Unorm;
+}
+
+QRgb readPacked(TextureFormat format, const uchar *texel) noexcept
+{
+    const auto value = int(qFromLittleEndian<quint16>(texel));
+    switch (format) {
+    case TextureFormat::BGR565_Unorm:
+        return qRgb(expand(value >> 11, 5), expand((value >> 5) & 0x3f, 6), expand(value & 0x1f, 5));
+    case TextureFormat::RGB565_Unorm:
+        return qRgb(expand(value & 0x1f, 5), expand((value >> 5) & 0x3f, 6), expand(value >> 11, 5));
+    case TextureFormat::BGRA4_Unorm:
+        return qRgb(expand((value >> 8) & 0xf, 4), expand((value >> 4) & 0xf, 4),
+                    expand(value & 0xf, 4));
+    case TextureFormat::BGRA5551_Unorm:
+    case TextureFormat::BGRX5551_Unorm:
+        return qRgb(expand((value >> 10) & 0x1f, 5), expand((value >> 5) & 0x1f, 5),
+                    expand(value & 0x1f, 5));
+    default:
+        return qRgb(0, 0, 0);
+    }
+}
+
+bool hasReader(TextureFormat format)
+{
+    const auto formats = Texture::supportedConvertions();
+    return std::find(formats.begin(), formats.end(), format) != formats.end();
+}
+
+} // namespace
+
+/*!
+    Returns the size of the low resolution image for the texture of the given \a size.
+
+    The image is at most 16x16 and keeps the aspect ratio of the texture.
+*/
+QSize lowResImageSize(Texture::Size size)
+{
+    const auto scale = std::max<qsizetype>(
+            1, std::max(size.width, size.height) / maxLowResImageSize);
+    return {int(std::max<qsizetype>(1, size.width / scale)),
+            int(std::max<qsizetype>(1, size.height / scale))};
+}
+
+/*!
+    Returns the size in bytes of the DXT1 low resolution image of the given \a size.
+*/
+qsizetype lowResImageBytes(QSize size)
+{
+    return qsizetype((size.width() + 3) / 4) * ((size.height() + 3) / 4) * dxt1BlockSize;
+}
+
+/*!
+    Creates the DXT1 low resolution image of the given \a size from the image at \a index of the
+    \a texture.
+
+    The image is taken from the smallest level that is not smaller than \a size; with a full mip
+    chain it has exactly the same size, so the bigger levels are not touched and no copy of the
+    texture is made. Texels are read with Texture::texelColor() and box-filtered when the level is
+    bigger. DXT1, DXT3 and DXT5 textures are not decoded, their color blocks are reused instead.
+    The 16-bit packed formats are decoded directly; for other formats that can't be read the image
+    is black.
+
+    Only the first slice of volume textures is used.
+*/
+QByteArray makeLowResImage(const Texture &texture, Texture::ArrayIndex index, QSize size)
+{
+    TraceSpan span("handler", "VTFHandler::makeLowResImage");
+
+    auto level = texture.levels() - 1;
+    while (level > 0
+           && (texture.width(level) < size.width() || texture.height(level) < size.height())) {
+        --level;
+    }
+    index.setLevel(level);
+
+    const auto blocksX = qsizetype((size.width() + 3) / 4);
+    const auto blocksY = qsizetype((size.height() + 3) / 4);
+    QByteArray result(int(lowResImageBytes(size)), Qt::Uninitialized);
+    auto dst = reinterpret_cast<uchar *>(result.data());
+
+    if (texture.isCompressed()) {
+        const auto data = texture.constImageData(index);
+        const auto blockSize = Texture::calculateBytesPerLine(texture.format(), 4);
+        const auto colorOffset = blockSize - dxt1BlockSize;
+        const auto lineSize = texture.bytesPerLine(level);
+        const auto levelBlocksX = (texture.width(level) + 3) / 4;
+        const auto levelBlocksY = (texture.height(level) + 3) / 4;
+        for (qsizetype y = 0; y < blocksY; ++y) {
+            for (qsizetype x = 0; x < blocksX; ++x) {
+                const auto src = data.data()
+                        + lineSize * (y * levelBlocksY / blocksY)
+                        + blockSize * (x * levelBlocksX / blocksX)
+                        + colorOffset;
+                copyColorBlock(src, dst);
+                dst += dxt1BlockSize;
+            }
+        }
+        return result;
+    }
+
+    const auto format = texture.format();
+    const auto packed = isPacked(format);
+    if (!packed && !hasReader(format)) {
+        qCWarning(vtfhandler) << "Can't read texels of format" << format
+                              << "- the low resolution image is black";
+        result.fill('\0');
+        return result;
+    }
+    const auto packedData = packed ? texture.constImageData(index) : Texture::ConstData();
+    const auto packedLineSize = packed ? texture.bytesPerLine(level) : 0;
+    const auto readTexel = [&](Texture::Position position) -> QRgb
+    {
+        if (packed)
+            return readPacked(format, packedData.data() + packedLineSize * position.y + 2 * position.x);
+        return qRgba(texture.texelColor(position, index));
+    };
+
+    const auto scaleX = texture.width(level) / size.width();
+    const auto scaleY = texture.height(level) / size.height();
+    const auto tapsX = std::min(scaleX, maxTaps);
+    const auto tapsY = std::min(scaleY, maxTaps);
+
+    const auto filter = [&](qsizetype x, qsizetype y)
+    {
+        int sum[3] = {0, 0, 0};
+        for (qsizetype tapY = 0; tapY < tapsY; ++tapY) {
+            for (qsizetype tapX = 0; tapX < tapsX; ++tapX) {
+                const auto position = Texture::Position(
+                        x * scaleX + tapX * scaleX / tapsX, y * scaleY + tapY * scaleY / tapsY);
+                const auto color = readTexel(position);
+                sum[0] += qRed(color);
+                sum[1] += qGreen(color);
+                sum[2] += qBlue(color);
+            }
+        }
+        const auto taps = int(tapsX * tapsY);
+        return qRgb(sum[0] / taps, sum[1] / taps, sum[2] / taps);
+    };
+
+    Block block;
+    for (qsizetype blockY = 0; blockY < blocksY; ++blockY) {
+        for (qsizetype blockX = 0; blockX < blocksX; ++blockX) {
+            for (qsizetype i = 0; i < 16; ++i) {
+                const auto x = std::min<qsizetype>(blockX * 4 + i % 4, size.width() - 1);
+                const auto y = std::min<qsizetype>(blockY * 4 + i / 4, size.height() - 1);
+                block[size_t(i)] = filter(x, y);
+            }
+            encodeBlock(block, dst);
+            dst += dxt1BlockSize;
+        }
+    }
+    return result;
+}
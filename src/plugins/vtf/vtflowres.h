@@ -0,0 +1,15 @@
+#ifndef VTFLOWRES_H
+#define VTFLOWRES_H
+
+#include <TextureLib/Texture>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSize>
+
+constexpr int maxLowResImageSize = 16;
+
+QSize lowResImageSize(Texture::Size size);
+qsizetype lowResImageBytes(QSize size);
+QByteArray makeLowResImage(const Texture &texture, Texture::ArrayIndex index, QSize size);
+
+#endif // VTFLOWRES_H
@@ -0,0 +1,81 @@
+#ifndef TESTHELPERS_H
+#define TESTHELPERS_H
+
+#include <TextureLib/Texture>
+
+#include <QtCore/QBuffer>
+
+#include <cstring>
+
+namespace TestHelpers {
+
+// Counts device calls; opened unbuffered, every QIODevice call reaches the device
+class CountingBuffer : public QBuffer
+{
+public:
+    using QBuffer::QBuffer;
+
+    int reads() const { return m_reads; }
+    int writes() const { return m_writes; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        ++m_reads;
+        return QBuffer::readData(data, maxSize);
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        ++m_writes;
+        return QBuffer::writeData(data, maxSize);
+    }
+
+private:
+    int m_reads {0};
+    int m_writes {0};
+};
+
+// How makeTexture() fills the images
+enum class Pattern {
+    Noise, // differs between neighbouring bytes, images, levels and layers
+    Runs,  // runs of 64 equal bytes, compresses well
+};
+
+inline Texture makeTexture(
+        TextureFormat format,
+        Texture::Size size,
+        Texture::ArraySize arraySize,
+        Texture::Alignment alignment = Texture::Alignment::Byte,
+        Pattern pattern = Pattern::Noise)
+{
+    auto result = Texture(format, size, arraySize, alignment);
+    for (int level = 0; level < result.levels(); ++level) {
+        for (int layer = 0; layer < result.layers(); ++layer) {
+            for (int face = 0; face < result.faces(); ++face) {
+                const auto data = result.imageData({Texture::Side(face), level, layer});
+                const auto seed = face * 17 + layer * 5 + level;
+                for (qsizetype i = 0; i < data.size(); ++i) {
+                    data[i] = pattern == Pattern::Runs
+                            ? uchar((i / 64) * 3 + seed)
+                            : uchar(i * 7 + seed);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// The image at the given index as a texture with a single level, layer and face
+inline Texture imageTexture(const Texture &texture, Texture::ArrayIndex index)
+{
+    auto result = Texture(
+            texture.format(), texture.size(index.level()), {1, 1}, texture.alignment());
+    const auto data = texture.constImageData(index);
+    memcpy(result.imageData({}).data(), data.data(), size_t(data.size()));
+    return result;
+}
+
+} // namespace TestHelpers
+
+#endif // TESTHELPERS_H
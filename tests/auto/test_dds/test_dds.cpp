@@ -43,6 +43,12 @@
 #include <QtTest/QtTest>
 #include <TextureLib/TextureIO>
 
+#include <QtCore/QBuffer>
+
+#include "testhelpers.h"
+
+using namespace TestHelpers;
+
 static bool verifyTexture(const Texture &texture, const QImage &second)
 {
     QImage image = second.convertToFormat(QImage::Format_ARGB32);
@@ -59,6 +65,8 @@ static bool verifyTexture(const Texture &texture, const QImage &second)
     return memcmp(texture.data().data(), image.bits(), image.sizeInBytes()) == 0;
 }
 
+Q_DECLARE_METATYPE(Texture)
+
 class TestDds: public QObject
 {
     Q_OBJECT
@@ -67,6 +75,14 @@ private slots:
     void initTestCase();
     void testRead_data();
     void testRead();
+    void readCalls_data();
+    void readCalls();
+    void writeCalls();
+    void readCallbacks();
+    void roundtrip_data();
+    void roundtrip();
+    void preview_data();
+    void preview();
     void benchRead_data();
     void benchRead();
 };
@@ -104,6 +120,217 @@ void TestDds::testRead()
     QVERIFY(verifyTexture(*result, QImage(sourcePath)));
 }
 
+void TestDds::readCalls_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("RGBA8, mipmaps") << QStringLiteral(":/dds/RGBA8_Unorm.dds");
+    QTest::newRow("cubemap") << QStringLiteral(":/dds/cubemap.dds");
+}
+
+void TestDds::readCalls()
+{
+    QFETCH(QString, fileName);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    auto bytes = file.readAll();
+
+    TextureIO fileReader(fileName, QStringLiteral("image/x-dds"));
+    const auto expected = fileReader.read();
+    QVERIFY2(expected, qPrintable(toUserString(expected.error())));
+
+    CountingBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(*result, *expected);
+
+    // Subresources are moved in blocks of 4 MiB instead of one read per image
+    const auto maxReads = 2 * (bytes.size() / (4 * 1024 * 1024) + 2);
+    QVERIFY2(buffer.reads() <= maxReads,
+             qPrintable(QStringLiteral("%1 reads, expected at most %2")
+                        .arg(buffer.reads()).arg(maxReads)));
+}
+
+void TestDds::writeCalls()
+{
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {256, 256}, {9, 1});
+    QVERIFY(!texture.isNull());
+    const auto data = texture.data();
+    for (qsizetype i = 0; i < data.size(); ++i)
+        data[i] = uchar(i * 13);
+
+    QByteArray bytes;
+    CountingBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly | QIODevice::Unbuffered));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    // The header and all levels are written at once
+    QCOMPARE(buffer.writes(), 1);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(*result, texture);
+}
+
+void TestDds::readCallbacks()
+{
+    // The 4 MiB base levels are read separately while the small levels are batched
+    const auto texture = makeTexture(
+            TextureFormat::RGBA8_Unorm, {1024, 1024}, {11, 2}, Texture::Alignment::Byte);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    int headers = 0;
+    bool headerMatches = false;
+    bool imagesMatch = true;
+    std::vector<Texture::ArrayIndex> indexes;
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    reader.setHeaderCallback([&](const Texture &result)
+    {
+        ++headers;
+        headerMatches = indexes.empty()
+                && result.format() == texture.format()
+                && result.width() == texture.width()
+                && result.height() == texture.height()
+                && result.levels() == texture.levels()
+                && result.layers() == texture.layers();
+    });
+    reader.setImageCallback([&](const Texture &result, Texture::ArrayIndex index)
+    {
+        indexes.push_back(index);
+        const auto image = result.constImageData(index);
+        const auto expected = texture.constImageData(index);
+        imagesMatch = imagesMatch
+                && std::equal(image.begin(), image.end(), expected.begin(), expected.end());
+    });
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(*result, texture);
+
+    QCOMPARE(headers, 1);
+    QVERIFY(headerMatches);
+    QVERIFY(imagesMatch);
+
+    // Images are reported once each, in the file order
+    const auto levels = int(texture.levels());
+    QCOMPARE(int(indexes.size()), levels * int(texture.layers()));
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        QCOMPARE(int(indexes[i].layer()), int(i) / levels);
+        QCOMPARE(int(indexes[i].level()), int(i) % levels);
+    }
+}
+
+void TestDds::roundtrip_data()
+{
+    QTest::addColumn<Texture>("texture");
+
+    QTest::newRow("RGBA8_Unorm, cubemap, mipmaps")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {32, 32},
+                           {Texture::IsCubemap::Yes, 6, 1}, Texture::Alignment::Byte);
+    QTest::newRow("RGBA8_Unorm, cubemap array")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {16, 16},
+                           {Texture::IsCubemap::Yes, 5, 3}, Texture::Alignment::Word);
+    QTest::newRow("Bc1Rgb_Unorm, array, mipmaps")
+            << makeTexture(TextureFormat::Bc1Rgb_Unorm, {64, 64}, {7, 4}, Texture::Alignment::Byte);
+    QTest::newRow("RGBA16_Float, volume, mipmaps")
+            << makeTexture(TextureFormat::RGBA16_Float, {16, 8, 4}, {5, 1}, Texture::Alignment::Byte);
+    QTest::newRow("BGR8_Unorm, word aligned, volume")
+            << makeTexture(TextureFormat::BGR8_Unorm, {63, 17, 3}, {6, 1}, Texture::Alignment::Word);
+}
+
+void TestDds::roundtrip()
+{
+    QFETCH(Texture, texture);
+    QVERIFY(!texture.isNull());
+
+    QByteArray bytes;
+    CountingBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly | QIODevice::Unbuffered));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    // Small subresources and realigned rows are gathered into a single write
+    QCOMPARE(buffer.writes(), 1);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QVERIFY(buffer.atEnd());
+    QCOMPARE(result->alignment(), Texture::Alignment::Byte);
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestDds::preview_data()
+{
+    QTest::addColumn<Texture>("texture");
+    QTest::addColumn<int>("previewSize");
+    QTest::addColumn<int>("level");
+
+    QTest::newRow("Bc1Rgb_Unorm, array, mipmaps")
+            << makeTexture(TextureFormat::Bc1Rgb_Unorm, {64, 64}, {7, 4}, Texture::Alignment::Byte)
+            << 16 << 2;
+    QTest::newRow("RGBA8_Unorm, cubemap, mipmaps")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {32, 32},
+                           {Texture::IsCubemap::Yes, 6, 1}, Texture::Alignment::Byte)
+            << 8 << 2;
+    QTest::newRow("RGBA16_Float, volume, mipmaps")
+            << makeTexture(TextureFormat::RGBA16_Float, {16, 8, 4}, {5, 1}, Texture::Alignment::Byte)
+            << 4 << 2;
+    QTest::newRow("RGBA8_Unorm, no level fits")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {32, 32}, {1, 1}, Texture::Alignment::Byte)
+            << 16 << -1;
+}
+
+void TestDds::preview()
+{
+    QFETCH(Texture, texture);
+    QFETCH(int, previewSize);
+    QFETCH(int, level);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-dds"));
+    reader.setPreviewSize(previewSize);
+    const auto preview = reader.readPreview();
+    if (level < 0) {
+        QVERIFY(!preview);
+    } else {
+        QVERIFY2(preview, qPrintable(toUserString(preview.error())));
+        QCOMPARE(*preview, imageTexture(texture, {Texture::Side::PositiveX, level, 0}));
+    }
+
+    // The device is moved back, so the whole texture can be read afterwards
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
 void TestDds::benchRead_data()
 {
     QTest::addColumn<QString>("fileName");
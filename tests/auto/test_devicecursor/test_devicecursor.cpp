@@ -0,0 +1,198 @@
+#include <QtTest>
+#include <TextureLib/DeviceCursor>
+
+namespace {
+
+// In-memory device that counts readData() calls and can pretend to be sequential
+class CountingDevice : public QIODevice
+{
+public:
+    CountingDevice(const QByteArray &data, bool sequential)
+        : m_data(data)
+        , m_sequential(sequential)
+    {
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const override { return m_sequential; }
+    qint64 size() const override { return m_sequential ? 0 : m_data.size(); }
+
+    bool seek(qint64 pos) override
+    {
+        if (m_sequential || pos > m_data.size())
+            return false;
+        m_offset = pos;
+        return QIODevice::seek(pos);
+    }
+
+    int reads() const { return m_reads; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        ++m_reads;
+        const auto size = std::min(maxSize, m_data.size() - m_offset);
+        memcpy(data, m_data.constData() + m_offset, size_t(size));
+        m_offset += size;
+        return size;
+    }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QByteArray m_data;
+    qint64 m_offset {0};
+    bool m_sequential {false};
+    int m_reads {0};
+};
+
+QByteArray makeData(int size)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        result[i] = char(i * 7);
+    return result;
+}
+
+} // namespace
+
+class TestDeviceCursor : public QObject
+{
+    Q_OBJECT
+private slots:
+    void read_data();
+    void read();
+    void largeRead();
+    void skip_data();
+    void skip();
+    void seek();
+    void sync();
+};
+
+void TestDeviceCursor::read_data()
+{
+    QTest::addColumn<bool>("sequential");
+    QTest::addColumn<int>("expectedReads");
+
+    // small reads are served from one read-ahead buffer
+    QTest::newRow("random-access") << false << 1;
+    // no read-ahead on sequential devices
+    QTest::newRow("sequential") << true << 64;
+}
+
+void TestDeviceCursor::read()
+{
+    QFETCH(bool, sequential);
+    QFETCH(int, expectedReads);
+
+    const auto data = makeData(1024);
+    CountingDevice device(data, sequential);
+    DeviceCursor cursor(&device, 1024);
+
+    for (int i = 0; i < 64; ++i) {
+        char value[16];
+        QVERIFY(cursor.read(value, sizeof(value)));
+        QCOMPARE(QByteArray(value, sizeof(value)), data.mid(i * 16, 16));
+    }
+    QCOMPARE(cursor.pos(), 1024);
+    QCOMPARE(device.reads(), expectedReads);
+    QCOMPARE(cursor.deviceReads(), expectedReads);
+
+    char value = 0;
+    QVERIFY(!cursor.read(&value, 1));
+    QVERIFY(!cursor.errorString().isEmpty());
+}
+
+void TestDeviceCursor::largeRead()
+{
+    const auto data = makeData(10000);
+    CountingDevice device(data, false);
+    DeviceCursor cursor(&device, 4096);
+
+    QCOMPARE(cursor.read(100), data.left(100));
+    QCOMPARE(device.reads(), 1);
+
+    // the rest of the buffer is copied, the remainder goes directly into the destination
+    QCOMPARE(cursor.read(9000), data.mid(100, 9000));
+    QCOMPARE(device.reads(), 2);
+
+    // reads past the end return the available data
+    QCOMPARE(cursor.read(1000), data.mid(9100));
+    QVERIFY(!cursor.errorString().isEmpty());
+}
+
+void TestDeviceCursor::skip_data()
+{
+    QTest::addColumn<bool>("sequential");
+    QTest::addColumn<int>("expectedReads");
+
+    QTest::newRow("random-access") << false << 0;
+    // the scratch buffer is reused for every chunk
+    QTest::newRow("sequential") << true << 25;
+}
+
+void TestDeviceCursor::skip()
+{
+    QFETCH(bool, sequential);
+    QFETCH(int, expectedReads);
+
+    const auto data = makeData(100 * 1024 + 16);
+    CountingDevice device(data, sequential);
+    DeviceCursor cursor(&device, 4096);
+
+    QVERIFY(cursor.skip(100 * 1024));
+    QCOMPARE(cursor.pos(), 100 * 1024);
+    QCOMPARE(device.reads(), expectedReads);
+
+    QCOMPARE(cursor.read(16), data.mid(100 * 1024));
+
+    QVERIFY(!cursor.skip(1));
+    QVERIFY(!cursor.skip(-1));
+}
+
+void TestDeviceCursor::seek()
+{
+    const auto data = makeData(10000);
+    {
+        CountingDevice device(data, false);
+        DeviceCursor cursor(&device, 4096);
+
+        QCOMPARE(cursor.read(100), data.left(100));
+        // backwards within the buffer, no device access
+        QVERIFY(cursor.seek(10));
+        QCOMPARE(cursor.read(10), data.mid(10, 10));
+        QCOMPARE(device.reads(), 1);
+
+        QVERIFY(cursor.seek(8000));
+        QCOMPARE(cursor.read(10), data.mid(8000, 10));
+        QVERIFY(cursor.seek(20));
+        QCOMPARE(cursor.read(10), data.mid(20, 10));
+        QCOMPARE(cursor.pos(), 30);
+    }
+    {
+        CountingDevice device(data, true);
+        DeviceCursor cursor(&device, 4096);
+
+        QVERIFY(cursor.seek(5000));
+        QCOMPARE(cursor.read(10), data.mid(5000, 10));
+        QVERIFY(!cursor.seek(10));
+        QVERIFY(!cursor.errorString().isEmpty());
+    }
+}
+
+void TestDeviceCursor::sync()
+{
+    const auto data = makeData(10000);
+    CountingDevice device(data, false);
+    {
+        DeviceCursor cursor(&device, 4096);
+        QCOMPARE(cursor.read(100), data.left(100));
+        QCOMPARE(cursor.pos(), 100);
+    }
+    // the data read ahead is given back to the device
+    QCOMPARE(device.pos(), 100);
+    QCOMPARE(device.read(10), data.mid(100, 10));
+}
+
+QTEST_MAIN(TestDeviceCursor)
+#include "test_devicecursor.moc"
@@ -1,8 +1,17 @@
+#include <TextureLib/DeviceCursor>
 #include <TextureLib/TextureIO>
 
 #include <QtTest/QtTest>
 
+#include <QtCore/QBuffer>
 #include <QtCore/QMimeDatabase>
+#include <QtCore/QtEndian>
+
+#include "testhelpers.h"
+
+using namespace TestHelpers;
+
+Q_DECLARE_METATYPE(Texture)
 
 class TestKTX: public QObject
 {
@@ -10,6 +19,15 @@ class TestKTX: public QObject
 
 private slots:
     void initTestCase();
+    void roundtrip_data();
+    void roundtrip();
+    void ktx2Roundtrip_data();
+    void ktx2Roundtrip();
+    void preview_data();
+    void preview();
+    void readLevel();
+    void readCalls_data();
+    void readCalls();
     void benchRead_data();
     void benchRead();
 };
@@ -19,7 +37,256 @@ void TestKTX::initTestCase()
     qApp->addLibraryPath(qApp->applicationDirPath() + TextureIO::pluginsDirPath());
     Q_INIT_RESOURCE(extramimetypes);
     Q_INIT_RESOURCE(images);
-    QLoggingCategory::setFilterRules(QStringLiteral("plugins.textureformats.ktxhandler.debug=false"));
+    QLoggingCategory::setFilterRules(QStringLiteral("plugins.textureformats.ktx*handler.debug=false"));
+}
+
+void TestKTX::roundtrip_data()
+{
+    QTest::addColumn<Texture>("texture");
+
+    QTest::newRow("RGBA8_Unorm, word aligned, mipmaps")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {7, 1}, Texture::Alignment::Word);
+    QTest::newRow("RGB8_Unorm, byte aligned, mipmaps")
+            << makeTexture(TextureFormat::RGB8_Unorm, {63, 17}, {6, 1}, Texture::Alignment::Byte);
+    QTest::newRow("RGBA8_Unorm, cubemap")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {16, 16},
+                           {Texture::IsCubemap::Yes, 5, 1}, Texture::Alignment::Word);
+    QTest::newRow("BGRA8_Unorm, cubemap array")
+            << makeTexture(TextureFormat::BGRA8_Unorm, {16, 16},
+                           {Texture::IsCubemap::Yes, 2, 3}, Texture::Alignment::Word);
+    QTest::newRow("RGBA16_Float, volume")
+            << makeTexture(TextureFormat::RGBA16_Float, {8, 8, 4}, {4, 1}, Texture::Alignment::Word);
+    QTest::newRow("RGB8_ETC2, mipmaps")
+            << makeTexture(TextureFormat::RGB8_ETC2, {64, 64}, {7, 1}, Texture::Alignment::Byte);
+}
+
+void TestKTX::roundtrip()
+{
+    QFETCH(Texture, texture);
+    QVERIFY(!texture.isNull());
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-ktx"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    // the key/value data and every level are padded to 4 bytes
+    QCOMPARE(bytes.size() % 4, 0);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-ktx"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QVERIFY(buffer.atEnd());
+    QCOMPARE(result->alignment(), Texture::Alignment::Word);
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestKTX::ktx2Roundtrip_data()
+{
+    QTest::addColumn<Texture>("texture");
+    QTest::addColumn<int>("compression");
+
+    const auto addRows = [](const char *name, const Texture &texture) {
+        QTest::newRow(name) << texture << -1;
+        QTest::newRow(qPrintable(QStringLiteral("%1, zlib").arg(QLatin1String(name))))
+                << texture << 6;
+    };
+
+    addRows("RGBA8_Unorm, word aligned, mipmaps",
+            makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {7, 1}, Texture::Alignment::Word));
+    addRows("RGB8_Unorm, word aligned, mipmaps",
+            makeTexture(TextureFormat::RGB8_Unorm, {63, 17}, {6, 1}, Texture::Alignment::Word));
+    addRows("BGRA8_Unorm, cubemap array",
+            makeTexture(TextureFormat::BGRA8_Unorm, {16, 16},
+                        {Texture::IsCubemap::Yes, 5, 3}, Texture::Alignment::Byte));
+    addRows("RGBA32_Float, volume",
+            makeTexture(TextureFormat::RGBA32_Float, {8, 8, 4}, {4, 1}, Texture::Alignment::Byte));
+    addRows("Bc1Rgba_Unorm, array, mipmaps",
+            makeTexture(TextureFormat::Bc1Rgba_Unorm, {64, 64}, {7, 2}, Texture::Alignment::Byte));
+    addRows("Bc7_Unorm, cubemap",
+            makeTexture(TextureFormat::Bc7_Unorm, {32, 32},
+                        {Texture::IsCubemap::Yes, 6, 1}, Texture::Alignment::Byte));
+}
+
+void TestKTX::ktx2Roundtrip()
+{
+    QFETCH(Texture, texture);
+    QFETCH(int, compression);
+    QVERIFY(!texture.isNull());
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/ktx2"));
+    writer.setCompression(compression);
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    // supercompressionScheme is at offset 44
+    const auto scheme = qFromLittleEndian<quint32>(bytes.constData() + 44);
+    QCOMPARE(scheme, compression > 0 ? 3u : 0u);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/ktx2"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QVERIFY(buffer.atEnd());
+    QCOMPARE(result->alignment(), Texture::Alignment::Byte);
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestKTX::preview_data()
+{
+    QTest::addColumn<Texture>("texture");
+    QTest::addColumn<int>("previewSize");
+    QTest::addColumn<int>("level");
+    QTest::addColumn<QString>("mimeType");
+
+    for (const auto &mimeType: {QStringLiteral("image/x-ktx"), QStringLiteral("image/ktx2")}) {
+        const auto addRow = [&mimeType](const char *name, const Texture &texture, int size, int level)
+        {
+            QTest::newRow(qPrintable(QStringLiteral("%1, %2").arg(mimeType, QLatin1String(name))))
+                    << texture << size << level << mimeType;
+        };
+        addRow("RGBA8_Unorm, word aligned, mipmaps",
+               makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {7, 1}, Texture::Alignment::Word),
+               16, 2);
+        addRow("RGB8_Unorm, array, mipmaps",
+               makeTexture(TextureFormat::RGB8_Unorm, {30, 30}, {5, 3}, Texture::Alignment::Byte),
+               8, 2);
+        addRow("BGRA8_Unorm, cubemap",
+               makeTexture(TextureFormat::BGRA8_Unorm, {16, 16},
+                           {Texture::IsCubemap::Yes, 5, 1}, Texture::Alignment::Byte),
+               4, 2);
+        addRow("RGB8_ETC2, no level fits",
+               makeTexture(TextureFormat::RGB8_ETC2, {64, 64}, {1, 1}, Texture::Alignment::Byte),
+               16, -1);
+    }
+}
+
+void TestKTX::preview()
+{
+    QFETCH(Texture, texture);
+    QFETCH(int, previewSize);
+    QFETCH(int, level);
+    QFETCH(QString, mimeType);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), mimeType);
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), mimeType);
+    reader.setPreviewSize(previewSize);
+    const auto preview = reader.readPreview();
+    if (level < 0) {
+        QVERIFY(!preview);
+    } else {
+        QVERIFY2(preview, qPrintable(toUserString(preview.error())));
+        QCOMPARE(*preview, imageTexture(texture, {Texture::Side::PositiveX, level, 0}));
+    }
+
+    // The device is moved back, so the whole texture can be read afterwards
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestKTX::readLevel()
+{
+    const auto texture =
+            makeTexture(TextureFormat::RGB8_Unorm, {30, 30}, {5, 3}, Texture::Alignment::Byte);
+
+    const auto write = [&texture](const QString &mimeType)
+    {
+        QByteArray bytes;
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        TextureIO writer(TextureIO::QIODevicePointer(&buffer), mimeType);
+        return writer.write(texture) ? bytes : QByteArray();
+    };
+
+    auto bytes = write(QStringLiteral("image/ktx2"));
+    QVERIFY(!bytes.isEmpty());
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/ktx2"));
+
+    // levels in any order, then the whole texture
+    for (const auto level: {4, 0, 2}) {
+        const auto result = reader.readLevel(level);
+        QVERIFY2(result, qPrintable(toUserString(result.error())));
+        QCOMPARE(result->levels(), 1);
+        QCOMPARE(result->layers(), texture.layers());
+        QCOMPARE(result->width(), texture.width(level));
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            QCOMPARE(imageTexture(*result, {Texture::Side::PositiveX, 0, layer}),
+                     imageTexture(texture, {Texture::Side::PositiveX, level, layer}));
+        }
+    }
+    QTest::ignoreMessage(QtWarningMsg, "Invalid level: 5");
+    QVERIFY(!reader.readLevel(5));
+    const auto whole = reader.read();
+    QVERIFY2(whole, qPrintable(toUserString(whole.error())));
+    QCOMPARE(*whole, texture);
+
+    // KTX 1 can't read single levels
+    auto ktxBytes = write(QStringLiteral("image/x-ktx"));
+    QBuffer ktxBuffer(&ktxBytes);
+    QVERIFY(ktxBuffer.open(QIODevice::ReadOnly));
+    TextureIO ktxReader(TextureIO::QIODevicePointer(&ktxBuffer), QStringLiteral("image/x-ktx"));
+    const auto result = ktxReader.readLevel(0);
+    QVERIFY(!result);
+    QVERIFY(result.error() == TextureIOError::HandlerError);
+
+    // a level index pointing past the end of the device
+    qToLittleEndian(quint64(1) << 40, bytes.data() + 80 + 8); // byteLength of level 0
+    QBuffer corruptedBuffer(&bytes);
+    QVERIFY(corruptedBuffer.open(QIODevice::ReadOnly));
+    TextureIO corruptedReader(
+            TextureIO::QIODevicePointer(&corruptedBuffer), QStringLiteral("image/ktx2"));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Level 0 is out of bounds.*"));
+    QVERIFY(!corruptedReader.readLevel(0));
+}
+
+void TestKTX::readCalls_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("RGBA8_Unorm") << QStringLiteral(":/ktx/RGBA8_Unorm.ktx");
+    QTest::newRow("L8_Unorm") << QStringLiteral(":/ktx/L8_Unorm.ktx");
+    QTest::newRow("RGBA32_Float") << QStringLiteral(":/ktx/RGBA32_Float.ktx");
+    QTest::newRow("RGB8_ETC2") << QStringLiteral(":/ktx/RGB8_ETC2.ktx");
+}
+
+void TestKTX::readCalls()
+{
+    QFETCH(QString, fileName);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    auto bytes = file.readAll();
+
+    CountingBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-ktx"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+
+    // Small values are served from the read-ahead buffer, large images are read directly
+    const auto maxReads = 2 * (bytes.size() / DeviceCursor::defaultBufferSize + 2);
+    QVERIFY2(buffer.reads() <= maxReads,
+             qPrintable(QStringLiteral("%1 reads, expected at most %2")
+                        .arg(buffer.reads()).arg(maxReads)));
 }
 
 void TestKTX::benchRead_data()
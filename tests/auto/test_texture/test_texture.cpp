@@ -1,5 +1,8 @@
 #include <QtTest>
+#include <TextureLib/TexelView>
 #include <TextureLib/Texture>
+#include <TextureLib/TextureStream>
+#include <TextureLib/Utils>
 
 class TestTexture : public QObject
 {
@@ -13,6 +16,16 @@ private slots:
     void constructWithInvalidData();
     void bytesPerLine_data();
     void bytesPerLine();
+    void contentHash();
+    void subresourceHash();
+    void equalsAlignment();
+    void lineData();
+    void texelView();
+    void copyOnWrite();
+    void convertProgress();
+    void thumbnail();
+    void dataStream();
+    void compressedStream();
 };
 
 void TestTexture::defaultConstructed()
@@ -274,6 +287,423 @@ void TestTexture::bytesPerLine()
     QCOMPARE(result4, bpl4);
 }
 
+void TestTexture::contentHash()
+{
+    QCOMPARE(Texture().contentHash(), quint64(0));
+
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {64, 64}, {Texture::IsCubemap::Yes, 3, 2});
+    QVERIFY(!texture.isNull());
+    std::fill(texture.data().begin(), texture.data().end(), 0);
+
+    const auto hash = texture.contentHash();
+    QVERIFY(hash != 0);
+    QCOMPARE(texture.contentHash(), hash);
+
+    // shallow and deep copies have the same hash
+    const auto shallow = texture;
+    QCOMPARE(shallow.contentHash(), hash);
+    const auto deep = texture.copy();
+    QCOMPARE(deep.contentHash(), hash);
+
+    // same data, different layout
+    auto other = Texture(TextureFormat::RGBA8_Unorm, {64, 64}, {3, 12});
+    std::fill(other.data().begin(), other.data().end(), 0);
+    QVERIFY(other.contentHash() != hash);
+
+    // equality doesn't change once both hashes are memoized
+    const auto fresh = texture.copy();
+    QVERIFY(fresh == texture);
+    QCOMPARE(fresh.contentHash(), hash);
+    QVERIFY(fresh == texture);
+    QVERIFY(other != texture);
+
+    // modification resets the hash and does not touch the shared copy
+    texture.setTexelColor({1, 2}, {Texture::Side::NegativeY, 1, 1}, qRgba(255, 0, 0, 255));
+    QVERIFY(texture.contentHash() != hash);
+    QCOMPARE(shallow.contentHash(), hash);
+    QVERIFY(texture != shallow);
+
+    texture.setTexelColor({1, 2}, {Texture::Side::NegativeY, 1, 1}, qRgba(0, 0, 0, 0));
+    QCOMPARE(texture.contentHash(), hash);
+    QVERIFY(texture == shallow);
+}
+
+void TestTexture::subresourceHash()
+{
+    auto texture = Texture(TextureFormat::L8_Unorm, {16, 16}, {Texture::IsCubemap::Yes, 1, 1});
+    QVERIFY(!texture.isNull());
+    for (int face = 0; face < texture.faces(); ++face) {
+        const auto data = texture.imageData({Texture::Side(face)});
+        std::fill(data.begin(), data.end(), uchar(face < 3 ? 0 : 1));
+    }
+
+    const auto posX = texture.subresourceHash({Texture::Side::PositiveX});
+    QVERIFY(posX != 0);
+    QCOMPARE(texture.subresourceHash({Texture::Side::NegativeX}), posX);
+    QVERIFY(texture.subresourceHash({Texture::Side::PositiveZ}) != posX);
+
+    const auto negZ = texture.subresourceHash({Texture::Side::NegativeZ});
+    texture.imageData({Texture::Side::PositiveX})[0] = 42;
+    QVERIFY(texture.subresourceHash({Texture::Side::PositiveX}) != posX);
+    QCOMPARE(texture.subresourceHash({Texture::Side::NegativeZ}), negZ);
+
+    QTest::ignoreMessage(QtWarningMsg, "was called with invalid level 1");
+    QCOMPARE(texture.subresourceHash({Texture::Side::PositiveX, 1}), quint64(0));
+}
+
+void TestTexture::equalsAlignment()
+{
+    // width 3 makes the Word-aligned lines longer than the Byte-aligned ones
+    auto byteAligned = Texture(TextureFormat::RGB8_Unorm, {3, 3}, {2, 1}, Texture::Alignment::Byte);
+    auto wordAligned = Texture(TextureFormat::RGB8_Unorm, {3, 3}, {2, 1}, Texture::Alignment::Word);
+    QVERIFY(byteAligned.bytes() != wordAligned.bytes());
+    std::fill(byteAligned.data().begin(), byteAligned.data().end(), 0);
+    std::fill(wordAligned.data().begin(), wordAligned.data().end(), 0);
+
+    QVERIFY(byteAligned != wordAligned);
+    QVERIFY(wordAligned != byteAligned);
+
+    // same answer once the hashes are memoized
+    QVERIFY(byteAligned.contentHash() != wordAligned.contentHash());
+    QVERIFY(byteAligned != wordAligned);
+    QVERIFY(wordAligned != byteAligned);
+
+    const auto copy = wordAligned.copy();
+    QVERIFY(copy == wordAligned);
+
+    // RGBA8 lines need no padding, so the bytes are the same regardless of the alignment
+    auto bytePacked = Texture(TextureFormat::RGBA8_Unorm, {3, 3}, {2, 1}, Texture::Alignment::Byte);
+    auto wordPacked = Texture(TextureFormat::RGBA8_Unorm, {3, 3}, {2, 1}, Texture::Alignment::Word);
+    QCOMPARE(bytePacked.bytes(), wordPacked.bytes());
+    std::fill(bytePacked.data().begin(), bytePacked.data().end(), 0);
+    std::fill(wordPacked.data().begin(), wordPacked.data().end(), 0);
+
+    QVERIFY(bytePacked == wordPacked);
+    QCOMPARE(bytePacked.contentHash(), wordPacked.contentHash());
+    QVERIFY(bytePacked == wordPacked);
+
+    wordPacked.imageData({})[0] = 1;
+    QVERIFY(bytePacked != wordPacked);
+}
+
+void TestTexture::lineData()
+{
+    auto texture = Texture(TextureFormat::RGB8_Unorm, {5, 3}, {1, 1}, Texture::Alignment::Word);
+    QVERIFY(!texture.isNull());
+    QCOMPARE(texture.bytesPerLine(), 16);
+
+    const auto line = texture.lineData({0, 2}, {});
+    QCOMPARE(line.size(), 15);
+    QCOMPARE(line.data(), texture.imageData({}).data() + 32);
+
+    QTest::ignoreMessage(QtWarningMsg, "x should be 0");
+    QVERIFY(texture.constLineData({1, 0}, {}).empty());
+}
+
+void TestTexture::texelView()
+{
+    auto texture = Texture(TextureFormat::RGB8_Unorm, {5, 3}, {1, 1}, Texture::Alignment::Word);
+    QVERIFY(!texture.isNull());
+
+    TexelView<TextureFormat::RGB8_Unorm> view(texture);
+    QVERIFY(!view.isNull());
+    QCOMPARE(view.width(), 5);
+    QCOMPARE(view.height(), 3);
+    for (int y = 0; y < view.height(); ++y) {
+        for (auto &texel: view.row(y))
+            texel = {{quint8(y), quint8(y * 2), quint8(y * 3)}};
+    }
+    view(4, 1) = {{1, 2, 3}};
+
+    QCOMPARE(texture.texelColor({4, 1}, {}), ColorVariant(qRgba(1, 2, 3, 0xff)));
+    QCOMPARE(texture.texelColor({3, 2}, {}), ColorVariant(qRgba(2, 4, 6, 0xff)));
+
+    const ConstTexelView<TextureFormat::RGB8_Unorm> constView(texture);
+    QVERIFY(constView(4, 1) == (Texel<quint8, 3>{{1, 2, 3}}));
+    QCOMPARE(constView.row(2).size(), 5);
+    QCOMPARE(reinterpret_cast<const uchar *>(constView.row(1).data()),
+             texture.constLineData({0, 1}, {}).data());
+
+    const ConstTexelView<TextureFormat::RGB8_Unorm> converted = view;
+    QVERIFY(!converted.isNull());
+
+    QTest::ignoreMessage(QtWarningMsg, "TexelView format mismatch: \"RGB8_Unorm\" != \"RGBA8_Unorm\"");
+    const ConstTexelView<TextureFormat::RGBA8_Unorm> invalid(texture);
+    QVERIFY(invalid.isNull());
+}
+
+void TestTexture::copyOnWrite()
+{
+    auto texture = Texture(TextureFormat::L8_Unorm, {8, 8}, {Texture::IsCubemap::No, 2, 3});
+    QVERIFY(!texture.isNull());
+    for (int layer = 0; layer < texture.layers(); ++layer) {
+        for (int level = 0; level < texture.levels(); ++level) {
+            const auto data = texture.imageData({level, layer});
+            std::fill(data.begin(), data.end(), uchar(layer * 10 + level));
+        }
+    }
+    const auto original = texture.copy();
+
+    auto shared = texture;
+    const auto data = shared.imageData({1, 2});
+    std::fill(data.begin(), data.end(), uchar(0xff));
+
+    // only the modified image is copied
+    QCOMPARE(shared.constImageData({0, 0}).data(), texture.constImageData({0, 0}).data());
+    QCOMPARE(shared.constImageData({0, 2}).data(), texture.constImageData({0, 2}).data());
+    QVERIFY(shared.constImageData({1, 2}).data() != texture.constImageData({1, 2}).data());
+
+    QCOMPARE(texture, original);
+    QVERIFY(shared != original);
+    QCOMPARE(shared.constImageData({1, 2})[0], uchar(0xff));
+    QCOMPARE(texture.constImageData({1, 2})[0], uchar(21));
+
+    // contiguous access still works for the scattered data
+    const auto contiguous = shared.constData();
+    QCOMPARE(contiguous.size(), shared.bytes());
+    for (int layer = 0; layer < shared.layers(); ++layer) {
+        for (int level = 0; level < shared.levels(); ++level) {
+            // the original texture is not scattered, so it has the same offsets
+            const auto offset =
+                    original.constImageData({level, layer}).data() - original.constData().data();
+            const auto image = shared.constImageData({level, layer});
+            QVERIFY(std::equal(image.begin(), image.end(), contiguous.begin() + offset));
+        }
+    }
+
+    auto mutableData = shared.data();
+    QCOMPARE(mutableData.size(), shared.bytes());
+    QCOMPARE(shared.constImageData({}).data(), mutableData.data());
+    QCOMPARE(shared.constImageData({1, 2})[0], uchar(0xff));
+    QCOMPARE(texture, original);
+}
+
+void TestTexture::convertProgress()
+{
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {512, 512}, {Texture::IsCubemap::No, 10});
+    QVERIFY(!texture.isNull());
+    const auto data = texture.data();
+    for (qsizetype i = 0; i < data.size(); ++i)
+        data[i] = uchar(i * 7);
+
+    std::vector<qsizetype> calls;
+    qsizetype total = 0;
+    const auto converted = texture.convert(
+            TextureFormat::BGRA8_Unorm,
+            Texture::Alignment::Byte,
+            [&calls, &total](qsizetype lines, qsizetype totalLines)
+    {
+        calls.push_back(lines);
+        total = totalLines;
+        return true;
+    });
+    QCOMPARE(converted, texture.convert(TextureFormat::BGRA8_Unorm));
+
+    // a line of the base level is 2 KiB, so there is a band per 128 lines and the final call
+    QCOMPARE(total, qsizetype(1023));
+    QVERIFY(calls.size() > 2);
+    QVERIFY(std::is_sorted(calls.begin(), calls.end()));
+    QCOMPARE(calls.front(), qsizetype(128));
+    QCOMPARE(calls.back(), total);
+
+    // the conversion stops at the first band
+    int canceledCalls = 0;
+    const auto canceled = texture.convert(
+            TextureFormat::BGRA8_Unorm,
+            Texture::Alignment::Byte,
+            [&canceledCalls](qsizetype, qsizetype) { return ++canceledCalls < 1; });
+    QVERIFY(canceled.isNull());
+    QCOMPARE(canceledCalls, 1);
+}
+
+void TestTexture::thumbnail()
+{
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {256, 128}, {Texture::IsCubemap::No, 9});
+    QVERIFY(!texture.isNull());
+
+    // only the longer side has to fill the box
+    QCOMPARE(Utils::thumbnailLevel(texture, {64, 64}), qsizetype(2));
+    QCOMPARE(Utils::thumbnailLevel(texture, {32, 32}), qsizetype(3));
+    QCOMPARE(Utils::thumbnailLevel(texture, {128, 32}), qsizetype(2));
+    QCOMPARE(Utils::thumbnailLevel(texture, {300, 300}), qsizetype(0));
+    QCOMPARE(Utils::thumbnailLevel(texture, {32, 32}, 4), qsizetype(4));
+
+    const auto tall = Texture(TextureFormat::RGBA8_Unorm, {128, 256}, {Texture::IsCubemap::No, 9});
+    QCOMPARE(Utils::thumbnailLevel(tall, {64, 64}), qsizetype(2));
+
+    for (int level = 0; level < texture.levels(); ++level) {
+        const auto color = level == 2 ? qRgba(255, 0, 0, 255) : qRgba(0, 0, 255, 255);
+        for (int y = 0; y < texture.height(level); ++y) {
+            for (int x = 0; x < texture.width(level); ++x)
+                texture.setTexelColor({x, y}, {level}, color);
+        }
+    }
+
+    const auto image = Utils::makeThumbnail(texture, {48, 48});
+    QCOMPARE(image.size(), QSize(48, 24));
+    QCOMPARE(image.pixel(10, 10), qRgba(255, 0, 0, 255));
+
+    const auto compressed = Texture(TextureFormat::Bc1Rgb_Unorm, {64, 64});
+    QVERIFY(Utils::makeThumbnail(compressed, {32, 32}).isNull());
+}
+
+namespace {
+
+Texture makeCubemapArray()
+{
+    auto texture = Texture(
+            TextureFormat::RGBA8_Unorm, {16, 16}, {Texture::IsCubemap::Yes, 3, 2});
+    for (int level = 0; level < texture.levels(); ++level) {
+        for (int layer = 0; layer < texture.layers(); ++layer) {
+            for (int face = 0; face < texture.faces(); ++face) {
+                const auto data = texture.imageData({Texture::Side(face), level, layer});
+                for (qsizetype i = 0; i < data.size(); ++i)
+                    data[i] = uchar(face * 40 + layer * 20 + level + i % 7);
+            }
+        }
+    }
+    return texture;
+}
+
+} // namespace
+
+void TestTexture::dataStream()
+{
+    QByteArray buffer;
+    {
+        QDataStream stream(&buffer, QIODevice::WriteOnly);
+        stream << Texture() << makeCubemapArray();
+        QCOMPARE(stream.status(), QDataStream::Ok);
+    }
+
+    QDataStream stream(buffer);
+    Texture null = makeCubemapArray();
+    Texture texture;
+    stream >> null >> texture;
+    QCOMPARE(stream.status(), QDataStream::Ok);
+    QVERIFY(null.isNull());
+    QCOMPARE(texture, makeCubemapArray());
+    QVERIFY(stream.atEnd());
+
+    // truncated payload
+    QDataStream truncated(buffer.left(buffer.size() - 1));
+    truncated >> null >> texture;
+    QVERIFY(truncated.status() != QDataStream::Ok);
+
+    // corrupted format and alignment fields of the second texture
+    const auto patched = [&buffer](int offset, quint32 value)
+    {
+        auto result = buffer;
+        QDataStream patchStream(&result, QIODevice::ReadWrite);
+        patchStream.device()->seek(offset);
+        patchStream << value;
+        return result;
+    };
+    const auto nullSize = 7 * 4 + 1 + 4; // fields, alignment and size of the null texture
+    for (const auto &corrupted: {
+             patched(nullSize, quint32(TextureFormat::FormatsCount)),
+             patched(nullSize, quint32(TextureFormat::Invalid)),
+             patched(nullSize, 0xffffu)}) {
+        QDataStream corruptedStream(corrupted);
+        corruptedStream >> null >> texture;
+        QCOMPARE(corruptedStream.status(), QDataStream::ReadCorruptData);
+        QVERIFY(null.isNull());
+        QVERIFY(texture.isNull());
+    }
+    auto misaligned = buffer;
+    misaligned[nullSize + 7 * 4] = char(3);
+    QDataStream misalignedStream(misaligned);
+    misalignedStream >> null >> texture;
+    QCOMPARE(misalignedStream.status(), QDataStream::ReadCorruptData);
+    QVERIFY(texture.isNull());
+}
+
+void TestTexture::compressedStream()
+{
+    const auto expected = makeCubemapArray();
+
+    QByteArray buffer;
+    {
+        QDataStream stream(&buffer, QIODevice::WriteOnly);
+        QVERIFY(TextureStream::writeCompressed(stream, expected));
+        QVERIFY(TextureStream::writeCompressed(stream, expected, 0)); // stored as is
+        stream << quint32(42);
+    }
+    QVERIFY(buffer.size() < 3 * expected.bytes());
+
+    {
+        QDataStream stream(buffer);
+        QCOMPARE(TextureStream::readCompressed(stream), expected);
+        QCOMPARE(TextureStream::readCompressed(stream), expected);
+        quint32 tail = 0;
+        stream >> tail;
+        QCOMPARE(tail, quint32(42));
+    }
+
+    {
+        const auto index = Texture::ArrayIndex(Texture::Side::NegativeY, 1, 1);
+        QDataStream stream(buffer);
+        const auto image = TextureStream::readCompressedImage(stream, index);
+        QCOMPARE(image.format(), expected.format());
+        QCOMPARE(image.width(), expected.width(1));
+        QCOMPARE(image.height(), expected.height(1));
+        QCOMPARE(image.faces(), 1);
+        QCOMPARE(image.levels(), 1);
+        QCOMPARE(image.layers(), 1);
+        const auto actualData = image.constImageData({});
+        const auto expectedData = expected.constImageData(index);
+        QVERIFY(std::equal(actualData.begin(), actualData.end(),
+                           expectedData.begin(), expectedData.end()));
+
+        // the stream is positioned after the whole texture
+        QCOMPARE(TextureStream::readCompressed(stream), expected);
+    }
+
+    QDataStream invalid(QByteArray(64, 'x'));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Unsupported compressed texture stream.*"));
+    QVERIFY(TextureStream::readCompressed(invalid).isNull());
+    QCOMPARE(invalid.status(), QDataStream::ReadCorruptData);
+
+    // crafted headers: a count that wraps in 32 bits and an index bigger than the stream
+    const auto craft = [](quint32 levels, quint32 layers, quint32 count)
+    {
+        QByteArray result;
+        QDataStream stream(&result, QIODevice::WriteOnly);
+        stream << TextureStream::magic << TextureStream::version
+               << quint32(TextureFormat::RGBA8_Unorm) << quint32(4) << quint32(4) << quint32(1)
+               << quint32(1) << layers << levels << quint8(Texture::Alignment::Byte) << count;
+        stream << quint64(1u << 30) << quint8(0); // a single entry, the payload is missing
+        return result;
+    };
+    for (const auto &crafted: {craft(65536, 65536, 0), craft(1, 1 << 20, 1 << 20), craft(1, 1, 1)}) {
+        QDataStream stream(crafted);
+        QVERIFY(TextureStream::readCompressed(stream).isNull());
+        QVERIFY(stream.status() != QDataStream::Ok);
+        QDataStream imageStream(crafted);
+        QVERIFY(TextureStream::readCompressedImage(imageStream, {}).isNull());
+        QVERIFY(imageStream.status() != QDataStream::Ok);
+    }
+
+    // corrupted format field, it follows the magic and the version
+    for (const auto format: {quint32(TextureFormat::Invalid),
+                             quint32(TextureFormat::FormatsCount), 0xffffu}) {
+        auto corrupted = buffer;
+        {
+            QDataStream stream(&corrupted, QIODevice::ReadWrite);
+            stream.device()->seek(sizeof(quint32) + sizeof(quint16));
+            stream << format;
+        }
+        QDataStream stream(corrupted);
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Invalid compressed texture stream.*"));
+        QVERIFY(TextureStream::readCompressed(stream).isNull());
+        QCOMPARE(stream.status(), QDataStream::ReadCorruptData);
+        QDataStream imageStream(corrupted);
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Invalid compressed texture stream.*"));
+        QVERIFY(TextureStream::readCompressedImage(imageStream, {}).isNull());
+        QCOMPARE(imageStream.status(), QDataStream::ReadCorruptData);
+    }
+}
+
 QTEST_MAIN(TestTexture)
 
 #include "test_texture.moc"
@@ -0,0 +1,101 @@
+#include <QtTest>
+#include <TextureLib/Texture>
+#include <TextureLib/TextureAllocator>
+
+class TestTextureAllocator : public QObject
+{
+    Q_OBJECT
+private slots:
+    void sizeClass_data();
+    void sizeClass();
+    void alignment();
+    void reuse();
+    void poolLimit();
+    void textureData();
+};
+
+void TestTextureAllocator::sizeClass_data()
+{
+    QTest::addColumn<qsizetype>("size");
+    QTest::addColumn<qsizetype>("expected");
+
+    QTest::newRow("1") << qsizetype(1) << qsizetype(64);
+    QTest::newRow("64") << qsizetype(64) << qsizetype(64);
+    QTest::newRow("65") << qsizetype(65) << qsizetype(128);
+    QTest::newRow("4096") << qsizetype(4096) << qsizetype(4096);
+    QTest::newRow("4097") << qsizetype(4097) << qsizetype(5120);
+    QTest::newRow("8192") << qsizetype(8192) << qsizetype(8192);
+    QTest::newRow("1M + 1") << qsizetype(1024 * 1024 + 1) << qsizetype(1280 * 1024);
+}
+
+void TestTextureAllocator::sizeClass()
+{
+    QFETCH(qsizetype, size);
+    QFETCH(qsizetype, expected);
+
+    QCOMPARE(TextureAllocator::sizeClass(size), expected);
+}
+
+void TestTextureAllocator::alignment()
+{
+    TextureAllocator allocator;
+    for (const auto size: {1, 3, 100, 4097, 1 << 20, 5 << 20}) {
+        const auto data = allocator.allocate(size);
+        QVERIFY(data);
+        QCOMPARE(quintptr(data) % quintptr(TextureAllocator::alignment), quintptr(0));
+        allocator.deallocate(data, size);
+    }
+}
+
+void TestTextureAllocator::reuse()
+{
+    TextureAllocator allocator;
+    const auto first = allocator.allocate(10000);
+    QVERIFY(first);
+    allocator.deallocate(first, 10000);
+    QCOMPARE(allocator.statistics().bytesPooled, qint64(TextureAllocator::sizeClass(10000)));
+
+    // same size class
+    const auto second = allocator.allocate(10100);
+    QCOMPARE(second, first);
+
+    const auto stats = allocator.statistics();
+    QCOMPARE(stats.allocations, qint64(2));
+    QCOMPARE(stats.deallocations, qint64(1));
+    QCOMPARE(stats.poolHits, qint64(1));
+    QCOMPARE(stats.bytesInUse, qint64(TextureAllocator::sizeClass(10100)));
+    QCOMPARE(stats.bytesPooled, qint64(0));
+
+    allocator.deallocate(second, 10100);
+    QCOMPARE(allocator.statistics().bytesInUse, qint64(0));
+    allocator.trim();
+    QCOMPARE(allocator.statistics().bytesPooled, qint64(0));
+}
+
+void TestTextureAllocator::poolLimit()
+{
+    TextureAllocator allocator;
+    allocator.setPoolLimit(4096);
+
+    const auto data = allocator.allocate(8192);
+    allocator.deallocate(data, 8192);
+    QCOMPARE(allocator.statistics().bytesPooled, qint64(0));
+}
+
+void TestTextureAllocator::textureData()
+{
+    const auto allocator = TextureAllocator::instance();
+    QVERIFY(allocator);
+    const auto before = allocator->statistics();
+    {
+        Texture texture(TextureFormat::RGBA8_Unorm, {100, 100});
+        QVERIFY(!texture.isNull());
+        QCOMPARE(quintptr(texture.constData().data()) % quintptr(TextureAllocator::alignment), quintptr(0));
+        QCOMPARE(allocator->statistics().allocations, before.allocations + 1);
+    }
+    QCOMPARE(allocator->statistics().deallocations, before.deallocations + 1);
+}
+
+QTEST_MAIN(TestTextureAllocator)
+
+#include "test_textureallocator.moc"
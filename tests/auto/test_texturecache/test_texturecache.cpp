@@ -0,0 +1,220 @@
+#include <QtTest>
+#include <TextureLib/TextureIO>
+#include <TextureViewCoreLib/TextureCache>
+#include <TextureViewCoreLib/TextureDocument>
+
+#include <memory>
+
+using TextureViewer::TextureCache;
+using TextureViewer::TextureDocument;
+
+class TestTextureCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void insert();
+    void evict();
+    void pinned();
+    void pin();
+    void setBudget();
+    void documents();
+};
+
+namespace {
+
+Texture createTexture(int width)
+{
+    return Texture(TextureFormat::RGBA8_Unorm, {width, width});
+}
+
+} // namespace
+
+void TestTextureCache::initTestCase()
+{
+    qApp->addLibraryPath(qApp->applicationDirPath() + TextureIO::pluginsDirPath());
+    Q_INIT_RESOURCE(extramimetypes);
+}
+
+void TestTextureCache::insert()
+{
+    TextureCache cache;
+    cache.setBudget(1024 * 1024);
+
+    int loads = 0;
+    const auto loader = [&loads]() { ++loads; return createTexture(16); };
+    const auto key = cache.insert(loader);
+    QVERIFY(cache.contains(key));
+    QVERIFY(!cache.isResident(key));
+    QCOMPARE(cache.statistics().bytes, qint64(0));
+
+    QVERIFY(!cache.texture(key).isNull());
+    QCOMPARE(loads, 1);
+    QVERIFY(cache.isResident(key));
+    QCOMPARE(cache.statistics().bytes, qint64(16 * 16 * 4));
+
+    QVERIFY(!cache.texture(key).isNull());
+    QCOMPARE(loads, 1);
+    QCOMPARE(cache.statistics().hits, qint64(1));
+    QCOMPARE(cache.statistics().misses, qint64(1));
+
+    cache.remove(key);
+    QVERIFY(!cache.contains(key));
+    QVERIFY(cache.texture(key).isNull());
+    QCOMPARE(cache.statistics().bytes, qint64(0));
+    QCOMPARE(cache.statistics().entries, qint64(0));
+}
+
+void TestTextureCache::evict()
+{
+    TextureCache cache;
+    const auto bytes = qint64(createTexture(64).bytes());
+    cache.setBudget(2 * bytes);
+
+    const auto loader = []() { return createTexture(64); };
+    const auto key1 = cache.insert(loader, createTexture(64));
+    const auto key2 = cache.insert(loader, createTexture(64));
+    QVERIFY(cache.isResident(key1));
+    QVERIFY(cache.isResident(key2));
+
+    // touch key1, so key2 becomes the least recently used
+    QVERIFY(!cache.texture(key1).isNull());
+    const auto key3 = cache.insert(loader, createTexture(64));
+    QVERIFY(cache.isResident(key1));
+    QVERIFY(!cache.isResident(key2));
+    QVERIFY(cache.isResident(key3));
+    QCOMPARE(cache.statistics().evictions, qint64(1));
+    QCOMPARE(cache.statistics().bytes, 2 * bytes);
+
+    // reload
+    QVERIFY(!cache.texture(key2).isNull());
+    QVERIFY(cache.isResident(key2));
+    QVERIFY(!cache.isResident(key1));
+    QCOMPARE(cache.statistics().reloads, qint64(1));
+    QCOMPARE(cache.statistics().peakBytes, 3 * bytes);
+}
+
+void TestTextureCache::pinned()
+{
+    TextureCache cache;
+    const auto bytes = qint64(createTexture(64).bytes());
+    cache.setBudget(bytes);
+
+    const auto pinned = cache.insert(createTexture(64));
+    const auto key = cache.insert([]() { return createTexture(64); }, createTexture(64));
+    QVERIFY(cache.isResident(pinned));
+    // the most recently inserted texture is kept even if it does not fit
+    QVERIFY(cache.isResident(key));
+    QCOMPARE(cache.statistics().pinnedBytes, bytes);
+
+    cache.setBudget(0);
+    QVERIFY(cache.isResident(pinned));
+    QVERIFY(!cache.isResident(key));
+    QCOMPARE(cache.statistics().bytes, bytes);
+}
+
+void TestTextureCache::pin()
+{
+    TextureCache cache;
+    const auto bytes = qint64(createTexture(64).bytes());
+    cache.setBudget(bytes);
+
+    int loads = 0;
+    const auto loader = [&loads]() { ++loads; return createTexture(64); };
+    const auto source = cache.insert(loader, createTexture(64));
+    cache.pin(source);
+    cache.pin(source);
+    QCOMPARE(cache.statistics().pinnedBytes, bytes);
+
+    // other entries are evicted instead of the pinned one
+    const auto key = cache.insert(loader, createTexture(64));
+    QVERIFY(!cache.texture(key).isNull());
+    QVERIFY(cache.isResident(source));
+    cache.setBudget(0);
+    QVERIFY(cache.isResident(source));
+    QVERIFY(!cache.isResident(key));
+    QCOMPARE(loads, 0);
+
+    // evictable again after the last unpin
+    cache.unpin(source);
+    QVERIFY(cache.isResident(source));
+    cache.unpin(source);
+    QVERIFY(!cache.isResident(source));
+    QCOMPARE(cache.statistics().pinnedBytes, qint64(0));
+    QCOMPARE(cache.statistics().bytes, qint64(0));
+
+    // unbalanced calls and unknown keys are ignored
+    cache.unpin(source);
+    cache.pin(TextureCache::Key(12345));
+    QCOMPARE(cache.statistics().pinnedBytes, qint64(0));
+}
+
+void TestTextureCache::setBudget()
+{
+    TextureCache cache;
+    QCOMPARE(cache.budget(), TextureCache::defaultBudget());
+
+    QSignalSpy spy(&cache, &TextureCache::budgetChanged);
+    cache.setBudget(1024);
+    QCOMPARE(cache.budget(), qint64(1024));
+    QCOMPARE(spy.count(), 1);
+    cache.setBudget(1024);
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestTextureCache::documents()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto cache = TextureCache::instance();
+    QVERIFY(cache);
+    const auto oldBudget = cache->budget();
+
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {64, 64}, {7, 4});
+    QVERIFY(!texture.isNull());
+    const auto data = texture.data();
+    for (qsizetype i = 0; i < data.size(); ++i)
+        data[i] = uchar(i * 7);
+
+    // Each texture fits the budget, both of them don't
+    const auto budget = qint64(texture.bytes()) * 3 / 2;
+    cache->setBudget(budget);
+
+    std::vector<std::unique_ptr<TextureDocument>> documents;
+    for (const auto name: {"first.ktx2", "second.ktx2"}) {
+        const auto path = dir.filePath(QString::fromLatin1(name));
+        TextureIO io(path);
+        QVERIFY(io.write(texture));
+
+        auto document = std::make_unique<TextureDocument>();
+        QSignalSpy spy(document.get(), &TextureDocument::openFinished);
+        document->open(QUrl::fromLocalFile(path));
+        QVERIFY(spy.wait());
+        QCOMPARE(spy.at(0).at(0).toBool(), true);
+        QVERIFY(cache->statistics().bytes <= budget);
+        documents.push_back(std::move(document));
+    }
+
+    // The evicted images are read from the files, the sources stay evictable
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto &document: documents) {
+            for (int level = 0; level < texture.levels(); ++level) {
+                for (int layer = 0; layer < texture.layers(); ++layer) {
+                    const auto image = document->item(0, level, layer)->texture();
+                    const auto expected = texture.constImageData({level, layer});
+                    QCOMPARE(image.bytes(), qsizetype(expected.size()));
+                    QVERIFY(memcmp(image.constData().data(), expected.data(), size_t(expected.size())) == 0);
+                    QVERIFY(cache->statistics().bytes <= budget);
+                }
+            }
+        }
+    }
+    QCOMPARE(cache->statistics().pinnedBytes, qint64(0));
+
+    documents.clear();
+    cache->setBudget(oldBudget);
+}
+
+QTEST_MAIN(TestTextureCache)
+
+#include "test_texturecache.moc"
@@ -0,0 +1,117 @@
+#include <QtTest>
+#include <TextureLib/Texture>
+#include <TextureLib/TextureMemory>
+
+using Origin = TextureMemory::Origin;
+
+class TestTextureMemory : public QObject
+{
+    Q_OBJECT
+private slots:
+    void construct();
+    void origins();
+    void copyOnWrite();
+    void originScope();
+    void peaks();
+};
+
+static TextureMemory::Counters originCounters(Origin origin)
+{
+    const auto statistics = TextureMemory::statistics();
+    const auto it = statistics.origins.find(origin);
+    return it != statistics.origins.end() ? it->second : TextureMemory::Counters();
+}
+
+void TestTextureMemory::construct()
+{
+    const auto before = TextureMemory::statistics();
+    {
+        Texture texture(TextureFormat::RGBA8_Unorm, {64, 64});
+        const auto after = TextureMemory::statistics();
+        QCOMPARE(after.textures, before.textures + 1);
+        QCOMPARE(after.total.allocations, before.total.allocations + 1);
+        QCOMPARE(after.total.bytes, before.total.bytes + texture.bytes());
+
+        const auto it = after.formats.find(TextureFormat::RGBA8_Unorm);
+        QVERIFY(it != after.formats.end());
+        QVERIFY(it->second.bytes >= texture.bytes());
+
+        // a shallow copy shares the data
+        const auto copy = texture;
+        QCOMPARE(TextureMemory::statistics().total.bytes, after.total.bytes);
+    }
+    const auto destroyed = TextureMemory::statistics();
+    QCOMPARE(destroyed.textures, before.textures);
+    QCOMPARE(destroyed.total.bytes, before.total.bytes);
+    QCOMPARE(destroyed.total.allocations, before.total.allocations);
+}
+
+void TestTextureMemory::origins()
+{
+    const auto convertBefore = originCounters(Origin::Convert);
+    const auto copyBefore = originCounters(Origin::Copy);
+
+    Texture texture(TextureFormat::RGBA8_Unorm, {32, 32});
+    const auto converted = texture.convert(TextureFormat::BGRA8_Unorm);
+    QVERIFY(!converted.isNull());
+    QCOMPARE(originCounters(Origin::Convert).bytes, convertBefore.bytes + converted.bytes());
+
+    const auto copy = texture.copy();
+    QCOMPARE(originCounters(Origin::Copy).bytes, copyBefore.bytes + copy.bytes());
+}
+
+void TestTextureMemory::copyOnWrite()
+{
+    Texture texture(TextureFormat::RGBA8_Unorm, {16, 16}, {5, 1});
+    const auto shared = texture;
+    const auto before = originCounters(Origin::Copy);
+
+    // modifying a single level of a shared texture copies only that level
+    texture.imageData({0, 0})[0] = 1;
+    const auto after = originCounters(Origin::Copy);
+    QCOMPARE(after.allocations, before.allocations + 1);
+    QCOMPARE(after.bytes, before.bytes + texture.bytesPerImage(0));
+}
+
+void TestTextureMemory::originScope()
+{
+    QCOMPARE(TextureMemory::currentOrigin(), Origin::Other);
+    {
+        TextureMemory::OriginScope outer(Origin::IO);
+        QCOMPARE(TextureMemory::currentOrigin(), Origin::IO);
+        {
+            TextureMemory::OriginScope inner(Origin::Slice);
+            QCOMPARE(TextureMemory::currentOrigin(), Origin::Slice);
+
+            const auto before = originCounters(Origin::Slice);
+            Texture texture(TextureFormat::RGBA8_Unorm, {8, 8});
+            QCOMPARE(originCounters(Origin::Slice).bytes, before.bytes + texture.bytes());
+        }
+        QCOMPARE(TextureMemory::currentOrigin(), Origin::IO);
+    }
+    QCOMPARE(TextureMemory::currentOrigin(), Origin::Other);
+}
+
+void TestTextureMemory::peaks()
+{
+    TextureMemory::resetPeaks();
+    const auto before = TextureMemory::statistics();
+    QCOMPARE(before.total.peakBytes, before.total.bytes);
+
+    qsizetype bytes = 0;
+    {
+        Texture texture(TextureFormat::RGBA8_Unorm, {128, 128});
+        bytes = texture.bytes();
+    }
+    const auto after = TextureMemory::statistics();
+    QCOMPARE(after.total.bytes, before.total.bytes);
+    QCOMPARE(after.total.peakBytes, before.total.bytes + bytes);
+    QCOMPARE(after.peakTextures, before.textures + 1);
+
+    TextureMemory::resetPeaks();
+    QCOMPARE(TextureMemory::statistics().total.peakBytes, after.total.bytes);
+}
+
+QTEST_GUILESS_MAIN(TestTextureMemory)
+
+#include "test_texturememory.moc"
@@ -0,0 +1,186 @@
+#include <QtTest>
+#include <TextureLib/ThumbnailCache>
+
+class TestThumbnailCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void insert();
+    void keyMismatch();
+    void persistence();
+    void trim();
+    void replacedPack();
+    void freeDesktop();
+};
+
+namespace {
+
+QImage createImage(QSize size, QRgb color)
+{
+    QImage result(size, QImage::Format_RGBA8888);
+    result.fill(color);
+    return result;
+}
+
+ThumbnailCache::Key createKey(const QString &path)
+{
+    ThumbnailCache::Key result;
+    result.filePath = path;
+    result.modified = 1000;
+    result.fileSize = 42;
+    return result;
+}
+
+} // namespace
+
+void TestThumbnailCache::insert()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ThumbnailCache cache(dir.path());
+
+    const auto key = createKey(QStringLiteral("/tmp/a.dds"));
+    const auto size = QSize(64, 64);
+    QVERIFY(cache.find(key, size).isNull());
+
+    const auto image = createImage({64, 32}, qRgba(255, 0, 0, 255));
+    QVERIFY(cache.insert(key, size, image));
+    QCOMPARE(cache.count(), 1);
+
+    const auto found = cache.find(key, size);
+    QCOMPARE(found.size(), image.size());
+    QCOMPARE(found.pixel(1, 1), image.pixel(1, 1));
+
+    QVERIFY(cache.remove(key, size));
+    QVERIFY(cache.find(key, size).isNull());
+    QCOMPARE(cache.count(), 0);
+}
+
+void TestThumbnailCache::keyMismatch()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ThumbnailCache cache(dir.path());
+
+    const auto key = createKey(QStringLiteral("/tmp/a.dds"));
+    QVERIFY(cache.insert(key, {64, 64}, createImage({64, 64}, qRgba(0, 255, 0, 255))));
+
+    auto changed = key;
+    changed.modified++;
+    QVERIFY(cache.find(changed, {64, 64}).isNull());
+    changed = key;
+    changed.contentHash = 1;
+    QVERIFY(cache.find(changed, {64, 64}).isNull());
+    changed = key;
+    changed.index = {1};
+    QVERIFY(cache.find(changed, {64, 64}).isNull());
+    QVERIFY(cache.find(key, {32, 32}).isNull());
+    QVERIFY(!cache.find(key, {64, 64}).isNull());
+}
+
+void TestThumbnailCache::persistence()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto key = createKey(QStringLiteral("/tmp/a.dds"));
+    const auto image = createImage({16, 16}, qRgba(0, 0, 255, 255));
+    {
+        ThumbnailCache cache(dir.path());
+        QVERIFY(cache.insert(key, {16, 16}, image));
+    }
+    ThumbnailCache cache(dir.path());
+    QCOMPARE(cache.count(), 1);
+    const auto found = cache.find(key, {16, 16});
+    QCOMPARE(found.size(), image.size());
+    QCOMPARE(found.pixel(0, 0), image.pixel(0, 0));
+}
+
+void TestThumbnailCache::trim()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ThumbnailCache cache(dir.path());
+
+    const auto size = QSize(64, 64);
+    const auto image = createImage(size, qRgba(255, 255, 0, 255));
+    const auto key1 = createKey(QStringLiteral("/tmp/1.dds"));
+    const auto key2 = createKey(QStringLiteral("/tmp/2.dds"));
+    const auto key3 = createKey(QStringLiteral("/tmp/3.dds"));
+    QVERIFY(cache.insert(key1, size, image));
+    QVERIFY(cache.insert(key2, size, image));
+    QVERIFY(cache.insert(key3, size, image));
+    const auto recordSize = cache.size() / 3;
+
+    // key2 becomes the least recently used
+    QVERIFY(!cache.find(key1, size).isNull());
+    QVERIFY(!cache.find(key3, size).isNull());
+
+    cache.setMaxSize(2 * recordSize);
+    cache.trim();
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.size(), 2 * recordSize);
+    QVERIFY(!cache.find(key1, size).isNull());
+    QVERIFY(cache.find(key2, size).isNull());
+    QVERIFY(!cache.find(key3, size).isNull());
+
+    cache.clear();
+    QCOMPARE(cache.count(), 0);
+    QVERIFY(cache.find(key1, size).isNull());
+}
+
+void TestThumbnailCache::replacedPack()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ThumbnailCache cache1(dir.path());
+    ThumbnailCache cache2(dir.path());
+
+    const auto size = QSize(16, 16);
+    const auto image = createImage(size, qRgba(0, 255, 255, 255));
+    const auto key1 = createKey(QStringLiteral("/tmp/1.dds"));
+    const auto key2 = createKey(QStringLiteral("/tmp/2.dds"));
+    QVERIFY(cache1.insert(key1, size, image));
+    QVERIFY(cache1.sync());
+    QVERIFY(cache2.insert(key2, size, image));
+
+    // Trimming replaces the pack, so the first cache has to reload the index
+    cache2.trim();
+    QCOMPARE(cache2.count(), 2);
+    QVERIFY(!cache1.find(key1, size).isNull());
+    QVERIFY(!cache1.find(key2, size).isNull());
+    QCOMPARE(cache1.count(), 2);
+}
+
+void TestThumbnailCache::freeDesktop()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ThumbnailCache cache(dir.path(), ThumbnailCache::Layout::FreeDesktop);
+
+    const auto key = createKey(QStringLiteral("/tmp/a.dds"));
+    const auto image = createImage({128, 64}, qRgba(255, 0, 255, 255));
+    QVERIFY(cache.insert(key, {128, 128}, image));
+
+    const auto hash = QCryptographicHash::hash("file:///tmp/a.dds", QCryptographicHash::Md5);
+    const auto path = dir.path() + "/normal/" + hash.toHex() + ".png";
+    QVERIFY(QFileInfo::exists(path));
+    QImage stored(path);
+    QCOMPARE(stored.text(QStringLiteral("Thumb::URI")), QStringLiteral("file:///tmp/a.dds"));
+    QCOMPARE(stored.text(QStringLiteral("Thumb::MTime")), QStringLiteral("1000"));
+
+    QCOMPARE(cache.find(key, {128, 128}).size(), image.size());
+    QCOMPARE(cache.find(key, {64, 64}).size(), QSize(64, 32));
+
+    auto changed = key;
+    changed.modified++;
+    QVERIFY(cache.find(changed, {128, 128}).isNull());
+
+    // only the first image of a file is supported by the spec
+    changed = key;
+    changed.index = {1};
+    QVERIFY(!cache.insert(changed, {128, 128}, image));
+}
+
+QTEST_MAIN(TestThumbnailCache)
+
+#include "test_thumbnailcache.moc"
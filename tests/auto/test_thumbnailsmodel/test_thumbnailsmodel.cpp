@@ -0,0 +1,112 @@
+#include <QtTest>
+#include <TextureViewCoreLib/TextureDocument>
+#include <TextureViewCoreLib/ThumbnailsModel>
+
+#include <algorithm>
+
+using TextureViewer::TextureDocument;
+using TextureViewer::ThumbnailsModel;
+
+class TestThumbnailsModel : public QObject
+{
+    Q_OBJECT
+private slots:
+    void singleImage();
+    void fetchMore();
+    void sameShape();
+};
+
+namespace {
+
+// The data is filled, so textures with different patterns never compare equal
+Texture createTexture(Texture::ArraySize arraySize, uchar pattern = 0)
+{
+    auto result = Texture(TextureFormat::RGBA8_Unorm, {4, 4}, arraySize);
+    std::fill(result.data().begin(), result.data().end(), pattern);
+    return result;
+}
+
+} // namespace
+
+void TestThumbnailsModel::singleImage()
+{
+    TextureDocument document;
+    document.setTexture(createTexture({1}));
+    ThumbnailsModel model;
+    model.setDocument(ObserverPointer<TextureDocument>(&document));
+
+    QVERIFY(model.hasChildren());
+    QCOMPARE(model.rowCount(), 0);
+    QVERIFY(model.canFetchMore({}));
+    model.fetchMore({});
+    QCOMPARE(model.rowCount(), 1);
+    QVERIFY(!model.canFetchMore({}));
+
+    const auto index = model.index(0, 0);
+    QCOMPARE(index.data().toString(), QStringLiteral("Image"));
+    QVERIFY(!model.hasChildren(index));
+    QCOMPARE(model.position(index).level, 0);
+    QCOMPARE(model.position(index).layer, 0);
+}
+
+void TestThumbnailsModel::fetchMore()
+{
+    TextureDocument document;
+    document.setTexture(createTexture({Texture::IsCubemap::Yes, 2, 1000}));
+    ThumbnailsModel model;
+    model.setDocument(ObserverPointer<TextureDocument>(&document));
+
+    // layers are fetched in batches
+    model.fetchMore({});
+    QVERIFY(model.rowCount() > 0);
+    QVERIFY(model.rowCount() < 1000);
+    while (model.canFetchMore({}))
+        model.fetchMore({});
+    QCOMPARE(model.rowCount(), 1000);
+
+    const auto layer = model.index(999, 0);
+    QCOMPARE(layer.data().toString(), QStringLiteral("Image 999"));
+    QVERIFY(model.hasChildren(layer));
+    QCOMPARE(model.rowCount(layer), 0);
+    QCOMPARE(model.position(layer).level, -1);
+
+    model.fetchMore(layer);
+    QCOMPARE(model.rowCount(layer), 2);
+    const auto level = model.index(1, 0, layer);
+    QCOMPARE(level.data().toString(), QStringLiteral("Mipmap 1"));
+    QCOMPARE(model.parent(level), layer);
+
+    model.fetchMore(level);
+    QCOMPARE(model.rowCount(level), 6);
+    const auto face = model.index(5, 0, level);
+    QCOMPARE(face.data().toString(), QStringLiteral("Face 5"));
+    QVERIFY(!model.hasChildren(face));
+    QCOMPARE(model.position(face).layer, 999);
+    QCOMPARE(model.position(face).level, 1);
+    QCOMPARE(model.position(face).face, 5);
+}
+
+void TestThumbnailsModel::sameShape()
+{
+    TextureDocument document;
+    document.setTexture(createTexture({3, 4}, 1));
+    ThumbnailsModel model;
+    model.setDocument(ObserverPointer<TextureDocument>(&document));
+    model.fetchMore({});
+    QCOMPARE(model.rowCount(), 4);
+
+    QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+    QSignalSpy dataSpy(&model, &QAbstractItemModel::dataChanged);
+    document.setTexture(createTexture({3, 4}, 2));
+    QCOMPARE(resetSpy.count(), 0);
+    QCOMPARE(dataSpy.count(), 1);
+    QCOMPARE(model.rowCount(), 4);
+
+    document.setTexture(createTexture({3, 5}, 3));
+    QCOMPARE(resetSpy.count(), 1);
+    QCOMPARE(model.rowCount(), 0);
+}
+
+QTEST_MAIN(TestThumbnailsModel)
+
+#include "test_thumbnailsmodel.moc"
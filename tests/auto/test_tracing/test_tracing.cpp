@@ -0,0 +1,140 @@
+#include <QtTest>
+#include <TextureLib/Tracing>
+
+class TestTracing : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void cleanup();
+    void disabled();
+    void span();
+    void threads();
+    void save();
+};
+
+void TestTracing::init()
+{
+    Tracer::clear();
+}
+
+void TestTracing::cleanup()
+{
+    Tracer::setEnabled(false);
+    Tracer::clear();
+}
+
+void TestTracing::disabled()
+{
+    Tracer::setEnabled(false);
+    QVERIFY(!Tracer::isEnabled());
+    {
+        TraceSpan span("test", "disabled");
+        QVERIFY(!span.isActive());
+        span.setDetail(QStringLiteral("detail"));
+    }
+    QCOMPARE(Tracer::eventCount(), 0);
+}
+
+void TestTracing::span()
+{
+    Tracer::setEnabled(true);
+    QVERIFY(Tracer::isEnabled());
+    {
+        TraceSpan span("test", "outer");
+        QVERIFY(span.isActive());
+        span.setDetail(QStringLiteral("file.dds"));
+        TraceSpan inner("test", "inner");
+        QThread::msleep(1);
+    }
+    QCOMPARE(Tracer::eventCount(), 2);
+
+    const auto document = QJsonDocument::fromJson(Tracer::toJson());
+    QVERIFY(document.isObject());
+    const auto events = document.object().value(QStringLiteral("traceEvents")).toArray();
+
+    QJsonObject outer;
+    QJsonObject inner;
+    for (const auto &value: events) {
+        const auto event = value.toObject();
+        if (event.value(QStringLiteral("ph")).toString() != QStringLiteral("X"))
+            continue;
+        QCOMPARE(event.value(QStringLiteral("cat")).toString(), QStringLiteral("test"));
+        if (event.value(QStringLiteral("name")).toString() == QStringLiteral("outer"))
+            outer = event;
+        else if (event.value(QStringLiteral("name")).toString() == QStringLiteral("inner"))
+            inner = event;
+    }
+    QVERIFY(!outer.isEmpty());
+    QVERIFY(!inner.isEmpty());
+    QCOMPARE(outer.value(QStringLiteral("args")).toObject().value(QStringLiteral("detail")).toString(),
+             QStringLiteral("file.dds"));
+
+    // the inner span is nested in the outer one
+    const auto outerStart = outer.value(QStringLiteral("ts")).toDouble();
+    const auto innerStart = inner.value(QStringLiteral("ts")).toDouble();
+    const auto outerEnd = outerStart + outer.value(QStringLiteral("dur")).toDouble();
+    const auto innerEnd = innerStart + inner.value(QStringLiteral("dur")).toDouble();
+    QVERIFY(outerStart <= innerStart);
+    QVERIFY(innerEnd <= outerEnd);
+    QVERIFY(inner.value(QStringLiteral("dur")).toDouble() >= 1000.0);
+}
+
+void TestTracing::threads()
+{
+    Tracer::setEnabled(true);
+
+    QThread thread;
+    thread.setObjectName(QStringLiteral("worker"));
+    QObject::connect(&thread, &QThread::started, [&thread]() {
+        TraceSpan span("test", "worker");
+        thread.quit();
+    });
+    thread.start();
+    QVERIFY(thread.wait(5000));
+    {
+        TraceSpan span("test", "main");
+    }
+    QCOMPARE(Tracer::eventCount(), 2);
+
+    const auto events = QJsonDocument::fromJson(Tracer::toJson()).object().
+            value(QStringLiteral("traceEvents")).toArray();
+    QMap<QString, int> threads;
+    QMap<int, QString> threadNames;
+    for (const auto &value: events) {
+        const auto event = value.toObject();
+        const auto tid = event.value(QStringLiteral("tid")).toInt();
+        if (event.value(QStringLiteral("ph")).toString() == QStringLiteral("M")) {
+            threadNames[tid] = event.value(QStringLiteral("args")).toObject().
+                    value(QStringLiteral("name")).toString();
+        } else {
+            threads[event.value(QStringLiteral("name")).toString()] = tid;
+        }
+    }
+    QVERIFY(threads.value(QStringLiteral("worker")) != threads.value(QStringLiteral("main")));
+    QCOMPARE(threadNames.value(threads.value(QStringLiteral("worker"))), QStringLiteral("worker"));
+}
+
+void TestTracing::save()
+{
+    Tracer::setEnabled(true);
+    {
+        TraceSpan span("test", "save");
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto fileName = dir.filePath(QStringLiteral("trace.json"));
+    QVERIFY(Tracer::save(fileName));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QJsonParseError error;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(!document.object().value(QStringLiteral("traceEvents")).toArray().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestTracing)
+
+#include "test_tracing.moc"
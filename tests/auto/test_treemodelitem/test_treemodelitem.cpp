@@ -0,0 +1,88 @@
+#include <QtTest>
+
+#include <UtilsLib/TreeModelItem>
+
+class TestTreeModelItem : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rows();
+    void arena();
+};
+
+namespace {
+
+class Item : public TreeModelItem<Item>
+{
+public:
+    int value {0};
+};
+
+void checkRows(const Item &parent)
+{
+    for (qsizetype row = 0; row < parent.childCount(); ++row) {
+        QCOMPARE(parent.child(row)->row(), row);
+        QCOMPARE(parent.child(row)->parent().get(), &parent);
+    }
+}
+
+} // namespace
+
+void TestTreeModelItem::rows()
+{
+    Item root;
+    for (int i = 0; i < 4; ++i)
+        root.createChild()->value = i;
+    checkRows(root);
+
+    const auto inserted = root.createChild(1);
+    inserted->value = 10;
+    QCOMPARE(inserted->row(), qsizetype(1));
+    QCOMPARE(root.child(1)->value, 10);
+    QCOMPARE(root.child(2)->value, 1);
+    checkRows(root);
+
+    root.append(std::make_unique<Item>());
+    QCOMPARE(root.childCount(), qsizetype(6));
+    checkRows(root);
+
+    root.remove(inserted);
+    QCOMPARE(root.childCount(), qsizetype(5));
+    QCOMPARE(root.child(1)->value, 1);
+    checkRows(root);
+
+    root.remove(0);
+    QCOMPARE(root.child(0)->value, 1);
+    checkRows(root);
+
+    // items of other parents are ignored
+    Item other;
+    root.remove(other.createChild());
+    QCOMPARE(root.childCount(), qsizetype(4));
+}
+
+void TestTreeModelItem::arena()
+{
+    TreeModelItem<Item>::Arena arena(4);
+    {
+        Item root;
+        root.setArena(&arena);
+        for (int i = 0; i < 10; ++i) {
+            const auto child = root.createChild();
+            QCOMPARE(child->arena(), &arena);
+            child->createChild()->value = i;
+        }
+        checkRows(root);
+        QCOMPARE(root.child(9)->child(0)->value, 9);
+
+        // freed items are reused
+        const auto removed = root.child(3).get();
+        root.remove(3);
+        QCOMPARE(root.createChild().get(), removed);
+        checkRows(root);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestTreeModelItem)
+
+#include "test_treemodelitem.moc"
@@ -0,0 +1,152 @@
+#include <TextureLib/TextureIO>
+
+#include <QtTest/QtTest>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QTemporaryFile>
+
+#include "testhelpers.h"
+
+using namespace TestHelpers;
+
+Q_DECLARE_METATYPE(Texture)
+
+class TestTvc: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void roundtrip_data();
+    void roundtrip();
+    void compressed();
+    void corrupted();
+};
+
+namespace {
+
+constexpr auto mimeType = u"image/x-tvc";
+
+} // namespace
+
+void TestTvc::initTestCase()
+{
+    qApp->addLibraryPath(qApp->applicationDirPath() + TextureIO::pluginsDirPath());
+    Q_INIT_RESOURCE(extramimetypes);
+}
+
+void TestTvc::roundtrip_data()
+{
+    QTest::addColumn<Texture>("texture");
+
+    QTest::newRow("RGBA8_Unorm")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {1, 1});
+    QTest::newRow("RGB8_Unorm, word aligned, mipmaps")
+            << makeTexture(TextureFormat::RGB8_Unorm, {63, 17}, {7, 1}, Texture::Alignment::Word);
+    QTest::newRow("RGBA8_Unorm, array")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {32, 32}, {6, 4});
+    QTest::newRow("BGRA8_Unorm, cubemap")
+            << makeTexture(TextureFormat::BGRA8_Unorm, {16, 16}, {Texture::IsCubemap::Yes, 5, 2});
+    QTest::newRow("RGBA16_Float, volume")
+            << makeTexture(TextureFormat::RGBA16_Float, {16, 16, 8}, {5, 1});
+    QTest::newRow("Bc1Rgb_Unorm, mipmaps")
+            << makeTexture(TextureFormat::Bc1Rgb_Unorm, {64, 64}, {7, 1});
+}
+
+void TestTvc::roundtrip()
+{
+    QFETCH(Texture, texture);
+    QVERIFY(!texture.isNull());
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+
+    {
+        TextureIO writer(file.fileName(), mimeType);
+        const auto ok = writer.write(texture);
+        QVERIFY2(ok, qPrintable(toUserString(ok)));
+    }
+
+    // the payload starts at a 4 KB boundary and is stored as is
+    QCOMPARE(qint64(QFileInfo(file.fileName()).size() % 4096), qint64(texture.bytes() % 4096));
+
+    {
+        TextureIO reader(file.fileName(), mimeType);
+        auto result = reader.read();
+        QVERIFY2(result, qPrintable(toUserString(result.error())));
+        QCOMPARE(*result, texture);
+
+        // the file is mapped, so the page-aligned payload is used as is
+        auto mapped = std::move(*result);
+        QCOMPARE(reinterpret_cast<quintptr>(mapped.constData().data()) % 4096, quintptr(0));
+
+        // the mapping is private, modifying the texture doesn't affect the file
+        const auto data = mapped.imageData({});
+        data[0] = uchar(~data[0]);
+        QVERIFY(mapped != texture);
+        TextureIO reader2(file.fileName(), mimeType);
+        QCOMPARE(*reader2.read(), texture);
+    }
+
+    // devices that can't be mapped are read as usual
+    QFile source(file.fileName());
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    auto bytes = source.readAll();
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), mimeType);
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(*result, texture);
+}
+
+void TestTvc::compressed()
+{
+    const auto texture = makeTexture(TextureFormat::RGBA8_Unorm, {256, 256}, {9, 2},
+                                     Texture::Alignment::Byte, Pattern::Runs);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), mimeType);
+    writer.setCompression(6);
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+    QVERIFY(bytes.size() < texture.bytes() / 4);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), mimeType);
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(*result, texture);
+}
+
+void TestTvc::corrupted()
+{
+    const auto texture = makeTexture(TextureFormat::RGBA8_Unorm, {64, 64}, {1, 1});
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(TextureIO(TextureIO::QIODevicePointer(&buffer), mimeType).write(texture));
+    buffer.close();
+
+    bytes[bytes.size() - 1] = char(~bytes[bytes.size() - 1]);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Checksum mismatch for.*"));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), mimeType);
+    QVERIFY(!reader.read());
+
+    bytes.chop(1);
+    buffer.close();
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QTest::ignoreMessage(QtWarningMsg, "File is truncated");
+    TextureIO truncated(TextureIO::QIODevicePointer(&buffer), mimeType);
+    QVERIFY(!truncated.read());
+}
+
+QTEST_MAIN(TestTvc)
+
+#include "test_tvc.moc"
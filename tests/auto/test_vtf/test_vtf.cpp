@@ -1,9 +1,18 @@
+#include <TextureLib/DeviceCursor>
 #include <TextureLib/TextureIO>
 
 #include <QtTest/QtTest>
 
+#include <QtCore/QBuffer>
 #include <QtCore/QMimeDatabase>
 #include <QtCore/QTemporaryFile>
+#include <QtCore/QtEndian>
+
+#include "testhelpers.h"
+
+using namespace TestHelpers;
+
+Q_DECLARE_METATYPE(Texture)
 
 class TestVTF: public QObject
 {
@@ -11,6 +20,15 @@ class TestVTF: public QObject
 
 private slots:
     void initTestCase();
+    void roundtrip_data();
+    void roundtrip();
+    void lowResImage();
+    void lowResImagePacked_data();
+    void lowResImagePacked();
+    void preview_data();
+    void preview();
+    void readCalls_data();
+    void readCalls();
     void benchRead_data();
     void benchRead();
 };
@@ -23,6 +41,209 @@ void TestVTF::initTestCase()
     QLoggingCategory::setFilterRules(QStringLiteral("plugins.textureformats.vtfhandler.debug=false"));
 }
 
+void TestVTF::roundtrip_data()
+{
+    QTest::addColumn<Texture>("texture");
+
+    QTest::newRow("RGBA8_Unorm, mipmaps")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {7, 1}, Texture::Alignment::Byte);
+    QTest::newRow("BGR8_Unorm, word aligned, frames")
+            << makeTexture(TextureFormat::BGR8_Unorm, {8, 2}, {4, 3}, Texture::Alignment::Word);
+    QTest::newRow("Bc1Rgb_Unorm, mipmaps")
+            << makeTexture(TextureFormat::Bc1Rgb_Unorm, {256, 64}, {9, 1}, Texture::Alignment::Byte);
+    QTest::newRow("Bc3_Unorm, cubemap")
+            << makeTexture(TextureFormat::Bc3_Unorm, {32, 32},
+                           {Texture::IsCubemap::Yes, 1, 1}, Texture::Alignment::Byte);
+    QTest::newRow("RGBA16_Float, volume")
+            << makeTexture(TextureFormat::RGBA16_Float, {8, 8, 4}, {4, 1}, Texture::Alignment::Byte);
+}
+
+void TestVTF::roundtrip()
+{
+    QFETCH(Texture, texture);
+    QVERIFY(!texture.isNull());
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    // 7.5 with the low resolution image and the image resources
+    QCOMPARE(qFromLittleEndian<quint32>(bytes.constData() + 4), 7u);
+    QCOMPARE(qFromLittleEndian<quint32>(bytes.constData() + 8), 5u);
+    QCOMPARE(qFromLittleEndian<quint32>(bytes.constData() + 68), 2u);
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QVERIFY(buffer.atEnd());
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestVTF::lowResImage()
+{
+    // a solid color texture without mipmaps, the low resolution image is filtered from level 0
+    auto texture = Texture(TextureFormat::RGBA8_Unorm, {256, 128});
+    const auto data = texture.data();
+    for (qsizetype i = 0; i < data.size(); i += 4) {
+        data[i] = 0xff;
+        data[i + 1] = 0x80;
+        data[i + 2] = 0x00;
+        data[i + 3] = 0xff;
+    }
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+
+    // lowResImageFormat, lowResImageWidth and lowResImageHeight
+    QCOMPARE(qFromLittleEndian<quint32>(bytes.constData() + 57), 13u);
+    QCOMPARE(int(uchar(bytes.at(61))), 16);
+    QCOMPARE(int(uchar(bytes.at(62))), 8);
+
+    // the first resource entry points to 4x2 DXT1 blocks of a single color, 0xfc00 in RGB565
+    const auto offset = qFromLittleEndian<quint32>(bytes.constData() + 84);
+    QCOMPARE(offset, 96u);
+    for (int block = 0; block < 8; ++block) {
+        const auto blockData = bytes.constData() + offset + block * 8;
+        QCOMPARE(qFromLittleEndian<quint16>(blockData), quint16(0xfc00));
+        QCOMPARE(qFromLittleEndian<quint16>(blockData + 2), quint16(0xfc00));
+        QCOMPARE(qFromLittleEndian<quint32>(blockData + 4), 0u);
+    }
+}
+
+void TestVTF::lowResImagePacked_data()
+{
+    QTest::addColumn<TextureFormat>("format");
+    QTest::addColumn<int>("red");
+
+    QTest::newRow("BGR565_Unorm") << TextureFormat::BGR565_Unorm << 0xf800;
+    QTest::newRow("RGB565_Unorm") << TextureFormat::RGB565_Unorm << 0x001f;
+    QTest::newRow("BGRA4_Unorm") << TextureFormat::BGRA4_Unorm << 0xff00;
+    QTest::newRow("BGRA5551_Unorm") << TextureFormat::BGRA5551_Unorm << 0xfc00;
+    QTest::newRow("BGRX5551_Unorm") << TextureFormat::BGRX5551_Unorm << 0x7c00;
+}
+
+void TestVTF::lowResImagePacked()
+{
+    QFETCH(TextureFormat, format);
+    QFETCH(int, red);
+
+    // Texture can't read these formats, the writer decodes them itself
+    auto texture = Texture(format, {64, 64});
+    const auto data = texture.data();
+    for (qsizetype i = 0; i < data.size(); i += 2)
+        qToLittleEndian(quint16(red), data.data() + i);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+
+    // 4x4 DXT1 blocks of pure red
+    const auto offset = qFromLittleEndian<quint32>(bytes.constData() + 84);
+    for (int block = 0; block < 16; ++block) {
+        const auto blockData = bytes.constData() + offset + block * 8;
+        QCOMPARE(qFromLittleEndian<quint16>(blockData), quint16(0xf800));
+        QCOMPARE(qFromLittleEndian<quint16>(blockData + 2), quint16(0xf800));
+    }
+}
+
+void TestVTF::preview_data()
+{
+    QTest::addColumn<Texture>("texture");
+    QTest::addColumn<int>("previewSize");
+    QTest::addColumn<int>("level");
+
+    // level -1 means that no level fits and the low resolution image is expected
+    QTest::newRow("RGBA8_Unorm, mipmaps")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {64, 32}, {7, 1}, Texture::Alignment::Byte)
+            << 16 << 2;
+    QTest::newRow("Bc3_Unorm, cubemap, mipmaps")
+            << makeTexture(TextureFormat::Bc3_Unorm, {32, 32},
+                           {Texture::IsCubemap::Yes, 6, 1}, Texture::Alignment::Byte)
+            << 8 << 2;
+    QTest::newRow("RGBA8_Unorm, no level fits")
+            << makeTexture(TextureFormat::RGBA8_Unorm, {64, 64}, {1, 1}, Texture::Alignment::Byte)
+            << 16 << -1;
+}
+
+void TestVTF::preview()
+{
+    QFETCH(Texture, texture);
+    QFETCH(int, previewSize);
+    QFETCH(int, level);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    TextureIO writer(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto ok = writer.write(texture);
+    QVERIFY2(ok, qPrintable(toUserString(ok)));
+    buffer.close();
+
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    reader.setPreviewSize(previewSize);
+    const auto preview = reader.readPreview();
+    QVERIFY2(preview, qPrintable(toUserString(preview.error())));
+    if (level < 0) {
+        QCOMPARE(preview->format(), TextureFormat::Bc1Rgb_Unorm);
+        QCOMPARE(preview->width(), qsizetype(16));
+        QCOMPARE(preview->height(), qsizetype(16));
+    } else {
+        // cubemap faces are stored starting from the positive Z side
+        const auto side = texture.faces() == 6 ? Texture::Side::PositiveZ : Texture::Side::PositiveX;
+        QCOMPARE(*preview, imageTexture(texture, {side, level, 0}));
+    }
+
+    // The device is moved back, so the whole texture can be read afterwards
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+    QCOMPARE(result->convert(texture.alignment()), texture);
+}
+
+void TestVTF::readCalls_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("7.0") << QStringLiteral(":/vtf/7.0.vtf");
+    QTest::newRow("7.2") << QStringLiteral(":/vtf/RGBA8.vtf");
+    QTest::newRow("7.3") << QStringLiteral(":/vtf/7.3.vtf");
+    QTest::newRow("7.5") << QStringLiteral(":/vtf/7.5.vtf");
+    QTest::newRow("cubemap") << QStringLiteral(":/vtf/cubemap.vtf");
+}
+
+void TestVTF::readCalls()
+{
+    QFETCH(QString, fileName);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    auto bytes = file.readAll();
+
+    CountingBuffer buffer(&bytes);
+    QVERIFY(buffer.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+    TextureIO reader(TextureIO::QIODevicePointer(&buffer), QStringLiteral("image/x-vtf"));
+    const auto result = reader.read();
+    QVERIFY2(result, qPrintable(toUserString(result.error())));
+
+    // Small values are served from the read-ahead buffer, large images are read directly
+    const auto maxReads = 2 * (bytes.size() / DeviceCursor::defaultBufferSize + 2);
+    QVERIFY2(buffer.reads() <= maxReads,
+             qPrintable(QStringLiteral("%1 reads, expected at most %2")
+                        .arg(buffer.reads()).arg(maxReads)));
+}
+
 void TestVTF::benchRead_data()
 {
     QTest::addColumn<QString>("fileName");
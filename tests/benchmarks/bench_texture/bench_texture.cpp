@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <TextureLib/Texture>
+
+#include "benchmarkhelpers.h"
+
+using namespace BenchmarkHelpers;
+
+class BenchTexture : public QObject
+{
+    Q_OBJECT
+private slots:
+    void construct_data();
+    void construct();
+    void convert_data();
+    void convert();
+    void copy_data();
+    void copy();
+    void equals_data();
+    void equals();
+    void toImage_data();
+    void toImage();
+    void dataStream_data();
+    void dataStream();
+};
+
+void BenchTexture::construct_data()
+{
+    addSizeRows();
+}
+
+void BenchTexture::construct()
+{
+    QFETCH(int, size);
+    QFETCH(Texture::ArraySize, dimensions);
+
+    QBENCHMARK {
+        Texture texture(TextureFormat::RGBA8_Unorm, {size, size}, dimensions);
+        QVERIFY(!texture.isNull());
+    }
+}
+
+void BenchTexture::convert_data()
+{
+    QTest::addColumn<TextureFormat>("from");
+    QTest::addColumn<TextureFormat>("to");
+
+    const auto formats = Texture::supportedConvertions();
+    for (const auto from: formats) {
+        for (const auto to: formats) {
+            if (from == to)
+                continue;
+            QTest::newRow(qPrintable(QStringLiteral("%1-%2").arg(toQString(from), toQString(to))))
+                    << from << to;
+        }
+    }
+}
+
+void BenchTexture::convert()
+{
+    QFETCH(TextureFormat, from);
+    QFETCH(TextureFormat, to);
+
+    // the full matrix is big, so a single small image is enough to compare the converters
+    const auto texture = createTexture(from, 256, {1, 1});
+
+    QBENCHMARK {
+        const auto result = texture.convert(to);
+        QVERIFY(!result.isNull());
+    }
+}
+
+void BenchTexture::copy_data()
+{
+    addSizeRows();
+}
+
+void BenchTexture::copy()
+{
+    QFETCH(int, size);
+    QFETCH(Texture::ArraySize, dimensions);
+
+    const auto texture = createTexture(TextureFormat::RGBA8_Unorm, size, dimensions);
+
+    QBENCHMARK {
+        const auto result = texture.copy();
+        QVERIFY(!result.isNull());
+    }
+}
+
+void BenchTexture::equals_data()
+{
+    addSizeRows();
+}
+
+void BenchTexture::equals()
+{
+    QFETCH(int, size);
+    QFETCH(Texture::ArraySize, dimensions);
+
+    // a deep copy, so the comparison can't take a shortcut on the shared data
+    const auto first = createTexture(TextureFormat::RGBA8_Unorm, size, dimensions);
+    const auto second = first.copy();
+
+    QBENCHMARK {
+        QVERIFY(first == second);
+    }
+}
+
+void BenchTexture::toImage_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<TextureFormat>("format");
+
+    for (const auto size: benchmarkSizes()) {
+        for (const auto format: {TextureFormat::RGBA8_Unorm,
+                                 TextureFormat::BGRA8_Unorm,
+                                 TextureFormat::RGBA16_Float}) {
+            QTest::newRow(qPrintable(QStringLiteral("%1-%2").arg(size).arg(toQString(format))))
+                    << size << format;
+        }
+    }
+}
+
+void BenchTexture::toImage()
+{
+    QFETCH(int, size);
+    QFETCH(TextureFormat, format);
+
+    const auto texture = createTexture(format, size, {1, 1});
+
+    QBENCHMARK {
+        const auto image = texture.toImage();
+        QVERIFY(!image.isNull());
+    }
+}
+
+void BenchTexture::dataStream_data()
+{
+    addSizeRows();
+}
+
+void BenchTexture::dataStream()
+{
+    QFETCH(int, size);
+    QFETCH(Texture::ArraySize, dimensions);
+
+    const auto texture = createTexture(TextureFormat::RGBA8_Unorm, size, dimensions);
+    QByteArray buffer;
+    buffer.reserve(int(texture.bytes()) + 1024);
+
+    QBENCHMARK {
+        buffer.resize(0);
+        {
+            QDataStream stream(&buffer, QIODevice::WriteOnly);
+            stream << texture;
+        }
+        Texture result;
+        {
+            QDataStream stream(buffer);
+            stream >> result;
+            QCOMPARE(stream.status(), QDataStream::Ok);
+        }
+        QCOMPARE(result.bytes(), texture.bytes());
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchTexture)
+
+#include "bench_texture.moc"
@@ -0,0 +1,154 @@
+#include <QtTest>
+#include <TextureLib/TextureIO>
+#include <TextureLib/private/TextureIOHandlerDatabase>
+
+#include "benchmarkhelpers.h"
+
+using namespace BenchmarkHelpers;
+
+namespace {
+
+// Returns the format the plugin can both read and write, preferring RGBA8
+TextureFormat benchmarkFormat(QStringView mimeType)
+{
+    const auto plugin = TextureIOHandlerDatabase::instance()->plugin(mimeType.toString());
+    if (!plugin)
+        return TextureFormat::Invalid;
+
+    const auto caps = plugin->formatCapabilites(mimeType);
+    const auto isReadWrite = [](const TextureIOHandlerPlugin::FormatCapabilites &cap) {
+        return (cap.capabilities & TextureIOHandlerPlugin::Capability::ReadWrite)
+                == TextureIOHandlerPlugin::Capability::ReadWrite;
+    };
+    for (const auto &cap: caps) {
+        if (cap.format == TextureFormat::RGBA8_Unorm && isReadWrite(cap))
+            return cap.format;
+    }
+    for (const auto &cap: caps) {
+        if (isReadWrite(cap) && !TextureFormatInfo::formatInfo(cap.format).isCompressed())
+            return cap.format;
+    }
+    return TextureFormat::Invalid;
+}
+
+} // namespace
+
+class BenchTextureIO : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void read_data();
+    void read();
+    void write_data();
+    void write();
+
+private:
+    void addRows();
+    Texture createTexture();
+};
+
+void BenchTextureIO::initTestCase()
+{
+    qApp->addLibraryPath(qApp->applicationDirPath() + TextureIO::pluginsDirPath());
+    QLoggingCategory::setFilterRules(QStringLiteral("plugins.textureformats.*.debug=false"));
+}
+
+void BenchTextureIO::addRows()
+{
+    QTest::addColumn<QString>("mimeType");
+    QTest::addColumn<TextureFormat>("format");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<Texture::ArraySize>("dimensions");
+
+    const auto database = TextureIOHandlerDatabase::instance();
+    for (const auto mimeType: database->availableMimeTypes(
+             TextureIOHandlerPlugin::Capability::ReadWrite)) {
+        const auto format = benchmarkFormat(mimeType);
+        if (format == TextureFormat::Invalid)
+            continue;
+
+        for (const auto size: benchmarkSizes()) {
+            for (const auto &shape: shapesFor(size)) {
+                const auto name = QStringLiteral("%1-%2-%3").
+                        arg(mimeType.toString()).arg(size).arg(shape.name);
+                QTest::newRow(qPrintable(name))
+                        << mimeType.toString() << format << size << shape.dimensions;
+            }
+        }
+    }
+}
+
+Texture BenchTextureIO::createTexture()
+{
+    QFETCH(TextureFormat, format);
+    QFETCH(int, size);
+    QFETCH(Texture::ArraySize, dimensions);
+
+    return BenchmarkHelpers::createTexture(format, size, dimensions);
+}
+
+void BenchTextureIO::read_data()
+{
+    addRows();
+}
+
+void BenchTextureIO::read()
+{
+    QFETCH(QString, mimeType);
+    const auto texture = createTexture();
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    {
+        TextureIO io(TextureIO::QIODevicePointer(&buffer), mimeType);
+        if (!io.write(texture))
+            QSKIP("The plugin can't write this texture");
+    }
+    buffer.close();
+
+    // reads from memory, so the disk does not add noise
+    QBENCHMARK {
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        TextureIO io(TextureIO::QIODevicePointer(&buffer), mimeType);
+        const auto result = io.read();
+        QVERIFY2(result, qPrintable(toUserString(result.error())));
+        QCOMPARE(result->bytes(), texture.bytes());
+        buffer.close();
+    }
+}
+
+void BenchTextureIO::write_data()
+{
+    addRows();
+}
+
+void BenchTextureIO::write()
+{
+    QFETCH(QString, mimeType);
+    const auto texture = createTexture();
+
+    QByteArray data;
+    data.reserve(int(texture.bytes()) + 4096);
+    QBuffer buffer(&data);
+
+    {
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        TextureIO io(TextureIO::QIODevicePointer(&buffer), mimeType);
+        if (!io.write(texture))
+            QSKIP("The plugin can't write this texture");
+        buffer.close();
+    }
+
+    QBENCHMARK {
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        TextureIO io(TextureIO::QIODevicePointer(&buffer), mimeType);
+        const auto result = io.write(texture);
+        QVERIFY2(result, qPrintable(toUserString(result.error())));
+        buffer.close();
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchTextureIO)
+
+#include "bench_textureio.moc"
@@ -0,0 +1,102 @@
+#include <QtTest>
+#include <TextureViewCoreLib/TextureDocument>
+#include <TextureViewCoreLib/ThumbnailsModel>
+
+#include "benchmarkhelpers.h"
+
+using TextureViewer::TextureDocument;
+using TextureViewer::ThumbnailsModel;
+
+namespace {
+
+void addLayerRows()
+{
+    // the time per item should stay the same as the number of layers grows
+    BenchmarkHelpers::addIntRows("layers", {1024, 4096, 16384}, QStringLiteral("%1-layers"));
+}
+
+// A tiny texture with two levels, so every layer item has children
+Texture createTexture(int layers)
+{
+    return Texture(TextureFormat::RGBA8_Unorm, {2, 2}, {2, layers});
+}
+
+void fetchAll(ThumbnailsModel &model, const QModelIndex &parent = {})
+{
+    while (model.canFetchMore(parent))
+        model.fetchMore(parent);
+    for (int row = 0; row < model.rowCount(parent); ++row) {
+        const auto index = model.index(row, 0, parent);
+        if (model.hasChildren(index))
+            fetchAll(model, index);
+    }
+}
+
+// Walks the tree the way views do: every index asks for its parent
+int traverse(const ThumbnailsModel &model, const QModelIndex &parent = {})
+{
+    int result = 0;
+    for (int row = 0; row < model.rowCount(parent); ++row) {
+        const auto index = model.index(row, 0, parent);
+        if (model.parent(index) != parent)
+            return -1;
+        result += 1 + traverse(model, index);
+    }
+    return result;
+}
+
+} // namespace
+
+class BenchThumbnailsModel : public QObject
+{
+    Q_OBJECT
+private slots:
+    void fetch_data();
+    void fetch();
+    void traverse_data();
+    void traverse();
+};
+
+void BenchThumbnailsModel::fetch_data()
+{
+    addLayerRows();
+}
+
+void BenchThumbnailsModel::fetch()
+{
+    QFETCH(int, layers);
+
+    TextureDocument document;
+    document.setTexture(createTexture(layers));
+
+    QBENCHMARK {
+        ThumbnailsModel model;
+        model.setDocument(ObserverPointer<TextureDocument>(&document));
+        fetchAll(model);
+        QCOMPARE(model.rowCount(), layers);
+    }
+}
+
+void BenchThumbnailsModel::traverse_data()
+{
+    addLayerRows();
+}
+
+void BenchThumbnailsModel::traverse()
+{
+    QFETCH(int, layers);
+
+    TextureDocument document;
+    document.setTexture(createTexture(layers));
+    ThumbnailsModel model;
+    model.setDocument(ObserverPointer<TextureDocument>(&document));
+    fetchAll(model);
+
+    QBENCHMARK {
+        QCOMPARE(::traverse(model), layers * 3);
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchThumbnailsModel)
+
+#include "bench_thumbnailsmodel.moc"
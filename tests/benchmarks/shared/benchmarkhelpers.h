@@ -0,0 +1,103 @@
+#ifndef BENCHMARKHELPERS_H
+#define BENCHMARKHELPERS_H
+
+#include <QtTest>
+#include <TextureLib/Texture>
+
+#include <initializer_list>
+#include <numeric>
+#include <vector>
+
+Q_DECLARE_METATYPE(Texture::ArraySize)
+
+namespace BenchmarkHelpers {
+
+// Benchmarks up to 8K² by default; set TEXTUREVIEWER_BENCH_MAX_SIZE to limit the memory usage
+inline int maxBenchmarkSize()
+{
+    bool ok = false;
+    const auto result = qEnvironmentVariableIntValue("TEXTUREVIEWER_BENCH_MAX_SIZE", &ok);
+    return ok && result > 0 ? result : 8192;
+}
+
+inline std::vector<int> benchmarkSizes()
+{
+    std::vector<int> result;
+    const auto maxSize = maxBenchmarkSize();
+    for (const auto size: {256, 1024, 4096, 8192}) {
+        if (size <= maxSize)
+            result.push_back(size);
+    }
+    return result;
+}
+
+inline int levelsFor(int size)
+{
+    int result = 1;
+    while (size > 1) {
+        size /= 2;
+        ++result;
+    }
+    return result;
+}
+
+struct Shape
+{
+    const char *name;
+    Texture::ArraySize dimensions;
+};
+
+// Plain, mipmapped, array and cubemap textures of the given size
+inline std::vector<Shape> shapesFor(int size)
+{
+    const auto levels = levelsFor(size);
+    const Shape shapes[] = {
+        {"plain", {1, 1}},
+        {"mips", {levels, 1}},
+        {"array", {levels, 6}},
+        {"cubemap", {Texture::IsCubemap::Yes, levels, 1}},
+    };
+    std::vector<Shape> result;
+    for (const auto &shape: shapes) {
+        // arrays of big textures do not fit the memory of a typical CI machine
+        if (shape.dimensions.layers() * shape.dimensions.faces() > 1 && size > 1024)
+            continue;
+        result.push_back(shape);
+    }
+    return result;
+}
+
+// Adds the "size" and "dimensions" columns with a row per size and shape
+inline void addSizeRows()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<Texture::ArraySize>("dimensions");
+
+    for (const auto size: benchmarkSizes()) {
+        for (const auto &shape: shapesFor(size)) {
+            QTest::newRow(qPrintable(QStringLiteral("%1-%2").arg(size).arg(shape.name)))
+                    << size << shape.dimensions;
+        }
+    }
+}
+
+// Adds a single int column with a row per value; the row names are made from the nameFormat
+inline void addIntRows(const char *column, std::initializer_list<int> values, const QString &nameFormat)
+{
+    QTest::addColumn<int>(column);
+    for (const auto value: values)
+        QTest::newRow(qPrintable(nameFormat.arg(value))) << value;
+}
+
+inline Texture createTexture(TextureFormat format, int size, Texture::ArraySize dimensions)
+{
+    Texture result(format, {size, size}, dimensions);
+    auto data = result.data();
+    // a cheap deterministic pattern, so the contents are not all zeroes
+    std::iota(data.begin(), data.end(), uchar(0));
+    return result;
+}
+
+} // namespace BenchmarkHelpers
+
+#endif // BENCHMARKHELPERS_H